@@ -0,0 +1,120 @@
+package main
+
+import (
+	"bufio"
+	"flag"
+	"fmt"
+	"io"
+	"log"
+	"os"
+	"time"
+
+	"balancing_robot/internal/telemetry"
+)
+
+var reasons = map[uint8]string{
+	telemetry.BBTrigNone:    "none",
+	telemetry.BBTrigTilt:    "tilt",
+	telemetry.BBTrigDisarm:  "disarm",
+	telemetry.BBTrigTimeout: "rc-timeout",
+	telemetry.BBTrigManual:  "manual",
+}
+
+// Requests a blackbox dump from the SAME51 firmware over its XBee link and
+// writes the records as CSV. The serial device must be set up beforehand
+// (e.g. stty raw 460800); with -send=false a capture file is decoded instead.
+func main() {
+	dev := flag.String("dev", "", "serial device of the robot's XBee link, or a capture file")
+	fromFlash := flag.Bool("flash", false, "dump the copy saved in flash instead of SRAM")
+	send := flag.Bool("send", true, "send the dump command (false to decode a capture)")
+	outPath := flag.String("out", "-", "CSV output, - for stdout")
+	timeout := flag.Duration("timeout", 30*time.Second, "give up after this long without the end frame")
+	flag.Parse()
+	if *dev == "" {
+		log.Fatalf("-dev is required")
+	}
+
+	mode := os.O_RDONLY
+	if *send {
+		mode = os.O_RDWR
+	}
+	f, err := os.OpenFile(*dev, mode, 0)
+	if err != nil {
+		log.Fatalf("open %s: %v", *dev, err)
+	}
+	defer f.Close()
+
+	if *send {
+		cmd := "BB\n"
+		if *fromFlash {
+			cmd = "BB:FLASH\n"
+		}
+		if _, err := f.Write([]byte(cmd)); err != nil {
+			log.Fatalf("write: %v", err)
+		}
+	}
+
+	items := make(chan interface{}, 256)
+	r := telemetry.NewReader(f)
+	go func() {
+		defer close(items)
+		for {
+			v, err := r.Next()
+			if err != nil {
+				if err != io.EOF {
+					log.Printf("read: %v", err)
+				}
+				return
+			}
+			items <- v
+		}
+	}()
+
+	var dump telemetry.BBDump
+	deadline := time.After(*timeout)
+collect:
+	for {
+		select {
+		case v, ok := <-items:
+			if !ok || dump.Add(v) {
+				break collect
+			}
+		case <-deadline:
+			log.Printf("timed out after %v", *timeout)
+			break collect
+		}
+	}
+	if !dump.Started {
+		log.Fatalf("no blackbox header received")
+	}
+
+	out := os.Stdout
+	if *outPath != "-" {
+		if out, err = os.Create(*outPath); err != nil {
+			log.Fatalf("create %s: %v", *outPath, err)
+		}
+		defer out.Close()
+	}
+	w := bufio.NewWriter(out)
+	defer w.Flush()
+	fmt.Fprintln(w, "index,t,ax,ay,az,gx,gy,gz,roll,pitch,target_pitch,p,i,d,left,right,latency_us,state,mode,enabled")
+	for _, rec := range dump.Records {
+		en := 0
+		if rec.Enabled {
+			en = 1
+		}
+		fmt.Fprintf(w, "%d,%.3f,%d,%d,%d,%d,%d,%d,%.2f,%.2f,%.2f,%.0f,%.0f,%.0f,%.0f,%.0f,%d,%d,%d,%d\n",
+			rec.Index, float64(rec.Tick)/telemetry.LoopHz,
+			rec.Accel[0], rec.Accel[1], rec.Accel[2], rec.Gyro[0], rec.Gyro[1], rec.Gyro[2],
+			rec.RollDeg, rec.PitchDeg, rec.TargetPitchDeg, rec.PTerm, rec.ITerm, rec.DTerm,
+			rec.Left, rec.Right, rec.LatencyUs, rec.State, rec.Mode, en)
+	}
+
+	src := "sram"
+	if dump.Info.Source == telemetry.BBSrcFlash {
+		src = "flash"
+	}
+	log.Printf("blackbox (%s): %d records, trigger %s at t=%.3f s, %d missing, complete=%v",
+		src, len(dump.Records), reasons[dump.Info.Reason], float64(dump.Info.TriggerTick)/telemetry.LoopHz,
+		dump.Missing(), dump.Complete)
+}
@@ -16,6 +16,8 @@ import (
 	"sync"
 	"syscall"
 	"time"
+
+	"balancing_robot/internal/telemetry"
 )
 
 func main() {
@@ -27,48 +29,12 @@ func main() {
 	motion := flag.String("motion", "", "motion type for imu-streamer (e.g. static for balancing-at-0); overrides config")
 	imuStreamer := flag.String("imu-streamer", "./bin/imu-streamer", "path to imu-streamer binary")
 	sim := flag.String("sim", "./firmware/tools/sim", "path to firmware sim binary")
+	robotDev := flag.String("robot", "", "serial device of the robot's XBee link (binary telemetry); replaces imu-streamer | sim")
+	rcASCII := flag.Bool("rc-ascii", false, "with --robot, send RC as ASCII lines at 20 Hz instead of binary frames at 50 Hz")
 	flag.Parse()
 
-	// Build imu-streamer args
-	imuArgs := []string{"--config", *config, "--duration_s", *durationS}
-	if *motion != "" {
-		imuArgs = append(imuArgs, "--motion", *motion)
-	}
-
-	// Start imu-streamer
-	cmdImu := exec.Command(*imuStreamer, imuArgs...)
-	cmdImu.Stderr = os.Stderr
-	imuOut, err := cmdImu.StdoutPipe()
-	if err != nil {
-		log.Fatalf("imu-streamer stdout pipe: %v", err)
-	}
-	if err := cmdImu.Start(); err != nil {
-		log.Fatalf("imu-streamer start: %v", err)
-	}
-	defer func() {
-		_ = cmdImu.Process.Kill()
-		_ = cmdImu.Wait()
-	}()
-
-	// Start sim: stdin is a pipe so we can merge IMU lines with live RC from the app
-	pipeReader, pipeWriter := io.Pipe()
-	cmdSim := exec.Command(*sim)
-	cmdSim.Stdin = pipeReader
-	cmdSim.Stderr = os.Stderr
-	simOut, err := cmdSim.StdoutPipe()
-	if err != nil {
-		log.Fatalf("sim stdout pipe: %v", err)
-	}
-	if err := cmdSim.Start(); err != nil {
-		log.Fatalf("sim start: %v", err)
-	}
-	defer func() {
-		_ = pipeWriter.Close()
-		_ = cmdSim.Process.Kill()
-		_ = cmdSim.Wait()
-	}()
-
 	// Pending RC: app sends M:throttle,turn or MODE:n; we inject "RC,throttle,turn,enabled,mode"
+	// into the sim, or send "throttle,turn,enabled,mode" to the robot
 	var pendingRCMu sync.Mutex
 	var pendingRC bool
 	var pendingThrottle float64
@@ -80,70 +46,199 @@ func main() {
 	var lastMode int
 	var lastEnabled int
 
-	// Merge goroutine: read imu-streamer, inject any pending RC before each IMU line, write to sim stdin
-	go func() {
-		sc := bufio.NewScanner(imuOut)
-		for sc.Scan() {
-			line := sc.Text()
-			pendingRCMu.Lock()
-			pend := pendingRC
-			th := pendingThrottle
-			tr := pendingTurn
-			md := pendingMode
-			en := pendingEnabled
-			pendingRC = false
-			pendingRCMu.Unlock()
-			if pend {
-				rcLine := fmt.Sprintf("RC,%g,%g,%d,%d\n", th, tr, en, md)
-				if _, err := pipeWriter.Write([]byte(rcLine)); err != nil {
-					return
-				}
-			}
-			if _, err := pipeWriter.Write([]byte(line + "\n")); err != nil {
-				return
-			}
-		}
-		_ = pipeWriter.Close()
-		if err := sc.Err(); err != nil {
-			log.Printf("imu-streamer read: %v", err)
-		}
-	}()
-
-	// Shared latest telemetry (radians from sim; we convert when sending)
+	// Shared latest telemetry (radians; we convert when sending)
 	var mu sync.Mutex
 	latestRoll := 0.0
 	latestPitch := 0.0
 	hasTelemetry := false
 
-	// Sim reader: parse "t,roll,pitch,balance,left,right", skip header, convert later when sending
-	go func() {
-		sc := bufio.NewScanner(simOut)
-		for sc.Scan() {
-			line := sc.Text()
-			if line == "" {
-				continue
+	if *robotDev == "" {
+		// Build imu-streamer args
+		imuArgs := []string{"--config", *config, "--duration_s", *durationS}
+		if *motion != "" {
+			imuArgs = append(imuArgs, "--motion", *motion)
+		}
+
+		// Start imu-streamer
+		cmdImu := exec.Command(*imuStreamer, imuArgs...)
+		cmdImu.Stderr = os.Stderr
+		imuOut, err := cmdImu.StdoutPipe()
+		if err != nil {
+			log.Fatalf("imu-streamer stdout pipe: %v", err)
+		}
+		if err := cmdImu.Start(); err != nil {
+			log.Fatalf("imu-streamer start: %v", err)
+		}
+		defer func() {
+			_ = cmdImu.Process.Kill()
+			_ = cmdImu.Wait()
+		}()
+
+		// Start sim: stdin is a pipe so we can merge IMU lines with live RC from the app
+		pipeReader, pipeWriter := io.Pipe()
+		cmdSim := exec.Command(*sim)
+		cmdSim.Stdin = pipeReader
+		cmdSim.Stderr = os.Stderr
+		simOut, err := cmdSim.StdoutPipe()
+		if err != nil {
+			log.Fatalf("sim stdout pipe: %v", err)
+		}
+		if err := cmdSim.Start(); err != nil {
+			log.Fatalf("sim start: %v", err)
+		}
+		defer func() {
+			_ = pipeWriter.Close()
+			_ = cmdSim.Process.Kill()
+			_ = cmdSim.Wait()
+		}()
+
+		// Merge goroutine: read imu-streamer, inject any pending RC before each IMU line, write to sim stdin
+		go func() {
+			sc := bufio.NewScanner(imuOut)
+			for sc.Scan() {
+				line := sc.Text()
+				pendingRCMu.Lock()
+				pend := pendingRC
+				th := pendingThrottle
+				tr := pendingTurn
+				md := pendingMode
+				en := pendingEnabled
+				pendingRC = false
+				pendingRCMu.Unlock()
+				if pend {
+					rcLine := fmt.Sprintf("RC,%g,%g,%d,%d\n", th, tr, en, md)
+					if _, err := pipeWriter.Write([]byte(rcLine)); err != nil {
+						return
+					}
+				}
+				if _, err := pipeWriter.Write([]byte(line + "\n")); err != nil {
+					return
+				}
 			}
-			// Parse "t,roll,pitch,balance,left,right" (header "t,roll,pitch,..." fails to parse)
-			parts := strings.Split(line, ",")
-			if len(parts) != 6 {
-				continue
+			_ = pipeWriter.Close()
+			if err := sc.Err(); err != nil {
+				log.Printf("imu-streamer read: %v", err)
 			}
-			_, err1 := strconv.ParseFloat(parts[0], 64)
-			roll, err2 := strconv.ParseFloat(parts[1], 64)
-			pitch, err3 := strconv.ParseFloat(parts[2], 64)
-			if err1 != nil || err2 != nil || err3 != nil {
-				continue
+		}()
+
+		// Sim reader: parse "t,roll,pitch,balance,left,right", skip header, convert later when sending
+		go func() {
+			sc := bufio.NewScanner(simOut)
+			for sc.Scan() {
+				line := sc.Text()
+				if line == "" {
+					continue
+				}
+				// Parse "t,roll,pitch,balance,left,right" (header "t,roll,pitch,..." fails to parse)
+				parts := strings.Split(line, ",")
+				if len(parts) != 6 {
+					continue
+				}
+				_, err1 := strconv.ParseFloat(parts[0], 64)
+				roll, err2 := strconv.ParseFloat(parts[1], 64)
+				pitch, err3 := strconv.ParseFloat(parts[2], 64)
+				if err1 != nil || err2 != nil || err3 != nil {
+					continue
+				}
+				mu.Lock()
+				latestRoll = roll
+				latestPitch = pitch
+				hasTelemetry = true
+				mu.Unlock()
 			}
-			mu.Lock()
-			latestRoll = roll
-			latestPitch = pitch
-			hasTelemetry = true
-			mu.Unlock()
-		}
-		if err := sc.Err(); err != nil {
-			log.Printf("sim stdout read: %v", err)
+			if err := sc.Err(); err != nil {
+				log.Printf("sim stdout read: %v", err)
+			}
+		}()
+	} else {
+		// Robot: binary frames in, XBee command lines out (device set up beforehand, e.g. stty raw 460800)
+		dev, err := os.OpenFile(*robotDev, os.O_RDWR, 0)
+		if err != nil {
+			log.Fatalf("robot %s: %v", *robotDev, err)
 		}
-	}()
+		defer dev.Close()
+
+		// RC sender: the firmware disarms after 80 ms without a binary
+		// command (1 s for ASCII lines), so resend at 50 Hz (20 Hz)
+		rcSender := telemetry.NewRCSender(time.Now())
+		go func() {
+			period := 20 * time.Millisecond
+			if *rcASCII {
+				period = 50 * time.Millisecond
+			}
+			ticker := time.NewTicker(period)
+			defer ticker.Stop()
+			for now := range ticker.C {
+				pendingRCMu.Lock()
+				pendingRC = false
+				var msg []byte
+				if *rcASCII {
+					msg = []byte(fmt.Sprintf("%.2f,%.2f,%d,%d\n", lastThrottle, lastTurn, lastEnabled, lastMode))
+				} else {
+					msg = rcSender.Command(lastThrottle, lastTurn, lastEnabled != 0, uint8(lastMode), now)
+				}
+				pendingRCMu.Unlock()
+				if _, err := dev.Write(msg); err != nil {
+					log.Printf("robot write: %v", err)
+					return
+				}
+			}
+		}()
+
+		// Robot reader: decode frames, log ASCII replies and link statistics
+		go func() {
+			r := telemetry.NewReader(dev)
+			lastReport := time.Now()
+			var robotLink telemetry.RCLink
+			// roll and pitch are subscribed at 50 Hz by default; their
+			// CHAN_INFO frames (resent each second) give the ids and scale
+			chans := telemetry.NewChannelSet()
+			for {
+				v, err := r.Next()
+				if err != nil {
+					log.Printf("robot read: %v", err)
+					return
+				}
+				switch f := v.(type) {
+				case telemetry.ChannelInfo:
+					chans.Add(f)
+				case telemetry.Channels:
+					roll, okR := chans.Get(f, "roll")
+					pitch, okP := chans.Get(f, "pitch")
+					if okR && okP {
+						mu.Lock()
+						latestRoll = roll * math.Pi / 180
+						latestPitch = pitch * math.Pi / 180
+						hasTelemetry = true
+						mu.Unlock()
+					}
+				case telemetry.State:
+					mu.Lock()
+					latestRoll = f.RollDeg * math.Pi / 180
+					latestPitch = f.PitchDeg * math.Pi / 180
+					hasTelemetry = true
+					mu.Unlock()
+				case telemetry.RCAck:
+					rcSender.Ack(f, time.Now())
+				case telemetry.RCLink:
+					robotLink = f
+				case string:
+					log.Printf("robot: %s", strings.TrimSpace(f))
+				}
+				if time.Since(lastReport) > 10*time.Second {
+					log.Printf("robot link: frames=%d lost=%d crc=%d malformed=%d",
+						r.Stats.Frames, r.Stats.Lost, r.Stats.CRCErrors, r.Stats.Malformed)
+					if !*rcASCII {
+						st := rcSender.Stats()
+						log.Printf("rc link: sent=%d acked=%d rtt min/avg/max=%v/%v/%v; robot: cmds=%d lost=%d late=%d bad=%d rtt avg/max=%.1f/%.1f ms",
+							st.Sent, st.Acked, st.RTTMin, st.RTTAvg(), st.RTTMax,
+							robotLink.Frames, robotLink.Lost, robotLink.Late, robotLink.Bad, robotLink.RTTAvgMs, robotLink.RTTMaxMs)
+					}
+					lastReport = time.Now()
+				}
+			}
+		}()
+	}
 
 	// TCP listener
 	listener, err := net.Listen("tcp", fmt.Sprintf(":%d", *port))
@@ -151,7 +246,11 @@ func main() {
 		log.Fatalf("listen :%d: %v", *port, err)
 	}
 	defer listener.Close()
-	log.Printf("E2E bridge listening on :%d (telemetry %.0f Hz); imu-streamer | sim running", *port, *telemetryHz)
+	source := "imu-streamer | sim"
+	if *robotDev != "" {
+		source = "robot " + *robotDev
+	}
+	log.Printf("E2E bridge listening on :%d (telemetry %.0f Hz); %s running", *port, *telemetryHz, source)
 
 	// connState: per-connection; streaming gates whether we send R: P: Y: (START/STOP)
 	// disarmed: when true, send fixed R:0 P:armRestPitch Y:0 (resting on arm) instead of sim
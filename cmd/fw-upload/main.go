@@ -0,0 +1,132 @@
+package main
+
+import (
+	"flag"
+	"fmt"
+	"log"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strconv"
+	"time"
+
+	"balancing_robot/internal/boot"
+)
+
+// Uploads the SAME51 firmware through its bootloader over the XBee or a
+// wired UART (firmware_sam/README.md, "Bootloader"). The serial device must
+// be set up beforehand (e.g. stty raw 460800). Both slot images are given;
+// the bootloader's reply decides which one goes. The last image sent to
+// each slot is cached, so the next upload can send deltas against it.
+func main() {
+	dev := flag.String("dev", "", "serial device of the robot's UART")
+	imgA := flag.String("a", "firmware_sam/build/balancing_robot_a.bin", "image linked for slot A")
+	imgB := flag.String("b", "firmware_sam/build/balancing_robot_b.bin", "image linked for slot B")
+	baud := flag.Int("baud", 0, "switch to this baud rate for the transfer (wired links only)")
+	wait := flag.Duration("wait", 3*time.Second, "keep sending HELLO this long (power cycle the robot meanwhile)")
+	run := flag.Bool("run", true, "reset into the new image when done")
+	full := flag.Bool("full", false, "send every page, ignoring what flash holds")
+	cacheDir := flag.String("cache", defaultCache(), "directory for the last image sent to each slot, empty to disable")
+	infoOnly := flag.Bool("info", false, "print the slot states and exit")
+	rollback := flag.Bool("rollback", false, "start the previous image again and exit")
+	flag.Parse()
+	if *dev == "" {
+		log.Fatalf("-dev is required")
+	}
+
+	f, err := os.OpenFile(*dev, os.O_RDWR, 0)
+	if err != nil {
+		log.Fatalf("open %s: %v", *dev, err)
+	}
+	defer f.Close()
+
+	u := boot.NewUploader(f)
+	u.Full = *full
+	if err := u.Enter(); err != nil {
+		log.Fatalf("write: %v", err)
+	}
+	info, err := u.Hello(*wait)
+	if err != nil {
+		log.Fatalf("no bootloader: %v", err)
+	}
+	printInfo(info)
+	if *infoOnly {
+		return
+	}
+	if *rollback {
+		slot, err := u.Rollback()
+		if err != nil {
+			log.Fatalf("rollback: %v", err)
+		}
+		log.Printf("slot %c active", 'A'+slot)
+		if *run {
+			if err := u.Run(); err != nil {
+				log.Fatalf("run: %v", err)
+			}
+		}
+		return
+	}
+
+	slot := info.UploadSlot()
+	path := []string{*imgA, *imgB}[slot]
+	image, err := os.ReadFile(path)
+	if err != nil {
+		log.Fatalf("read %s: %v", path, err)
+	}
+	var previous []byte
+	cache := ""
+	if *cacheDir != "" {
+		cache = filepath.Join(*cacheDir, fmt.Sprintf("slot_%c.bin", 'a'+slot))
+		previous, _ = os.ReadFile(cache)
+	}
+
+	if *baud != 0 {
+		setLocal := func(b int) error {
+			return exec.Command("stty", "-F", *dev, strconv.Itoa(b)).Run()
+		}
+		if err := u.Baud(*baud, setLocal); err != nil {
+			log.Fatalf("baud %d: %v", *baud, err)
+		}
+	}
+
+	log.Printf("uploading %s (%d bytes) to slot %c", path, len(image), 'A'+slot)
+	if err := u.Upload(slot, image, previous); err != nil {
+		log.Fatalf("upload: %v", err)
+	}
+	s := u.Stats
+	log.Printf("%d pages: %d unchanged, %d sent (%d LZ, %d bytes), %d blocks programmed, %d retries, %v",
+		s.Pages, s.Skipped, s.Sent, s.LZ, s.DataBytes, s.Blocks, s.Retries, s.Elapsed.Round(time.Millisecond))
+	if cache != "" {
+		if err := os.MkdirAll(*cacheDir, 0o755); err == nil {
+			err = os.WriteFile(cache, image, 0o644)
+		}
+		if err != nil {
+			log.Printf("cache: %v", err)
+		}
+	}
+	if *run {
+		if err := u.Run(); err != nil {
+			log.Fatalf("run: %v", err)
+		}
+		log.Printf("reset; the new image must reach calibration on its first boot or slot %c starts again",
+			'A'+(slot^1))
+	}
+}
+
+func defaultCache() string {
+	dir, err := os.UserCacheDir()
+	if err != nil {
+		return ""
+	}
+	return filepath.Join(dir, "balancing-robot", "fw-upload")
+}
+
+func printInfo(in boot.Info) {
+	for i := 0; i < 2; i++ {
+		mark := " "
+		if uint8(i) == in.Active {
+			mark = "*"
+		}
+		log.Printf("%s slot %c: %-7s %7d bytes crc %08X", mark, 'A'+i, boot.SlotName(in.State[i]), in.Size[i], in.CRC[i])
+	}
+}
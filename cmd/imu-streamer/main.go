@@ -24,6 +24,7 @@ func main() {
 	udpEnabled := flag.Bool("udp", false, "enable UDP output (overrides config)")
 	udpAddr := flag.String("udp_addr", "", "udp host:port (overrides config)")
 	units := flag.String("units", "", "units: si or deg (overrides config)")
+	format := flag.String("format", "", "stdout format: csv or frame (overrides config)")
 	flag.Parse()
 
 	cfg, err := config.Load(*cfgPath)
@@ -48,6 +49,9 @@ func main() {
 	if *units != "" {
 		cfg.Units = strings.ToLower(*units)
 	}
+	if *format != "" {
+		cfg.Format = strings.ToLower(*format)
+	}
 	if *motionType != "" {
 		cfg.Motion.Type = *motionType
 	}
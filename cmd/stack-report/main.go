@@ -0,0 +1,99 @@
+package main
+
+import (
+	"flag"
+	"fmt"
+	"log"
+	"os"
+	"strings"
+
+	"balancing_robot/internal/stackusage"
+)
+
+// Exception entry pushes 8 words, plus 18 FPU words once the interrupted
+// code has used the FPU, plus one word of alignment padding
+const exceptionFrame = 108
+
+// Prints each function's worst-case stack depth from the .ci files that
+// "make stack-usage" leaves in firmware_sam/build/su (firmware_sam/README.md,
+// "Stack and RAM"), then the worst case for the whole firmware: the
+// deepest chain from Reset_Handler plus the deepest interrupt handler on
+// top of it. Every IRQ runs at the same priority, so handlers do not nest.
+func main() {
+	stack := flag.Int("stack", 0, "usable stack in bytes, 0 to skip the headroom line")
+	top := flag.Int("top", 25, "functions to list, 0 for all")
+	flag.Parse()
+	if flag.NArg() == 0 {
+		log.Fatalf("usage: stack-report [-stack bytes] file.ci...")
+	}
+
+	g := stackusage.NewGraph()
+	for _, path := range flag.Args() {
+		f, err := os.Open(path)
+		if err != nil {
+			log.Fatalf("%v", err)
+		}
+		err = g.Parse(f)
+		f.Close()
+		if err != nil {
+			log.Fatalf("%s: %v", path, err)
+		}
+	}
+	// Pointer calls land in scheduler tasks and callbacks, never in handlers
+	results := g.Analyze(func(name string) bool { return !isHandler(name) })
+
+	sorted := stackusage.ByDepth(results)
+	if *top > 0 && len(sorted) > *top {
+		sorted = sorted[:*top]
+	}
+	fmt.Printf("%6s %6s  %-32s %s\n", "depth", "frame", "function", "location")
+	for _, r := range sorted {
+		fmt.Printf("%6d %6d  %-32s %s%s\n", r.Depth, r.Frame, r.Name, r.Loc, notes(r))
+	}
+
+	reset, ok := results["Reset_Handler"]
+	if !ok {
+		return
+	}
+	var irq *stackusage.Result
+	for name, r := range results {
+		if isHandler(name) && (irq == nil || r.Depth > irq.Depth) {
+			irq = r
+		}
+	}
+	worst := reset.Depth
+	fmt.Printf("\nReset_Handler %d: %s\n", reset.Depth, strings.Join(reset.Path, " > "))
+	if irq != nil {
+		worst += exceptionFrame + irq.Depth
+		fmt.Printf("%s %d + %d exception frame: %s\n", irq.Name, irq.Depth, exceptionFrame, strings.Join(irq.Path, " > "))
+	}
+	fmt.Printf("worst case %d bytes", worst)
+	if *stack > 0 {
+		fmt.Printf(" of %d, headroom %d", *stack, *stack-worst)
+	}
+	fmt.Println()
+}
+
+func isHandler(name string) bool {
+	return strings.HasSuffix(name, "_Handler") && name != "Reset_Handler"
+}
+
+func notes(r *stackusage.Result) string {
+	var n []string
+	if r.Recursive {
+		n = append(n, "recursive")
+	}
+	if r.Dynamic {
+		n = append(n, "dynamic")
+	}
+	if r.Indirect {
+		n = append(n, "indirect")
+	}
+	if len(r.Unknown) > 0 {
+		n = append(n, "unknown: "+strings.Join(r.Unknown, ","))
+	}
+	if len(n) == 0 {
+		return ""
+	}
+	return "  [" + strings.Join(n, "; ") + "]"
+}
@@ -0,0 +1,186 @@
+package main
+
+import (
+	"bufio"
+	"flag"
+	"fmt"
+	"io"
+	"log"
+	"os"
+	"strconv"
+	"strings"
+
+	"balancing_robot/internal/telemetry"
+)
+
+// Decodes the SAME51 binary telemetry stream (a serial device set up with
+// stty, or a capture file) into CSV on stdout, one row per channel frame
+// with blanks for channels not due on that tick. Status frames and ASCII
+// replies go to stderr. With -sub the device is opened read-write and the
+// named channels are subscribed once the firmware has listed them.
+func main() {
+	in := flag.String("in", "-", "serial device or capture file, - for stdin")
+	status := flag.Bool("status", true, "print status frames to stderr")
+	sub := flag.String("sub", "", "channels to subscribe, e.g. roll:500,pitch:500 (needs a device)")
+	flag.Parse()
+
+	subs, err := parseSubs(*sub)
+	if err != nil {
+		log.Fatalf("-sub: %v", err)
+	}
+
+	var src io.Reader = os.Stdin
+	var dev *os.File
+	if *in != "-" {
+		mode := os.O_RDONLY
+		if len(subs) > 0 {
+			mode = os.O_RDWR
+		}
+		f, err := os.OpenFile(*in, mode, 0)
+		if err != nil {
+			log.Fatalf("open %s: %v", *in, err)
+		}
+		defer f.Close()
+		src = f
+		dev = f
+	} else if len(subs) > 0 {
+		log.Fatal("-sub needs -in <device>")
+	}
+	if len(subs) > 0 {
+		if _, err := dev.WriteString("CH\n"); err != nil {
+			log.Fatalf("write: %v", err)
+		}
+	}
+
+	out := bufio.NewWriter(os.Stdout)
+	defer out.Flush()
+
+	set := telemetry.NewChannelSet()
+	var columns []string // fixed by the first channel frame
+	row := map[string]string{}
+
+	r := telemetry.NewReader(src)
+	for {
+		v, err := r.Next()
+		if err != nil {
+			if err != io.EOF {
+				log.Printf("read: %v", err)
+			}
+			break
+		}
+		switch f := v.(type) {
+		case telemetry.ChannelInfo:
+			set.Add(f)
+			// Subscribe each requested channel once, when first described
+			if hz, ok := subs[f.Name]; ok && hz >= 0 {
+				cmd, _ := set.SubscribeCommand(f.Name, hz)
+				if _, err := dev.WriteString(cmd); err != nil {
+					log.Printf("write: %v", err)
+				}
+				subs[f.Name] = -1
+			}
+		case telemetry.ChanPlan:
+			if *status {
+				fmt.Fprintf(os.Stderr, "# seq=%d plan budget=%d planned=%d skipped=%d subscribed=%08X degraded=%08X dropped=%08X\n",
+					f.Seq, f.BudgetBps, f.PlannedBps, f.Skipped, f.Subscribed, f.Degraded, f.Dropped)
+			}
+		case telemetry.Channels:
+			vals := set.Values(f)
+			if columns == nil {
+				if len(vals) == 0 {
+					break
+				}
+				columns = channelColumns(set, f.Mask)
+				fmt.Fprintf(out, "tick,seq,%s\n", strings.Join(columns, ","))
+			}
+			for _, val := range vals {
+				row[val.Name] = strconv.FormatFloat(val.Value, 'f', -1, 64)
+			}
+			fmt.Fprintf(out, "%d,%d", f.Tick, f.Seq)
+			for _, c := range columns {
+				fmt.Fprintf(out, ",%s", row[c])
+			}
+			fmt.Fprintln(out)
+			for k := range row {
+				delete(row, k)
+			}
+		case telemetry.State:
+			// Firmware from before the channel scheduler
+			if columns == nil {
+				columns = []string{}
+				fmt.Fprintln(out, "t,seq,roll,pitch,pitch_rate,target_pitch,balance,left,right,state,mode,enabled")
+			}
+			en := 0
+			if f.Enabled {
+				en = 1
+			}
+			fmt.Fprintf(out, "%.3f,%d,%.2f,%.2f,%.1f,%.2f,%.0f,%.0f,%.0f,%d,%d,%d\n",
+				f.TimeS(), f.Seq, f.RollDeg, f.PitchDeg, f.PitchRateDps, f.TargetPitchDeg,
+				f.Balance, f.Left, f.Right, f.State, f.Mode, en)
+		case telemetry.Status:
+			if *status {
+				fmt.Fprintf(os.Stderr, "# seq=%d lat=%d latmax=%d miss=%d dovr=%d txdrop=%d sg=%d,%d tstep=%d,%d drv=%08X,%08X rxovf=%d rxferr=%d rxdrop=%d\n",
+					f.Seq, f.LatAvgUs, f.LatMaxUs, f.Missed, f.DMAOverruns, f.TxDropped,
+					f.SG[0], f.SG[1], f.TStep[0], f.TStep[1], f.DrvStatus[0], f.DrvStatus[1],
+					f.RxOverruns, f.RxFrameErrs, f.RxDropped)
+			}
+		case telemetry.Shutdown:
+			fmt.Fprintf(os.Stderr, "# seq=%d shutdown retract=%d lower=%d lean=%d off=%d arm_travel=%v lean_pitch=%.2f off_pitch=%.2f\n",
+				f.Seq, f.RetractTick, f.LowerTick, f.LeanTick, f.OffTick, f.ArmTravel(), f.LeanPitch, f.OffPitch)
+		case telemetry.RAM:
+			if *status {
+				fmt.Fprintf(os.Stderr, "# seq=%d ram data=%d bss=%d free=%d noinit=%d stack=%d used=%d headroom=%d faults=%d addr=%08X\n",
+					f.Seq, f.Data, f.BSS, f.Free, f.NoInit, f.Stack, f.StackUsed, f.StackHeadroom(), f.Faults, f.FaultAddr)
+			}
+		case telemetry.RCLink:
+			if *status {
+				fmt.Fprintf(os.Stderr, "# seq=%d rc cmds=%d lost=%d late=%d bad=%d rtt=%.1f rttmax=%.1f\n",
+					f.Seq, f.Frames, f.Lost, f.Late, f.Bad, f.RTTAvgMs, f.RTTMaxMs)
+			}
+		case string:
+			for _, line := range strings.Split(strings.TrimSpace(f), "\n") {
+				fmt.Fprintf(os.Stderr, "# %s\n", strings.TrimSpace(line))
+			}
+		}
+	}
+	fmt.Fprintf(os.Stderr, "# frames=%d lost=%d crc=%d malformed=%d\n",
+		r.Stats.Frames, r.Stats.Lost, r.Stats.CRCErrors, r.Stats.Malformed)
+}
+
+// parseSubs reads "name:hz,name:hz".
+func parseSubs(s string) (map[string]int, error) {
+	subs := map[string]int{}
+	if s == "" {
+		return subs, nil
+	}
+	for _, item := range strings.Split(s, ",") {
+		name, hz, ok := strings.Cut(strings.TrimSpace(item), ":")
+		if !ok {
+			return nil, fmt.Errorf("%q: want name:hz", item)
+		}
+		n, err := strconv.Atoi(hz)
+		if err != nil || n < 0 {
+			return nil, fmt.Errorf("%q: bad rate", item)
+		}
+		subs[name] = n
+	}
+	return subs, nil
+}
+
+// channelColumns names every described channel, so channels subscribed
+// later still get a column; those in the first frame come first.
+func channelColumns(set *telemetry.ChannelSet, first uint32) []string {
+	var cols, rest []string
+	for id := 0; id < 32; id++ {
+		info, ok := set.ByID(uint8(id))
+		if !ok {
+			continue
+		}
+		if first&(1<<id) != 0 {
+			cols = append(cols, info.Name)
+		} else {
+			rest = append(rest, info.Name)
+		}
+	}
+	return append(cols, rest...)
+}
@@ -5,17 +5,43 @@
 
 #include "spi.h"
 
-// Adjust CS pins to your wiring.
-#define ACCEL_CS_PORT PORTB
-#define ACCEL_CS_PIN 0
-#define GYRO_CS_PORT PORTB
-#define GYRO_CS_PIN 1
+// Adjust CS pins to your wiring (the AVR64DD32 has no PORTB).
+#define ACCEL_CS_PORT PORTD
+#define ACCEL_CS_PIN 4
+#define GYRO_CS_PORT PORTD
+#define GYRO_CS_PIN 5
 
-#define BMI088_ACCEL_CHIP_ID 0x00
-#define BMI088_GYRO_CHIP_ID 0x00
+// BMI088 register addresses
+#define BMI088_ACC_CHIP_ID   0x00
+#define BMI088_ACC_DATA      0x12
+#define BMI088_ACC_CONF      0x40
+#define BMI088_ACC_RANGE     0x41
+#define BMI088_ACC_PWR_CONF  0x7C
+#define BMI088_ACC_PWR_CTRL  0x7D
+#define BMI088_ACC_SOFTRESET 0x7E
 
-#define BMI088_ACCEL_X_LSB 0x12
-#define BMI088_GYRO_X_LSB 0x02
+#define BMI088_GYR_CHIP_ID   0x00
+#define BMI088_GYR_DATA      0x02
+#define BMI088_GYR_RANGE     0x0F
+#define BMI088_GYR_BANDWIDTH 0x10
+#define BMI088_GYR_SOFTRESET 0x14
+
+#define BMI088_ACC_CHIP_ID_VAL 0x1E
+#define BMI088_GYR_CHIP_ID_VAL 0x0F
+#define BMI088_SOFTRESET_CMD   0xB6
+
+// Accel 400 Hz with OSR4 (about 40 Hz bandwidth), gyro 400 Hz with a
+// 47 Hz filter: both below the Nyquist frequency of a 100 Hz or faster loop
+#define ACC_CONF_400HZ_OSR4  0x8A
+#define ACC_RANGE_3G         0x00
+#define GYR_RANGE_2000DPS    0x00
+#define GYR_BW_400HZ_47HZ    0x03
+
+#define POR_TIMEOUT_MS 50  // gyro answers 30 ms after power-on or reset
+
+// +-3 g and +-2000 deg/s over the int16 range
+#define ACCEL_SCALE (3.0f * 9.80665f / 32768.0f)
+#define GYRO_SCALE  (2000.0f / 32768.0f * 3.14159265f / 180.0f)
 
 static inline void cs_accel_low(void) { ACCEL_CS_PORT.OUTCLR = (1 << ACCEL_CS_PIN); }
 static inline void cs_accel_high(void) { ACCEL_CS_PORT.OUTSET = (1 << ACCEL_CS_PIN); }
@@ -30,6 +56,9 @@ static void read_regs(uint8_t reg, uint8_t *buf, uint8_t len, uint8_t accel) {
 		cs_gyro_low();
 	}
 	spi_transfer(reg | 0x80);
+	if (accel) {
+		spi_transfer(0x00); // the accel sends a dummy byte first
+	}
 	for (i = 0; i < len; i++) {
 		buf[i] = spi_transfer(0x00);
 	}
@@ -55,23 +84,56 @@ static void write_reg(uint8_t reg, uint8_t val, uint8_t accel) {
 	}
 }
 
-void bmi088_init(void) {
+static uint8_t read_reg(uint8_t reg, uint8_t accel) {
+	uint8_t v = 0;
+	read_regs(reg, &v, 1, accel);
+	return v;
+}
+
+static bool wait_gyro_id(void) {
+	for (uint8_t ms = 0; ms < POR_TIMEOUT_MS; ms++) {
+		if (read_reg(BMI088_GYR_CHIP_ID, 0) == BMI088_GYR_CHIP_ID_VAL) {
+			return true;
+		}
+		_delay_ms(1);
+	}
+	return false;
+}
+
+bool bmi088_init(void) {
 	ACCEL_CS_PORT.DIRSET = (1 << ACCEL_CS_PIN);
 	GYRO_CS_PORT.DIRSET = (1 << GYRO_CS_PIN);
 	cs_accel_high();
 	cs_gyro_high();
 
-	_delay_ms(10);
+	if (!wait_gyro_id()) {
+		return false;
+	}
+	write_reg(BMI088_ACC_SOFTRESET, BMI088_SOFTRESET_CMD, 1);
+	write_reg(BMI088_GYR_SOFTRESET, BMI088_SOFTRESET_CMD, 0);
+	_delay_ms(1);
+	// The accel starts in I2C mode; a rising CS edge switches it to SPI
+	(void)read_reg(BMI088_ACC_CHIP_ID, 1);
+	if (read_reg(BMI088_ACC_CHIP_ID, 1) != BMI088_ACC_CHIP_ID_VAL || !wait_gyro_id()) {
+		return false;
+	}
+
+	write_reg(BMI088_ACC_PWR_CONF, 0x00, 1); // active mode
+	_delay_us(450);
+	write_reg(BMI088_ACC_PWR_CTRL, 0x04, 1); // accel on
+	_delay_ms(1);
+	write_reg(BMI088_ACC_CONF, ACC_CONF_400HZ_OSR4, 1);
+	write_reg(BMI088_ACC_RANGE, ACC_RANGE_3G, 1);
 
-	// TODO: Configure accelerometer and gyro ranges/ODR based on desired rate.
-	// This is a minimal stub to validate wiring.
-	(void)BMI088_ACCEL_CHIP_ID;
-	(void)BMI088_GYRO_CHIP_ID;
+	write_reg(BMI088_GYR_RANGE, GYR_RANGE_2000DPS, 0);
+	write_reg(BMI088_GYR_BANDWIDTH, GYR_BW_400HZ_47HZ, 0);
+	return read_reg(BMI088_ACC_RANGE, 1) == ACC_RANGE_3G &&
+		   read_reg(BMI088_GYR_RANGE, 0) == GYR_RANGE_2000DPS;
 }
 
 void bmi088_read_accel(int16_t *ax, int16_t *ay, int16_t *az) {
 	uint8_t buf[6];
-	read_regs(BMI088_ACCEL_X_LSB, buf, 6, 1);
+	read_regs(BMI088_ACC_DATA, buf, 6, 1);
 	*ax = (int16_t)((buf[1] << 8) | buf[0]);
 	*ay = (int16_t)((buf[3] << 8) | buf[2]);
 	*az = (int16_t)((buf[5] << 8) | buf[4]);
@@ -79,7 +141,7 @@ void bmi088_read_accel(int16_t *ax, int16_t *ay, int16_t *az) {
 
 void bmi088_read_gyro(int16_t *gx, int16_t *gy, int16_t *gz) {
 	uint8_t buf[6];
-	read_regs(BMI088_GYRO_X_LSB, buf, 6, 0);
+	read_regs(BMI088_GYR_DATA, buf, 6, 0);
 	*gx = (int16_t)((buf[1] << 8) | buf[0]);
 	*gy = (int16_t)((buf[3] << 8) | buf[2]);
 	*gz = (int16_t)((buf[5] << 8) | buf[4]);
@@ -89,3 +151,12 @@ void bmi088_read_sample(bmi088_sample_t *out) {
 	bmi088_read_accel(&out->ax, &out->ay, &out->az);
 	bmi088_read_gyro(&out->gx, &out->gy, &out->gz);
 }
+
+void bmi088_scale(const bmi088_sample_t *raw, bmi088_scaled_t *out) {
+	out->ax = raw->ax * ACCEL_SCALE;
+	out->ay = raw->ay * ACCEL_SCALE;
+	out->az = raw->az * ACCEL_SCALE;
+	out->gx = raw->gx * GYRO_SCALE;
+	out->gy = raw->gy * GYRO_SCALE;
+	out->gz = raw->gz * GYRO_SCALE;
+}
@@ -1,6 +1,7 @@
 #ifndef BMI088_H
 #define BMI088_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef struct {
@@ -8,9 +9,19 @@ typedef struct {
 	int16_t gx, gy, gz;
 } bmi088_sample_t;
 
-void bmi088_init(void);
+// m/s^2 and rad/s
+typedef struct {
+	float ax, ay, az;
+	float gx, gy, gz;
+} bmi088_scaled_t;
+
+// Resets both sensors, switches the accel to SPI, powers it up and sets
+// +-3 g / 400 Hz and +-2000 deg/s / 400 Hz. False if a sensor does not
+// answer with its chip ID.
+bool bmi088_init(void);
 void bmi088_read_accel(int16_t *ax, int16_t *ay, int16_t *az);
 void bmi088_read_gyro(int16_t *gx, int16_t *gy, int16_t *gz);
 void bmi088_read_sample(bmi088_sample_t *out);
+void bmi088_scale(const bmi088_sample_t *raw, bmi088_scaled_t *out);
 
 #endif
@@ -0,0 +1,81 @@
+#include "imu_bench.h"
+
+#include <avr/io.h>
+#include <stdlib.h>
+
+#include "attitude.h"
+#include "control.h"
+#include "imu_input.h"
+#include "uart.h"
+
+#define BENCH_RUNS 32
+#define BENCH_DIV  4  // TCA0 prescaler: cycles per count, 262k cycles per wrap
+
+// The same sample as imu-streamer writes it in each format
+static const char csv_line[] =
+	"12.345600,0.012345,-0.023456,0.003456,0.123456,-0.234567,9.801234\n";
+static const uint8_t bin_frame[IMU_BIN_FRAME] = {
+	0xA5, 0x07, 0x00, 0x61, 0x0C, 0x00, 0xEA, 0xFF, 0x03,
+	0x00, 0x8A, 0x00, 0xFB, 0xFE, 0xA5, 0x2A, 0xFB,
+};
+
+static uint32_t cycles(uint32_t counts) {
+	return counts * BENCH_DIV / BENCH_RUNS;
+}
+
+static void print_result(const char *name, uint32_t v) {
+	char buf[12];
+	uart_write_str(name);
+	uart_write_str(ultoa(v, buf, 10));
+}
+
+void imu_bench_run(void) {
+	TCA0.SINGLE.PER = 0xFFFF;
+	TCA0.SINGLE.CNT = 0;
+	TCA0.SINGLE.CTRLA = TCA_SINGLE_CLKSEL_DIV4_gc | TCA_SINGLE_ENABLE_bm;
+
+	imu_sample_t s;
+	uint32_t csv = 0;
+	imu_csv_parser_t cp;
+	imu_csv_init(&cp);
+	for (uint8_t r = 0; r < BENCH_RUNS; r++) {
+		uint16_t t0 = TCA0.SINGLE.CNT;
+		for (const char *c = csv_line; *c; c++) {
+			imu_csv_feed(&cp, (uint8_t)*c, &s);
+		}
+		csv += (uint16_t)(TCA0.SINGLE.CNT - t0);
+	}
+
+	uint32_t bin = 0;
+	imu_bin_parser_t bp;
+	imu_bin_init(&bp);
+	for (uint8_t r = 0; r < BENCH_RUNS; r++) {
+		uint16_t t0 = TCA0.SINGLE.CNT;
+		for (uint8_t i = 0; i < IMU_BIN_FRAME; i++) {
+			imu_bin_feed(&bp, bin_frame[i], &s);
+		}
+		bin += (uint16_t)(TCA0.SINGLE.CNT - t0);
+	}
+
+	// The per-sample work main() does after calibration
+	uint32_t loop = 0;
+	attitude_filter_t filter;
+	attitude_init(&filter);
+	pid_ctrl_t pid;
+	pid_init(&pid, 2.5f, 0.0f, 0.05f, 10.0f);
+	for (uint8_t r = 0; r < BENCH_RUNS; r++) {
+		float roll, pitch;
+		uint16_t t0 = TCA0.SINGLE.CNT;
+		attitude_update(&filter, s.gx, s.gy, s.gz, s.ax, s.ay, s.az, 0.002f, &roll, &pitch);
+		float balance = pid_update(&pid, -pitch, 0.002f);
+		motor_cmd_t cmd = motor_mix(balance, 0.0f, 0.0f, 10.0f);
+		loop += (uint16_t)(TCA0.SINGLE.CNT - t0);
+		(void)cmd;
+	}
+	TCA0.SINGLE.CTRLA = 0;
+
+	print_result("BENCH csv=", cycles(csv));
+	print_result(" bin=", cycles(bin));
+	print_result(" loop=", cycles(loop));
+	uart_write_str("\r\n");
+}
@@ -0,0 +1,10 @@
+#ifndef IMU_BENCH_H
+#define IMU_BENCH_H
+
+// Times the CSV and binary IMU decoders and one control step on the target
+// and prints "BENCH csv=<n> bin=<n> loop=<n>" in CPU cycles per sample.
+// Built with `make build BENCH=1`; tools/imu_bench turns the numbers into
+// the highest sample rate the loop sustains.
+void imu_bench_run(void);
+
+#endif
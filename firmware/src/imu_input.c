@@ -3,32 +3,37 @@
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef __AVR__
+#include <util/crc16.h>
+#endif
+
 #include "uart.h"
 
 void imu_csv_init(imu_csv_parser_t *p) {
 	p->idx = 0;
 }
 
-static bool parse_line(const char *line, imu_sample_t *out) {
+bool imu_csv_parse(const char *line, imu_sample_t *out) {
 	if (line[0] == 't') {
 		return false; // header
 	}
-	char tmp[128];
+	char tmp[IMU_CSV_LINE];
 	strncpy(tmp, line, sizeof(tmp) - 1);
 	tmp[sizeof(tmp) - 1] = '\0';
 
 	char *save = NULL;
 	char *tok = strtok_r(tmp, ",", &save);
-	float vals[7];
+	float vals[IMU_CSV_FIELDS];
 	int count = 0;
-	while (tok && count < 7) {
+	while (tok && count < IMU_CSV_FIELDS) {
 		vals[count++] = strtof(tok, NULL);
 		tok = strtok_r(NULL, ",", &save);
 	}
-	if (count != 7) {
+	if (count != IMU_CSV_FIELDS) {
 		return false;
 	}
 	out->t = vals[0];
+	out->dt = 0.0f;
 	out->gx = vals[1];
 	out->gy = vals[2];
 	out->gz = vals[3];
@@ -38,21 +43,110 @@ static bool parse_line(const char *line, imu_sample_t *out) {
 	return true;
 }
 
+bool imu_csv_feed(imu_csv_parser_t *p, uint8_t b, imu_sample_t *out) {
+	if (b == '\n' || b == '\r') {
+		if (p->idx == 0) {
+			return false;
+		}
+		p->buf[p->idx] = '\0';
+		p->idx = 0;
+		return imu_csv_parse(p->buf, out);
+	}
+	if (p->idx < sizeof(p->buf) - 1) {
+		p->buf[p->idx++] = (char)b;
+	} else {
+		p->idx = 0;
+	}
+	return false;
+}
+
 bool imu_csv_poll(imu_csv_parser_t *p, imu_sample_t *out) {
 	uint8_t b;
 	while (uart_read_byte(&b)) {
-		if (b == '\n' || b == '\r') {
-			if (p->idx == 0) {
-				continue;
-			}
-			p->buf[p->idx] = '\0';
-			p->idx = 0;
-			return parse_line(p->buf, out);
+		if (imu_csv_feed(p, b, out)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void imu_bin_init(imu_bin_parser_t *p) {
+	memset(p, 0, sizeof(*p));
+}
+
+static uint8_t crc8(const uint8_t *d, uint8_t n) {
+	uint8_t crc = 0;
+	while (n--) {
+#ifdef __AVR__
+		crc = _crc8_ccitt_update(crc, *d++);
+#else
+		crc ^= *d++;
+		for (uint8_t i = 0; i < 8; i++) {
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
 		}
-		if (p->idx < sizeof(p->buf) - 1) {
-			p->buf[p->idx++] = (char)b;
-		} else {
-			p->idx = 0;
+#endif
+	}
+	return crc;
+}
+
+static int16_t get_i16(const uint8_t *d) {
+	return (int16_t)((uint16_t)d[0] | ((uint16_t)d[1] << 8));
+}
+
+// Drop the frame up to the next sync byte after its first one
+static void resync(imu_bin_parser_t *p) {
+	uint8_t i = 1;
+	while (i < p->len && p->buf[i] != IMU_BIN_SYNC) {
+		i++;
+	}
+	p->len -= i;
+	memmove(p->buf, p->buf + i, p->len);
+}
+
+bool imu_bin_feed(imu_bin_parser_t *p, uint8_t b, imu_sample_t *out) {
+	if (p->len == 0 && b != IMU_BIN_SYNC) {
+		return false;
+	}
+	p->buf[p->len++] = b;
+	if (p->len < IMU_BIN_FRAME) {
+		return false;
+	}
+	const uint8_t *f = p->buf;
+	if (crc8(f + 1, IMU_BIN_FRAME - 2) != f[IMU_BIN_FRAME - 1]) {
+		p->crc_errors++;
+		resync(p);
+		return false;
+	}
+	p->len = 0;
+
+	uint16_t stamp = (uint16_t)f[2] | ((uint16_t)f[3] << 8);
+	uint16_t dt_us = 0;
+	if (p->synced) {
+		p->lost += (uint8_t)(f[1] - p->seq - 1);
+		dt_us = stamp - p->stamp;
+	}
+	p->synced = true;
+	p->seq = f[1];
+	p->stamp = stamp;
+	p->t_us += dt_us;
+
+	// Integers up to here; one multiply per axis brings them to SI units
+	out->t = (float)p->t_us * 1e-6f;
+	out->dt = (float)dt_us * 1e-6f;
+	out->gx = (float)get_i16(f + 4) * (1.0f / IMU_BIN_GYRO_LSB);
+	out->gy = (float)get_i16(f + 6) * (1.0f / IMU_BIN_GYRO_LSB);
+	out->gz = (float)get_i16(f + 8) * (1.0f / IMU_BIN_GYRO_LSB);
+	out->ax = (float)get_i16(f + 10) * (1.0f / IMU_BIN_ACCEL_LSB);
+	out->ay = (float)get_i16(f + 12) * (1.0f / IMU_BIN_ACCEL_LSB);
+	out->az = (float)get_i16(f + 14) * (1.0f / IMU_BIN_ACCEL_LSB);
+	return true;
+}
+
+bool imu_bin_poll(imu_bin_parser_t *p, imu_sample_t *out) {
+	uint8_t b;
+	while (uart_read_byte(&b)) {
+		if (imu_bin_feed(p, b, out)) {
+			return true;
 		}
 	}
 	return false;
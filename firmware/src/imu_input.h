@@ -2,19 +2,60 @@
 #define IMU_INPUT_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct {
 	float t;
+	float dt;  // seconds since the previous sample, 0 when the input has no stamp
 	float gx, gy, gz;
 	float ax, ay, az;
 } imu_sample_t;
 
+#define IMU_CSV_LINE   128  // longest line kept, terminator included
+#define IMU_CSV_FIELDS 7
+
 typedef struct {
-	char buf[128];
+	char buf[IMU_CSV_LINE];
 	unsigned int idx;
 } imu_csv_parser_t;
 
 void imu_csv_init(imu_csv_parser_t *p);
+// Parse one complete line without its terminator
+bool imu_csv_parse(const char *line, imu_sample_t *out);
+// Feed one byte. Returns true when it ended a line that parsed into *out.
+bool imu_csv_feed(imu_csv_parser_t *p, uint8_t b, imu_sample_t *out);
 bool imu_csv_poll(imu_csv_parser_t *p, imu_sample_t *out);
 
+// Binary samples (imu-streamer --format frame), IMU_BIN_FRAME bytes each:
+//   0      IMU_BIN_SYNC
+//   1      sequence number, +1 per sample
+//   2..3   time stamp in microseconds modulo 65536, u16 little-endian
+//   4..15  gx,gy,gz,ax,ay,az as int16 little-endian at the BMI088 scales below
+//   16     CRC-8 (poly 0x07, init 0) of bytes 1..15
+// The sync byte is not ASCII, so it never occurs in text lines.
+#define IMU_BIN_SYNC  0xA5
+#define IMU_BIN_FRAME 17
+
+// Counts per rad/s (+-2000 deg/s range) and per m/s^2 (+-3 g range)
+#define IMU_BIN_GYRO_LSB  (32768.0f / (2000.0f * 3.14159265f / 180.0f))
+#define IMU_BIN_ACCEL_LSB (32768.0f / (3.0f * 9.80665f))
+
+typedef struct {
+	uint8_t buf[IMU_BIN_FRAME];
+	uint8_t len;
+	bool synced;        // seq and stamp hold a good frame
+	uint8_t seq;
+	uint16_t stamp;
+	uint32_t t_us;
+	uint16_t crc_errors;
+	uint16_t lost;      // frames missing from the sequence
+} imu_bin_parser_t;
+
+void imu_bin_init(imu_bin_parser_t *p);
+// Feed one byte. Returns true when it completed a frame with a good CRC.
+// A bad frame is dropped and the parser resynchronises on the next
+// IMU_BIN_SYNC inside it.
+bool imu_bin_feed(imu_bin_parser_t *p, uint8_t b, imu_sample_t *out);
+bool imu_bin_poll(imu_bin_parser_t *p, imu_sample_t *out);
+
 #endif
@@ -0,0 +1,132 @@
+#include "input_mux.h"
+
+#include "uart.h"
+
+// Message being received
+#define INPUT_ST_IDLE    0  // at a line end or after a frame
+#define INPUT_ST_NUMERIC 1
+#define INPUT_ST_KEYWORD 2
+#define INPUT_ST_FRAME   3
+#define INPUT_ST_SKIP    4
+
+void input_mux_init(input_mux_t *m) {
+	m->state = INPUT_ST_IDLE;
+	m->commas = 0;
+	m->len = 0;
+	imu_bin_init(&m->bin);
+	rc_init(&m->rc);
+	m->n = (input_counts_t){0};
+}
+
+static bool is_line_end(uint8_t b) {
+	return b == '\n' || b == '\r';
+}
+
+static uint8_t end_numeric(input_mux_t *m, imu_sample_t *imu) {
+	if (m->len >= sizeof(m->line)) {
+		m->n.bad++;
+		return INPUT_NONE;
+	}
+	m->line[m->len] = '\0';
+	if (m->commas == IMU_CSV_FIELDS - 1) {
+		if (imu_csv_parse(m->line, imu)) {
+			m->n.imu++;
+			return INPUT_IMU;
+		}
+		m->n.bad++;
+		return INPUT_NONE;
+	}
+	// RC lines are short; replay the buffer through the streaming parser
+	for (uint8_t i = 0; i < m->len; i++) {
+		rc_feed(&m->rc, (uint8_t)m->line[i]);
+	}
+	if (rc_feed(&m->rc, '\n')) {
+		m->n.rc++;
+		return INPUT_RC;
+	}
+	m->n.bad++;
+	return INPUT_NONE;
+}
+
+static uint8_t start_message(input_mux_t *m, uint8_t b) {
+	if (b == IMU_BIN_SYNC) {
+		return INPUT_ST_FRAME;
+	}
+	if ((b >= '0' && b <= '9') || b == '-' || b == '+' || b == '.') {
+		m->commas = 0;
+		m->len = 0;
+		return INPUT_ST_NUMERIC;
+	}
+	if (b >= 'A' && b <= 'Z') {
+		return INPUT_ST_KEYWORD;
+	}
+	return INPUT_ST_SKIP;
+}
+
+uint8_t input_mux_feed(input_mux_t *m, uint8_t b, imu_sample_t *imu) {
+	if (m->state == INPUT_ST_IDLE) {
+		if (is_line_end(b)) {
+			return INPUT_NONE;
+		}
+		m->state = start_message(m, b);
+	}
+
+	switch (m->state) {
+	case INPUT_ST_FRAME:
+		if (imu_bin_feed(&m->bin, b, imu)) {
+			m->state = INPUT_ST_IDLE;
+			m->n.imu++;
+			return INPUT_IMU;
+		}
+		// A bad frame leaves the parser at the next sync byte, if any
+		if (m->bin.len == 0) {
+			m->state = INPUT_ST_IDLE;
+		}
+		return INPUT_NONE;
+	case INPUT_ST_NUMERIC:
+		if (is_line_end(b)) {
+			m->state = INPUT_ST_IDLE;
+			return end_numeric(m, imu);
+		}
+		if (m->len < sizeof(m->line)) {
+			m->line[m->len++] = (char)b;
+		}
+		if (b == ',') {
+			m->commas++;
+		}
+		return INPUT_NONE;
+	case INPUT_ST_KEYWORD:
+		if (rc_feed(&m->rc, b)) {
+			m->state = INPUT_ST_IDLE;
+			m->n.keyword++;
+			return INPUT_RC;
+		}
+		if (is_line_end(b)) {
+			m->state = INPUT_ST_IDLE;
+			m->n.bad++;
+		}
+		return INPUT_NONE;
+	default:
+		if (is_line_end(b)) {
+			m->state = INPUT_ST_IDLE;
+			m->n.skipped++;
+		}
+		return INPUT_NONE;
+	}
+}
+
+bool input_mux_poll(input_mux_t *m, imu_sample_t *imu, rc_cmd_t *rc) {
+	uint8_t b;
+	while (uart_read_byte(&b)) {
+		switch (input_mux_feed(m, b, imu)) {
+		case INPUT_IMU:
+			return true;
+		case INPUT_RC:
+			*rc = m->rc.last;
+			break;
+		default:
+			break;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,47 @@
+#ifndef INPUT_MUX_H
+#define INPUT_MUX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "imu_input.h"
+#include "rc_input.h"
+
+// One reader for everything the host sends on the UART. Each byte is read
+// once and the message it belongs to is classified as it starts:
+//   IMU_BIN_SYNC          binary IMU frame, to the frame parser
+//   'A'..'Z'              ARM, DISARM or MODE:n, to the RC parser
+//   digit, sign or '.'    numeric line, buffered; IMU_CSV_FIELDS fields make
+//                         it an IMU sample, anything else goes to the RC parser
+//   anything else         (the CSV header, noise) dropped to the line end
+
+typedef struct {
+	uint16_t imu;       // IMU samples, CSV or binary
+	uint16_t rc;        // throttle,turn,enable[,mode] lines
+	uint16_t keyword;   // ARM, DISARM, MODE:n
+	uint16_t bad;       // text lines that did not parse or were too long
+	uint16_t skipped;   // header and noise lines
+} input_counts_t;
+
+typedef struct {
+	uint8_t state;      // INPUT_ST_*
+	uint8_t commas;
+	uint8_t len;
+	char line[IMU_CSV_LINE];
+	imu_bin_parser_t bin;   // also holds frame CRC errors and lost frames
+	rc_parser_t rc;
+	input_counts_t n;
+} input_mux_t;
+
+// input_mux_feed results
+#define INPUT_NONE 0
+#define INPUT_IMU  1  // *imu holds a new sample
+#define INPUT_RC   2  // rc.last changed
+
+void input_mux_init(input_mux_t *m);
+uint8_t input_mux_feed(input_mux_t *m, uint8_t b, imu_sample_t *imu);
+// Read the UART until an IMU sample completes or it runs dry. RC updates
+// on the way are copied to *rc. Returns true with a sample in *imu.
+bool input_mux_poll(input_mux_t *m, imu_sample_t *imu, rc_cmd_t *rc);
+
+#endif
@@ -1,3 +1,4 @@
+#include <avr/interrupt.h>
 #include <avr/io.h>
 #include <stdlib.h>
 #include <util/delay.h>
@@ -5,48 +6,97 @@
 #include "attitude.h"
 #include "bmi088.h"
 #include "control.h"
+#include "imu_bench.h"
 #include "imu_input.h"
+#include "input_mux.h"
 #include "rc_input.h"
 #include "spi.h"
 #include "system.h"
+#include "tick.h"
 #include "uart.h"
 
 #ifndef USE_EMULATOR_UART
 #define USE_EMULATOR_UART 1
 #endif
 
+#ifndef CONTROL_HZ
+#define CONTROL_HZ 200
+#endif
+
 #define OUTPUT_EVERY_N 50
+#define COUNTS_EVERY_N 500
+#define TELEMETRY_EVERY_N (CONTROL_HZ / 20)
 #define CALIB_SAMPLES 200
 #define TARGET_PITCH 0.0f
 #define MOTOR_LIMIT 10.0f
 
-static void print_hex16(int16_t v) {
-	const char hex[] = "0123456789ABCDEF";
-	uint16_t u = (uint16_t)v;
-	char out[7];
-	out[0] = '0';
-	out[1] = 'x';
-	out[2] = hex[(u >> 12) & 0xF];
-	out[3] = hex[(u >> 8) & 0xF];
-	out[4] = hex[(u >> 4) & 0xF];
-	out[5] = hex[u & 0xF];
-	out[6] = '\0';
-	uart_write_str(out);
+static void print_count(const char *name, uint16_t v) {
+	char buf[8];
+	uart_write_str(name);
+	uart_write_str(utoa(v, buf, 10));
 }
 
+#if USE_EMULATOR_UART
 static void print_float(float v) {
 	char buf[16];
 	dtostrf(v, 0, 4, buf);
 	uart_write_str(buf);
 }
 
+// Messages of each kind taken off the UART, and what was lost
+static void print_counts(const input_mux_t *m) {
+	print_count("IN imu=", m->n.imu);
+	print_count(" rc=", m->n.rc);
+	print_count(" kw=", m->n.keyword);
+	print_count(" bad=", m->n.bad);
+	print_count(" skip=", m->n.skipped);
+	print_count(" crc=", m->bin.crc_errors);
+	print_count(" lost=", m->bin.lost);
+	print_count(" ovf=", uart_rx_overflows());
+	uart_write_str("\r\n");
+}
+#else
+static void print_milli(const char *name, float v) {
+	char buf[8];
+	uart_write_str(name);
+	uart_write_str(itoa((int16_t)(v * 1000.0f), buf, 10));
+}
+
+// Compact: milliradians and thousandths, integers only
+static void print_telemetry(float roll, float pitch, float balance, const motor_cmd_t *cmd) {
+	print_milli("T ", roll);
+	print_milli(" ", pitch);
+	print_milli(" ", balance);
+	print_milli(" ", cmd->left);
+	print_milli(" ", cmd->right);
+	uart_write_str("\r\n");
+}
+
+// Worst and mean cycles per tick over the last second, the loop rate the
+// worst case allows, and ticks lost to overruns
+static void print_loop(uint32_t busy_max, uint32_t busy_avg, uint16_t overruns) {
+	char buf[12];
+	uart_write_str("LOOP max=");
+	uart_write_str(ultoa(busy_max, buf, 10));
+	uart_write_str(" avg=");
+	uart_write_str(ultoa(busy_avg, buf, 10));
+	uart_write_str(" max_hz=");
+	uart_write_str(ultoa(busy_max ? F_CPU / busy_max : 0, buf, 10));
+	print_count(" over=", overruns);
+	uart_write_str("\r\n");
+}
+#endif
+
 int main(void) {
 	system_init();
 	uart_init(UART_BAUD);
+	sei();
 	spi_init();
-	bmi088_init();
 
 	uart_write_str("IMU firmware ready\r\n");
+#ifdef IMU_BENCH
+	imu_bench_run();
+#endif
 
 	attitude_filter_t filter;
 	attitude_init(&filter);
@@ -54,25 +104,39 @@ int main(void) {
 	pid_init(&pid, 2.5f, 0.0f, 0.05f, 10.0f);
 
 #if USE_EMULATOR_UART
-	imu_csv_parser_t parser;
-	imu_csv_init(&parser);
-	rc_parser_t rc_parser;
-	rc_init(&rc_parser);
+	input_mux_t input;
+	input_mux_init(&input);
 	rc_cmd_t rc = {0};
 	float last_t = 0.0f;
 	unsigned int sample_count = 0;
 	unsigned int calib_count = 0;
 	float roll_offset = 0.0f;
 	float pitch_offset = 0.0f;
-	uart_write_str("UART CSV mode (t,gx,gy,gz,ax,ay,az)\r\n");
+	uart_write_str("UART input: IMU CSV (t,gx,gy,gz,ax,ay,az) or frames, RC lines\r\n");
+#else
+	if (!bmi088_init()) {
+		uart_write_str("BMI088 not responding\r\n");
+		while (1) {
+		}
+	}
+	unsigned int calib_count = 0;
+	float roll_offset = 0.0f;
+	float pitch_offset = 0.0f;
+	uint16_t tick_count = 0;
+	uint16_t overruns = 0;
+	uint32_t busy_max = 0;
+	uint32_t busy_sum = 0;
+	tick_init(CONTROL_HZ);
+	uart_write_str("BMI088 loop at ");
+	print_count("", CONTROL_HZ);
+	uart_write_str(" Hz\r\n");
 #endif
 
 	while (1) {
 #if USE_EMULATOR_UART
-		rc_poll(&rc_parser, &rc);
 		imu_sample_t s;
-		if (imu_csv_poll(&parser, &s)) {
-			float dt = (last_t > 0.0f) ? (s.t - last_t) : (1.0f / 500.0f);
+		if (input_mux_poll(&input, &s, &rc)) {
+			float dt = (s.dt > 0.0f) ? s.dt : (last_t > 0.0f) ? (s.t - last_t) : (1.0f / 500.0f);
 			last_t = s.t;
 
 			float roll = 0.0f;
@@ -114,27 +178,64 @@ int main(void) {
 				print_float(cmd.right);
 				uart_write_str("\r\n");
 			}
+			if ((sample_count % COUNTS_EVERY_N) == 0) {
+				print_counts(&input);
+			}
 		}
 #else
-		bmi088_sample_t s;
-		bmi088_read_sample(&s);
-
-		uart_write_str("ACC ");
-		print_hex16(s.ax);
-		uart_write_str(" ");
-		print_hex16(s.ay);
-		uart_write_str(" ");
-		print_hex16(s.az);
-
-		uart_write_str(" GYR ");
-		print_hex16(s.gx);
-		uart_write_str(" ");
-		print_hex16(s.gy);
-		uart_write_str(" ");
-		print_hex16(s.gz);
-		uart_write_str("\r\n");
-
-		_delay_ms(20);
+		uint8_t ticks = tick_wait();
+		if (ticks > 1) {
+			overruns += ticks - 1;
+		}
+		float dt = ticks * (1.0f / CONTROL_HZ);
+
+		bmi088_sample_t raw;
+		bmi088_scaled_t s;
+		bmi088_read_sample(&raw);
+		bmi088_scale(&raw, &s);
+
+		if (calib_count < CALIB_SAMPLES) {
+			float roll_acc = 0.0f;
+			float pitch_acc = 0.0f;
+			attitude_accel_angles(s.ax, s.ay, s.az, &roll_acc, &pitch_acc);
+			roll_offset += roll_acc;
+			pitch_offset += pitch_acc;
+			calib_count++;
+			if (calib_count == CALIB_SAMPLES) {
+				roll_offset /= (float)CALIB_SAMPLES;
+				pitch_offset /= (float)CALIB_SAMPLES;
+				uart_write_str("Calibration done\r\n");
+			}
+			continue;
+		}
+
+		float roll = 0.0f;
+		float pitch = 0.0f;
+		attitude_update(&filter, s.gx, s.gy, s.gz, s.ax, s.ay, s.az, dt, &roll, &pitch);
+		roll -= roll_offset;
+		pitch -= pitch_offset;
+
+		float balance = pid_update(&pid, TARGET_PITCH - pitch, dt);
+		motor_cmd_t cmd = motor_mix(balance, 0.0f, 0.0f, MOTOR_LIMIT);
+
+		if (++tick_count == CONTROL_HZ) {
+			tick_count = 0;
+		}
+		if (tick_count % TELEMETRY_EVERY_N == 0) {
+			print_telemetry(roll, pitch, balance, &cmd);
+		}
+
+		// What the loop cost, and the rate it could run at
+		uint32_t busy = tick_busy_cycles();
+		busy_sum += busy;
+		if (busy > busy_max) {
+			busy_max = busy;
+		}
+		if (tick_count == 0) {
+			print_loop(busy_max, busy_sum / CONTROL_HZ, overruns);
+			busy_max = 0;
+			busy_sum = 0;
+		}
 #endif
 	}
 }
@@ -1,74 +1,272 @@
 #include "rc_input.h"
 
-#include <stdlib.h>
-#include <string.h>
-
 #include "uart.h"
 
+// Parser states
+#define RC_PS_START   0
+#define RC_PS_KEYWORD 1
+#define RC_PS_NUMBER  2
+#define RC_PS_SKIP    3  // bad byte seen, drop the rest of the line
+
+// Keywords, matched a byte at a time. Ones ending in ':' take numbers.
+#define RC_KW_ARM    0
+#define RC_KW_DISARM 1
+#define RC_KW_MODE   2
+#define RC_KW_COUNT  3
+#define RC_KW_NONE   0xFF
+
+static const char *const keywords[RC_KW_COUNT] = {
+	"ARM", "DISARM", "MODE:",
+};
+
+#define RC_KW_ALL ((uint8_t)((1u << RC_KW_COUNT) - 1))
+
+// Number flags
+#define RC_NUM_DIGITS 0x01
+#define RC_NUM_NEG    0x02
+#define RC_NUM_SIGN   0x04
+#define RC_NUM_DOT    0x08
+
+static const int16_t frac_weight[3] = {100, 10, 1};
+
+static void reset_number(rc_parser_t *p) {
+	p->num_flags = 0;
+	p->num_int = 0;
+	p->num_frac = 0;
+	p->num_fdigits = 0;
+}
+
+static void reset_line(rc_parser_t *p) {
+	p->state = RC_PS_START;
+	p->cmd = RC_KW_NONE;
+	p->kw_len = 0;
+	p->kw_cand = RC_KW_ALL;
+	p->nfields = 0;
+	reset_number(p);
+}
+
 void rc_init(rc_parser_t *p) {
-	p->idx = 0;
+	reset_line(p);
 	p->last.throttle = 0.0f;
 	p->last.turn = 0.0f;
 	p->last.enabled = false;
+	p->last.mode = 0;
+}
+
+static bool is_digit(uint8_t b) {
+	return b >= '0' && b <= '9';
+}
+
+static bool is_number_start(uint8_t b) {
+	return is_digit(b) || b == '-' || b == '+' || b == '.';
 }
 
-static float clamp_unit(float v) {
-	if (v > 1.0f) {
-		return 1.0f;
+static bool is_keyword_char(uint8_t b) {
+	return (b >= 'A' && b <= 'Z') || b == ':';
+}
+
+// Keyword that ends exactly at the bytes seen so far
+static uint8_t keyword_match(const rc_parser_t *p) {
+	for (uint8_t i = 0; i < RC_KW_COUNT; i++) {
+		if ((p->kw_cand & (1u << i)) && keywords[i][p->kw_len] == '\0') {
+			return i;
+		}
 	}
-	if (v < -1.0f) {
-		return -1.0f;
+	return RC_KW_NONE;
+}
+
+static bool keyword_byte(rc_parser_t *p, uint8_t b) {
+	for (uint8_t i = 0; i < RC_KW_COUNT; i++) {
+		if ((p->kw_cand & (1u << i)) && (uint8_t)keywords[i][p->kw_len] != b) {
+			p->kw_cand &= (uint8_t)~(1u << i);
+		}
 	}
-	return v;
+	p->kw_len++;
+	return p->kw_cand != 0;
 }
 
-static bool parse_line(const char *line, rc_cmd_t *out) {
-	// Expected format: "throttle,turn,enable"
-	// Example: "0.10,-0.25,1"
-	char tmp[64];
-	strncpy(tmp, line, sizeof(tmp) - 1);
-	tmp[sizeof(tmp) - 1] = '\0';
+// Store the number just finished. Numeric lines keep thousandths, keyword
+// arguments are plain integers.
+static bool end_field(rc_parser_t *p) {
+	if (!(p->num_flags & RC_NUM_DIGITS) || p->nfields >= RC_MAX_FIELDS) {
+		return false;
+	}
+	int32_t v;
+	if (p->cmd == RC_KW_NONE) {
+		v = p->num_int * RC_FIX_ONE + p->num_frac;
+	} else {
+		if (p->num_flags & RC_NUM_DOT) {
+			return false;
+		}
+		v = p->num_int;
+	}
+	p->field[p->nfields++] = (p->num_flags & RC_NUM_NEG) ? -v : v;
+	reset_number(p);
+	return true;
+}
 
-	char *save = NULL;
-	char *tok = strtok_r(tmp, ",", &save);
-	float vals[3];
-	int count = 0;
-	while (tok && count < 3) {
-		vals[count++] = strtof(tok, NULL);
-		tok = strtok_r(NULL, ",", &save);
+static bool number_byte(rc_parser_t *p, uint8_t b) {
+	if (is_digit(b)) {
+		uint8_t d = (uint8_t)(b - '0');
+		if (p->num_flags & RC_NUM_DOT) {
+			// Digits past the third decimal are dropped
+			if (p->num_fdigits < 3) {
+				p->num_frac = (int16_t)(p->num_frac + d * frac_weight[p->num_fdigits++]);
+			}
+		} else {
+			p->num_int = p->num_int * 10 + d;
+			if (p->num_int > RC_MAX_INT) {
+				return false;
+			}
+		}
+		p->num_flags |= RC_NUM_DIGITS;
+		return true;
 	}
-	if (count != 3) {
+	switch (b) {
+	case '-':
+	case '+':
+		if (p->num_flags) {
+			return false;
+		}
+		p->num_flags = (b == '-') ? (RC_NUM_SIGN | RC_NUM_NEG) : RC_NUM_SIGN;
+		return true;
+	case '.':
+		if (p->num_flags & RC_NUM_DOT) {
+			return false;
+		}
+		p->num_flags |= RC_NUM_DOT;
+		return true;
+	case ',':
+		return end_field(p);
+	default:
 		return false;
 	}
-	out->throttle = clamp_unit(vals[0]);
-	out->turn = clamp_unit(vals[1]);
-	out->enabled = (vals[2] != 0.0f);
+}
+
+static float fix_to_unit(int32_t v) {
+	if (v > RC_FIX_ONE) {
+		v = RC_FIX_ONE;
+	}
+	if (v < -RC_FIX_ONE) {
+		v = -RC_FIX_ONE;
+	}
+	return (float)v * (1.0f / RC_FIX_ONE);
+}
+
+static uint8_t clamp_mode(int32_t mode) {
+	if (mode < 0) {
+		return 0;
+	}
+	if (mode > 255) {
+		return 255;
+	}
+	return (uint8_t)mode;
+}
+
+// "throttle,turn,enable[,mode]", e.g. "0.10,-0.25,1,1"
+static bool apply_numeric(rc_parser_t *p) {
+	if (p->nfields < 3 || p->nfields > 4) {
+		return false;
+	}
+	p->last.throttle = fix_to_unit(p->field[0]);
+	p->last.turn = fix_to_unit(p->field[1]);
+	p->last.enabled = (p->field[2] != 0);
+	p->last.mode = (p->nfields == 4) ? clamp_mode(p->field[3] / RC_FIX_ONE) : 0;
 	return true;
 }
 
+static bool apply_keyword(rc_parser_t *p) {
+	switch (p->cmd) {
+	case RC_KW_ARM:
+		p->last.enabled = true;
+		return true;
+	case RC_KW_DISARM:
+		p->last.enabled = false;
+		return true;
+	case RC_KW_MODE:
+		if (p->nfields != 1) {
+			return false;
+		}
+		p->last.mode = clamp_mode(p->field[0]);
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool end_line(rc_parser_t *p) {
+	bool updated = false;
+	switch (p->state) {
+	case RC_PS_KEYWORD:
+		p->cmd = keyword_match(p);
+		updated = apply_keyword(p);
+		break;
+	case RC_PS_NUMBER:
+		if (!end_field(p)) {
+			p->nfields = 0;
+		}
+		updated = (p->cmd == RC_KW_NONE) ? apply_numeric(p) : apply_keyword(p);
+		break;
+	default:
+		break;
+	}
+	reset_line(p);
+	return updated;
+}
+
+bool rc_feed(rc_parser_t *p, uint8_t b) {
+	if (b == '\n' || b == '\r') {
+		return end_line(p);
+	}
+	if (b == ' ' || b == '\t') {
+		return false;
+	}
+	bool ok = true;
+	switch (p->state) {
+	case RC_PS_START:
+		if (is_number_start(b)) {
+			p->state = RC_PS_NUMBER;
+			ok = number_byte(p, b);
+		} else if (is_keyword_char(b)) {
+			p->state = RC_PS_KEYWORD;
+			ok = keyword_byte(p, b);
+		} else {
+			ok = false;
+		}
+		break;
+	case RC_PS_KEYWORD:
+		if (is_number_start(b)) {
+			// Arguments follow a complete "XXX:" keyword
+			p->cmd = keyword_match(p);
+			ok = (p->cmd == RC_KW_MODE);
+			if (ok) {
+				p->state = RC_PS_NUMBER;
+				ok = number_byte(p, b);
+			}
+		} else {
+			ok = is_keyword_char(b) && keyword_byte(p, b);
+		}
+		break;
+	case RC_PS_NUMBER:
+		ok = number_byte(p, b);
+		break;
+	default:
+		break;
+	}
+	if (!ok) {
+		p->state = RC_PS_SKIP;
+	}
+	return false;
+}
+
 bool rc_poll(rc_parser_t *p, rc_cmd_t *out) {
 	uint8_t b;
 	while (uart_read_byte(&b)) {
-		if (b == '\n' || b == '\r') {
-			if (p->idx == 0) {
-				continue;
+		if (rc_feed(p, b)) {
+			if (out) {
+				*out = p->last;
 			}
-			p->buf[p->idx] = '\0';
-			p->idx = 0;
-			rc_cmd_t parsed;
-			if (parse_line(p->buf, &parsed)) {
-				p->last = parsed;
-				if (out) {
-					*out = parsed;
-				}
-				return true;
-			}
-			return false;
-		}
-		if (p->idx < sizeof(p->buf) - 1) {
-			p->buf[p->idx++] = (char)b;
-		} else {
-			p->idx = 0;
+			return true;
 		}
 	}
 	return false;
@@ -2,20 +2,39 @@
 #define RC_INPUT_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct {
 	float throttle;
 	float turn;
 	bool enabled;
+	uint8_t mode;
 } rc_cmd_t;
 
+// Numbers are parsed as they arrive into fixed-point thousandths, so a
+// line is handled without buffering it and without strtof.
+#define RC_FIX_ONE    1000
+#define RC_MAX_FIELDS 4
+#define RC_MAX_INT    65535  // largest integer part accepted per field
+
 typedef struct {
-	char buf[64];
-	unsigned int idx;
+	uint8_t state;      // RC_PS_*
+	uint8_t cmd;        // matched keyword, RC_KW_NONE for a numeric line
+	uint8_t kw_len;
+	uint8_t kw_cand;    // keywords still matching the bytes seen so far
+	uint8_t nfields;
+	uint8_t num_flags;
+	int32_t num_int;
+	int16_t num_frac;   // thousandths
+	uint8_t num_fdigits;
+	int32_t field[RC_MAX_FIELDS];
 	rc_cmd_t last;
 } rc_parser_t;
 
 void rc_init(rc_parser_t *p);
 bool rc_poll(rc_parser_t *p, rc_cmd_t *out);
+// Feed one byte. Returns true when it completed a command that updated
+// p->last ("throttle,turn,enable[,mode]", ARM, DISARM or MODE:).
+bool rc_feed(rc_parser_t *p, uint8_t b);
 
 #endif
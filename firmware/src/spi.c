@@ -7,8 +7,11 @@ void spi_init(void) {
 	SPI_PORT.DIRCLR = (1 << SPI_MISO_PIN);
 
 	// SPI mode 3 by default; adjust CPOL/CPHA as needed.
-	SPI0.CTRLA = SPI_ENABLE_bm | SPI_MASTER_bm | SPI_PRESC_DIV4_gc;
-	SPI0.CTRLB = SPI_MODE_3_gc;
+	// F_CPU/2: 2 MHz at 4 MHz, well inside the BMI088's 10 MHz
+	SPI0.CTRLA = SPI_ENABLE_bm | SPI_MASTER_bm | SPI_CLK2X_bm | SPI_PRESC_DIV4_gc;
+	// SSD: PA7 is SS on this route and left unconnected; without it a low
+	// level there drops the peripheral out of master mode mid-transfer
+	SPI0.CTRLB = SPI_MODE_3_gc | SPI_SSD_bm;
 }
 
 uint8_t spi_transfer(uint8_t data) {
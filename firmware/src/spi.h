@@ -3,11 +3,12 @@
 
 #include <stdint.h>
 
-// Adjust these pins to match Curiosity Nano routing.
-#define SPI_PORT PORTC
-#define SPI_MOSI_PIN 0
-#define SPI_MISO_PIN 1
-#define SPI_SCK_PIN 2
+// SPI0 default route (PORTMUX), adjust to match Curiosity Nano routing.
+#define SPI_PORT PORTA
+#define SPI_MOSI_PIN 4
+#define SPI_MISO_PIN 5
+#define SPI_SCK_PIN 6
+#define SPI_SS_PIN 7  // unused: SS is disabled (SPI_SSD), chip selects are on PORTD
 
 void spi_init(void);
 uint8_t spi_transfer(uint8_t data);
@@ -0,0 +1,56 @@
+#include "tick.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+
+static volatile uint8_t pending;
+static uint16_t period;
+
+ISR(TCB0_INT_vect) {
+	TCB0.INTFLAGS = TCB_CAPT_bm;
+	if (pending < 0xFF) {
+		pending++;
+	}
+}
+
+void tick_init(uint16_t hz) {
+	period = (uint16_t)(F_CPU / TICK_CLK_DIV / hz);
+	TCB0.CCMP = period - 1;
+	TCB0.CNT = 0;
+	TCB0.CTRLB = TCB_CNTMODE_INT_gc;
+	TCB0.INTFLAGS = TCB_CAPT_bm;
+	TCB0.INTCTRL = TCB_CAPT_bm;
+	TCB0.CTRLA = TCB_CLKSEL_DIV2_gc | TCB_ENABLE_bm;
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	pending = 0;
+}
+
+uint8_t tick_wait(void) {
+	cli();
+	while (pending == 0) {
+		// sei() takes effect after the next instruction, so no tick is
+		// missed between the check and the sleep
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		cli();
+	}
+	uint8_t n = pending;
+	pending = 0;
+	sei();
+	return n;
+}
+
+uint32_t tick_busy_cycles(void) {
+	cli();
+	uint16_t cnt = TCB0.CNT;
+	uint8_t late = pending;
+	if (TCB0.INTFLAGS & TCB_CAPT_bm) {
+		late++;
+		cnt = TCB0.CNT;
+	}
+	sei();
+	return ((uint32_t)late * period + cnt) * TICK_CLK_DIV;
+}
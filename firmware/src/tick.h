@@ -0,0 +1,18 @@
+#ifndef TICK_H
+#define TICK_H
+
+#include <stdint.h>
+
+// Control tick from TCB0 in periodic interrupt mode, counting CLK_PER/2,
+// so rates from 31 Hz up fit its 16-bit period. The core sleeps in idle
+// between ticks.
+#define TICK_CLK_DIV 2
+
+void tick_init(uint16_t hz);
+// Sleep until the next tick. Returns the ticks that passed since the last
+// call: more than 1 means the loop overran.
+uint8_t tick_wait(void);
+// CPU cycles since the current tick began, overran periods included
+uint32_t tick_busy_cycles(void);
+
+#endif
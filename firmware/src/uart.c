@@ -1,6 +1,16 @@
 #include "uart.h"
 
+#include <avr/interrupt.h>
 #include <avr/io.h>
+#include <util/atomic.h>
+
+static volatile uint8_t rx_buf[UART_RX_SIZE];
+static volatile uint8_t rx_head;
+static volatile uint8_t rx_tail;
+static volatile uint16_t rx_overflows;
+static volatile uint8_t tx_buf[UART_TX_SIZE];
+static volatile uint8_t tx_head;
+static volatile uint8_t tx_tail;
 
 static uint16_t baud_to_reg(uint32_t baud) {
 	if (baud == 0) {
@@ -16,13 +26,42 @@ void uart_init(uint32_t baud) {
 
 	UART_USART.BAUD = baud_to_reg(baud);
 	UART_USART.CTRLC = USART_CHSIZE_8BIT_gc;
+	UART_USART.CTRLA = USART_RXCIE_bm;
 	UART_USART.CTRLB = USART_TXEN_bm | USART_RXEN_bm;
 }
 
+ISR(UART_RXC_vect) {
+	uint8_t status = UART_USART.RXDATAH;
+	uint8_t b = UART_USART.RXDATAL;
+	if (status & USART_BUFOVF_bm) {
+		rx_overflows++;
+	}
+	uint8_t next = (uint8_t)((rx_head + 1) & (UART_RX_SIZE - 1));
+	if (next == rx_tail) {
+		rx_overflows++;
+		return;
+	}
+	rx_buf[rx_head] = b;
+	rx_head = next;
+}
+
+ISR(UART_DRE_vect) {
+	uint8_t tail = tx_tail;
+	if (tail == tx_head) {
+		UART_USART.CTRLA &= (uint8_t)~USART_DREIE_bm;
+		return;
+	}
+	UART_USART.TXDATAL = tx_buf[tail];
+	tx_tail = (uint8_t)((tail + 1) & (UART_TX_SIZE - 1));
+}
+
 void uart_write_byte(uint8_t b) {
-	while (!(UART_USART.STATUS & USART_DREIF_bm)) {
+	uint8_t next = (uint8_t)((tx_head + 1) & (UART_TX_SIZE - 1));
+	while (next == tx_tail) {
 	}
-	UART_USART.TXDATAL = b;
+	tx_buf[tx_head] = b;
+	tx_head = next;
+	UART_USART.CTRLA |= USART_DREIE_bm;
 }
 
 void uart_write_str(const char *s) {
@@ -32,9 +71,19 @@ void uart_write_str(const char *s) {
 }
 
 bool uart_read_byte(uint8_t *out) {
-	if (UART_USART.STATUS & USART_RXCIF_bm) {
-		*out = UART_USART.RXDATAL;
-		return true;
+	uint8_t tail = rx_tail;
+	if (tail == rx_head) {
+		return false;
+	}
+	*out = rx_buf[tail];
+	rx_tail = (uint8_t)((tail + 1) & (UART_RX_SIZE - 1));
+	return true;
+}
+
+uint16_t uart_rx_overflows(void) {
+	uint16_t n;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		n = rx_overflows;
 	}
-	return false;
+	return n;
 }
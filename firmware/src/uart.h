@@ -9,10 +9,21 @@
 #define UART_PORT PORTA
 #define UART_TX_PIN 0
 #define UART_RX_PIN 1
+#define UART_RXC_vect USART0_RXC_vect
+#define UART_DRE_vect USART0_DRE_vect
+
+// Received bytes wait here for uart_read_byte; a power of two up to 256.
+// 256 bytes hold 22 ms at 115200 baud, 5 ms at 460800.
+#define UART_RX_SIZE 256
+// Bytes written wait here and go out by interrupt; uart_write_byte only
+// blocks when it is full, so interrupts must be enabled.
+#define UART_TX_SIZE 128
 
 void uart_init(uint32_t baud);
 void uart_write_byte(uint8_t b);
 void uart_write_str(const char *s);
 bool uart_read_byte(uint8_t *out);
+// Bytes lost because the buffer or the USART itself was full
+uint16_t uart_rx_overflows(void);
 
 #endif
@@ -0,0 +1,344 @@
+// Host benchmark for the AVR IMU input: encodes the same samples as
+// imu-streamer CSV lines and as binary frames, checks that imu_input.c
+// decodes both alike (and resynchronises after a corrupted frame) and that
+// input_mux.c sorts a stream mixing both with RC commands, then
+// reports bytes and time per sample and the highest sample rate the UART
+// carries. Given the cycle counts a `make build BENCH=1` firmware prints,
+// it also reports the rate the 4 MHz loop sustains:
+//   make imu-bench BAUD=115200 AVR="BENCH csv=... bin=... loop=..."
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "attitude.h"
+#include "control.h"
+#include "imu_input.h"
+#include "input_mux.h"
+
+#define SAMPLES   2000
+#define RATE_HZ   500.0
+#define PASSES    50
+
+static const uint8_t *rx;
+static size_t rx_len;
+static size_t rx_pos;
+
+bool uart_read_byte(uint8_t *out) {
+	if (rx_pos >= rx_len) {
+		return false;
+	}
+	*out = rx[rx_pos++];
+	return true;
+}
+
+static void feed(const uint8_t *d, size_t n) {
+	rx = d;
+	rx_len = n;
+	rx_pos = 0;
+}
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static uint8_t crc8(const uint8_t *d, size_t n) {
+	uint8_t crc = 0;
+	while (n--) {
+		crc ^= *d++;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+static void put_i16(uint8_t *d, double v) {
+	long r = lround(v);
+	r = r > 32767 ? 32767 : r < -32768 ? -32768 : r;
+	d[0] = (uint8_t)(r & 0xFF);
+	d[1] = (uint8_t)((r >> 8) & 0xFF);
+}
+
+static void encode_frame(uint8_t *f, uint8_t seq, const double v[7]) {
+	uint16_t stamp = (uint16_t)(llround(v[0] * 1e6) & 0xFFFF);
+	f[0] = IMU_BIN_SYNC;
+	f[1] = seq;
+	f[2] = (uint8_t)(stamp & 0xFF);
+	f[3] = (uint8_t)(stamp >> 8);
+	for (int i = 0; i < 3; i++) {
+		put_i16(f + 4 + 2 * i, v[1 + i] * IMU_BIN_GYRO_LSB);
+		put_i16(f + 10 + 2 * i, v[4 + i] * IMU_BIN_ACCEL_LSB);
+	}
+	f[IMU_BIN_FRAME - 1] = crc8(f + 1, IMU_BIN_FRAME - 2);
+}
+
+// A rocking robot, noisy enough that every digit of the CSV is in use
+static void sample_at(int i, double v[7]) {
+	double t = i / RATE_HZ;
+	double pitch = 0.087 * sin(2.0 * M_PI * t);
+	double noise = 0.01 * sin(i * 12.9898);
+	v[0] = t;
+	v[1] = 0.02 + noise;
+	v[2] = 0.087 * 2.0 * M_PI * cos(2.0 * M_PI * t) - 0.01;
+	v[3] = 0.005 - noise;
+	v[4] = -9.80665 * sin(pitch) + 0.05 * noise;
+	v[5] = 0.05 * noise;
+	v[6] = 9.80665 * cos(pitch) - 0.05 * noise;
+}
+
+static char csv[SAMPLES * 80];
+static size_t csv_len;
+static uint8_t bin[SAMPLES * IMU_BIN_FRAME];
+static double ref[SAMPLES][7];
+
+static void build_streams(void) {
+	csv_len = (size_t)sprintf(csv, "t,gx,gy,gz,ax,ay,az\n");
+	for (int i = 0; i < SAMPLES; i++) {
+		sample_at(i, ref[i]);
+		const double *v = ref[i];
+		csv_len += (size_t)sprintf(csv + csv_len, "%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+								   v[0], v[1], v[2], v[3], v[4], v[5], v[6]);
+		encode_frame(bin + i * IMU_BIN_FRAME, (uint8_t)i, v);
+	}
+}
+
+static int check(void) {
+	int bad = 0;
+	imu_csv_parser_t cp;
+	imu_bin_parser_t bp;
+	imu_csv_init(&cp);
+	imu_bin_init(&bp);
+	imu_sample_t a, b;
+	feed((const uint8_t *)csv, csv_len);
+	for (int i = 0; i < SAMPLES; i++) {
+		if (!imu_csv_poll(&cp, &a)) {
+			printf("CSV sample %d missing\n", i);
+			return 1;
+		}
+		size_t pos = rx_pos;
+		feed(bin + i * IMU_BIN_FRAME, IMU_BIN_FRAME);
+		bool got = imu_bin_poll(&bp, &b);
+		feed((const uint8_t *)csv, csv_len);
+		rx_pos = pos;
+		double tol_g = 0.5 / IMU_BIN_GYRO_LSB + 1e-5;
+		double tol_a = 0.5 / IMU_BIN_ACCEL_LSB + 1e-5;
+		if (!got || fabsf(a.gx - b.gx) > tol_g || fabsf(a.gy - b.gy) > tol_g ||
+			fabsf(a.gz - b.gz) > tol_g || fabsf(a.ax - b.ax) > tol_a ||
+			fabsf(a.ay - b.ay) > tol_a || fabsf(a.az - b.az) > tol_a ||
+			(i > 0 && fabsf(b.dt - (float)(1.0 / RATE_HZ)) > 1.5e-6f)) {
+			printf("MISMATCH %d csv %.5f %.5f %.5f %.5f %.5f %.5f  bin %d %.5f %.5f %.5f %.5f %.5f %.5f dt %.6f\n",
+				   i, a.gx, a.gy, a.gz, a.ax, a.ay, a.az,
+				   got, b.gx, b.gy, b.gz, b.ax, b.ay, b.az, b.dt);
+			bad++;
+		}
+	}
+
+	// A flipped bit costs that frame only; dt still spans the gap
+	static uint8_t damaged[4 * IMU_BIN_FRAME];
+	memcpy(damaged, bin, sizeof(damaged));
+	damaged[IMU_BIN_FRAME + 7] ^= 0x10;
+	imu_bin_init(&bp);
+	feed(damaged, sizeof(damaged));
+	int n = 0;
+	float dt_sum = 0.0f;
+	while (imu_bin_poll(&bp, &b)) {
+		n++;
+		dt_sum += b.dt;
+	}
+	if (n != 3 || bp.crc_errors != 1 || bp.lost != 1 ||
+		fabsf(dt_sum - (float)(3.0 / RATE_HZ)) > 3e-6f) {
+		printf("RESYNC frames %d crc_errors %u lost %u dt %.6f\n",
+			   n, bp.crc_errors, bp.lost, dt_sum);
+		bad++;
+	}
+	return bad;
+}
+
+// Samples alternate between CSV and frames, with RC lines, keywords and
+// a header in between, as several writers sharing the port would send them
+#define MIX_SAMPLES 400
+static char mix[MIX_SAMPLES * 100];
+static size_t mix_len;
+static unsigned mix_rc, mix_kw;
+
+static void build_mix(void) {
+	static const char *const kw[] = {"ARM\r\n", "MODE:3\n", "DISARM\n"};
+	uint8_t seq = 0;
+	mix_len = (size_t)sprintf(mix, "t,gx,gy,gz,ax,ay,az\n");
+	for (int i = 0; i < MIX_SAMPLES; i++) {
+		const double *v = ref[i];
+		if (i % 2) {
+			encode_frame((uint8_t *)mix + mix_len, seq++, v);
+			mix_len += IMU_BIN_FRAME;
+		} else {
+			mix_len += (size_t)sprintf(mix + mix_len, "%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\r\n",
+									   v[0], v[1], v[2], v[3], v[4], v[5], v[6]);
+		}
+		if (i % 3 == 0) {
+			mix_len += (size_t)sprintf(mix + mix_len, "%.2f,-0.25,1,%d\n", (i % 200) / 200.0, i % 7);
+			mix_rc++;
+		}
+		if (i % 7 == 0) {
+			mix_len += (size_t)sprintf(mix + mix_len, "%s", kw[(i / 7) % 3]);
+			mix_kw++;
+		}
+	}
+}
+
+static int check_mux(void) {
+	input_mux_t m;
+	input_mux_init(&m);
+	imu_sample_t s;
+	rc_cmd_t rc = {0};
+	int bad = 0;
+	int i = 0;
+	feed((const uint8_t *)mix, mix_len);
+	while (input_mux_poll(&m, &s, &rc)) {
+		const double *v = ref[i];
+		double tol_g = (i % 2) ? 0.5 / IMU_BIN_GYRO_LSB + 1e-5 : 1e-5;
+		double tol_a = (i % 2) ? 0.5 / IMU_BIN_ACCEL_LSB + 1e-5 : 1e-5;
+		if (i >= MIX_SAMPLES || fabs(s.gx - v[1]) > tol_g || fabs(s.gz - v[3]) > tol_g ||
+			fabs(s.ax - v[4]) > tol_a || fabs(s.az - v[6]) > tol_a) {
+			printf("MUX sample %d %.5f %.5f %.5f %.5f\n", i, s.gx, s.gz, s.ax, s.az);
+			bad++;
+		}
+		i++;
+	}
+	if (i != MIX_SAMPLES || m.n.imu != MIX_SAMPLES || m.n.rc != mix_rc || m.n.keyword != mix_kw ||
+		m.n.bad != 0 || m.n.skipped != 1 || m.bin.crc_errors != 0 || m.bin.lost != 0) {
+		printf("MUX imu %u/%d rc %u/%u kw %u/%u bad %u skip %u crc %u lost %u\n",
+			   m.n.imu, MIX_SAMPLES, m.n.rc, mix_rc, m.n.keyword, mix_kw,
+			   m.n.bad, m.n.skipped, m.bin.crc_errors, m.bin.lost);
+		bad++;
+	}
+	return bad;
+}
+
+// Parse every sample of a stream PASSES times; ns per sample
+static double time_csv(void) {
+	imu_csv_parser_t p;
+	imu_sample_t s;
+	imu_csv_init(&p);
+	unsigned long n = 0;
+	double t0 = now_ns();
+	for (int it = 0; it < PASSES; it++) {
+		feed((const uint8_t *)csv, csv_len);
+		while (imu_csv_poll(&p, &s)) {
+			n++;
+		}
+	}
+	return (now_ns() - t0) / (double)n;
+}
+
+static double time_bin(void) {
+	imu_bin_parser_t p;
+	imu_sample_t s;
+	imu_bin_init(&p);
+	unsigned long n = 0;
+	double t0 = now_ns();
+	for (int it = 0; it < PASSES; it++) {
+		feed(bin, sizeof(bin));
+		while (imu_bin_poll(&p, &s)) {
+			n++;
+		}
+	}
+	return (now_ns() - t0) / (double)n;
+}
+
+static double time_mix(void) {
+	input_mux_t m;
+	imu_sample_t s;
+	rc_cmd_t rc;
+	input_mux_init(&m);
+	unsigned long n = 0;
+	double t0 = now_ns();
+	for (int it = 0; it < PASSES; it++) {
+		feed((const uint8_t *)mix, mix_len);
+		while (input_mux_poll(&m, &s, &rc)) {
+			n++;
+		}
+	}
+	return (now_ns() - t0) / (double)n;
+}
+
+static double time_loop(void) {
+	attitude_filter_t filter;
+	pid_ctrl_t pid;
+	attitude_init(&filter);
+	pid_init(&pid, 2.5f, 0.0f, 0.05f, 10.0f);
+	volatile float sink = 0.0f;
+	double t0 = now_ns();
+	for (int it = 0; it < PASSES; it++) {
+		for (int i = 0; i < SAMPLES; i++) {
+			const double *v = ref[i];
+			float roll, pitch;
+			attitude_update(&filter, (float)v[1], (float)v[2], (float)v[3],
+							(float)v[4], (float)v[5], (float)v[6],
+							(float)(1.0 / RATE_HZ), &roll, &pitch);
+			float balance = pid_update(&pid, -pitch, (float)(1.0 / RATE_HZ));
+			motor_cmd_t cmd = motor_mix(balance, 0.0f, 0.0f, 10.0f);
+			sink += cmd.left;
+		}
+	}
+	return (now_ns() - t0) / ((double)PASSES * SAMPLES);
+}
+
+static void report(const char *name, double bytes, double wire_hz, unsigned long parse,
+				   unsigned long loop, double f_cpu) {
+	printf("%-6s %5.1f B/sample  UART %6.0f Hz", name, bytes, wire_hz);
+	if (parse == 0 || loop == 0) {
+		printf("\n");
+		return;
+	}
+	double cpu_hz = f_cpu / (double)(parse + loop);
+	printf("  CPU %6.0f Hz (%lu+%lu cycles)  sustained %6.0f Hz (%s-bound)\n",
+		   cpu_hz, parse, loop, cpu_hz < wire_hz ? cpu_hz : wire_hz,
+		   cpu_hz < wire_hz ? "CPU" : "UART");
+}
+
+int main(int argc, char **argv) {
+	double baud = 115200.0;
+	double f_cpu = 4000000.0;
+	unsigned long avr_csv = 0, avr_bin = 0, avr_loop = 0;
+	for (int i = 1; i < argc; i++) {
+		if (sscanf(argv[i], "baud=%lf", &baud) == 1 || sscanf(argv[i], "f_cpu=%lf", &f_cpu) == 1 ||
+			sscanf(argv[i], "csv=%lu", &avr_csv) == 1 || sscanf(argv[i], "bin=%lu", &avr_bin) == 1 ||
+			sscanf(argv[i], "loop=%lu", &avr_loop) == 1 || strcmp(argv[i], "BENCH") == 0) {
+			continue;
+		}
+		fprintf(stderr, "usage: %s [baud=N] [f_cpu=N] [BENCH csv=N bin=N loop=N]\n", argv[0]);
+		return 2;
+	}
+
+	build_streams();
+	build_mix();
+	if (check() + check_mux() != 0) {
+		return 1;
+	}
+
+	double ns_csv = time_csv();
+	double ns_bin = time_bin();
+	double ns_mix = time_mix();
+	double ns_loop = time_loop();
+	printf("%d samples x %d on the host\n", SAMPLES, PASSES);
+	printf("CSV (strtof)   %7.1f ns/sample\n", ns_csv);
+	printf("binary frame   %7.1f ns/sample  (%.1fx)\n", ns_bin, ns_csv / ns_bin);
+	printf("mixed via mux  %7.1f ns/sample  (half CSV, half frames, plus RC)\n", ns_mix);
+	printf("control step   %7.1f ns/sample\n", ns_loop);
+
+	// 8N1: ten bit times per byte
+	double bytes_csv = (double)csv_len / SAMPLES;
+	double bytes_bin = IMU_BIN_FRAME;
+	printf("\n%.0f baud, %.1f MHz AVR\n", baud, f_cpu / 1e6);
+	report("CSV", bytes_csv, baud / 10.0 / bytes_csv, avr_csv, avr_loop, f_cpu);
+	report("binary", bytes_bin, baud / 10.0 / bytes_bin, avr_bin, avr_loop, f_cpu);
+	if (avr_loop == 0) {
+		printf("(no AVR cycle counts: flash `make build BENCH=1` and pass its BENCH line as AVR=...)\n");
+	}
+	return 0;
+}
@@ -0,0 +1,113 @@
+// Host test for the motion script interpreter (firmware_sam/src/
+// motion_script.c): upload validation, segment sequencing and looping,
+// and the NCO sine against sinf. Build and run with `make ms-test`.
+
+#include <math.h>
+#include <stdio.h>
+
+#include "motion_script.h"
+
+#define DT 0.001f  // 1 kHz control tick
+
+static int failures;
+
+static void expect(int ok, const char *what) {
+	if (!ok) {
+		printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+static void test_upload_bounds(void) {
+	motion_segment_t seg = { 100, 0, 200, 0, 0, 0, 0, 0 };
+	expect(motion_script_upload(0, 0, &seg), "upload slot 0 index 0");
+	expect(!motion_script_upload(MS_USER_SLOTS, 0, &seg), "slot out of range");
+	expect(!motion_script_upload(0, MS_MAX_SEGMENTS, &seg), "index out of range");
+	expect(!motion_script_upload(0, 2, &seg), "index out of order");
+
+	// Values above 255 must not wrap onto slot 0 or restart it at index 0
+	expect(motion_script_upload_line("0,1,100,0,300,0,0,0,0,0"), "MS line index 1");
+	expect(!motion_script_upload_line("256,0,100,0,900,0,0,0,0,0"), "MS slot 256");
+	expect(!motion_script_upload_line("0,256,100,0,900,0,0,0,0,0"), "MS index 256");
+	expect(!motion_script_upload_line("0,2,100,0,40000,0,0,0,0,0"), "MS value over int16");
+	expect(!motion_script_upload_line("-1,0,100,0,0,0,0,0,0,0"), "MS negative slot");
+
+	// Slot 0 still holds the two segments uploaded above
+	motion_script_t s;
+	motion_script_init(&s);
+	float thr, turn, pitch;
+	motion_script_step(&s, MS_USER_MODE_BASE, DT, &thr, &turn, &pitch);
+	expect(fabsf(thr - 0.2f) < 1e-6f, "slot 0 segment 0 intact");
+	for (int i = 0; i < 100; i++) {
+		motion_script_step(&s, MS_USER_MODE_BASE, DT, &thr, &turn, &pitch);
+	}
+	expect(fabsf(thr - 0.3f) < 1e-6f, "slot 0 segment 1 intact");
+}
+
+static void test_sequence(void) {
+	// 50 ms forward, 30 ms turning, then back to the start
+	motion_segment_t a = { 50, 0, 400, 0, 0, 0, 0, 0 };
+	motion_segment_t b = { 30, 0, 0, 0, -250, 0, 100, 0 };
+	expect(motion_script_upload(1, 0, &a), "upload slot 1 segment 0");
+	expect(motion_script_upload(1, 1, &b), "upload slot 1 segment 1");
+
+	motion_script_t s;
+	motion_script_init(&s);
+	float thr, turn, pitch;
+	int ok = 1;
+	for (int tick = 0; tick < 240; tick++) {
+		motion_script_step(&s, MS_USER_MODE_BASE + 1, DT, &thr, &turn, &pitch);
+		int in_a = (tick % 80) < 50;
+		float want_thr = in_a ? 0.4f : 0.0f;
+		float want_turn = in_a ? 0.0f : -0.25f;
+		float want_pitch = in_a ? 0.0f : 100.0f * 3.14159265f / 18000.0f;
+		if (fabsf(thr - want_thr) > 1e-6f || fabsf(turn - want_turn) > 1e-6f ||
+			fabsf(pitch - want_pitch) > 1e-6f) {
+			printf("  tick %d: thr=%f turn=%f pitch=%f\n", tick, thr, turn, pitch);
+			ok = 0;
+			break;
+		}
+	}
+	expect(ok, "segments play in order and loop");
+
+	// Switching mode restarts the script from its first segment
+	motion_script_step(&s, 0, DT, &thr, &turn, &pitch);
+	expect(thr == 0.0f && turn == 0.0f, "manual mode outputs nothing");
+	motion_script_step(&s, MS_USER_MODE_BASE + 1, DT, &thr, &turn, &pitch);
+	expect(fabsf(thr - 0.4f) < 1e-6f, "mode change restarts the script");
+
+	// An empty slot outputs nothing
+	motion_script_step(&s, MS_USER_MODE_BASE + 3, DT, &thr, &turn, &pitch);
+	expect(thr == 0.0f && turn == 0.0f && pitch == 0.0f, "empty slot");
+}
+
+static void test_sine(void) {
+	// Built-in figure-8: turn = 0.25 * sin(2 pi t / 4 s), throttle 0.3
+	motion_script_t s;
+	motion_script_init(&s);
+	float thr, turn, pitch;
+	float max_err = 0.0f;
+	for (int tick = 0; tick < 8000; tick++) {
+		motion_script_step(&s, 2, DT, &thr, &turn, &pitch);
+		float want = 0.25f * sinf(2.0f * 3.14159265f * (float)tick * DT / 4.0f);
+		float err = fabsf(turn - want);
+		if (err > max_err) {
+			max_err = err;
+		}
+	}
+	expect(fabsf(thr - 0.3f) < 1e-6f, "figure-8 throttle");
+	printf("figure-8 turn: max error %.5f over two periods\n", max_err);
+	expect(max_err < 0.002f, "NCO sine within 0.002 of sinf");
+}
+
+int main(void) {
+	test_upload_bounds();
+	test_sequence();
+	test_sine();
+	if (failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("motion script: all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,151 @@
+// Host benchmark for the RC command parser: feeds the same byte stream to
+// rc_input.c and to the old line-buffered strtof parser (rc_legacy.c),
+// checks that both decode every line alike and reports the time per line.
+// Build with `make rc-bench` (SAM parser) or `make rc-bench-avr`.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rc_input.h"
+#include "rc_legacy.h"
+
+#define ITERATIONS 200000
+
+static const char *const corpus[] = {
+	"0.10,-0.25,1,1",
+	"-0.734,0.5,1",
+	"0,0,0,0",
+	"ARM",
+	"0.999,-1.000,1,7",
+	"MODE:3",
+	"1.5,-2,1,12",
+	"-0.05,0.125,1,0",
+	"DISARM",
+	"0.333,0.667,0",
+};
+#define CORPUS_LINES (sizeof(corpus) / sizeof(corpus[0]))
+
+static const uint8_t *rx;
+static size_t rx_len;
+static size_t rx_pos;
+
+bool uart_read_byte(uint8_t *out) {
+	if (rx_pos >= rx_len) {
+		return false;
+	}
+	*out = rx[rx_pos++];
+	return true;
+}
+
+void uart_write_str(const char *s) {
+	(void)s;
+}
+
+bool uart_write(const uint8_t *data, uint16_t len) {
+	(void)data;
+	(void)len;
+	return true;
+}
+
+uint16_t uart_tx_free(void) {
+	return 2048;
+}
+
+// The SAM parser stamps acks with the control tick
+#ifdef RC_BENCH_AVR
+#define RC_POLL(p, out) rc_poll(p, out)
+#else
+#define RC_POLL(p, out) rc_poll(p, out, 0)
+#endif
+
+static void feed(const char *s) {
+	rx = (const uint8_t *)s;
+	rx_len = strlen(s);
+	rx_pos = 0;
+}
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int check(void) {
+	rc_parser_t p;
+	legacy_rc_parser_t lp;
+	rc_init(&p);
+	legacy_rc_init(&lp);
+	int bad = 0;
+	for (size_t i = 0; i < CORPUS_LINES; i++) {
+		char line[80];
+		snprintf(line, sizeof(line), "%s\n", corpus[i]);
+		rc_cmd_t a;
+		legacy_rc_cmd_t b;
+		feed(line);
+		bool got_a = RC_POLL(&p, &a);
+		feed(line);
+		bool got_b = legacy_rc_poll(&lp, &b);
+		if (got_a != got_b || (got_a && (fabsf(a.throttle - b.throttle) > 0.0005f ||
+										 fabsf(a.turn - b.turn) > 0.0005f ||
+										 a.enabled != b.enabled || a.mode != b.mode))) {
+			printf("MISMATCH %-20s new %d %.4f %.4f %d %u  old %d %.4f %.4f %d %u\n",
+				   corpus[i], got_a, a.throttle, a.turn, a.enabled, a.mode,
+				   got_b, b.throttle, b.turn, b.enabled, b.mode);
+			bad++;
+		}
+	}
+	return bad;
+}
+
+int main(void) {
+	if (check() != 0) {
+		return 1;
+	}
+
+	// One stream holding the whole corpus, parsed ITERATIONS times
+	static char stream[1024];
+	size_t n = 0;
+	for (size_t i = 0; i < CORPUS_LINES; i++) {
+		n += (size_t)snprintf(stream + n, sizeof(stream) - n, "%s\n", corpus[i]);
+	}
+
+	rc_parser_t p;
+	rc_cmd_t cmd;
+	rc_init(&p);
+	unsigned long updates = 0;
+	double t0 = now_ns();
+	for (int it = 0; it < ITERATIONS; it++) {
+		feed(stream);
+		while (RC_POLL(&p, &cmd)) {
+			updates++;
+		}
+	}
+	double t_new = now_ns() - t0;
+
+	legacy_rc_parser_t lp;
+	legacy_rc_cmd_t lcmd;
+	legacy_rc_init(&lp);
+	unsigned long legacy_updates = 0;
+	t0 = now_ns();
+	for (int it = 0; it < ITERATIONS; it++) {
+		feed(stream);
+		while (legacy_rc_poll(&lp, &lcmd)) {
+			legacy_updates++;
+		}
+	}
+	double t_old = now_ns() - t0;
+
+	double lines = (double)ITERATIONS * CORPUS_LINES;
+	printf("%zu lines x %d, %zu bytes per pass\n", CORPUS_LINES, ITERATIONS, n);
+	printf("legacy (strtof)  %7.1f ns/line  %5.1f ns/byte  %lu updates\n",
+		   t_old / lines, t_old / (lines * n / CORPUS_LINES), legacy_updates);
+	printf("state machine    %7.1f ns/line  %5.1f ns/byte  %lu updates\n",
+		   t_new / lines, t_new / (lines * n / CORPUS_LINES), updates);
+	printf("speedup          %7.2fx\n", t_old / t_new);
+	return updates == legacy_updates ? 0 : 1;
+}
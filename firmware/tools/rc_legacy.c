@@ -0,0 +1,153 @@
+// The line-buffered strtof/strtol command parser that rc_input.c used
+// before it was rewritten as a byte-at-a-time state machine. Kept only as
+// the baseline for rc_bench and `make rc-size`.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rc_legacy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../firmware_sam/src/motion_script.h"
+
+bool uart_read_byte(uint8_t *out);
+void uart_write_str(const char *s);
+
+void legacy_rc_init(legacy_rc_parser_t *p) {
+	p->idx = 0;
+	p->perf_request = false;
+	p->bb_request = LEGACY_BB_NONE;
+	p->last.throttle = 0.0f;
+	p->last.turn = 0.0f;
+	p->last.enabled = false;
+	p->last.mode = 0;
+}
+
+static float clamp_unit(float v) {
+	if (v > 1.0f) {
+		return 1.0f;
+	}
+	if (v < -1.0f) {
+		return -1.0f;
+	}
+	return v;
+}
+
+static bool parse_line(const char *line, legacy_rc_cmd_t *out) {
+	// Expected format: "throttle,turn,enable[,mode]"
+	// Example: "0.10,-0.25,1,1"
+	char tmp[64];
+	strncpy(tmp, line, sizeof(tmp) - 1);
+	tmp[sizeof(tmp) - 1] = '\0';
+
+	char *save = NULL;
+	char *tok = strtok_r(tmp, ",", &save);
+	float vals[4];
+	int count = 0;
+	while (tok && count < 4) {
+		vals[count++] = strtof(tok, NULL);
+		tok = strtok_r(NULL, ",", &save);
+	}
+	if (count < 3) {
+		return false;
+	}
+	out->throttle = clamp_unit(vals[0]);
+	out->turn = clamp_unit(vals[1]);
+	out->enabled = (vals[2] != 0.0f);
+	if (count >= 4) {
+		int mode = (int)vals[3];
+		if (mode < 0) {
+			mode = 0;
+		}
+		if (mode > 255) {
+			mode = 255;
+		}
+		out->mode = (uint8_t)mode;
+	} else {
+		out->mode = 0;
+	}
+	return true;
+}
+
+bool legacy_rc_poll(legacy_rc_parser_t *p, legacy_rc_cmd_t *out) {
+	uint8_t b;
+	while (uart_read_byte(&b)) {
+		if (b == '\n' || b == '\r') {
+			if (p->idx == 0) {
+				continue;
+			}
+			p->buf[p->idx] = '\0';
+			p->idx = 0;
+			if (strcmp(p->buf, "ARM") == 0) {
+				p->last.enabled = true;
+				if (out) {
+					*out = p->last;
+				}
+				return true;
+			}
+			if (strcmp(p->buf, "DISARM") == 0) {
+				p->last.enabled = false;
+				if (out) {
+					*out = p->last;
+				}
+				return true;
+			}
+			if (strncmp(p->buf, "MODE:", 5) == 0) {
+				int mode = (int)strtol(p->buf + 5, NULL, 10);
+				if (mode < 0) {
+					mode = 0;
+				}
+				if (mode > 255) {
+					mode = 255;
+				}
+				p->last.mode = (uint8_t)mode;
+				if (out) {
+					*out = p->last;
+				}
+				return true;
+			}
+			if (strcmp(p->buf, "PERF") == 0) {
+				p->perf_request = true;
+				continue;
+			}
+			if (strcmp(p->buf, "BB") == 0) {
+				p->bb_request = LEGACY_BB_DUMP;
+				continue;
+			}
+			if (strcmp(p->buf, "BB:FLASH") == 0) {
+				p->bb_request = LEGACY_BB_DUMP_FLASH;
+				continue;
+			}
+			if (strcmp(p->buf, "BB:SAVE") == 0) {
+				p->bb_request = LEGACY_BB_SAVE;
+				continue;
+			}
+			if (strcmp(p->buf, "BB:REARM") == 0) {
+				p->bb_request = LEGACY_BB_REARM;
+				continue;
+			}
+			if (strncmp(p->buf, "MS:", 3) == 0) {
+				// Motion script upload: one segment per line
+				bool ok = motion_script_upload_line(p->buf + 3);
+				uart_write_str(ok ? "MS OK\r\n" : "MS ERR\r\n");
+				continue;
+			}
+			legacy_rc_cmd_t parsed;
+			if (parse_line(p->buf, &parsed)) {
+				p->last = parsed;
+				if (out) {
+					*out = parsed;
+				}
+				return true;
+			}
+			return false;
+		}
+		if (p->idx < sizeof(p->buf) - 1) {
+			p->buf[p->idx++] = (char)b;
+		} else {
+			p->idx = 0;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,31 @@
+#ifndef RC_LEGACY_H
+#define RC_LEGACY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+	float throttle;
+	float turn;
+	bool enabled;
+	uint8_t mode;
+} legacy_rc_cmd_t;
+
+typedef struct {
+	char buf[64];
+	unsigned int idx;
+	legacy_rc_cmd_t last;
+	bool perf_request;
+	uint8_t bb_request;
+} legacy_rc_parser_t;
+
+#define LEGACY_BB_NONE       0
+#define LEGACY_BB_DUMP       1
+#define LEGACY_BB_DUMP_FLASH 2
+#define LEGACY_BB_SAVE       3
+#define LEGACY_BB_REARM      4
+
+void legacy_rc_init(legacy_rc_parser_t *p);
+bool legacy_rc_poll(legacy_rc_parser_t *p, legacy_rc_cmd_t *out);
+
+#endif
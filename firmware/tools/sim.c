@@ -5,6 +5,7 @@
 
 #include "../src/attitude.h"
 #include "../src/control.h"
+#include "../../firmware_sam/src/motion_script.h"
 
 static int parse_line(const char *line,
 					  float *t, float *gx, float *gy, float *gz,
@@ -160,7 +161,7 @@ int main(int argc, char **argv) {
 	float step_acc_left = 0.0f;
 	float step_acc_right = 0.0f;
 	int trace = 0;
-	float script_time = 0.0f;
+	motion_script_t script;
 	int last_mode = 0;
 	int last_enabled = 0;
 	int standup_active = 0;
@@ -170,6 +171,8 @@ int main(int argc, char **argv) {
 	const float rc_timeout_s = 1.0f;
 	const float max_tilt_deg = 40.0f;
 
+	motion_script_init(&script);
+
 	attitude_filter_t filter;
 	attitude_init(&filter);
 	pid_ctrl_t pid;
@@ -238,6 +241,13 @@ int main(int argc, char **argv) {
 		puts("t,roll,pitch,balance,left,right");
 	}
 	while (fgets(line, sizeof(line), stdin)) {
+		/* Motion script upload, same "MS:" payload as the XBee command */
+		if (strncmp(line, "MS:", 3) == 0) {
+			if (!motion_script_upload_line(line + 3)) {
+				fprintf(stderr, "sim: bad motion script line: %s", line);
+			}
+			continue;
+		}
 		/* Live RC from e2e-bridge (app M: command) overrides file-based RC */
 		if (parse_rc_live(line, &live_rc)) {
 			use_live_rc = 1;
@@ -304,7 +314,7 @@ int main(int argc, char **argv) {
 			}
 		}
 		if (!rc.enabled || rc.mode != last_mode || rc.enabled != last_enabled) {
-			script_time = 0.0f;
+			motion_script_reset(&script);
 			last_mode = rc.mode;
 			last_enabled = rc.enabled;
 		}
@@ -334,94 +344,10 @@ int main(int argc, char **argv) {
 			cmd_turn = 0.0f;
 			standup_elapsed += control_dt;
 		} else if (rc.enabled && rc.mode != 0) {
-			if (rc.mode == 1) {
-				cmd_throttle = 0.3f;
-				cmd_turn = 0.2f;
-			} else if (rc.mode >= 2 && rc.mode <= 4) {
-				const float PI = 3.14159265f;
-				float period_s = 4.0f;
-				float turn_amp = 0.25f;
-				if (rc.mode == 3) {
-					period_s = 6.0f;
-					turn_amp = 0.20f;
-				} else if (rc.mode == 4) {
-					period_s = 3.0f;
-					turn_amp = 0.30f;
-				}
-				float phase = (2.0f * PI * script_time) / period_s;
-				cmd_throttle = 0.3f;
-				cmd_turn = turn_amp * sinf(phase);
-			} else if (rc.mode == 5) {
-				cmd_throttle = 0.0f;
-				cmd_turn = 0.35f;
-			} else if (rc.mode == 6) {
-				const float period_s = 2.0f;
-				float phase = script_time;
-				while (phase >= period_s) {
-					phase -= period_s;
-				}
-				cmd_throttle = (phase < 1.0f) ? 0.3f : 0.0f;
-				cmd_turn = 0.0f;
-			} else if (rc.mode == 7) {
-				const float period_s = 6.0f;
-				float phase = script_time;
-				while (phase >= period_s) {
-					phase -= period_s;
-				}
-				if (phase < 1.0f) {
-					cmd_throttle = 0.3f;
-					cmd_turn = 0.0f;
-				} else if (phase < 1.5f) {
-					cmd_throttle = 0.0f;
-					cmd_turn = 0.35f;
-				} else if (phase < 2.5f) {
-					cmd_throttle = 0.3f;
-					cmd_turn = 0.0f;
-				} else if (phase < 3.0f) {
-					cmd_throttle = 0.0f;
-					cmd_turn = 0.35f;
-				} else if (phase < 4.0f) {
-					cmd_throttle = 0.3f;
-					cmd_turn = 0.0f;
-				} else if (phase < 4.5f) {
-					cmd_throttle = 0.0f;
-					cmd_turn = 0.35f;
-				} else if (phase < 5.5f) {
-					cmd_throttle = 0.3f;
-					cmd_turn = 0.0f;
-				} else {
-					cmd_throttle = 0.0f;
-					cmd_turn = 0.35f;
-				}
-			} else if (rc.mode == 8) {
-				const float PI = 3.14159265f;
-				const float period_s = 3.0f;
-				float phase = (2.0f * PI * script_time) / period_s;
-				cmd_throttle = 0.3f;
-				cmd_turn = 0.40f * sinf(phase);
-			} else if (rc.mode == 9) {
-				const float DEG2RAD = 3.14159265f / 180.0f;
-				cmd_throttle = 0.0f;
-				cmd_turn = 0.0f;
-				target_pitch = 5.0f * DEG2RAD;
-				target_pitch_deg = 5.0f;
-			} else if (rc.mode == 10) {
-				const float DEG2RAD = 3.14159265f / 180.0f;
-				cmd_throttle = 0.0f;
-				cmd_turn = 0.0f;
-				target_pitch = -5.0f * DEG2RAD;
-				target_pitch_deg = -5.0f;
-			} else if (rc.mode == 11) {
-				const float PI = 3.14159265f;
-				const float DEG2RAD = 3.14159265f / 180.0f;
-				const float period_s = 10.0f;
-				float phase = (2.0f * PI * script_time) / period_s;
-				cmd_throttle = 0.0f;
-				cmd_turn = 0.0f;
-				target_pitch = (3.0f * DEG2RAD) * sinf(phase);
-				target_pitch_deg = target_pitch * (180.0f / 3.14159265f);
-			}
-			script_time += control_dt;
+			/* Same waypoint tables as firmware_sam */
+			motion_script_step(&script, (uint8_t)rc.mode, control_dt,
+							   &cmd_throttle, &cmd_turn, &target_pitch);
+			target_pitch_deg = target_pitch * (180.0f / 3.14159265f);
 		} else if (!rc.enabled) {
 			cmd_throttle = 0.0f;
 			cmd_turn = 0.0f;
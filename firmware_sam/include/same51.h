@@ -1,16 +1,32 @@
 #ifndef SAME51_H
 #define SAME51_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 // Base addresses
 #define SERCOM0_BASE 0x40003000UL
 #define SERCOM1_BASE 0x40003400UL
+#define SERCOM4_BASE 0x43000000UL
 #define PORT_BASE    0x41008000UL
 #define GCLK_BASE    0x40001C00UL
 #define MCLK_BASE    0x40000800UL
 #define NVMCTRL_BASE 0x41004000UL
-#define CPU_HZ       48000000UL
+#define EIC_BASE     0x40002800UL
+#define TCC0_BASE    0x41016000UL
+#define DMAC_BASE    0x4100A000UL
+#define TCC1_BASE    0x41018000UL
+#define TC5_BASE     0x42001800UL
+#define OSCCTRL_BASE 0x40001000UL
+#define CMCC_BASE    0x41006000UL
+
+// CPU clock: 48 runs from DFLL48M directly, 96..120 (even) from DPLL0.
+// Peripherals always run from DFLL48M on GCLK1 (PERIPH_HZ).
+#ifndef CPU_MHZ
+#define CPU_MHZ      120
+#endif
+#define CPU_HZ       (CPU_MHZ * 1000000UL)
+#define PERIPH_HZ    48000000UL
 
 // PORT registers (Group A = 0, Group B = 1)
 typedef struct {
@@ -81,6 +97,7 @@ typedef struct {
 
 #define SERCOM0_USART ((SercomUsart *)SERCOM0_BASE)
 #define SERCOM1_SPI   ((SercomSpi *)SERCOM1_BASE)
+#define SERCOM4_USART ((SercomUsart *)SERCOM4_BASE)
 
 // GCLK
 typedef struct {
@@ -94,6 +111,48 @@ typedef struct {
 
 #define GCLK ((Gclk *)GCLK_BASE)
 
+#define GCLK_GENCTRL_SRC_DFLL    0x06
+#define GCLK_GENCTRL_SRC_DPLL0   0x07
+#define GCLK_GENCTRL_GENEN       (1 << 8)
+#define GCLK_GENCTRL_DIV(x)      ((uint32_t)(x) << 16)
+#define GCLK_SYNCBUSY_GENCTRL(n) (1UL << (2 + (n)))
+#define GCLK_PCHCTRL_GEN(n)      ((uint32_t)(n))
+#define GCLK_PCHCTRL_CHEN        (1 << 6)
+
+// Generators used by this firmware
+#define GCLK_GEN_CPU      0  // CPU_HZ
+#define GCLK_GEN_PERIPH   1  // DFLL48M, PERIPH_HZ
+#define GCLK_GEN_DPLL_REF 2  // DFLL48M / 24, DPLL0 reference
+#define GCLK_GEN_SERVO    3  // DFLL48M / 15, servo PWM (servo.h)
+
+// Peripheral clock channel enable, fed from the peripheral generator
+#define GCLK_PCHCTRL_PERIPH (GCLK_PCHCTRL_CHEN | GCLK_PCHCTRL_GEN(GCLK_GEN_PERIPH))
+
+// OSCCTRL (DPLL0 only)
+typedef struct {
+	volatile uint8_t  DPLLCTRLA;
+	volatile uint8_t  RESERVED0[3];
+	volatile uint32_t DPLLRATIO;
+	volatile uint32_t DPLLCTRLB;
+	volatile uint32_t DPLLSYNCBUSY;
+	volatile uint32_t DPLLSTATUS;
+} OscctrlDpll;
+
+typedef struct {
+	volatile uint8_t  RESERVED0[0x30];
+	OscctrlDpll       DPLL[2];
+} Oscctrl;
+
+#define OSCCTRL ((Oscctrl *)OSCCTRL_BASE)
+
+#define OSCCTRL_DPLLCTRLA_ENABLE       (1 << 1)
+#define OSCCTRL_DPLLRATIO_LDR(x)       ((uint32_t)(x) & 0x1FFF)
+#define OSCCTRL_DPLLCTRLB_REFCLK_GCLK  (0x0 << 5)
+#define OSCCTRL_DPLLSYNCBUSY_ENABLE    (1 << 1)
+#define OSCCTRL_DPLLSYNCBUSY_DPLLRATIO (1 << 2)
+#define OSCCTRL_DPLLSTATUS_LOCK        (1 << 0)
+#define OSCCTRL_DPLLSTATUS_CLKRDY      (1 << 1)
+
 // MCLK
 typedef struct {
 	volatile uint8_t  RESERVED0[1];
@@ -117,6 +176,10 @@ typedef struct {
 #define SERCOM_CTRLA_SWRST      (1 << 0)
 #define SERCOM_CTRLA_MODE_SPI   (0x3 << 2)
 #define SERCOM_CTRLA_MODE_USART (0x1 << 2)
+#define SERCOM_USART_CTRLA_SAMPR(x) ((uint32_t)(x) << 13)  // 1 = 16x fractional
+
+// SERCOM USART BAUD in fractional mode: BAUD[12:0] + FP[15:13] / 8
+#define SERCOM_USART_BAUD_FP(x) ((uint16_t)(x) << 13)
 
 // SERCOM SPI CTRLB bits
 #define SERCOM_SPI_CTRLB_RXEN   (1 << 17)
@@ -133,6 +196,12 @@ typedef struct {
 // SERCOM USART INTFLAG bits
 #define SERCOM_USART_INTFLAG_RXC (1 << 2)
 #define SERCOM_USART_INTFLAG_DRE (1 << 0)
+#define SERCOM_USART_INTFLAG_TXC (1 << 1)
+
+// SERCOM USART STATUS bits (write 1 to clear)
+#define SERCOM_USART_STATUS_PERR   (1 << 0)
+#define SERCOM_USART_STATUS_FERR   (1 << 1)
+#define SERCOM_USART_STATUS_BUFOVF (1 << 2)
 
 // Pin function macros
 #define PORT_PMUX_PMUXE(x) ((x) & 0xF)
@@ -140,13 +209,375 @@ typedef struct {
 #define PORT_PINCFG_PMUXEN (1 << 0)
 #define PORT_PINCFG_INEN   (1 << 1)
 #define PORT_PINCFG_PULLEN (1 << 2)
+#define PORT_PMUX_A 0x0
+#define PORT_PMUX_D 0x3
+#define PORT_PMUX_E 0x4
+#define PORT_PMUX_F 0x5
+#define PORT_PMUX_G 0x6
 
 // GCLK peripheral channel IDs
+#define GCLK_OSCCTRL_FDPLL0 1
+#define GCLK_EIC          4
 #define GCLK_SERCOM0_CORE 7
 #define GCLK_SERCOM1_CORE 8
+#define GCLK_TCC0_TCC1    25
+#define GCLK_TC4_TC5      30
+#define GCLK_SERCOM4_CORE 34
+
+// EIC (external interrupt controller)
+typedef struct {
+	volatile uint8_t  CTRLA;
+	volatile uint8_t  NMICTRL;
+	volatile uint16_t NMIFLAG;
+	volatile uint32_t SYNCBUSY;
+	volatile uint32_t EVCTRL;
+	volatile uint32_t INTENCLR;
+	volatile uint32_t INTENSET;
+	volatile uint32_t INTFLAG;
+	volatile uint32_t ASYNCH;
+	volatile uint32_t CONFIG[2];
+	volatile uint32_t RESERVED0[3];
+	volatile uint32_t DEBOUNCEN;
+	volatile uint32_t DPRESCALER;
+	volatile uint32_t PINSTATE;
+} Eic;
+
+#define EIC ((Eic *)EIC_BASE)
+
+#define EIC_CTRLA_SWRST  (1 << 0)
+#define EIC_CTRLA_ENABLE (1 << 1)
+// CONFIG[n] holds 8 EXTINT lines, 4 bits each: SENSE[2:0], FILTEN[3]
+#define EIC_SENSE_RISE   0x1
+#define EIC_SENSE_HIGH   0x4
+#define EIC_CONFIG_SENSE(line, sense) ((uint32_t)(sense) << (((line) & 7) * 4))
+
+// DMAC (direct memory access controller)
+typedef struct {
+	volatile uint32_t CHCTRLA;
+	volatile uint8_t  CHCTRLB;
+	volatile uint8_t  CHPRILVL;
+	volatile uint8_t  CHEVCTRL;
+	volatile uint8_t  RESERVED0[5];
+	volatile uint8_t  CHINTENCLR;
+	volatile uint8_t  CHINTENSET;
+	volatile uint8_t  CHINTFLAG;
+	volatile uint8_t  CHSTATUS;
+} DmacChannel;
+
+typedef struct {
+	volatile uint16_t CTRL;
+	volatile uint16_t CRCCTRL;
+	volatile uint32_t CRCDATAIN;
+	volatile uint32_t CRCCHKSUM;
+	volatile uint8_t  CRCSTATUS;
+	volatile uint8_t  DBGCTRL;
+	volatile uint8_t  RESERVED0[2];
+	volatile uint32_t SWTRIGCTRL;
+	volatile uint32_t PRICTRL0;
+	volatile uint8_t  RESERVED1[8];
+	volatile uint16_t INTPEND;
+	volatile uint8_t  RESERVED2[2];
+	volatile uint32_t INTSTATUS;
+	volatile uint32_t BUSYCH;
+	volatile uint32_t PENDCH;
+	volatile uint32_t ACTIVE;
+	volatile uint32_t BASEADDR;
+	volatile uint32_t WRBADDR;
+	volatile uint8_t  RESERVED3[4];
+	DmacChannel CHANNEL[32];
+} Dmac;
+
+// Transfer descriptor, in SRAM, 128-bit aligned
+typedef struct {
+	volatile uint16_t BTCTRL;
+	volatile uint16_t BTCNT;
+	volatile uint32_t SRCADDR;   // end address when SRCINC is set
+	volatile uint32_t DSTADDR;   // end address when DSTINC is set
+	volatile uint32_t DESCADDR;  // next descriptor, 0 = last
+} __attribute__((aligned(16))) DmacDescriptor;
+
+#define DMAC ((Dmac *)DMAC_BASE)
+
+#define DMAC_CTRL_SWRST         (1 << 0)
+#define DMAC_CTRL_DMAENABLE     (1 << 1)
+#define DMAC_CTRL_LVLEN_ALL     (0xF << 8)
+#define DMAC_CHCTRLA_SWRST      (1 << 0)
+#define DMAC_CHCTRLA_ENABLE     (1 << 1)
+#define DMAC_CHCTRLA_TRIGSRC(x) ((uint32_t)(x) << 8)
+#define DMAC_CHCTRLA_TRIGACT_BURST (0x2UL << 20)
+#define DMAC_CHCTRLB_CMD_RESUME 0x2
+#define DMAC_CHINT_TERR         (1 << 0)
+#define DMAC_CHINT_TCMPL        (1 << 1)
+#define DMAC_CHINT_SUSP         (1 << 2)
+#define DMAC_BTCTRL_VALID       (1 << 0)
+#define DMAC_BTCTRL_BLOCKACT_INT     (0x1 << 3)
+#define DMAC_BTCTRL_BLOCKACT_SUSPEND (0x2 << 3)
+#define DMAC_BTCTRL_BEATSIZE_BYTE    (0x0 << 8)
+#define DMAC_BTCTRL_SRCINC      (1 << 10)
+#define DMAC_BTCTRL_DSTINC      (1 << 11)
+
+// DMAC trigger sources
+#define DMAC_TRIG_SERCOM1_RX    0x06
+#define DMAC_TRIG_SERCOM1_TX    0x07
+
+// NVMCTRL (flash controller)
+typedef struct {
+	volatile uint16_t CTRLA;
+	volatile uint8_t  RESERVED0[2];
+	volatile uint16_t CTRLB;
+	volatile uint8_t  RESERVED1[2];
+	volatile uint32_t PARAM;
+	volatile uint16_t INTENCLR;
+	volatile uint16_t INTENSET;
+	volatile uint16_t INTFLAG;
+	volatile uint16_t STATUS;
+	volatile uint32_t ADDR;
+	volatile uint32_t RUNLOCK;
+	volatile uint32_t PBLDATA[2];
+	volatile uint32_t ECCERR;
+	volatile uint8_t  DBGCTRL;
+} Nvmctrl;
+
+#define NVMCTRL ((Nvmctrl *)NVMCTRL_BASE)
+
+#define NVMCTRL_CTRLA_AUTOWS     (1 << 2)
+#define NVMCTRL_CTRLA_RWS(x)     ((uint16_t)(x) << 8)
+#define NVMCTRL_CTRLA_RWS_MASK   (0xF << 8)
+#define NVMCTRL_CTRLA_WMODE_MASK (0x3 << 4)
+#define NVMCTRL_CTRLA_WMODE_MAN  (0x0 << 4)
+#define NVMCTRL_CTRLB_CMDEX      (0xA5 << 8)
+#define NVMCTRL_CMD_EB           0x01  // erase block
+#define NVMCTRL_CMD_WP           0x03  // write page
+#define NVMCTRL_CMD_PBC          0x15  // page buffer clear
+#define NVMCTRL_STATUS_READY     (1 << 0)
+#define NVMCTRL_INTFLAG_DONE     (1 << 0)
+#define NVMCTRL_INTFLAG_ADDRE    (1 << 1)
+#define NVMCTRL_INTFLAG_PROGE    (1 << 2)
+#define NVMCTRL_INTFLAG_LOCKE    (1 << 3)
+#define NVMCTRL_INTFLAG_NVME     (1 << 6)
+#define NVMCTRL_INTFLAG_ERRORS   (NVMCTRL_INTFLAG_ADDRE | NVMCTRL_INTFLAG_PROGE | \
+                                  NVMCTRL_INTFLAG_LOCKE | NVMCTRL_INTFLAG_NVME)
+#define NVM_PAGE_SIZE            512
+#define NVM_BLOCK_SIZE           8192  // erase granularity, 16 pages
+
+// TCC (timer/counter for control applications)
+typedef struct {
+	volatile uint32_t CTRLA;
+	volatile uint8_t  CTRLBCLR;
+	volatile uint8_t  CTRLBSET;
+	volatile uint8_t  RESERVED0[2];
+	volatile uint32_t SYNCBUSY;
+	volatile uint32_t FCTRLA;
+	volatile uint32_t FCTRLB;
+	volatile uint32_t WEXCTRL;
+	volatile uint32_t DRVCTRL;
+	volatile uint8_t  RESERVED1[2];
+	volatile uint8_t  DBGCTRL;
+	volatile uint8_t  RESERVED2;
+	volatile uint32_t EVCTRL;
+	volatile uint32_t INTENCLR;
+	volatile uint32_t INTENSET;
+	volatile uint32_t INTFLAG;
+	volatile uint32_t STATUS;
+	volatile uint32_t COUNT;
+	volatile uint16_t PATT;
+	volatile uint8_t  RESERVED3[2];
+	volatile uint32_t WAVE;
+	volatile uint32_t PER;
+	volatile uint32_t CC[6];
+	volatile uint8_t  RESERVED4[8];
+	volatile uint16_t PATTBUF;
+	volatile uint8_t  RESERVED5[6];
+	volatile uint32_t PERBUF;
+	volatile uint32_t CCBUF[6];
+} Tcc;
+
+#define TCC0 ((Tcc *)TCC0_BASE)
+#define TCC1 ((Tcc *)TCC1_BASE)
+
+#define TCC_CTRLA_SWRST          (1 << 0)
+#define TCC_CTRLA_ENABLE         (1 << 1)
+#define TCC_CTRLA_PRESCALER_DIV1 (0x0 << 8)
+#define TCC_CTRLB_LUPD           (1 << 1)
+#define TCC_WAVE_NPWM            0x2
+#define TCC_INT_OVF              (1 << 0)
+#define TCC_SYNCBUSY_SWRST       (1 << 0)
+#define TCC_SYNCBUSY_ENABLE      (1 << 1)
+#define TCC_SYNCBUSY_CTRLB       (1 << 2)
+#define TCC_SYNCBUSY_WAVE        (1 << 6)
+#define TCC_SYNCBUSY_PER         (1 << 7)
+#define TCC_SYNCBUSY_CC(n)       (1 << (8 + (n)))
+#define TCC_PER_MAX              0xFFFFFFUL
+
+// TC in 16-bit mode
+typedef struct {
+	volatile uint32_t CTRLA;
+	volatile uint8_t  CTRLBCLR;
+	volatile uint8_t  CTRLBSET;
+	volatile uint16_t EVCTRL;
+	volatile uint8_t  INTENCLR;
+	volatile uint8_t  INTENSET;
+	volatile uint8_t  INTFLAG;
+	volatile uint8_t  STATUS;
+	volatile uint8_t  WAVE;
+	volatile uint8_t  DRVCTRL;
+	volatile uint8_t  RESERVED0;
+	volatile uint8_t  DBGCTRL;
+	volatile uint32_t SYNCBUSY;
+	volatile uint16_t COUNT;
+	volatile uint8_t  RESERVED1[6];
+	volatile uint16_t CC[2];
+	volatile uint8_t  RESERVED2[16];
+	volatile uint16_t CCBUF[2];
+} TcCount16;
+
+#define TC5 ((TcCount16 *)TC5_BASE)
+
+#define TC_CTRLA_SWRST          (1 << 0)
+#define TC_CTRLA_ENABLE         (1 << 1)
+#define TC_CTRLA_MODE_COUNT16   (0x0 << 2)
+#define TC_CTRLA_PRESCALER_DIV1 (0x0 << 8)
+#define TC_WAVE_NPWM            0x2
+#define TC_SYNCBUSY_SWRST       (1 << 0)
+#define TC_SYNCBUSY_ENABLE      (1 << 1)
+#define TC_SYNCBUSY_CC(n)       (1 << (6 + (n)))
+
+// MCLK APBxMASK bits
+#define MCLK_APBAMASK_EIC     (1 << 10)
+#define MCLK_APBBMASK_TCC0    (1 << 11)
+#define MCLK_APBBMASK_TCC1    (1 << 12)
+#define MCLK_APBCMASK_TC5     (1 << 6)
+#define MCLK_APBDMASK_SERCOM4 (1 << 0)
+
+// Interrupt numbers (external IRQs, after the 16 core exceptions)
+#define EIC_EXTINT_0_IRQn 12
+#define DMAC_0_IRQn       31  // channels 0..3 have their own lines
+#define SERCOM0_0_IRQn    46  // DRE
+#define SERCOM0_2_IRQn    48  // RXC
+#define SERCOM4_0_IRQn    62  // DRE
+#define SERCOM4_2_IRQn    64  // RXC
+#define TCC0_0_IRQn       85  // OVF, TRG, CNT, ERR, faults
+#define TCC1_0_IRQn       92
+#define PERIPH_IRQ_COUNT  137
 
 // Cortex-M4 NVIC
 #define NVIC_ISER ((volatile uint32_t *)0xE000E100UL)
+#define NVIC_ICER ((volatile uint32_t *)0xE000E180UL)
+#define NVIC_ICPR ((volatile uint32_t *)0xE000E280UL)
+
+// Cortex-M4 SCB: vector table offset and reset request
+#define SCB_VTOR  (*(volatile uint32_t *)0xE000ED08UL)
+#define SCB_AIRCR (*(volatile uint32_t *)0xE000ED0CUL)
+
+#define SCB_AIRCR_VECTKEY     (0x05FAUL << 16)
+#define SCB_AIRCR_SYSRESETREQ (1 << 2)
+
+// Cortex-M4 SCB fault status
+#define SCB_SHCSR (*(volatile uint32_t *)0xE000ED24UL)
+#define SCB_CFSR  (*(volatile uint32_t *)0xE000ED28UL)
+#define SCB_MMFAR (*(volatile uint32_t *)0xE000ED34UL)
+
+#define SCB_SHCSR_MEMFAULTENA (1 << 16)
+#define SCB_CFSR_MMFSR_MASK   0xFFUL     // MemManage status, low byte
+#define SCB_CFSR_MMARVALID    (1 << 7)   // MMFAR holds the faulting address
+
+// Cortex-M4 MPU (8 regions)
+typedef struct {
+	volatile uint32_t TYPE;
+	volatile uint32_t CTRL;
+	volatile uint32_t RNR;
+	volatile uint32_t RBAR;
+	volatile uint32_t RASR;
+} Mpu;
+
+#define MPU ((Mpu *)0xE000ED90UL)
+
+#define MPU_CTRL_ENABLE     (1 << 0)
+#define MPU_CTRL_PRIVDEFENA (1 << 2)     // default map for everything else
+#define MPU_RASR_ENABLE     (1 << 0)
+#define MPU_RASR_SIZE(log2) ((uint32_t)((log2) - 1) << 1)  // 2^log2 bytes
+#define MPU_RASR_AP_NONE    (0UL << 24)  // no access, privileged or not
+#define MPU_RASR_XN         (1UL << 28)
+
+// Keeps the compiler from moving ring buffer accesses across an index update
+static inline void compiler_barrier(void) {
+	__asm__ volatile ("" ::: "memory");
+}
+
+static inline void nvic_enable_irq(uint32_t irqn) {
+	NVIC_ICPR[irqn >> 5] = (1UL << (irqn & 31));
+	NVIC_ISER[irqn >> 5] = (1UL << (irqn & 31));
+}
+
+static inline void nvic_disable_irq(uint32_t irqn) {
+	NVIC_ICER[irqn >> 5] = (1UL << (irqn & 31));
+	NVIC_ICPR[irqn >> 5] = (1UL << (irqn & 31));
+}
+
+static inline void system_reset(void) {
+	__asm__ volatile ("dsb" ::: "memory");
+	SCB_AIRCR = SCB_AIRCR_VECTKEY | SCB_AIRCR_SYSRESETREQ;
+	while (1) {
+	}
+}
+
+// Cortex-M4 DWT cycle counter
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} Dwt;
+
+#define DWT        ((Dwt *)0xE0001000UL)
+#define CORE_DEMCR (*(volatile uint32_t *)0xE000EDFCUL)
+
+#define DWT_CTRL_CYCCNTENA (1 << 0)
+#define DEMCR_TRCENA       (1 << 24)
+
+static inline uint32_t dwt_cycles(void) {
+	return DWT->CYCCNT;
+}
+
+// CMCC (Cortex-M cache controller, caches flash code and data)
+typedef struct {
+	volatile uint32_t TYPE;
+	volatile uint32_t CFG;
+	volatile uint32_t CTRL;
+	volatile uint32_t SR;
+	volatile uint32_t RESERVED0[4];
+	volatile uint32_t MAINT0;
+	volatile uint32_t MAINT1;
+} Cmcc;
+
+#define CMCC ((Cmcc *)CMCC_BASE)
+
+#define CMCC_CTRL_CEN      (1 << 0)
+#define CMCC_SR_CSTS       (1 << 0)
+#define CMCC_MAINT0_INVALL (1 << 0)
+
+static inline bool cmcc_enabled(void) {
+	return (CMCC->SR & CMCC_SR_CSTS) != 0;
+}
+
+static inline void cmcc_disable(void) {
+	CMCC->CTRL = 0;
+	while (CMCC->SR & CMCC_SR_CSTS) {
+	}
+}
+
+static inline void cmcc_enable(void) {
+	CMCC->CTRL = CMCC_CTRL_CEN;
+}
+
+// Drop every cached line, e.g. after flash was erased or written. The
+// cache has to be off while it is invalidated.
+static inline void cmcc_invalidate(void) {
+	bool on = cmcc_enabled();
+	cmcc_disable();
+	CMCC->MAINT0 = CMCC_MAINT0_INVALL;
+	if (on) {
+		cmcc_enable();
+	}
+}
 
 // Cortex-M4 SysTick
 typedef struct {
@@ -0,0 +1,659 @@
+// BMI088 on one SPI bus with its two chip selects (GPIO input 0 = accel
+// CSB1, 1 = gyro CSB2, active low), replaying an imu-streamer CSV
+// (t,gx,gy,gz,ax,ay,az; rad/s or deg/s, m/s^2). Modelled as far as
+// bmi088.c uses it:
+//   - POR and soft reset delays (gyro 30 ms, accel 1 ms) and the accel's
+//     switch to SPI on the first CSB rising edge
+//   - chip IDs, ranges, ODRs, data and ACC_STATUS registers
+//   - the gyro FIFO (stream mode, 100 frames, watermark on INT3 as a level)
+//   - the accel FIFO (1 KiB of 0x84 frames, a sensor time frame once it is
+//     read empty, then 0x80); a frame cut short by CSB is read again
+//   - sensor time at 25.6 kHz
+// The CSV row in effect is the last one at or before the time since start;
+// the last row holds after the file ends.
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Exceptions;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.SPI;
+using Antmicro.Renode.Peripherals.Timers;
+using Antmicro.Renode.Time;
+
+namespace Antmicro.Renode.Peripherals.Sensors
+{
+    public class BMI088 : ISPIPeripheral, IGPIOReceiver
+    {
+        public BMI088(IMachine machine)
+        {
+            var clock = machine.ClockSource;
+            Int3 = new GPIO();
+
+            timeBase = new LimitTimer(clock, SensorTimeHz, this, "sensortime", SensorTimeWrap,
+                Direction.Ascending, enabled: true, workMode: WorkMode.Periodic, eventEnabled: true);
+            timeBase.LimitReached += () => timeEpochs++;
+
+            gyroTimer = new LimitTimer(clock, 1000000, this, "gyro", 500,
+                Direction.Ascending, enabled: false, workMode: WorkMode.Periodic, eventEnabled: true);
+            gyroTimer.LimitReached += GyroSample;
+            accelTimer = new LimitTimer(clock, 1000000, this, "accel", 625,
+                Direction.Ascending, enabled: false, workMode: WorkMode.Periodic, eventEnabled: true);
+            accelTimer.LimitReached += AccelSample;
+
+            gyroBoot = new LimitTimer(clock, 1000000, this, "gyro-boot", GyroBootUs,
+                Direction.Ascending, enabled: false, workMode: WorkMode.OneShot, eventEnabled: true);
+            gyroBoot.LimitReached += () =>
+            {
+                gyroReady = true;
+                gyroTimer.Value = 0;
+                gyroTimer.Enabled = true;
+            };
+            accelBoot = new LimitTimer(clock, 1000000, this, "accel-boot", AccelBootUs,
+                Direction.Ascending, enabled: false, workMode: WorkMode.OneShot, eventEnabled: true);
+            accelBoot.LimitReached += () =>
+            {
+                accelReady = true;
+                UpdateAccelTimer();
+            };
+            Reset();
+        }
+
+        public void Reset()
+        {
+            timeBase.Reset();
+            timeEpochs = 0;
+            ResetGyro();
+            ResetAccel();
+            selected = Chip.None;
+            accelCs = gyroCs = true;
+        }
+
+        // Replays an imu-streamer CSV; gyroUnits is "rad" (the default, as
+        // for units: si) or "deg"
+        public void LoadCsv(string path, string gyroUnits = "rad")
+        {
+            var gyroScale = gyroUnits == "deg" ? 1.0 : 180.0 / Math.PI;
+            var loaded = new List<Row>();
+            foreach(var line in File.ReadLines(path))
+            {
+                var f = line.Split(',');
+                if(f.Length < 7 || !double.TryParse(f[0], NumberStyles.Float, CultureInfo.InvariantCulture, out var t))
+                {
+                    continue; // header or blank line
+                }
+                var row = new Row { T = t, Gyro = new double[3], Accel = new double[3] };
+                for(var i = 0; i < 3; i++)
+                {
+                    row.Gyro[i] = double.Parse(f[1 + i], CultureInfo.InvariantCulture) * gyroScale;
+                    row.Accel[i] = double.Parse(f[4 + i], CultureInfo.InvariantCulture) / StandardGravity;
+                }
+                loaded.Add(row);
+            }
+            if(loaded.Count == 0)
+            {
+                throw new RecoverableException($"{path}: no samples");
+            }
+            rows = loaded;
+            this.Log(LogLevel.Info, "{0} samples over {1:F2} s from {2}", rows.Count, rows[rows.Count - 1].T - rows[0].T, path);
+        }
+
+        public void OnGPIO(int number, bool value)
+        {
+            if(number == 0)
+            {
+                ChipSelect(Chip.Accel, ref accelCs, value);
+            }
+            else if(number == 1)
+            {
+                ChipSelect(Chip.Gyro, ref gyroCs, value);
+            }
+        }
+
+        public byte Transmit(byte data)
+        {
+            byte reply;
+            switch(selected)
+            {
+            case Chip.Accel:
+                reply = AccelTransfer(data);
+                break;
+            case Chip.Gyro:
+                reply = GyroTransfer(data);
+                break;
+            default:
+                return 0xFF;
+            }
+            byteIndex++;
+            return reply;
+        }
+
+        public void FinishTransmission()
+        {
+        }
+
+        public GPIO Int3 { get; }
+
+        public ulong GyroFrames { get; private set; }
+
+        public ulong GyroOverruns { get; private set; }
+
+        public ulong AccelFrames { get; private set; }
+
+        private enum Chip
+        {
+            None,
+            Accel,
+            Gyro
+        }
+
+        private class Row
+        {
+            public double T;
+            public double[] Gyro;  // deg/s
+            public double[] Accel; // g
+        }
+
+        private void ChipSelect(Chip chip, ref bool level, bool value)
+        {
+            var was = level;
+            level = value;
+            if(was && !value)
+            {
+                selected = chip;
+                byteIndex = 0;
+            }
+            else if(!was && value)
+            {
+                if(selected == chip)
+                {
+                    EndTransfer(chip);
+                    selected = Chip.None;
+                }
+                if(chip == Chip.Accel && accelReady)
+                {
+                    accelSpi = true;
+                }
+            }
+        }
+
+        private void EndTransfer(Chip chip)
+        {
+            // A frame cut short is read again from its start
+            if(chip == Chip.Accel)
+            {
+                accelFifoPos = 0;
+                accelEmptyPos = 0;
+            }
+            else
+            {
+                gyroFifoPos = 0;
+            }
+        }
+
+        private byte AccelTransfer(byte data)
+        {
+            if(byteIndex == 0)
+            {
+                address = data & 0x7F;
+                reading = (data & 0x80) != 0;
+                return 0xFF;
+            }
+            if(!accelReady || !accelSpi)
+            {
+                return 0xFF;
+            }
+            if(!reading)
+            {
+                AccelWrite(address, data);
+                address = (address + 1) & 0x7F;
+                return 0xFF;
+            }
+            if(byteIndex == 1)
+            {
+                return 0xFF; // dummy byte
+            }
+            var value = AccelRead(address);
+            if(address != AccFifoData)
+            {
+                address = (address + 1) & 0x7F;
+            }
+            return value;
+        }
+
+        private byte GyroTransfer(byte data)
+        {
+            if(byteIndex == 0)
+            {
+                address = data & 0x7F;
+                reading = (data & 0x80) != 0;
+                return 0xFF;
+            }
+            if(!gyroReady)
+            {
+                return 0xFF;
+            }
+            if(!reading)
+            {
+                GyroWrite(address, data);
+                address = (address + 1) & 0x7F;
+                return 0xFF;
+            }
+            var value = GyroRead(address);
+            if(address != GyrFifoData)
+            {
+                address = (address + 1) & 0x7F;
+            }
+            return value;
+        }
+
+        private byte AccelRead(int reg)
+        {
+            switch(reg)
+            {
+            case 0x00:
+                return AccChipId;
+            case 0x03:
+            {
+                var status = accelDrdy ? AccDrdy : (byte)0;
+                return status;
+            }
+            case 0x12:
+                accelDrdy = false;
+                return (byte)accelData[0];
+            case 0x13:
+                return (byte)(accelData[0] >> 8);
+            case 0x14:
+                return (byte)accelData[1];
+            case 0x15:
+                return (byte)(accelData[1] >> 8);
+            case 0x16:
+                return (byte)accelData[2];
+            case 0x17:
+                return (byte)(accelData[2] >> 8);
+            case 0x18:
+                return (byte)SensorTime;
+            case 0x19:
+                return (byte)(SensorTime >> 8);
+            case 0x1A:
+                return (byte)(SensorTime >> 16);
+            case 0x24:
+                return (byte)accelFifoBytes;
+            case 0x25:
+                return (byte)(accelFifoBytes >> 8);
+            case AccFifoData:
+                return AccelFifoRead();
+            default:
+                return accelRegs[reg];
+            }
+        }
+
+        private void AccelWrite(int reg, byte value)
+        {
+            switch(reg)
+            {
+            case 0x7E:
+                if(value == SoftResetCmd)
+                {
+                    ResetAccel();
+                }
+                else if(value == 0xB0)
+                {
+                    accelFifo.Clear(); // fifo_flush
+                    accelFifoPos = 0;
+                }
+                return;
+            default:
+                accelRegs[reg] = value;
+                break;
+            }
+            if(reg == 0x40 || reg == 0x7C || reg == 0x7D)
+            {
+                UpdateAccelTimer();
+            }
+        }
+
+        private byte GyroRead(int reg)
+        {
+            switch(reg)
+            {
+            case 0x00:
+                return GyrChipId;
+            case 0x02:
+                return (byte)gyroData[0];
+            case 0x03:
+                return (byte)(gyroData[0] >> 8);
+            case 0x04:
+                return (byte)gyroData[1];
+            case 0x05:
+                return (byte)(gyroData[1] >> 8);
+            case 0x06:
+                return (byte)gyroData[2];
+            case 0x07:
+                return (byte)(gyroData[2] >> 8);
+            case 0x0A:
+                return (byte)(GyroWatermark ? 0x10 : 0x00);
+            case 0x10:
+                return (byte)(gyroRegs[reg] | 0x80); // BANDWIDTH bit 7 reads as 1
+            case 0x0E:
+                return (byte)(Math.Min(gyroFifo.Count, 0x7F) | (gyroOverrun ? 0x80 : 0));
+            case GyrFifoData:
+                return GyroFifoRead();
+            default:
+                return gyroRegs[reg];
+            }
+        }
+
+        private void GyroWrite(int reg, byte value)
+        {
+            switch(reg)
+            {
+            case 0x14:
+                if(value == SoftResetCmd)
+                {
+                    ResetGyro();
+                }
+                return;
+            case 0x3E:
+                gyroRegs[reg] = value;
+                gyroFifo.Clear(); // writing FIFO_CONFIG_1 clears the FIFO
+                gyroFifoPos = 0;
+                gyroOverrun = false;
+                break;
+            default:
+                gyroRegs[reg] = value;
+                break;
+            }
+            if(reg == 0x10)
+            {
+                gyroTimer.Limit = (ulong)(1000000 / GyroOdrHz[value & 0x7]);
+            }
+            UpdateInt3();
+        }
+
+        private byte AccelFifoRead()
+        {
+            if(accelFifo.Count > 0)
+            {
+                var frame = accelFifo.Peek();
+                var b = frame[accelFifoPos++];
+                if(accelFifoPos == frame.Length)
+                {
+                    accelFifo.Dequeue();
+                    accelFifoPos = 0;
+                    accelFifoBytes -= frame.Length;
+                }
+                return b;
+            }
+            // Read empty: one sensor time frame, then the empty marker
+            var n = accelEmptyPos++;
+            switch(n)
+            {
+            case 0:
+                emptyTime = SensorTime;
+                return AccFrameSensorTime;
+            case 1:
+                return (byte)emptyTime;
+            case 2:
+                return (byte)(emptyTime >> 8);
+            case 3:
+                return (byte)(emptyTime >> 16);
+            default:
+                return AccFrameEmpty;
+            }
+        }
+
+        private byte GyroFifoRead()
+        {
+            if(gyroFifo.Count == 0)
+            {
+                // Reading an empty FIFO returns -32768 on every axis
+                return (byte)((gyroFifoPos++ & 1) == 0 ? 0x00 : 0x80);
+            }
+            var frame = gyroFifo.Peek();
+            var b = frame[gyroFifoPos++];
+            if(gyroFifoPos == frame.Length)
+            {
+                gyroFifo.Dequeue();
+                gyroFifoPos = 0;
+                UpdateInt3();
+            }
+            return b;
+        }
+
+        private void GyroSample()
+        {
+            var row = CurrentRow();
+            var lsbPerDps = 16.384 * (1 << Math.Min((int)gyroRegs[0x0F], 4));
+            for(var i = 0; i < 3; i++)
+            {
+                gyroData[i] = Saturate((row?.Gyro[i] ?? 0.0) * lsbPerDps);
+            }
+            GyroFrames++;
+            var mode = gyroRegs[0x3E] >> 6;
+            if(mode == 0)
+            {
+                return; // FIFO bypass
+            }
+            if(gyroFifo.Count >= GyroFifoFrames)
+            {
+                gyroOverrun = true;
+                GyroOverruns++;
+                if(mode == 1)
+                {
+                    return; // FIFO mode stops when full
+                }
+                gyroFifo.Dequeue();
+                gyroFifoPos = 0;
+            }
+            gyroFifo.Enqueue(Frame(null, gyroData));
+            UpdateInt3();
+        }
+
+        private void AccelSample()
+        {
+            var row = CurrentRow();
+            var gRange = 1.5 * (2 << Math.Min((int)accelRegs[0x41], 3));
+            for(var i = 0; i < 3; i++)
+            {
+                var g = row?.Accel[i] ?? (i == 2 ? 1.0 : 0.0);
+                accelData[i] = Saturate(g * 32768.0 / gRange);
+            }
+            accelDrdy = true;
+            AccelFrames++;
+            if((accelRegs[0x49] & 0x40) == 0)
+            {
+                return; // accel frames not in the FIFO
+            }
+            var frame = Frame(AccFrameData, accelData);
+            while(accelFifoBytes + frame.Length > AccelFifoBytes)
+            {
+                if((accelRegs[0x48] & 0x01) != 0)
+                {
+                    return; // FIFO mode stops when full
+                }
+                accelFifoBytes -= accelFifo.Dequeue().Length;
+                accelFifoPos = 0;
+            }
+            accelFifo.Enqueue(frame);
+            accelFifoBytes += frame.Length;
+        }
+
+        private static byte[] Frame(byte? header, short[] xyz)
+        {
+            var n = header.HasValue ? 1 : 0;
+            var frame = new byte[n + 6];
+            if(header.HasValue)
+            {
+                frame[0] = header.Value;
+            }
+            for(var i = 0; i < 3; i++)
+            {
+                frame[n + 2 * i] = (byte)xyz[i];
+                frame[n + 2 * i + 1] = (byte)(xyz[i] >> 8);
+            }
+            return frame;
+        }
+
+        private static short Saturate(double v)
+        {
+            return (short)Math.Max(short.MinValue, Math.Min(short.MaxValue, Math.Round(v)));
+        }
+
+        private Row CurrentRow()
+        {
+            if(rows == null)
+            {
+                return null;
+            }
+            var t = rows[0].T + Seconds;
+            int lo = 0, hi = rows.Count - 1;
+            while(lo < hi)
+            {
+                var mid = (lo + hi + 1) / 2;
+                if(rows[mid].T <= t)
+                {
+                    lo = mid;
+                }
+                else
+                {
+                    hi = mid - 1;
+                }
+            }
+            return rows[lo];
+        }
+
+        private void UpdateAccelTimer()
+        {
+            var odr = accelRegs[0x40] & 0x0F;
+            var active = accelReady && accelRegs[0x7C] == 0x00 && accelRegs[0x7D] == 0x04 && odr >= 5;
+            if(active)
+            {
+                // 1600 Hz >> (12 - odr)
+                accelTimer.Limit = (ulong)Math.Round(1e6 * (1 << (12 - Math.Min(odr, 12))) / 1600.0);
+            }
+            if(active != accelTimer.Enabled)
+            {
+                accelTimer.Value = 0;
+                accelTimer.Enabled = active;
+            }
+        }
+
+        private void UpdateInt3()
+        {
+            var fifoInt = (gyroRegs[0x15] & 0x40) != 0 && (gyroRegs[0x18] & 0x04) != 0 && GyroWatermark;
+            var activeHigh = (gyroRegs[0x16] & 0x01) != 0;
+            Int3.Set(fifoInt == activeHigh);
+        }
+
+        private bool GyroWatermark
+        {
+            get
+            {
+                var wm = gyroRegs[0x3D] & 0x7F;
+                return (gyroRegs[0x1E] & 0x80) != 0 && wm > 0 && gyroFifo.Count >= wm;
+            }
+        }
+
+        private void ResetGyro()
+        {
+            for(var i = 0; i < gyroRegs.Length; i++)
+            {
+                gyroRegs[i] = 0;
+            }
+            gyroRegs[0x10] = 0x80; // 2000 Hz ODR
+            gyroRegs[0x16] = 0x01; // INT3 active high
+            gyroRegs[0x3E] = 0x00;
+            gyroFifo.Clear();
+            gyroFifoPos = 0;
+            gyroOverrun = false;
+            gyroData[0] = gyroData[1] = gyroData[2] = 0;
+            gyroReady = false;
+            gyroTimer.Enabled = false;
+            gyroTimer.Limit = (ulong)(1000000 / GyroOdrHz[0]);
+            gyroBoot.Value = 0;
+            gyroBoot.Enabled = true;
+            UpdateInt3();
+        }
+
+        private void ResetAccel()
+        {
+            for(var i = 0; i < accelRegs.Length; i++)
+            {
+                accelRegs[i] = 0;
+            }
+            accelRegs[0x40] = 0xA8;  // 100 Hz, normal
+            accelRegs[0x41] = 0x01;  // +-6 g
+            accelRegs[0x45] = 0x80;
+            accelRegs[0x48] = 0x02;
+            accelRegs[0x49] = 0x10;
+            accelRegs[0x7C] = 0x03;  // suspend
+            accelFifo.Clear();
+            accelFifoBytes = 0;
+            accelFifoPos = 0;
+            accelEmptyPos = 0;
+            accelDrdy = false;
+            accelData[0] = accelData[1] = accelData[2] = 0;
+            accelReady = false;
+            accelSpi = false;
+            accelTimer.Enabled = false;
+            accelBoot.Value = 0;
+            accelBoot.Enabled = true;
+        }
+
+        private uint SensorTime => (uint)timeBase.Value & 0xFFFFFF;
+
+        private double Seconds => (timeEpochs * (double)SensorTimeWrap + timeBase.Value) / SensorTimeHz;
+
+        private readonly LimitTimer timeBase;
+        private readonly LimitTimer gyroTimer;
+        private readonly LimitTimer accelTimer;
+        private readonly LimitTimer gyroBoot;
+        private readonly LimitTimer accelBoot;
+        private readonly byte[] accelRegs = new byte[128];
+        private readonly byte[] gyroRegs = new byte[128];
+        private readonly short[] accelData = new short[3];
+        private readonly short[] gyroData = new short[3];
+        private readonly Queue<byte[]> gyroFifo = new Queue<byte[]>();
+        private readonly Queue<byte[]> accelFifo = new Queue<byte[]>();
+
+        private List<Row> rows;
+        private ulong timeEpochs;
+        private Chip selected;
+        private bool accelCs;
+        private bool gyroCs;
+        private int byteIndex;
+        private int address;
+        private bool reading;
+        private bool gyroReady;
+        private bool accelReady;
+        private bool accelSpi;
+        private bool accelDrdy;
+        private bool gyroOverrun;
+        private int gyroFifoPos;
+        private int accelFifoPos;
+        private int accelFifoBytes;
+        private int accelEmptyPos;
+        private uint emptyTime;
+
+        private static readonly int[] GyroOdrHz = { 2000, 2000, 1000, 400, 200, 100, 200, 100 };
+
+        private const long SensorTimeHz = 25600;
+        private const ulong SensorTimeWrap = 1UL << 24;
+        private const ulong GyroBootUs = 30000;
+        private const ulong AccelBootUs = 1000;
+        private const int GyroFifoFrames = 100;
+        private const int AccelFifoBytes = 1024;
+        private const double StandardGravity = 9.80665;
+        private const byte AccChipId = 0x1E;
+        private const byte GyrChipId = 0x0F;
+        private const byte SoftResetCmd = 0xB6;
+        private const byte AccDrdy = 0x80;
+        private const int AccFifoData = 0x26;
+        private const int GyrFifoData = 0x3F;
+        private const byte AccFrameData = 0x84;
+        private const byte AccFrameSensorTime = 0x44;
+        private const byte AccFrameEmpty = 0x80;
+    }
+}
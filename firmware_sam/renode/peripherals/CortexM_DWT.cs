@@ -0,0 +1,110 @@
+// Cortex-M DWT cycle counter (CTRL.CYCCNTENA, CYCCNT). The firmware reads
+// CYCCNT for delays, timestamps and PERF, so it must advance both while
+// code runs and while the core sleeps in WFI. Between two reads the counter
+// moves by the larger of the instructions executed (one cycle each, exact
+// within a time quantum) and the virtual time elapsed at the core clock
+// (which alone sees sleep).
+using System;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.Bus;
+using Antmicro.Renode.Peripherals.CPU;
+using Antmicro.Renode.Peripherals.Timers;
+using Antmicro.Renode.Time;
+
+namespace Antmicro.Renode.Peripherals.Miscellaneous
+{
+    public class CortexM_DWT : IDoubleWordPeripheral, IKnownSize
+    {
+        public CortexM_DWT(IMachine machine, TranslationCPU cpu, long frequency = 120000000)
+        {
+            this.cpu = cpu;
+            clock = new LimitTimer(machine.ClockSource, frequency, this, "cyccnt", uint.MaxValue,
+                Direction.Ascending, enabled: true, workMode: WorkMode.Periodic, eventEnabled: false);
+            Reset();
+        }
+
+        public void Reset()
+        {
+            ctrl = 0;
+            cyccnt = 0;
+            Sample();
+        }
+
+        public uint ReadDoubleWord(long offset)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                return ctrl | NumComp;
+            case 0x04:
+                Advance();
+                return cyccnt;
+            default:
+                this.Log(LogLevel.Noisy, "Read from unhandled offset 0x{0:X}", offset);
+                return 0;
+            }
+        }
+
+        public void WriteDoubleWord(long offset, uint value)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                Advance();
+                ctrl = value & CtrlCyccntena;
+                break;
+            case 0x04:
+                cyccnt = value;
+                Sample();
+                break;
+            default:
+                this.Log(LogLevel.Noisy, "Write of 0x{0:X} to unhandled offset 0x{1:X}", value, offset);
+                break;
+            }
+        }
+
+        public long Size => 0x1000;
+
+        // Cycles counted since reset, for the monitor
+        public uint Cycles
+        {
+            get
+            {
+                Advance();
+                return cyccnt;
+            }
+        }
+
+        private void Advance()
+        {
+            var instructions = cpu.ExecutedInstructions;
+            var ticks = (uint)clock.Value;
+            var ran = instructions - lastInstructions;
+            var elapsed = (uint)(ticks - lastTicks);
+            if((ctrl & CtrlCyccntena) != 0)
+            {
+                cyccnt += (uint)Math.Max(ran, (ulong)elapsed);
+            }
+            lastInstructions = instructions;
+            lastTicks = ticks;
+        }
+
+        private void Sample()
+        {
+            lastInstructions = cpu.ExecutedInstructions;
+            lastTicks = (uint)clock.Value;
+        }
+
+        private readonly TranslationCPU cpu;
+        private readonly LimitTimer clock;
+
+        private uint ctrl;
+        private uint cyccnt;
+        private ulong lastInstructions;
+        private uint lastTicks;
+
+        private const uint CtrlCyccntena = 1u << 0;
+        private const uint NumComp = 4u << 28;
+    }
+}
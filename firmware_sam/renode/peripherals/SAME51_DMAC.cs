@@ -0,0 +1,434 @@
+// SAME51 DMAC, as far as the firmware drives it: peripheral-triggered
+// channels with BURST (one beat per trigger) or BLOCK trigger actions,
+// descriptors in SRAM (first one at BASEADDR + 16 * channel, chained by
+// DESCADDR), SRCADDR/DSTADDR holding the end address when incrementing,
+// block actions INT and SUSPEND, and the RESUME command. Beats move at
+// once when their trigger is ready; bus arbitration and the write-back
+// section are not modelled.
+using System;
+using System.Collections.Generic;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.Bus;
+
+namespace Antmicro.Renode.Peripherals.DMA
+{
+    public class SAME51_DMAC : IDoubleWordPeripheral, IWordPeripheral, IBytePeripheral, IKnownSize, INumberedGPIOOutput
+    {
+        public SAME51_DMAC(IMachine machine)
+        {
+            sysbus = machine.GetSystemBus(this);
+            var irqs = new Dictionary<int, IGPIO>();
+            for(var i = 0; i < IrqLines; i++)
+            {
+                irqs[i] = new GPIO();
+            }
+            Connections = irqs;
+            for(var i = 0; i < Channels; i++)
+            {
+                channels[i] = new Channel();
+            }
+            Reset();
+        }
+
+        public void Reset()
+        {
+            ctrl = 0;
+            baseAddr = 0;
+            wrbAddr = 0;
+            foreach(var ch in channels)
+            {
+                ch.Reset();
+            }
+            UpdateInterrupts();
+        }
+
+        // A peripheral's DMA request: ready says whether it wants a beat now
+        public void AttachTrigger(int source, Func<bool> ready)
+        {
+            if(source > 0)
+            {
+                triggers[source] = ready;
+            }
+        }
+
+        // Moves every beat whose trigger is ready. Peripherals call this when
+        // a request may have changed; beats that touch a peripheral can call
+        // it again, which only asks the running loop for another pass.
+        public void Service()
+        {
+            if(servicing)
+            {
+                again = true;
+                return;
+            }
+            servicing = true;
+            try
+            {
+                do
+                {
+                    again = false;
+                    if((ctrl & CtrlDmaEnable) == 0)
+                    {
+                        break;
+                    }
+                    for(var i = 0; i < Channels; i++)
+                    {
+                        var ch = channels[i];
+                        if(ch.Enabled && !ch.Suspended && ch.HasBlock && TriggerReady(ch))
+                        {
+                            Beat(i, ch);
+                            again = true;
+                        }
+                    }
+                }
+                while(again);
+            }
+            finally
+            {
+                servicing = false;
+            }
+            UpdateInterrupts();
+        }
+
+        public byte ReadByte(long offset)
+        {
+            return (byte)Read(offset);
+        }
+
+        public ushort ReadWord(long offset)
+        {
+            return (ushort)Read(offset);
+        }
+
+        public uint ReadDoubleWord(long offset)
+        {
+            return Read(offset);
+        }
+
+        public void WriteByte(long offset, byte value)
+        {
+            Write(offset, value);
+        }
+
+        public void WriteWord(long offset, ushort value)
+        {
+            Write(offset, value);
+        }
+
+        public void WriteDoubleWord(long offset, uint value)
+        {
+            Write(offset, value);
+        }
+
+        public long Size => 0x400;
+
+        public IReadOnlyDictionary<int, IGPIO> Connections { get; }
+
+        private uint Read(long offset)
+        {
+            if(offset >= ChannelBase && offset < ChannelBase + Channels * ChannelStride)
+            {
+                return ReadChannel(channels[(offset - ChannelBase) / ChannelStride], (offset - ChannelBase) % ChannelStride);
+            }
+            switch(offset)
+            {
+            case 0x00:
+                return ctrl;
+            case 0x24: // INTSTATUS
+            {
+                uint pending = 0;
+                for(var i = 0; i < Channels; i++)
+                {
+                    if((channels[i].IntFlag & channels[i].IntEn) != 0)
+                    {
+                        pending |= 1u << i;
+                    }
+                }
+                return pending;
+            }
+            case 0x28: // BUSYCH
+            {
+                uint busy = 0;
+                for(var i = 0; i < Channels; i++)
+                {
+                    if(channels[i].Enabled && channels[i].HasBlock && !channels[i].Suspended)
+                    {
+                        busy |= 1u << i;
+                    }
+                }
+                return busy;
+            }
+            case 0x34:
+                return baseAddr;
+            case 0x38:
+                return wrbAddr;
+            default:
+                this.Log(LogLevel.Noisy, "Read from unhandled offset 0x{0:X}", offset);
+                return 0;
+            }
+        }
+
+        private void Write(long offset, uint value)
+        {
+            if(offset >= ChannelBase && offset < ChannelBase + Channels * ChannelStride)
+            {
+                var n = (int)((offset - ChannelBase) / ChannelStride);
+                WriteChannel(n, channels[n], (offset - ChannelBase) % ChannelStride, value);
+                Service();
+                return;
+            }
+            switch(offset)
+            {
+            case 0x00:
+                if((value & CtrlSwrst) != 0)
+                {
+                    Reset();
+                    return;
+                }
+                ctrl = (ushort)value;
+                Service();
+                break;
+            case 0x10: // SWTRIGCTRL
+                for(var i = 0; i < Channels; i++)
+                {
+                    if((value & (1u << i)) != 0)
+                    {
+                        channels[i].SoftwareTrigger = true;
+                    }
+                }
+                Service();
+                break;
+            case 0x34:
+                baseAddr = value;
+                break;
+            case 0x38:
+                wrbAddr = value;
+                break;
+            default:
+                this.Log(LogLevel.Noisy, "Write of 0x{0:X} to unhandled offset 0x{1:X}", value, offset);
+                break;
+            }
+        }
+
+        private uint ReadChannel(Channel ch, long reg)
+        {
+            switch(reg)
+            {
+            case 0x0:
+                return ch.CtrlA;
+            case 0xC:
+            case 0xD:
+                return ch.IntEn;
+            case 0xE:
+                return ch.IntFlag;
+            case 0xF: // CHSTATUS: PEND, BUSY
+                return (uint)((ch.Enabled && ch.HasBlock && !ch.Suspended) ? 0x2 : 0x0);
+            default:
+                return 0;
+            }
+        }
+
+        private void WriteChannel(int n, Channel ch, long reg, uint value)
+        {
+            switch(reg)
+            {
+            case 0x0:
+                if((value & ChCtrlaSwrst) != 0)
+                {
+                    ch.Reset();
+                    break;
+                }
+                var enabling = (value & ChCtrlaEnable) != 0 && !ch.Enabled;
+                ch.CtrlA = value;
+                if(enabling)
+                {
+                    ch.Suspended = false;
+                    Load(n, ch, baseAddr + (uint)(n * DescriptorSize));
+                }
+                else if(!ch.Enabled)
+                {
+                    ch.HasBlock = false;
+                    ch.Suspended = false;
+                }
+                break;
+            case 0x4: // CHCTRLB: CMD
+                switch(value & 0x3)
+                {
+                case 1:
+                    ch.Suspended = true;
+                    ch.IntFlag |= IntSusp;
+                    break;
+                case 2:
+                    ch.Suspended = false;
+                    break;
+                }
+                break;
+            case 0xC:
+                ch.IntEn &= (byte)~value;
+                break;
+            case 0xD:
+                ch.IntEn |= (byte)(value & 0x7);
+                break;
+            case 0xE:
+                ch.IntFlag &= (byte)~value;
+                break;
+            }
+            UpdateInterrupts();
+        }
+
+        private bool TriggerReady(Channel ch)
+        {
+            var source = (int)((ch.CtrlA >> 8) & 0x7F);
+            if(source == 0)
+            {
+                return ch.SoftwareTrigger;
+            }
+            return triggers.TryGetValue(source, out var ready) && ready();
+        }
+
+        private void Load(int n, Channel ch, uint address)
+        {
+            ch.BtCtrl = sysbus.ReadWord(address);
+            ch.BtCnt = sysbus.ReadWord(address + 2);
+            ch.Src = sysbus.ReadDoubleWord(address + 4);
+            ch.Dst = sysbus.ReadDoubleWord(address + 8);
+            ch.Next = sysbus.ReadDoubleWord(address + 12);
+            ch.Beat = 0;
+            ch.HasBlock = (ch.BtCtrl & BtctrlValid) != 0 && ch.BtCnt > 0;
+            if((ch.BtCtrl & BtctrlValid) == 0)
+            {
+                this.Log(LogLevel.Warning, "Channel {0}: descriptor at 0x{1:X} not valid", n, address);
+                ch.IntFlag |= IntTerr;
+                ch.CtrlA &= ~ChCtrlaEnable;
+            }
+        }
+
+        private void Beat(int n, Channel ch)
+        {
+            var size = 1u << ((ch.BtCtrl >> 8) & 0x3);
+            var left = (uint)(ch.BtCnt - ch.Beat);
+            var src = (ch.BtCtrl & BtctrlSrcinc) != 0 ? ch.Src - left * size : ch.Src;
+            var dst = (ch.BtCtrl & BtctrlDstinc) != 0 ? ch.Dst - left * size : ch.Dst;
+            switch(size)
+            {
+            case 1:
+                sysbus.WriteByte(dst, sysbus.ReadByte(src));
+                break;
+            case 2:
+                sysbus.WriteWord(dst, sysbus.ReadWord(src));
+                break;
+            default:
+                sysbus.WriteDoubleWord(dst, sysbus.ReadDoubleWord(src));
+                break;
+            }
+            ch.Beat++;
+
+            var action = (ch.CtrlA >> 20) & 0x3;
+            if(action == TrigactBurst)
+            {
+                ch.SoftwareTrigger = false;
+            }
+            if(ch.Beat < ch.BtCnt)
+            {
+                return;
+            }
+
+            var blockAction = (ch.BtCtrl >> 3) & 0x3;
+            if((blockAction & BlockactInt) != 0)
+            {
+                ch.IntFlag |= IntTcmpl;
+            }
+            if(ch.Next != 0)
+            {
+                Load(n, ch, ch.Next);
+            }
+            else
+            {
+                ch.HasBlock = false;
+                ch.CtrlA &= ~ChCtrlaEnable;
+                ch.SoftwareTrigger = false;
+            }
+            if((blockAction & BlockactSuspend) != 0)
+            {
+                ch.Suspended = true;
+                ch.IntFlag |= IntSusp;
+            }
+            UpdateInterrupts();
+        }
+
+        private void UpdateInterrupts()
+        {
+            var lines = new bool[IrqLines];
+            for(var i = 0; i < Channels; i++)
+            {
+                if((channels[i].IntFlag & channels[i].IntEn) != 0)
+                {
+                    lines[Math.Min(i, IrqLines - 1)] = true;
+                }
+            }
+            for(var i = 0; i < IrqLines; i++)
+            {
+                Connections[i].Set(lines[i]);
+            }
+        }
+
+        private class Channel
+        {
+            public void Reset()
+            {
+                CtrlA = 0;
+                IntEn = 0;
+                IntFlag = 0;
+                Suspended = false;
+                HasBlock = false;
+                SoftwareTrigger = false;
+            }
+
+            public bool Enabled => (CtrlA & ChCtrlaEnable) != 0;
+
+            public uint CtrlA;
+            public byte IntEn;
+            public byte IntFlag;
+            public bool Suspended;
+            public bool HasBlock;
+            public bool SoftwareTrigger;
+            public ushort BtCtrl;
+            public ushort BtCnt;
+            public uint Src;
+            public uint Dst;
+            public uint Next;
+            public ushort Beat;
+        }
+
+        private readonly IBusController sysbus;
+        private readonly Channel[] channels = new Channel[Channels];
+        private readonly Dictionary<int, Func<bool>> triggers = new Dictionary<int, Func<bool>>();
+
+        private ushort ctrl;
+        private uint baseAddr;
+        private uint wrbAddr;
+        private bool servicing;
+        private bool again;
+
+        // Channels 0..3 have their own interrupt line, the rest share line 4
+        private const int Channels = 32;
+        private const int IrqLines = 5;
+        private const long ChannelBase = 0x40;
+        private const long ChannelStride = 0x10;
+        private const int DescriptorSize = 16;
+        private const uint CtrlSwrst = 1u << 0;
+        private const uint CtrlDmaEnable = 1u << 1;
+        private const uint ChCtrlaSwrst = 1u << 0;
+        private const uint ChCtrlaEnable = 1u << 1;
+        private const uint TrigactBurst = 2;
+        private const uint BlockactInt = 1;
+        private const uint BlockactSuspend = 2;
+        private const ushort BtctrlValid = 1 << 0;
+        private const ushort BtctrlSrcinc = 1 << 10;
+        private const ushort BtctrlDstinc = 1 << 11;
+        private const byte IntTerr = 1 << 0;
+        private const byte IntTcmpl = 1 << 1;
+        private const byte IntSusp = 1 << 2;
+    }
+}
@@ -0,0 +1,215 @@
+// SAME51 EIC: 16 external interrupt lines with the CONFIG sense modes
+// (rise, fall, both, high, low) and one interrupt output per line
+// (EIC_EXTINT_0..15). A line sensed by level sets its flag again after
+// every register write while the level holds, as the hardware sets it on
+// every sample. Filtering, debouncing and the NMI are not modelled.
+// Inputs are the EXTINT numbers, so a pin is wired as "-> eic@6" for
+// PA22/EXTINT6.
+using System.Collections.Generic;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.Bus;
+
+namespace Antmicro.Renode.Peripherals.GPIOPort
+{
+    public class SAME51_EIC : IDoubleWordPeripheral, IWordPeripheral, IBytePeripheral, IKnownSize,
+        IGPIOReceiver, INumberedGPIOOutput
+    {
+        public SAME51_EIC()
+        {
+            var irqs = new Dictionary<int, IGPIO>();
+            for(var i = 0; i < Lines; i++)
+            {
+                irqs[i] = new GPIO();
+            }
+            Connections = irqs;
+            Reset();
+        }
+
+        public void Reset()
+        {
+            ctrla = 0;
+            inten = 0;
+            intflag = 0;
+            config[0] = config[1] = 0;
+            UpdateInterrupts();
+        }
+
+        public void OnGPIO(int number, bool value)
+        {
+            if(number < 0 || number >= Lines)
+            {
+                this.Log(LogLevel.Warning, "No EXTINT{0}", number);
+                return;
+            }
+            var was = levels[number];
+            levels[number] = value;
+            if((ctrla & CtrlaEnable) == 0)
+            {
+                return;
+            }
+            var sense = (config[number / 8] >> (4 * (number % 8))) & 0x7;
+            bool hit;
+            switch(sense)
+            {
+            case SenseRise:
+                hit = value && !was;
+                break;
+            case SenseFall:
+                hit = !value && was;
+                break;
+            case SenseBoth:
+                hit = value != was;
+                break;
+            case SenseHigh:
+                hit = value;
+                break;
+            case SenseLow:
+                hit = !value;
+                break;
+            default:
+                hit = false;
+                break;
+            }
+            if(hit)
+            {
+                intflag |= 1u << number;
+                UpdateInterrupts();
+            }
+        }
+
+        public byte ReadByte(long offset)
+        {
+            return (byte)(ReadDoubleWord(offset & ~3) >> (int)(8 * (offset & 3)));
+        }
+
+        public ushort ReadWord(long offset)
+        {
+            return (ushort)(ReadDoubleWord(offset & ~3) >> (int)(8 * (offset & 3)));
+        }
+
+        public uint ReadDoubleWord(long offset)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                return ctrla;
+            case 0x04:
+                return 0; // SYNCBUSY
+            case 0x0C:
+            case 0x10:
+                return inten;
+            case 0x14:
+                return intflag;
+            case 0x1C:
+                return config[0];
+            case 0x20:
+                return config[1];
+            case 0x38: // PINSTATE
+            {
+                uint state = 0;
+                for(var i = 0; i < Lines; i++)
+                {
+                    if(levels[i])
+                    {
+                        state |= 1u << i;
+                    }
+                }
+                return state;
+            }
+            default:
+                this.Log(LogLevel.Noisy, "Read from unhandled offset 0x{0:X}", offset);
+                return 0;
+            }
+        }
+
+        public void WriteByte(long offset, byte value)
+        {
+            WriteDoubleWord(offset & ~3, (uint)value << (int)(8 * (offset & 3)));
+        }
+
+        public void WriteWord(long offset, ushort value)
+        {
+            WriteDoubleWord(offset & ~3, (uint)value << (int)(8 * (offset & 3)));
+        }
+
+        public void WriteDoubleWord(long offset, uint value)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                if((value & CtrlaSwrst) != 0)
+                {
+                    Reset();
+                    return;
+                }
+                ctrla = value & 0xFF;
+                break;
+            case 0x0C:
+                inten &= ~value;
+                break;
+            case 0x10:
+                inten |= value & 0xFFFF;
+                break;
+            case 0x14:
+                intflag &= ~value;
+                break;
+            case 0x1C:
+                config[0] = value;
+                break;
+            case 0x20:
+                config[1] = value;
+                break;
+            default:
+                this.Log(LogLevel.Noisy, "Write of 0x{0:X} to unhandled offset 0x{1:X}", value, offset);
+                break;
+            }
+            LatchLevels();
+            UpdateInterrupts();
+        }
+
+        public long Size => 0x400;
+
+        public IReadOnlyDictionary<int, IGPIO> Connections { get; }
+
+        private void LatchLevels()
+        {
+            if((ctrla & CtrlaEnable) == 0)
+            {
+                return;
+            }
+            for(var i = 0; i < Lines; i++)
+            {
+                var sense = (config[i / 8] >> (4 * (i % 8))) & 0x7;
+                if((sense == SenseHigh && levels[i]) || (sense == SenseLow && !levels[i]))
+                {
+                    intflag |= 1u << i;
+                }
+            }
+        }
+
+        private void UpdateInterrupts()
+        {
+            var active = intflag & inten;
+            for(var i = 0; i < Lines; i++)
+            {
+                Connections[i].Set((active & (1u << i)) != 0);
+            }
+        }
+
+        private uint ctrla;
+        private uint inten;
+        private uint intflag;
+        private readonly uint[] config = new uint[2];
+        private readonly bool[] levels = new bool[Lines];
+
+        private const int Lines = 16;
+        private const uint CtrlaSwrst = 1u << 0;
+        private const uint CtrlaEnable = 1u << 1;
+        private const uint SenseRise = 1;
+        private const uint SenseFall = 2;
+        private const uint SenseBoth = 3;
+        private const uint SenseHigh = 4;
+        private const uint SenseLow = 5;
+    }
+}
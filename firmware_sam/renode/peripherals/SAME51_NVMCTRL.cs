@@ -0,0 +1,150 @@
+// SAME51 NVMCTRL in manual write mode. The flash is plain memory in the
+// platform, so CPU writes land in it directly and WP has nothing left to
+// do; EB fills the 8 KiB block with 0xFF. Commands finish at once: STATUS
+// is always READY and INTFLAG.DONE is set after each one. Erase() is for
+// the monitor, to start from blank flash as a new part would.
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.Bus;
+
+namespace Antmicro.Renode.Peripherals.MTD
+{
+    public class SAME51_NVMCTRL : IDoubleWordPeripheral, IWordPeripheral, IBytePeripheral, IKnownSize
+    {
+        public SAME51_NVMCTRL(IMachine machine, long flashSize = 0x100000)
+        {
+            sysbus = machine.GetSystemBus(this);
+            this.flashSize = flashSize;
+            Reset();
+        }
+
+        public void Reset()
+        {
+            ctrla = 0x0004; // AUTOWS
+            addr = 0;
+            intflag = 0;
+        }
+
+        public void Erase(long start, long size)
+        {
+            var blank = new byte[BlockSize];
+            for(var i = 0; i < BlockSize; i++)
+            {
+                blank[i] = 0xFF;
+            }
+            for(var a = start; a < start + size; a += BlockSize)
+            {
+                sysbus.WriteBytes(blank, (ulong)a, (int)System.Math.Min(BlockSize, start + size - a), onlyMemory: true);
+            }
+        }
+
+        public byte ReadByte(long offset)
+        {
+            return (byte)(ReadDoubleWord(offset & ~3) >> (int)(8 * (offset & 3)));
+        }
+
+        public ushort ReadWord(long offset)
+        {
+            return (ushort)(ReadDoubleWord(offset & ~3) >> (int)(8 * (offset & 3)));
+        }
+
+        public uint ReadDoubleWord(long offset)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                return ctrla;
+            case 0x08: // PARAM: NVMP pages of 512 bytes
+                return (uint)(flashSize / PageSize) | (PsizCode << 16);
+            case 0x10: // INTFLAG, STATUS in the upper half
+                return intflag | (StatusReady << 16);
+            case 0x14:
+                return addr;
+            default:
+                this.Log(LogLevel.Noisy, "Read from unhandled offset 0x{0:X}", offset);
+                return 0;
+            }
+        }
+
+        public void WriteByte(long offset, byte value)
+        {
+            WriteDoubleWord(offset & ~3, (uint)value << (int)(8 * (offset & 3)));
+        }
+
+        public void WriteWord(long offset, ushort value)
+        {
+            WriteDoubleWord(offset & ~3, (uint)value << (int)(8 * (offset & 3)));
+        }
+
+        public void WriteDoubleWord(long offset, uint value)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                ctrla = value & 0xFFFF;
+                break;
+            case 0x04:
+                Command(value);
+                break;
+            case 0x10:
+                intflag &= ~value & 0xFFFF;
+                break;
+            case 0x14:
+                addr = value & 0xFFFFFF;
+                break;
+            default:
+                this.Log(LogLevel.Noisy, "Write of 0x{0:X} to unhandled offset 0x{1:X}", value, offset);
+                break;
+            }
+        }
+
+        public long Size => 0x400;
+
+        private void Command(uint value)
+        {
+            if(((value >> 8) & 0xFF) != CmdExecute)
+            {
+                intflag |= IntProge;
+                return;
+            }
+            var cmd = value & 0x7F;
+            switch(cmd)
+            {
+            case CmdEraseBlock:
+                if(addr >= flashSize)
+                {
+                    intflag |= IntAddre;
+                    break;
+                }
+                Erase(addr & ~(long)(BlockSize - 1), BlockSize);
+                break;
+            case CmdWritePage:
+            case CmdPageBufferClear:
+                break;
+            default:
+                this.Log(LogLevel.Warning, "Command 0x{0:X} not modelled", cmd);
+                break;
+            }
+            intflag |= IntDone;
+        }
+
+        private readonly IBusController sysbus;
+        private readonly long flashSize;
+
+        private uint ctrla;
+        private uint addr;
+        private uint intflag;
+
+        private const int BlockSize = 8192;
+        private const int PageSize = 512;
+        private const uint PsizCode = 6; // 512-byte pages
+        private const uint CmdExecute = 0xA5;
+        private const uint CmdEraseBlock = 0x01;
+        private const uint CmdWritePage = 0x03;
+        private const uint CmdPageBufferClear = 0x15;
+        private const uint StatusReady = 1u << 0;
+        private const uint IntDone = 1u << 0;
+        private const uint IntAddre = 1u << 1;
+        private const uint IntProge = 1u << 2;
+    }
+}
@@ -0,0 +1,224 @@
+// SAME51 PORT, groups A and B: DIR/OUT with their CLR/SET/TGL aliases, IN,
+// PMUX and PINCFG. Output n is pin n of group A (32 + n for group B) and
+// follows OUT while the pin is an output; an input pin reads high, as the
+// chip selects do through their pull-ups. Inputs set the level IN reports
+// for pins that are not outputs.
+using System.Collections.Generic;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.Bus;
+
+namespace Antmicro.Renode.Peripherals.GPIOPort
+{
+    public class SAME51_PORT : IDoubleWordPeripheral, IWordPeripheral, IBytePeripheral, IKnownSize,
+        IGPIOReceiver, INumberedGPIOOutput
+    {
+        public SAME51_PORT()
+        {
+            var pins = new Dictionary<int, IGPIO>();
+            for(var i = 0; i < Groups * 32; i++)
+            {
+                pins[i] = new GPIO();
+            }
+            Connections = pins;
+            Reset();
+        }
+
+        public void Reset()
+        {
+            for(var g = 0; g < Groups; g++)
+            {
+                dir[g] = 0;
+                output[g] = 0;
+                input[g] = 0xFFFFFFFF;
+                for(var i = 0; i < 16; i++)
+                {
+                    pmux[g, i] = 0;
+                }
+                for(var i = 0; i < 32; i++)
+                {
+                    pincfg[g, i] = 0;
+                }
+            }
+            Update();
+        }
+
+        public void OnGPIO(int number, bool value)
+        {
+            if(number < 0 || number >= Groups * 32)
+            {
+                return;
+            }
+            var bit = 1u << (number % 32);
+            if(value)
+            {
+                input[number / 32] |= bit;
+            }
+            else
+            {
+                input[number / 32] &= ~bit;
+            }
+        }
+
+        public byte ReadByte(long offset)
+        {
+            var g = (int)(offset / GroupStride);
+            var reg = offset % GroupStride;
+            if(g < Groups && reg >= 0x30 && reg < 0x40)
+            {
+                return pmux[g, reg - 0x30];
+            }
+            if(g < Groups && reg >= 0x40 && reg < 0x60)
+            {
+                return pincfg[g, reg - 0x40];
+            }
+            return (byte)(ReadDoubleWord(offset & ~3) >> (int)(8 * (offset & 3)));
+        }
+
+        public ushort ReadWord(long offset)
+        {
+            return (ushort)(ReadByte(offset) | (ReadByte(offset + 1) << 8));
+        }
+
+        public uint ReadDoubleWord(long offset)
+        {
+            var g = (int)(offset / GroupStride);
+            var reg = offset % GroupStride;
+            if(g >= Groups)
+            {
+                return 0;
+            }
+            switch(reg)
+            {
+            case 0x00:
+            case 0x04:
+            case 0x08:
+            case 0x0C:
+                return dir[g];
+            case 0x10:
+            case 0x14:
+            case 0x18:
+            case 0x1C:
+                return output[g];
+            case 0x20:
+                return (output[g] & dir[g]) | (input[g] & ~dir[g]);
+            default:
+                if(reg >= 0x30 && reg < 0x60)
+                {
+                    return (uint)(ReadByte(offset) | (ReadByte(offset + 1) << 8)
+                        | (ReadByte(offset + 2) << 16) | (ReadByte(offset + 3) << 24));
+                }
+                this.Log(LogLevel.Noisy, "Read from unhandled offset 0x{0:X}", offset);
+                return 0;
+            }
+        }
+
+        public void WriteByte(long offset, byte value)
+        {
+            var g = (int)(offset / GroupStride);
+            var reg = offset % GroupStride;
+            if(g < Groups && reg >= 0x30 && reg < 0x40)
+            {
+                pmux[g, reg - 0x30] = value;
+                return;
+            }
+            if(g < Groups && reg >= 0x40 && reg < 0x60)
+            {
+                pincfg[g, reg - 0x40] = value;
+                return;
+            }
+            // Byte access to the 32-bit registers touches only that byte
+            WriteRegister(g, reg & ~3, (uint)value << (int)(8 * (reg & 3)), 0xFFu << (int)(8 * (reg & 3)));
+        }
+
+        public void WriteWord(long offset, ushort value)
+        {
+            var g = (int)(offset / GroupStride);
+            var reg = offset % GroupStride;
+            if(reg >= 0x30 && reg < 0x60)
+            {
+                WriteByte(offset, (byte)value);
+                WriteByte(offset + 1, (byte)(value >> 8));
+                return;
+            }
+            WriteRegister(g, reg & ~3, (uint)value << (int)(8 * (reg & 3)), 0xFFFFu << (int)(8 * (reg & 3)));
+        }
+
+        public void WriteDoubleWord(long offset, uint value)
+        {
+            var g = (int)(offset / GroupStride);
+            var reg = offset % GroupStride;
+            if(reg >= 0x30 && reg < 0x60)
+            {
+                WriteWord(offset, (ushort)value);
+                WriteWord(offset + 2, (ushort)(value >> 16));
+                return;
+            }
+            WriteRegister(g, reg, value, 0xFFFFFFFF);
+        }
+
+        public long Size => 0x200;
+
+        public IReadOnlyDictionary<int, IGPIO> Connections { get; }
+
+        private void WriteRegister(int g, long reg, uint value, uint mask)
+        {
+            if(g >= Groups)
+            {
+                return;
+            }
+            switch(reg)
+            {
+            case 0x00:
+                dir[g] = (dir[g] & ~mask) | (value & mask);
+                break;
+            case 0x04:
+                dir[g] &= ~value;
+                break;
+            case 0x08:
+                dir[g] |= value;
+                break;
+            case 0x0C:
+                dir[g] ^= value;
+                break;
+            case 0x10:
+                output[g] = (output[g] & ~mask) | (value & mask);
+                break;
+            case 0x14:
+                output[g] &= ~value;
+                break;
+            case 0x18:
+                output[g] |= value;
+                break;
+            case 0x1C:
+                output[g] ^= value;
+                break;
+            default:
+                this.Log(LogLevel.Noisy, "Write of 0x{0:X} to unhandled offset 0x{1:X}", value, g * GroupStride + reg);
+                return;
+            }
+            Update();
+        }
+
+        private void Update()
+        {
+            for(var g = 0; g < Groups; g++)
+            {
+                var level = (output[g] & dir[g]) | ~dir[g];
+                for(var i = 0; i < 32; i++)
+                {
+                    Connections[g * 32 + i].Set((level & (1u << i)) != 0);
+                }
+            }
+        }
+
+        private readonly uint[] dir = new uint[Groups];
+        private readonly uint[] output = new uint[Groups];
+        private readonly uint[] input = new uint[Groups];
+        private readonly byte[,] pmux = new byte[Groups, 16];
+        private readonly byte[,] pincfg = new byte[Groups, 32];
+
+        private const int Groups = 2;
+        private const long GroupStride = 0x80;
+    }
+}
@@ -0,0 +1,72 @@
+// Register file for the clock and cache blocks the firmware only configures
+// (GCLK, MCLK, OSCCTRL, CMCC, TC5): writes are kept and read back, so
+// read-modify-write sequences work, and SYNCBUSY-style registers read 0
+// because nothing ever writes them. A status register that must read
+// non-zero (OSCCTRL DPLL0 STATUS: LOCK | CLKRDY) is set with statusOffset
+// and statusValue.
+using System.Collections.Generic;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.Bus;
+
+namespace Antmicro.Renode.Peripherals.Miscellaneous
+{
+    public class SAME51_Registers : IDoubleWordPeripheral, IWordPeripheral, IBytePeripheral, IKnownSize
+    {
+        public SAME51_Registers(long size = 0x400, long statusOffset = -1, uint statusValue = 0)
+        {
+            this.size = size;
+            this.statusOffset = statusOffset;
+            this.statusValue = statusValue;
+        }
+
+        public void Reset()
+        {
+            bytes.Clear();
+        }
+
+        public byte ReadByte(long offset)
+        {
+            if(statusOffset >= 0 && offset >= statusOffset && offset < statusOffset + 4)
+            {
+                return (byte)(statusValue >> (int)(8 * (offset - statusOffset)));
+            }
+            return bytes.TryGetValue(offset, out var b) ? b : (byte)0;
+        }
+
+        public ushort ReadWord(long offset)
+        {
+            return (ushort)(ReadByte(offset) | (ReadByte(offset + 1) << 8));
+        }
+
+        public uint ReadDoubleWord(long offset)
+        {
+            return (uint)ReadWord(offset) | ((uint)ReadWord(offset + 2) << 16);
+        }
+
+        public void WriteByte(long offset, byte value)
+        {
+            this.Log(LogLevel.Noisy, "0x{0:X} <- 0x{1:X2}", offset, value);
+            bytes[offset] = value;
+        }
+
+        public void WriteWord(long offset, ushort value)
+        {
+            WriteByte(offset, (byte)value);
+            WriteByte(offset + 1, (byte)(value >> 8));
+        }
+
+        public void WriteDoubleWord(long offset, uint value)
+        {
+            WriteWord(offset, (ushort)value);
+            WriteWord(offset + 2, (ushort)(value >> 16));
+        }
+
+        public long Size => size;
+
+        private readonly long size;
+        private readonly long statusOffset;
+        private readonly uint statusValue;
+        private readonly Dictionary<long, byte> bytes = new Dictionary<long, byte>();
+    }
+}
@@ -0,0 +1,396 @@
+// SAME51 SERCOM in the two modes the firmware uses: USART (SERCOM0 to the
+// XBee, SERCOM4 to the TMC2209 bus) and SPI master (SERCOM1 to the BMI088).
+// Register offsets follow include/same51.h.
+//
+// USART: bytes leave at the programmed baud rate (one DATA buffer plus the
+// shift register), so DRE/TXC interrupts pace the firmware like the real
+// part. Received bytes are queued without a rate limit.
+// SPI: a byte written to DATA is exchanged with the attached peripheral at
+// once; wire time is not modelled.
+using System;
+using System.Collections.Generic;
+using Antmicro.Migrant;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Core.Structure;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.Bus;
+using Antmicro.Renode.Peripherals.DMA;
+using Antmicro.Renode.Peripherals.SPI;
+using Antmicro.Renode.Peripherals.Timers;
+using Antmicro.Renode.Time;
+
+namespace Antmicro.Renode.Peripherals.UART
+{
+    public class SAME51_SERCOM : NullRegistrationPointPeripheralContainer<ISPIPeripheral>, IUART,
+        IDoubleWordPeripheral, IWordPeripheral, IBytePeripheral, IKnownSize, INumberedGPIOOutput
+    {
+        public SAME51_SERCOM(IMachine machine, long frequency = 48000000, bool loopback = false,
+            SAME51_DMAC dmac = null, int dmaRxTrigger = -1, int dmaTxTrigger = -1) : base(machine)
+        {
+            this.frequency = frequency;
+            this.loopback = loopback;
+            this.dmac = dmac;
+            var irqs = new Dictionary<int, IGPIO>();
+            for(var i = 0; i < IrqLines; i++)
+            {
+                irqs[i] = new GPIO();
+            }
+            Connections = irqs;
+
+            charTimer = new LimitTimer(machine.ClockSource, 115200, this, "char", CharBits,
+                Direction.Ascending, enabled: false, workMode: WorkMode.OneShot, eventEnabled: true);
+            charTimer.LimitReached += CharSent;
+
+            if(dmac != null)
+            {
+                dmac.AttachTrigger(dmaRxTrigger, () => (Flags & IntRXC) != 0);
+                dmac.AttachTrigger(dmaTxTrigger, () => (Flags & IntDRE) != 0);
+            }
+            Reset();
+        }
+
+        public override void Reset()
+        {
+            ctrla = ctrlb = ctrlc = 0;
+            baud = 0;
+            inten = 0;
+            sticky = 0;
+            status = 0;
+            spiBaud = 0;
+            rx.Clear();
+            txBusy = false;
+            txPending = false;
+            charTimer.Enabled = false;
+            UpdateInterrupts();
+        }
+
+        // Bytes from the host (a terminal, a file or the monitor)
+        public void WriteChar(byte value)
+        {
+            if(!Enabled || Mode != ModeUsart || (ctrlb & CtrlbRxen) == 0)
+            {
+                return;
+            }
+            rx.Enqueue(value);
+            Changed();
+        }
+
+        public void WriteLine(string line)
+        {
+            foreach(var c in line)
+            {
+                WriteChar((byte)c);
+            }
+            WriteChar((byte)'\n');
+        }
+
+        public byte ReadByte(long offset)
+        {
+            return (byte)Read(offset);
+        }
+
+        public ushort ReadWord(long offset)
+        {
+            return (ushort)Read(offset);
+        }
+
+        public uint ReadDoubleWord(long offset)
+        {
+            return Read(offset);
+        }
+
+        public void WriteByte(long offset, byte value)
+        {
+            Write(offset, value, 1);
+        }
+
+        public void WriteWord(long offset, ushort value)
+        {
+            Write(offset, value, 2);
+        }
+
+        public void WriteDoubleWord(long offset, uint value)
+        {
+            Write(offset, value, 4);
+        }
+
+        public long Size => 0x400;
+
+        public IReadOnlyDictionary<int, IGPIO> Connections { get; }
+
+        public uint BaudRate
+        {
+            get
+            {
+                if(Mode == ModeSpiMaster)
+                {
+                    return (uint)(frequency / (2 * (spiBaud + 1)));
+                }
+                if(((ctrla >> 13) & 7) == 1)
+                {
+                    // 16x fractional: fREF / (16 * (BAUD + FP / 8))
+                    var div8 = (baud & 0x1FFF) * 8 + (baud >> 13);
+                    return div8 == 0 ? 0 : (uint)(frequency * 8 / (16 * div8));
+                }
+                // 16x arithmetic: fREF * (65536 - BAUD) / (16 * 65536)
+                return (uint)(frequency * (65536 - baud) / (16L * 65536));
+            }
+        }
+
+        public Bits StopBits => Bits.One;
+
+        public Parity ParityBit => Parity.None;
+
+        [field: Transient]
+        public event Action<byte> CharReceived;
+
+        private uint Read(long offset)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                return ctrla;
+            case 0x04:
+                return ctrlb;
+            case 0x08:
+                return ctrlc;
+            case 0x0C:
+                return Mode == ModeSpiMaster ? spiBaud : baud;
+            case 0x14:
+            case 0x16:
+                return inten;
+            case 0x18:
+                return Flags;
+            case 0x1A:
+                return status;
+            case 0x1C:
+                return 0; // SYNCBUSY: writes synchronise at once
+            case 0x28:
+                return ReadData();
+            default:
+                this.Log(LogLevel.Noisy, "Read from unhandled offset 0x{0:X}", offset);
+                return 0;
+            }
+        }
+
+        private void Write(long offset, uint value, int width)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                WriteCtrla(value);
+                break;
+            case 0x04:
+                ctrlb = value;
+                break;
+            case 0x08:
+                ctrlc = value;
+                break;
+            case 0x0C:
+                if(Mode == ModeSpiMaster)
+                {
+                    spiBaud = (byte)value;
+                }
+                else
+                {
+                    baud = (ushort)value;
+                }
+                UpdateCharTime();
+                break;
+            case 0x14:
+                inten &= (byte)~value;
+                UpdateInterrupts();
+                break;
+            case 0x16:
+                inten |= (byte)value;
+                UpdateInterrupts();
+                break;
+            case 0x18:
+                // DRE and RXC follow the buffers; the rest are write-1-to-clear
+                sticky &= (byte)~(value & ~(IntDRE | IntRXC));
+                UpdateInterrupts();
+                break;
+            case 0x1A:
+                status &= (ushort)~value;
+                break;
+            case 0x28:
+                WriteData((byte)value);
+                break;
+            default:
+                this.Log(LogLevel.Noisy, "Write of 0x{0:X} ({1} bytes) to unhandled offset 0x{2:X}", value, width, offset);
+                break;
+            }
+        }
+
+        private void WriteCtrla(uint value)
+        {
+            if((value & CtrlaSwrst) != 0)
+            {
+                Reset();
+                return;
+            }
+            ctrla = value;
+            UpdateCharTime();
+            Changed();
+        }
+
+        private uint ReadData()
+        {
+            if(rx.Count == 0)
+            {
+                return 0;
+            }
+            var b = rx.Dequeue();
+            Changed();
+            return b;
+        }
+
+        private void WriteData(byte value)
+        {
+            if(!Enabled)
+            {
+                return;
+            }
+            if(Mode == ModeSpiMaster)
+            {
+                var reply = RegisteredPeripheral != null ? RegisteredPeripheral.Transmit(value) : (byte)0xFF;
+                if((ctrlb & CtrlbRxen) != 0)
+                {
+                    if(rx.Count >= SpiRxBuffer)
+                    {
+                        status |= StatusBufovf;
+                        sticky |= IntError;
+                    }
+                    else
+                    {
+                        rx.Enqueue(reply);
+                    }
+                }
+                sticky |= IntTXC;
+                Changed();
+                return;
+            }
+            if((ctrlb & CtrlbTxen) == 0)
+            {
+                return;
+            }
+            sticky &= (byte)~IntTXC;
+            if(!txBusy)
+            {
+                txShift = value;
+                txBusy = true;
+                charTimer.Value = 0;
+                charTimer.Enabled = true;
+            }
+            else if(!txPending)
+            {
+                txData = value;
+                txPending = true;
+            }
+            else
+            {
+                this.Log(LogLevel.Warning, "DATA written while DRE was clear, byte 0x{0:X2} lost", value);
+            }
+            Changed();
+        }
+
+        private void CharSent()
+        {
+            var b = txShift;
+            if(txPending)
+            {
+                txShift = txData;
+                txPending = false;
+                charTimer.Value = 0;
+                charTimer.Enabled = true;
+            }
+            else
+            {
+                txBusy = false;
+                sticky |= IntTXC;
+            }
+            CharReceived?.Invoke(b);
+            if(loopback)
+            {
+                // One-wire bus: every byte sent comes back on RX
+                WriteChar(b);
+            }
+            Changed();
+        }
+
+        private void UpdateCharTime()
+        {
+            charTimer.Frequency = Math.Max(1L, (long)BaudRate);
+        }
+
+        private void Changed()
+        {
+            UpdateInterrupts();
+            dmac?.Service();
+        }
+
+        private void UpdateInterrupts()
+        {
+            var active = (byte)(Flags & inten);
+            Connections[0].Set((active & IntDRE) != 0);
+            Connections[1].Set((active & IntTXC) != 0);
+            Connections[2].Set((active & IntRXC) != 0);
+            Connections[3].Set((active & ~(IntDRE | IntTXC | IntRXC)) != 0);
+        }
+
+        private byte Flags
+        {
+            get
+            {
+                byte f = sticky;
+                if(Enabled && (Mode == ModeSpiMaster || (ctrlb & CtrlbTxen) != 0) && !txPending)
+                {
+                    f |= IntDRE;
+                }
+                if(rx.Count > 0)
+                {
+                    f |= IntRXC;
+                }
+                return f;
+            }
+        }
+
+        private bool Enabled => (ctrla & CtrlaEnable) != 0;
+
+        private uint Mode => (ctrla >> 2) & 7;
+
+        private readonly long frequency;
+        private readonly bool loopback;
+        private readonly SAME51_DMAC dmac;
+        private readonly LimitTimer charTimer;
+        private readonly Queue<byte> rx = new Queue<byte>();
+
+        private uint ctrla;
+        private uint ctrlb;
+        private uint ctrlc;
+        private ushort baud;
+        private byte spiBaud;
+        private byte inten;
+        private byte sticky;
+        private ushort status;
+        private bool txBusy;
+        private bool txPending;
+        private byte txShift;
+        private byte txData;
+
+        private const int IrqLines = 4;
+        private const int SpiRxBuffer = 2;
+        private const ulong CharBits = 10; // 8N1
+        private const uint ModeUsart = 1;
+        private const uint ModeSpiMaster = 3;
+        private const uint CtrlaSwrst = 1u << 0;
+        private const uint CtrlaEnable = 1u << 1;
+        private const uint CtrlbTxen = 1u << 16;
+        private const uint CtrlbRxen = 1u << 17;
+        private const byte IntDRE = 1 << 0;
+        private const byte IntTXC = 1 << 1;
+        private const byte IntRXC = 1 << 2;
+        private const byte IntError = 1 << 7;
+        private const ushort StatusBufovf = 1 << 2;
+    }
+}
@@ -0,0 +1,240 @@
+// SAME51 TCC as the step generator uses it: NPWM counting up to PER from
+// the prescaled 48 MHz clock, PERBUF/CCBUF copied into PER/CC at the
+// overflow after they are written (unless CTRLB.LUPD is set), and the OVF
+// interrupt. The WO outputs
+// are not driven; Pulses counts the periods that emitted a step pulse
+// (0 < CC <= PER), which is what the motor would have seen.
+using System;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.Bus;
+using Antmicro.Renode.Time;
+
+namespace Antmicro.Renode.Peripherals.Timers
+{
+    public class SAME51_TCC : IDoubleWordPeripheral, IWordPeripheral, IBytePeripheral, IKnownSize
+    {
+        public SAME51_TCC(IMachine machine, long frequency = 48000000)
+        {
+            IRQ = new GPIO();
+            timer = new LimitTimer(machine.ClockSource, frequency, this, "count", TccMax + 1,
+                Direction.Ascending, enabled: false, workMode: WorkMode.Periodic, eventEnabled: true);
+            timer.LimitReached += Overflow;
+            Reset();
+        }
+
+        public void Reset()
+        {
+            timer.Reset();
+            ctrla = 0;
+            ctrlb = 0;
+            wave = 0;
+            per = perbuf = TccMax;
+            for(var i = 0; i < Channels; i++)
+            {
+                cc[i] = ccbuf[i] = 0;
+            }
+            bufValid = 0;
+            inten = 0;
+            intflag = 0;
+            Pulses = 0;
+            Overflows = 0;
+            IRQ.Unset();
+        }
+
+        public byte ReadByte(long offset)
+        {
+            return (byte)(ReadDoubleWord(offset & ~3) >> (int)(8 * (offset & 3)));
+        }
+
+        public ushort ReadWord(long offset)
+        {
+            return (ushort)(ReadDoubleWord(offset & ~3) >> (int)(8 * (offset & 3)));
+        }
+
+        public uint ReadDoubleWord(long offset)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                return ctrla;
+            case 0x04:
+                return (uint)ctrlb | ((uint)ctrlb << 8);
+            case 0x08:
+                return 0; // SYNCBUSY
+            case 0x24:
+            case 0x28:
+                return inten;
+            case 0x2C:
+                return intflag;
+            case 0x30: // STATUS: PERBUFV, CCBUFVn
+                return ((bufValid & 1) << 7) | ((bufValid >> 1) << 16);
+            case 0x34:
+                return (uint)timer.Value;
+            case 0x3C:
+                return wave;
+            case 0x40:
+                return per;
+            case 0x6C:
+                return perbuf;
+            default:
+                if(offset >= 0x44 && offset < 0x44 + 4 * Channels)
+                {
+                    return cc[(offset - 0x44) / 4];
+                }
+                if(offset >= 0x70 && offset < 0x70 + 4 * Channels)
+                {
+                    return ccbuf[(offset - 0x70) / 4];
+                }
+                this.Log(LogLevel.Noisy, "Read from unhandled offset 0x{0:X}", offset);
+                return 0;
+            }
+        }
+
+        public void WriteByte(long offset, byte value)
+        {
+            // CTRLBCLR and CTRLBSET are byte registers side by side
+            if(offset == 0x04)
+            {
+                ctrlb &= (byte)~value;
+                return;
+            }
+            if(offset == 0x05)
+            {
+                ctrlb |= value;
+                return;
+            }
+            WriteDoubleWord(offset & ~3, (uint)value << (int)(8 * (offset & 3)));
+        }
+
+        public void WriteWord(long offset, ushort value)
+        {
+            WriteDoubleWord(offset & ~3, (uint)value << (int)(8 * (offset & 3)));
+        }
+
+        public void WriteDoubleWord(long offset, uint value)
+        {
+            switch(offset)
+            {
+            case 0x00:
+                if((value & CtrlaSwrst) != 0)
+                {
+                    Reset();
+                    return;
+                }
+                ctrla = value;
+                timer.Divider = Prescalers[(value >> 8) & 0x7];
+                timer.Enabled = (value & CtrlaEnable) != 0;
+                break;
+            case 0x04:
+                ctrlb &= (byte)~value;
+                ctrlb |= (byte)(value >> 8);
+                break;
+            case 0x24:
+                inten &= ~value;
+                break;
+            case 0x28:
+                inten |= value;
+                break;
+            case 0x2C:
+                intflag &= ~value;
+                break;
+            case 0x34:
+                timer.Value = value & TccMax;
+                break;
+            case 0x3C:
+                wave = value;
+                break;
+            case 0x40:
+                per = value & TccMax;
+                timer.Limit = per + 1;
+                break;
+            case 0x6C:
+                perbuf = value & TccMax;
+                bufValid |= 1;
+                break;
+            default:
+                if(offset >= 0x44 && offset < 0x44 + 4 * Channels)
+                {
+                    cc[(offset - 0x44) / 4] = value & TccMax;
+                    break;
+                }
+                if(offset >= 0x70 && offset < 0x70 + 4 * Channels)
+                {
+                    ccbuf[(offset - 0x70) / 4] = value & TccMax;
+                    bufValid |= 2u << (int)((offset - 0x70) / 4);
+                    break;
+                }
+                this.Log(LogLevel.Noisy, "Write of 0x{0:X} to unhandled offset 0x{1:X}", value, offset);
+                return;
+            }
+            UpdateInterrupts();
+        }
+
+        public long Size => 0x400;
+
+        public GPIO IRQ { get; }
+
+        public ulong Pulses { get; private set; }
+
+        public ulong Overflows { get; private set; }
+
+        private void Overflow()
+        {
+            Overflows++;
+            for(var i = 0; i < Channels; i++)
+            {
+                if(cc[i] > 0 && cc[i] <= per)
+                {
+                    Pulses++;
+                    break;
+                }
+            }
+            if((ctrlb & CtrlbLupd) == 0 && bufValid != 0)
+            {
+                if((bufValid & 1) != 0)
+                {
+                    per = perbuf;
+                    timer.Limit = per + 1;
+                }
+                for(var i = 0; i < Channels; i++)
+                {
+                    if((bufValid & (2u << i)) != 0)
+                    {
+                        cc[i] = ccbuf[i];
+                    }
+                }
+                bufValid = 0;
+            }
+            intflag |= IntOvf;
+            UpdateInterrupts();
+        }
+
+        private void UpdateInterrupts()
+        {
+            IRQ.Set((intflag & inten) != 0);
+        }
+
+        private readonly LimitTimer timer;
+        private readonly uint[] cc = new uint[Channels];
+        private readonly uint[] ccbuf = new uint[Channels];
+
+        private uint ctrla;
+        private byte ctrlb;
+        private uint wave;
+        private uint per;
+        private uint perbuf;
+        private uint bufValid; // bit 0 PERBUF, bit 1 + n CCBUF[n]
+        private uint inten;
+        private uint intflag;
+
+        private static readonly int[] Prescalers = { 1, 2, 4, 8, 16, 64, 256, 1024 };
+
+        private const int Channels = 6;
+        private const uint TccMax = 0xFFFFFF;
+        private const uint CtrlaSwrst = 1u << 0;
+        private const uint CtrlaEnable = 1u << 1;
+        private const byte CtrlbLupd = 1 << 1;
+        private const uint IntOvf = 1u << 0;
+    }
+}
@@ -60,10 +60,10 @@ void attitude_accel_angles(float ax, float ay, float az, float *roll, float *pit
     }
 }
 
-void attitude_update(attitude_filter_t *f,
-                     float gx, float gy, float gz,
-                     float ax, float ay, float az,
-                     float dt, float *roll, float *pitch) {
+RAMFUNC void attitude_update(attitude_filter_t *f,
+                             float gx, float gy, float gz,
+                             float ax, float ay, float az,
+                             float dt, float *roll, float *pitch) {
     (void)gz;
     float roll_acc = 0.0f;
     float pitch_acc = 0.0f;
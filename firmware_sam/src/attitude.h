@@ -1,6 +1,8 @@
 #ifndef ATTITUDE_H
 #define ATTITUDE_H
 
+#include "ramfunc.h"
+
 typedef struct {
     float angle;
     float bias;
@@ -14,9 +16,10 @@ typedef struct {
 
 void attitude_init(attitude_filter_t *f);
 void attitude_accel_angles(float ax, float ay, float az, float *roll, float *pitch);
-void attitude_update(attitude_filter_t *f,
-                     float gx, float gy, float gz,
-                     float ax, float ay, float az,
-                     float dt, float *roll, float *pitch);
+// Runs every control tick, from SRAM
+RAMFUNC void attitude_update(attitude_filter_t *f,
+                             float gx, float gy, float gz,
+                             float ax, float ay, float az,
+                             float dt, float *roll, float *pitch);
 
 #endif
@@ -0,0 +1,326 @@
+#include "blackbox.h"
+
+#include "nvm.h"
+#include "sercom_uart.h"
+#include "telemetry.h"
+
+// Flash layout: one header page, then the records oldest first. The
+// header is written last, so an interrupted save leaves no valid log.
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t trigger_tick;
+    uint8_t reason;
+    uint8_t record_size;
+    uint16_t reserved;
+} bb_header_t;
+
+#define RECORD_SIZE        ((uint32_t)sizeof(blackbox_record_t))
+#define FLASH_RECORDS_ADDR (BLACKBOX_FLASH_ADDR + NVM_PAGE_SIZE)
+#define DUMP_FRAMES_PER_RUN 6
+
+_Static_assert(sizeof(blackbox_record_t) == 36, "record layout changed");
+_Static_assert(NVM_PAGE_SIZE + BLACKBOX_RECORDS * sizeof(blackbox_record_t) <= BLACKBOX_FLASH_SIZE,
+               "blackbox does not fit the flash log region");
+
+typedef enum {
+    BB_RECORDING = 0,
+    BB_POST,        // triggered, recording the post-trigger window
+    BB_FROZEN
+} bb_state_t;
+
+typedef enum {
+    FLASH_IDLE = 0,
+    FLASH_ERASE,
+    FLASH_WRITE,
+    FLASH_HEADER,
+    FLASH_FINISH
+} flash_state_t;
+
+static blackbox_record_t ring[BLACKBOX_RECORDS];
+static uint16_t head;           // next slot to fill
+static uint16_t count;
+static bb_state_t state;
+static uint16_t post_left;
+static uint8_t trig_reason;
+static uint32_t trig_tick;
+static bool rearm_pending;
+
+static flash_state_t flash_state;
+static uint32_t flash_addr;     // next block to erase or page to write
+static uint32_t flash_end;
+static uint32_t page_buf[NVM_PAGE_SIZE / 4];
+
+static bool dump_pending;
+static bool dumping;
+static uint8_t dump_src;
+static uint16_t dump_idx;
+static uint16_t dump_count;
+
+static const bb_header_t *flash_header(void) {
+    return (const bb_header_t *)BLACKBOX_FLASH_ADDR;
+}
+
+static bool flash_valid(void) {
+    const bb_header_t *h = flash_header();
+    return h->magic == BLACKBOX_MAGIC && h->record_size == RECORD_SIZE &&
+           h->count <= BLACKBOX_RECORDS;
+}
+
+// Record i of the frozen ring, oldest first
+static const blackbox_record_t *ram_record(uint16_t i) {
+    uint16_t first = (count < BLACKBOX_RECORDS) ? 0 : head;
+    uint16_t idx = (uint16_t)(first + i);
+    if (idx >= BLACKBOX_RECORDS) {
+        idx -= BLACKBOX_RECORDS;
+    }
+    return &ring[idx];
+}
+
+void blackbox_init(void) {
+    head = 0;
+    count = 0;
+    state = BB_RECORDING;
+    trig_reason = BB_TRIG_NONE;
+    rearm_pending = false;
+    flash_state = FLASH_IDLE;
+    dump_pending = false;
+    dumping = false;
+    nvm_init();
+}
+
+blackbox_record_t *blackbox_next(void) {
+    if (state == BB_FROZEN) {
+        return 0;
+    }
+    return &ring[head];
+}
+
+void blackbox_commit(void) {
+    if (state == BB_FROZEN) {
+        return;
+    }
+    if (++head == BLACKBOX_RECORDS) {
+        head = 0;
+    }
+    if (count < BLACKBOX_RECORDS) {
+        count++;
+    }
+    if (state == BB_POST && --post_left == 0) {
+        state = BB_FROZEN;
+        // A manual freeze must not overwrite the last fall in flash
+        if (BLACKBOX_AUTOSAVE && trig_reason != BB_TRIG_MANUAL) {
+            blackbox_save();
+        }
+    }
+}
+
+void blackbox_trigger(uint8_t reason) {
+    if (state != BB_RECORDING) {
+        return;
+    }
+    state = BB_POST;
+    post_left = BLACKBOX_POST_TICKS;
+    trig_reason = reason;
+    trig_tick = (count > 0) ? ram_record((uint16_t)(count - 1))->tick : 0;
+}
+
+void blackbox_rearm(void) {
+    rearm_pending = true;
+}
+
+bool blackbox_frozen(void) {
+    return state == BB_FROZEN;
+}
+
+void blackbox_save(void) {
+    if (state != BB_FROZEN || flash_state != FLASH_IDLE || count == 0) {
+        return;
+    }
+    flash_addr = BLACKBOX_FLASH_ADDR;
+    flash_end = FLASH_RECORDS_ADDR + count * RECORD_SIZE;
+    flash_state = FLASH_ERASE;
+}
+
+void blackbox_dump(uint8_t source) {
+    // dump_service reads dump_src for every record; a second request must
+    // not switch the copy under a running dump
+    if (dumping || dump_pending) {
+        return;
+    }
+    dump_src = source;
+    dump_pending = true;
+    if (source == BB_SRC_RAM) {
+        blackbox_trigger(BB_TRIG_MANUAL);
+    }
+}
+
+// Fill page_buf with the record stream starting at byte offset off
+static void fill_page(uint32_t off) {
+    uint8_t *dst = (uint8_t *)page_buf;
+    uint32_t total = count * RECORD_SIZE;
+    uint16_t rec = (uint16_t)(off / RECORD_SIZE);
+    uint32_t in_rec = off % RECORD_SIZE;
+    const uint8_t *src = (const uint8_t *)ram_record(rec);
+    for (uint32_t i = 0; i < NVM_PAGE_SIZE; i++) {
+        if (off + i >= total) {
+            dst[i] = 0xFF;
+            continue;
+        }
+        dst[i] = src[in_rec];
+        if (++in_rec == RECORD_SIZE) {
+            in_rec = 0;
+            src = (const uint8_t *)ram_record(++rec);
+        }
+    }
+}
+
+// One flash command per call; each takes a few ms in the background
+static void flash_service(void) {
+    if (flash_state == FLASH_IDLE || !nvm_ready()) {
+        return;
+    }
+    if (nvm_error()) {
+        cmcc_invalidate();
+        flash_state = FLASH_IDLE;
+        return;
+    }
+    switch (flash_state) {
+    case FLASH_ERASE:
+        nvm_erase_block(flash_addr);
+        flash_addr += NVM_BLOCK_SIZE;
+        if (flash_addr >= flash_end) {
+            flash_addr = FLASH_RECORDS_ADDR;
+            flash_state = FLASH_WRITE;
+        }
+        break;
+    case FLASH_WRITE:
+        fill_page(flash_addr - FLASH_RECORDS_ADDR);
+        nvm_write_page(flash_addr, page_buf);
+        flash_addr += NVM_PAGE_SIZE;
+        if (flash_addr >= flash_end) {
+            flash_state = FLASH_HEADER;
+        }
+        break;
+    case FLASH_HEADER: {
+        for (uint32_t i = 0; i < NVM_PAGE_SIZE / 4; i++) {
+            page_buf[i] = 0xFFFFFFFFUL;
+        }
+        bb_header_t *h = (bb_header_t *)page_buf;
+        h->magic = BLACKBOX_MAGIC;
+        h->count = count;
+        h->trigger_tick = trig_tick;
+        h->reason = trig_reason;
+        h->record_size = (uint8_t)RECORD_SIZE;
+        h->reserved = 0;
+        nvm_write_page(BLACKBOX_FLASH_ADDR, page_buf);
+        flash_state = FLASH_FINISH;
+        break;
+    }
+    case FLASH_FINISH:
+    default:
+        // The CMCC may still hold the old log; reads see the new one
+        cmcc_invalidate();
+        flash_state = FLASH_IDLE;
+        break;
+    }
+}
+
+static void send(telem_frame_t *f) {
+    uint8_t out[TELEM_MAX_FRAME];
+    uart_write(out, telem_finish(f, out));
+}
+
+static void put_record(telem_frame_t *f, const blackbox_record_t *r) {
+    telem_put_u32(f, r->tick);
+    telem_put_u16(f, (uint16_t)r->ax);
+    telem_put_u16(f, (uint16_t)r->ay);
+    telem_put_u16(f, (uint16_t)r->az);
+    telem_put_u16(f, (uint16_t)r->gx);
+    telem_put_u16(f, (uint16_t)r->gy);
+    telem_put_u16(f, (uint16_t)r->gz);
+    telem_put_u16(f, (uint16_t)r->roll);
+    telem_put_u16(f, (uint16_t)r->pitch);
+    telem_put_u16(f, (uint16_t)r->target_pitch);
+    telem_put_u16(f, (uint16_t)r->p_term);
+    telem_put_u16(f, (uint16_t)r->i_term);
+    telem_put_u16(f, (uint16_t)r->d_term);
+    telem_put_u16(f, (uint16_t)r->left);
+    telem_put_u16(f, (uint16_t)r->right);
+    telem_put_u16(f, r->latency_us);
+    telem_put_u8(f, r->state);
+    telem_put_u8(f, r->mode);
+}
+
+static void dump_start(void) {
+    telem_frame_t f;
+    uint8_t reason = trig_reason;
+    uint32_t tick = trig_tick;
+    if (dump_src == BB_SRC_FLASH) {
+        bool valid = flash_valid();
+        dump_count = valid ? (uint16_t)flash_header()->count : 0;
+        reason = valid ? flash_header()->reason : BB_TRIG_NONE;
+        tick = valid ? flash_header()->trigger_tick : 0;
+    } else {
+        dump_count = count;
+    }
+    telem_begin(&f, TELEM_TYPE_BB_INFO);
+    telem_put_u8(&f, dump_src);
+    telem_put_u8(&f, reason);
+    telem_put_u8(&f, (uint8_t)RECORD_SIZE);
+    telem_put_u16(&f, dump_count);
+    telem_put_u32(&f, tick);
+    send(&f);
+    dump_idx = 0;
+    dumping = true;
+}
+
+// Send records while the TX ring has room, leaving space for telemetry
+static void dump_service(void) {
+    for (int n = 0; n < DUMP_FRAMES_PER_RUN; n++) {
+        if (uart_tx_free() < 4 * TELEM_MAX_FRAME) {
+            return;
+        }
+        telem_frame_t f;
+        if (dump_idx >= dump_count) {
+            telem_begin(&f, TELEM_TYPE_BB_END);
+            telem_put_u16(&f, dump_count);
+            send(&f);
+            dumping = false;
+            return;
+        }
+        const blackbox_record_t *r = (dump_src == BB_SRC_FLASH)
+            ? (const blackbox_record_t *)FLASH_RECORDS_ADDR + dump_idx
+            : ram_record(dump_idx);
+        telem_begin(&f, TELEM_TYPE_BB_RECORD);
+        telem_put_u16(&f, dump_idx);
+        put_record(&f, r);
+        send(&f);
+        dump_idx++;
+    }
+}
+
+void blackbox_service(void) {
+    flash_service();
+
+    if (dump_pending && !dumping) {
+        // RAM dumps wait for the freeze, flash dumps for the save
+        bool ready = (dump_src == BB_SRC_FLASH) ? (flash_state == FLASH_IDLE)
+                                                : (state == BB_FROZEN);
+        if (ready) {
+            dump_pending = false;
+            dump_start();
+        }
+    }
+    if (dumping) {
+        dump_service();
+    }
+
+    if (rearm_pending && flash_state == FLASH_IDLE && !dumping && !dump_pending) {
+        rearm_pending = false;
+        head = 0;
+        count = 0;
+        trig_reason = BB_TRIG_NONE;
+        state = BB_RECORDING;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Post-mortem recorder. Every control tick appends one record to a ring
+// in SRAM. A trigger (tilt cutoff, disarm, RC timeout) keeps recording for
+// BLACKBOX_POST_TICKS more ticks and then freezes the ring, so the last
+// few seconds around the fall survive. A frozen ring is copied to the
+// flash log region, from where it survives a power cycle, and either copy
+// can be streamed out as telemetry frames.
+
+#define BLACKBOX_RECORDS    3072   // 3.07 s at 1 kHz, 108 KB
+#define BLACKBOX_POST_TICKS 250    // keep recording 0.25 s past the trigger
+#define BLACKBOX_AUTOSAVE   1      // copy to flash on every non-manual freeze
+
+// Flash log region, top of bank B (128 KB, flash map in bootcfg.h)
+#define BLACKBOX_FLASH_ADDR 0x000E0000UL
+#define BLACKBOX_FLASH_SIZE 0x00020000UL
+#define BLACKBOX_MAGIC      0x31584242UL  // "BBX1"
+
+// Trigger reasons
+#define BB_TRIG_NONE    0
+#define BB_TRIG_TILT    1
+#define BB_TRIG_DISARM  2
+#define BB_TRIG_TIMEOUT 3
+#define BB_TRIG_MANUAL  4
+
+// Dump sources
+#define BB_SRC_RAM   0
+#define BB_SRC_FLASH 1
+
+// One control tick, 36 bytes. Angles in centidegrees, PID terms and motor
+// commands in steps/s, IMU in raw sensor LSB.
+typedef struct {
+    uint32_t tick;
+    int16_t ax, ay, az;
+    int16_t gx, gy, gz;
+    int16_t roll, pitch;
+    int16_t target_pitch;
+    int16_t p_term, i_term, d_term;
+    int16_t left, right;
+    uint16_t latency_us;    // data-ready edge to motor command
+    uint8_t state;
+    uint8_t mode;           // bit 7 = enabled
+} blackbox_record_t;
+
+void blackbox_init(void);
+
+// Slot for this tick's record, filled in place by the caller, or NULL
+// once the ring is frozen. blackbox_commit() appends it.
+blackbox_record_t *blackbox_next(void);
+void blackbox_commit(void);
+
+// Start the post-trigger window; ignored unless recording
+void blackbox_trigger(uint8_t reason);
+
+// Clear the ring and record again (waits for a flash save to finish)
+void blackbox_rearm(void);
+
+// Copy the frozen ring to flash (automatic with BLACKBOX_AUTOSAVE)
+void blackbox_save(void);
+
+// Stream a copy as BB_INFO, BB_RECORD... and BB_END telemetry frames.
+// Ignored while a dump is pending or running.
+void blackbox_dump(uint8_t source);
+
+// Run from a low-priority task: flash programming and dump pacing
+void blackbox_service(void);
+
+bool blackbox_frozen(void);
+
+#endif
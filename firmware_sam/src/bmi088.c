@@ -1,14 +1,25 @@
 #include "bmi088.h"
 #include "same51.h"
 #include "sercom_spi.h"
+#include "dmac.h"
+#include "ramfunc.h"
 
 // CS pins on PORTA
 #define ACCEL_CS_PIN 20
 #define GYRO_CS_PIN  21
 
+// Gyro INT3 -> PA22 (EXTINT6, PMUX function A)
+#define GYRO_INT_PIN    22
+#define GYRO_INT_EXTINT 6
+
 // BMI088 register addresses
 #define BMI088_ACC_CHIP_ID      0x00
+#define BMI088_ACC_STATUS       0x03
 #define BMI088_ACC_DATA         0x12
+#define BMI088_ACC_FIFO_DATA    0x26
+#define BMI088_ACC_FIFO_DOWNS   0x45
+#define BMI088_ACC_FIFO_CONFIG_0 0x48
+#define BMI088_ACC_FIFO_CONFIG_1 0x49
 #define BMI088_ACC_CONF         0x40
 #define BMI088_ACC_RANGE        0x41
 #define BMI088_ACC_PWR_CONF     0x7C
@@ -20,10 +31,43 @@
 #define BMI088_GYR_RANGE        0x0F
 #define BMI088_GYR_BANDWIDTH    0x10
 #define BMI088_GYR_SOFTRESET    0x14
+#define BMI088_GYR_INT_CTRL     0x15
+#define BMI088_GYR_INT3_IO_CONF 0x16
+#define BMI088_GYR_INT3_IO_MAP  0x18
+#define BMI088_GYR_FIFO_STATUS  0x0E
+#define BMI088_GYR_FIFO_WM_EN   0x1E
+#define BMI088_GYR_FIFO_CONFIG_0 0x3D
+#define BMI088_GYR_FIFO_CONFIG_1 0x3E
+#define BMI088_GYR_FIFO_DATA    0x3F
+
+// Accel FIFO frame headers
+#define ACC_FRAME_DATA          0x84  // low 2 bits carry interrupt tags
+#define ACC_FRAME_SKIP          0x40
+#define ACC_FRAME_SENSORTIME    0x44
+#define ACC_FRAME_CONFIG        0x48
+#define ACC_FRAME_DROP          0x50
+#define ACC_FRAME_EMPTY         0x80
+
+// FIFO batching: gyro at 2 kHz, watermark of 2 frames = one 1 kHz tick
+#define GYRO_ODR_HZ             2000
+#define GYRO_FIFO_WATERMARK     2
+#define SENSORTIME_US           39.0625f
+// Re-estimate the gyro frame period against sensor time this often
+#define GYRO_PERIOD_WINDOW      2000
 
 // Expected chip IDs
 #define BMI088_ACC_CHIP_ID_VAL  0x1E
 #define BMI088_GYR_CHIP_ID_VAL  0x0F
+#define BMI088_SOFTRESET_CMD    0xB6
+#define ACC_STATUS_DRDY         0x80
+
+// Init polls ID and status registers; these are only the give-up limits
+// (datasheet: gyro ready 30 ms after POR or soft reset, accel 1 ms)
+#define POR_TIMEOUT_US          50000
+#define RESET_TIMEOUT_US        50000
+#define ACC_RESET_US            1000   // before the accel answers at all
+#define ACC_PWR_CONF_US         450    // active mode to enable
+#define ACC_START_TIMEOUT_US    20000  // enable to first data ready
 
 // Scale factors
 // Accel: ±3g range -> 10920 LSB/g
@@ -31,7 +75,71 @@
 // Gyro: ±2000 deg/s range -> 16.4 LSB/(deg/s) -> rad/s
 #define GYRO_SCALE  (1.0f / 16.4f * 3.14159265f / 180.0f)
 
-extern void delay_ms(uint32_t ms);
+extern void delay_us(uint32_t us);
+
+static volatile uint32_t drdy_count = 0;
+static volatile uint32_t drdy_cycles = 0;
+
+// INT3 is a level: high while the gyro FIFO holds the watermark or more.
+// The EIC senses it as a level and the line is masked from the interrupt
+// until the drain has published, so frames left behind (a drain reads at
+// most GYR_MAX_FRAMES) start the next drain at once instead of leaving
+// the line high with no edge to come.
+static inline void drdy_mask(void) {
+    EIC->INTENCLR = (1 << GYRO_INT_EXTINT);
+}
+
+static inline void drdy_unmask(void) {
+    EIC->INTFLAG = (1 << GYRO_INT_EXTINT);
+    EIC->INTENSET = (1 << GYRO_INT_EXTINT);
+}
+
+// One FIFO drain per watermark interrupt, three SPI transactions:
+//   accel FIFO burst (reg, dummy, ACC_BURST bytes of frames)
+//   gyro FIFO_STATUS (reg, frame count)
+//   gyro FIFO burst (reg, 6 bytes per counted frame)
+// The first two are chained descriptors; the TX channel suspends after the
+// accel block so CS can be switched. The gyro burst length comes from the
+// status byte, so the ISR loads it as a new transfer.
+#define ACC_BURST        36  // 4 frames + sensor time + slack at 1.6 kHz
+#define ACC_XFER_LEN     (2 + ACC_BURST)
+#define GYR_STATUS_LEN   2
+#define GYR_MAX_FRAMES   8
+#define GYR_XFER_MAX     (1 + GYR_MAX_FRAMES * 6)
+
+typedef enum {
+    DMA_IDLE = 0,
+    DMA_ACCEL,
+    DMA_GYRO_STATUS,
+    DMA_GYRO_DATA
+} dma_phase_t;
+
+static uint8_t tx_acc[ACC_XFER_LEN] = { BMI088_ACC_FIFO_DATA | 0x80 };
+static uint8_t tx_gyr_status[GYR_STATUS_LEN] = { BMI088_GYR_FIFO_STATUS | 0x80 };
+static uint8_t tx_gyr[GYR_XFER_MAX] = { BMI088_GYR_FIFO_DATA | 0x80 };
+static uint8_t rx_acc[ACC_XFER_LEN];
+static uint8_t rx_gyr_status[GYR_STATUS_LEN];
+static uint8_t rx_gyr[GYR_XFER_MAX];
+static DmacDescriptor tx_status_desc;
+static DmacDescriptor rx_status_desc;
+
+static volatile dma_phase_t dma_phase = DMA_IDLE;
+static volatile uint32_t dma_overruns = 0;
+static uint32_t dma_drdy_cycles;
+static uint32_t data_addr;
+static uint8_t gyr_frames;
+
+// Published samples: slot (sample_count & 1) is the latest
+static bmi088_sample_t samples[2];
+static uint32_t sample_drdy_cycles[2];
+static volatile uint32_t sample_count = 0;
+
+// Gyro frame period in seconds, refined against accel sensor time
+static float gyro_period = 1.0f / GYRO_ODR_HZ;
+static uint32_t last_sensortime;
+static bool have_sensortime = false;
+static uint32_t window_frames;
+static uint32_t window_ticks;
 
 static inline void cs_accel_low(void)  { PORTA->OUTCLR = (1 << ACCEL_CS_PIN); }
 static inline void cs_accel_high(void) { PORTA->OUTSET = (1 << ACCEL_CS_PIN); }
@@ -71,55 +179,125 @@ static void gyro_write_reg(uint8_t reg, uint8_t val) {
     cs_gyro_high();
 }
 
+static bmi088_init_times_t init_times;
+
+static uint32_t elapsed_us(uint32_t since) {
+    return (dwt_cycles() - since) / (CPU_HZ / 1000000UL);
+}
+
+static uint8_t accel_read_reg(uint8_t reg) {
+    uint8_t v = 0;
+    accel_read_regs(reg, &v, 1);
+    return v;
+}
+
+static uint8_t gyro_read_reg(uint8_t reg) {
+    uint8_t v = 0;
+    gyro_read_regs(reg, &v, 1);
+    return v;
+}
+
+// Write, then read back the bits the register keeps. A chip ID answer
+// does not prove the soft reset is over, so a lost write shows up here.
+static bool gyro_write_checked(uint8_t reg, uint8_t val, uint8_t mask) {
+    gyro_write_reg(reg, val);
+    return (gyro_read_reg(reg) & mask) == (val & mask);
+}
+
+// Poll until (reg & mask) == val, measuring from since. Returns false
+// once timeout_us has passed.
+static bool accel_wait(uint8_t reg, uint8_t mask, uint8_t val, uint32_t since, uint32_t timeout_us) {
+    while ((accel_read_reg(reg) & mask) != val) {
+        if (elapsed_us(since) > timeout_us) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool gyro_wait(uint8_t reg, uint8_t val, uint32_t since, uint32_t timeout_us) {
+    while (gyro_read_reg(reg) != val) {
+        if (elapsed_us(since) > timeout_us) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool bmi088_init(void) {
     // Configure CS pins as outputs, initially high
     PORTA->DIRSET = (1 << ACCEL_CS_PIN) | (1 << GYRO_CS_PIN);
     cs_accel_high();
     cs_gyro_high();
 
-    delay_ms(10);
-
-    // Soft reset accelerometer
-    accel_write_reg(BMI088_ACC_SOFTRESET, 0xB6);
-    delay_ms(50);
-
-    // Dummy read to switch accel to SPI mode
-    uint8_t dummy;
-    accel_read_regs(BMI088_ACC_CHIP_ID, &dummy, 1);
-    delay_ms(1);
+    // Power-on reset: the gyro answers its chip ID once it is done
+    uint32_t t0 = dwt_cycles();
+    if (!gyro_wait(BMI088_GYR_CHIP_ID, BMI088_GYR_CHIP_ID_VAL, t0, POR_TIMEOUT_US)) {
+        return false;
+    }
+    init_times.por_us = elapsed_us(t0);
 
-    // Read and verify chip IDs
-    uint8_t acc_id = 0;
-    uint8_t gyr_id = 0;
-    accel_read_regs(BMI088_ACC_CHIP_ID, &acc_id, 1);
-    gyro_read_regs(BMI088_GYR_CHIP_ID, &gyr_id, 1);
-    if (acc_id != BMI088_ACC_CHIP_ID_VAL || gyr_id != BMI088_GYR_CHIP_ID_VAL) {
+    // Soft reset both sensors back to back and wait for them together
+    t0 = dwt_cycles();
+    accel_write_reg(BMI088_ACC_SOFTRESET, BMI088_SOFTRESET_CMD);
+    gyro_write_reg(BMI088_GYR_SOFTRESET, BMI088_SOFTRESET_CMD);
+    delay_us(ACC_RESET_US);
+    // Dummy read to switch the accel to SPI mode, then poll the IDs
+    (void)accel_read_reg(BMI088_ACC_CHIP_ID);
+    if (!accel_wait(BMI088_ACC_CHIP_ID, 0xFF, BMI088_ACC_CHIP_ID_VAL, t0, RESET_TIMEOUT_US) ||
+        !gyro_wait(BMI088_GYR_CHIP_ID, BMI088_GYR_CHIP_ID_VAL, t0, RESET_TIMEOUT_US)) {
         return false;
     }
+    init_times.reset_us = elapsed_us(t0);
 
     // Power on accelerometer
+    t0 = dwt_cycles();
     accel_write_reg(BMI088_ACC_PWR_CONF, 0x00); // active mode
-    delay_ms(5);
+    delay_us(ACC_PWR_CONF_US);
     accel_write_reg(BMI088_ACC_PWR_CTRL, 0x04); // enable accel
-    delay_ms(50);
 
-    // Configure accelerometer: ODR=400Hz, OSR=normal
+    // Configure accelerometer: ODR=1600Hz, OSR=normal
     accel_write_reg(BMI088_ACC_CONF, 0xAC);
     // Range: ±3g
     accel_write_reg(BMI088_ACC_RANGE, 0x00);
 
-    // Soft reset gyroscope
-    gyro_write_reg(BMI088_GYR_SOFTRESET, 0xB6);
-    delay_ms(50);
+    // Configure gyroscope while the accel starts: ±2000 deg/s
+    bool gyro_ok = gyro_write_checked(BMI088_GYR_RANGE, 0x00, 0xFF);
+    // Bandwidth: ODR=2000Hz, filter=230Hz (below the 500 Hz tick Nyquist).
+    // Bit 7 always reads back as 1.
+    gyro_ok = gyro_ok && gyro_write_checked(BMI088_GYR_BANDWIDTH, 0x01, 0x7F);
+
+    // Accel FIFO: stream mode, accel frames, no downsampling
+    accel_write_reg(BMI088_ACC_FIFO_DOWNS, 0x80);
+    accel_write_reg(BMI088_ACC_FIFO_CONFIG_0, 0x02);
+    accel_write_reg(BMI088_ACC_FIFO_CONFIG_1, 0x50);
+
+    // Gyro FIFO: stream mode, watermark interrupt on INT3, push-pull,
+    // active high
+    gyro_write_reg(BMI088_GYR_FIFO_CONFIG_0, GYRO_FIFO_WATERMARK);
+    gyro_ok = gyro_ok && gyro_write_checked(BMI088_GYR_FIFO_CONFIG_1, 0x80, 0xC0);
+    gyro_write_reg(BMI088_GYR_FIFO_WM_EN, 0x88);
+    gyro_write_reg(BMI088_GYR_INT_CTRL, 0x40);
+    gyro_write_reg(BMI088_GYR_INT3_IO_CONF, 0x01);
+    gyro_ok = gyro_ok && gyro_write_checked(BMI088_GYR_INT3_IO_MAP, 0x04, 0xA5);
+    if (!gyro_ok) {
+        return false;
+    }
 
-    // Configure gyroscope: ±2000 deg/s
-    gyro_write_reg(BMI088_GYR_RANGE, 0x00);
-    // Bandwidth: ODR=400Hz, filter=47Hz
-    gyro_write_reg(BMI088_GYR_BANDWIDTH, 0x03);
-    delay_ms(10);
+    // The accel is up once it flags its first sample
+    if (!accel_wait(BMI088_ACC_STATUS, ACC_STATUS_DRDY, ACC_STATUS_DRDY, t0, ACC_START_TIMEOUT_US)) {
+        return false;
+    }
+    init_times.accel_start_us = elapsed_us(t0);
     return true;
 }
 
+void bmi088_init_times(bmi088_init_times_t *out) {
+    out->por_us = init_times.por_us;
+    out->reset_us = init_times.reset_us;
+    out->accel_start_us = init_times.accel_start_us;
+}
+
 void bmi088_read_raw(bmi088_sample_t *out) {
     uint8_t buf[6];
 
@@ -132,17 +310,287 @@ void bmi088_read_raw(bmi088_sample_t *out) {
     out->gx = (int16_t)((buf[1] << 8) | buf[0]);
     out->gy = (int16_t)((buf[3] << 8) | buf[2]);
     out->gz = (int16_t)((buf[5] << 8) | buf[4]);
+    out->acc_frames = 1;
+    out->gyr_frames = 1;
+    out->sensortime = 0;
+    out->dt = 0.0f;
+}
+
+void bmi088_scale(const bmi088_sample_t *raw, bmi088_scaled_t *out) {
+    out->ax = raw->ax * ACCEL_SCALE;
+    out->ay = raw->ay * ACCEL_SCALE;
+    out->az = raw->az * ACCEL_SCALE;
+
+    out->gx = raw->gx * GYRO_SCALE;
+    out->gy = raw->gy * GYRO_SCALE;
+    out->gz = raw->gz * GYRO_SCALE;
+    out->dt = raw->dt;
 }
 
 void bmi088_read_scaled(bmi088_scaled_t *out) {
     bmi088_sample_t raw;
     bmi088_read_raw(&raw);
+    bmi088_scale(&raw, out);
+}
+
+static void desc_set(DmacDescriptor *d, uint16_t btctrl, uint16_t count,
+                     uint32_t src, uint32_t dst, DmacDescriptor *next) {
+    d->BTCTRL = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | btctrl;
+    d->BTCNT = count;
+    d->SRCADDR = src;
+    d->DSTADDR = dst;
+    d->DESCADDR = (uint32_t)next;
+}
+
+static void dma_init(void) {
+    data_addr = (uint32_t)spi_data_reg();
+
+    dmac_init();
+    dmac_channel_init(DMAC_CH_SPI_TX, DMAC_TRIG_SERCOM1_TX);
+    dmac_channel_init(DMAC_CH_SPI_RX, DMAC_TRIG_SERCOM1_RX);
 
-    out->ax = raw.ax * ACCEL_SCALE;
-    out->ay = raw.ay * ACCEL_SCALE;
-    out->az = raw.az * ACCEL_SCALE;
+    desc_set(&tx_status_desc, DMAC_BTCTRL_SRCINC,
+             GYR_STATUS_LEN, (uint32_t)(tx_gyr_status + GYR_STATUS_LEN), data_addr, 0);
+    desc_set(&rx_status_desc, DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_BLOCKACT_INT,
+             GYR_STATUS_LEN, data_addr, (uint32_t)(rx_gyr_status + GYR_STATUS_LEN), 0);
+
+    DMAC->CHANNEL[DMAC_CH_SPI_RX].CHINTENSET = DMAC_CHINT_TCMPL | DMAC_CHINT_TERR;
+    nvic_enable_irq(DMAC_0_IRQn + DMAC_CH_SPI_RX);
+}
+
+// Called from the watermark ISR: accel burst chained to the gyro status
+static void dma_start(void) {
+    if (dma_phase != DMA_IDLE) {
+        dma_overruns++;
+        return;
+    }
+    dma_phase = DMA_ACCEL;
+    dma_drdy_cycles = drdy_cycles;
+    desc_set(dmac_desc(DMAC_CH_SPI_TX), DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_BLOCKACT_SUSPEND,
+             ACC_XFER_LEN, (uint32_t)(tx_acc + ACC_XFER_LEN), data_addr, &tx_status_desc);
+    desc_set(dmac_desc(DMAC_CH_SPI_RX), DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_BLOCKACT_INT,
+             ACC_XFER_LEN, data_addr, (uint32_t)(rx_acc + ACC_XFER_LEN), &rx_status_desc);
+    cs_accel_low();
+    dmac_channel_enable(DMAC_CH_SPI_RX);
+    dmac_channel_enable(DMAC_CH_SPI_TX);
+}
+
+static void dma_start_gyro(uint8_t frames) {
+    uint16_t len = (uint16_t)(1 + frames * 6);
+    gyr_frames = frames;
+    dma_phase = DMA_GYRO_DATA;
+    desc_set(dmac_desc(DMAC_CH_SPI_TX), DMAC_BTCTRL_SRCINC,
+             len, (uint32_t)(tx_gyr + len), data_addr, 0);
+    desc_set(dmac_desc(DMAC_CH_SPI_RX), DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_BLOCKACT_INT,
+             len, data_addr, (uint32_t)(rx_gyr + len), 0);
+    cs_gyro_low();
+    dmac_channel_enable(DMAC_CH_SPI_RX);
+    dmac_channel_enable(DMAC_CH_SPI_TX);
+}
+
+static inline int16_t le16(const uint8_t *p) {
+    return (int16_t)((p[1] << 8) | p[0]);
+}
+
+// Average the accel frames of this drain and pick up the sensor time frame
+// the FIFO appends once it has been read empty.
+static uint8_t parse_accel(int32_t sum[3], uint32_t *sensortime, bool *have_time) {
+    const uint8_t *p = &rx_acc[2];
+    const uint8_t *end = &rx_acc[ACC_XFER_LEN];
+    uint8_t frames = 0;
+    *have_time = false;
+    while (p < end) {
+        uint8_t h = *p++;
+        if ((h & 0xFC) == ACC_FRAME_DATA) {
+            if (end - p < 6) break;
+            sum[0] += le16(p);
+            sum[1] += le16(p + 2);
+            sum[2] += le16(p + 4);
+            frames++;
+            p += 6;
+        } else if (h == ACC_FRAME_SENSORTIME) {
+            if (end - p < 3) break;
+            *sensortime = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+            *have_time = true;
+            p += 3;
+        } else if (h == ACC_FRAME_SKIP || h == ACC_FRAME_CONFIG || h == ACC_FRAME_DROP) {
+            p += 1;
+        } else {
+            break;  // ACC_FRAME_EMPTY or garbage: nothing more this drain
+        }
+    }
+    return frames;
+}
+
+static void dma_publish(uint8_t gyr_count) {
+    uint8_t slot = (uint8_t)((sample_count + 1) & 1);
+    bmi088_sample_t *out = &samples[slot];
+
+    int32_t acc[3] = { 0, 0, 0 };
+    uint32_t sensortime = 0;
+    bool have_time;
+    uint8_t acc_frames = parse_accel(acc, &sensortime, &have_time);
+    if (acc_frames > 0) {
+        out->ax = (int16_t)(acc[0] / acc_frames);
+        out->ay = (int16_t)(acc[1] / acc_frames);
+        out->az = (int16_t)(acc[2] / acc_frames);
+    } else {
+        *out = samples[slot ^ 1];  // hold the previous accel reading
+    }
+
+    if (gyr_count > 0) {
+        int32_t gyr[3] = { 0, 0, 0 };
+        for (uint8_t f = 0; f < gyr_count; f++) {
+            const uint8_t *g = &rx_gyr[1 + f * 6];
+            gyr[0] += le16(g);
+            gyr[1] += le16(g + 2);
+            gyr[2] += le16(g + 4);
+        }
+        out->gx = (int16_t)(gyr[0] / gyr_count);
+        out->gy = (int16_t)(gyr[1] / gyr_count);
+        out->gz = (int16_t)(gyr[2] / gyr_count);
+    } else {
+        const bmi088_sample_t *prev = &samples[slot ^ 1];
+        out->gx = prev->gx;
+        out->gy = prev->gy;
+        out->gz = prev->gz;
+    }
+    out->acc_frames = acc_frames;
+    out->gyr_frames = gyr_count;
+
+    // The averaged gyro covers gyr_count frame periods; calibrate that
+    // period against the accel die's sensor time over longer windows.
+    if (have_time) {
+        if (have_sensortime) {
+            window_ticks += (sensortime - last_sensortime) & 0xFFFFFF;
+            if (window_frames >= GYRO_PERIOD_WINDOW) {
+                float p = (float)window_ticks * (SENSORTIME_US * 1e-6f) / (float)window_frames;
+                if (p > 0.95f / GYRO_ODR_HZ && p < 1.05f / GYRO_ODR_HZ) {
+                    gyro_period = p;
+                }
+                window_ticks = 0;
+                window_frames = 0;
+            }
+        }
+        last_sensortime = sensortime;
+        have_sensortime = true;
+        window_frames += gyr_count;
+    } else if (have_sensortime) {
+        window_frames += gyr_count;
+    }
+    out->sensortime = sensortime;
+    out->dt = (float)gyr_count * gyro_period;
+
+    sample_drdy_cycles[slot] = dma_drdy_cycles;
+    sample_count++;
+    drdy_unmask();
+}
+
+// RX channel: one interrupt per transaction (accel, gyro status, gyro data)
+RAMFUNC void DMAC_1_Handler(void) {
+    DmacChannel *rx = &DMAC->CHANNEL[DMAC_CH_SPI_RX];
+    uint8_t flags = rx->CHINTFLAG;
+    rx->CHINTFLAG = flags;
+
+    if (flags & DMAC_CHINT_TERR) {
+        cs_accel_high();
+        cs_gyro_high();
+        DMAC->CHANNEL[DMAC_CH_SPI_TX].CHCTRLA &= ~DMAC_CHCTRLA_ENABLE;
+        rx->CHCTRLA &= ~DMAC_CHCTRLA_ENABLE;
+        dma_phase = DMA_IDLE;
+        drdy_unmask();
+        return;
+    }
+    if (!(flags & DMAC_CHINT_TCMPL)) {
+        return;
+    }
+    if (dma_phase == DMA_ACCEL) {
+        cs_accel_high();
+        cs_gyro_low();
+        dma_phase = DMA_GYRO_STATUS;
+        DMAC->CHANNEL[DMAC_CH_SPI_TX].CHCTRLB = DMAC_CHCTRLB_CMD_RESUME;
+    } else if (dma_phase == DMA_GYRO_STATUS) {
+        cs_gyro_high();
+        uint8_t frames = rx_gyr_status[1] & 0x7F;
+        if (frames > GYR_MAX_FRAMES) {
+            frames = GYR_MAX_FRAMES;  // the rest keeps INT3 high: drained next
+        }
+        if (frames > 0) {
+            dma_start_gyro(frames);
+        } else {
+            dma_publish(0);
+            dma_phase = DMA_IDLE;
+        }
+    } else if (dma_phase == DMA_GYRO_DATA) {
+        cs_gyro_high();
+        dma_publish(gyr_frames);
+        dma_phase = DMA_IDLE;
+    }
+}
+
+void bmi088_drdy_init(void) {
+    dma_init();
+
+    MCLK->APBAMASK |= MCLK_APBAMASK_EIC;
+    GCLK->PCHCTRL[GCLK_EIC] = GCLK_PCHCTRL_PERIPH;
+
+    EIC->CTRLA = EIC_CTRLA_SWRST;
+    while (EIC->SYNCBUSY & 1) {
+    }
+
+    // PA22 as EIC input (function A)
+    PORTA->PINCFG[GYRO_INT_PIN] = PORT_PINCFG_PMUXEN | PORT_PINCFG_INEN;
+    PORTA->PMUX[GYRO_INT_PIN / 2] &= ~0x0F;
+
+    EIC->CONFIG[GYRO_INT_EXTINT / 8] = EIC_CONFIG_SENSE(GYRO_INT_EXTINT, EIC_SENSE_HIGH);
+
+    // The FIFO has been filling since bmi088_init; start from empty so the
+    // first drain is one tick's worth (writing FIFO_CONFIG_1 clears it)
+    gyro_write_reg(BMI088_GYR_FIFO_CONFIG_1, 0x80);
+    drdy_unmask();
+
+    EIC->CTRLA = EIC_CTRLA_ENABLE;
+    while (EIC->SYNCBUSY & 2) {
+    }
+    nvic_enable_irq(EIC_EXTINT_0_IRQn + GYRO_INT_EXTINT);
+}
+
+RAMFUNC void EIC_EXTINT_6_Handler(void) {
+    drdy_mask();
+    EIC->INTFLAG = (1 << GYRO_INT_EXTINT);
+    drdy_cycles = dwt_cycles();
+    drdy_count++;
+    dma_start();
+}
+
+uint32_t bmi088_drdy_count(void) {
+    return drdy_count;
+}
+
+uint32_t bmi088_drdy_cycles(void) {
+    return drdy_cycles;
+}
+
+uint32_t bmi088_sample_count(void) {
+    return sample_count;
+}
+
+void bmi088_latest(bmi088_sample_t *raw, bmi088_scaled_t *out, uint32_t *drdy_stamp) {
+    uint32_t n;
+    uint32_t stamp;
+    // The ISR only writes the other slot; retry if it published twice
+    do {
+        n = sample_count;
+        *raw = samples[n & 1];
+        stamp = sample_drdy_cycles[n & 1];
+    } while (n != sample_count);
+
+    bmi088_scale(raw, out);
+    if (drdy_stamp) {
+        *drdy_stamp = stamp;
+    }
+}
 
-    out->gx = raw.gx * GYRO_SCALE;
-    out->gy = raw.gy * GYRO_SCALE;
-    out->gz = raw.gz * GYRO_SCALE;
+uint32_t bmi088_dma_overruns(void) {
+    return dma_overruns;
 }
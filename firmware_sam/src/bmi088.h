@@ -5,17 +5,54 @@
 #include <stdbool.h>
 
 typedef struct {
-    int16_t ax, ay, az;
-    int16_t gx, gy, gz;
+    int16_t ax, ay, az;     // averaged over acc_frames FIFO frames
+    int16_t gx, gy, gz;     // averaged over gyr_frames FIFO frames
+    uint8_t acc_frames;
+    uint8_t gyr_frames;
+    uint32_t sensortime;    // accel sensor time at the drain, 39.0625 us LSB
+    float dt;               // seconds covered by the gyro frames
 } bmi088_sample_t;
 
 typedef struct {
     float ax, ay, az;
     float gx, gy, gz;
+    float dt;               // 0 for blocking reads
 } bmi088_scaled_t;
 
+// Resets both sensors together and polls their ID and status registers
+// instead of sleeping worst-case times. False if a sensor does not answer.
 bool bmi088_init(void);
+
+// Where bmi088_init spent its time, in µs
+typedef struct {
+    uint32_t por_us;          // waiting for the gyro power-on reset
+    uint32_t reset_us;        // both soft resets, overlapped
+    uint32_t accel_start_us;  // accel enable and setup to first data ready
+} bmi088_init_times_t;
+
+void bmi088_init_times(bmi088_init_times_t *out);
+
+// Blocking reads; only valid before bmi088_drdy_init() hands SPI to DMA
 void bmi088_read_raw(bmi088_sample_t *out);
 void bmi088_read_scaled(bmi088_scaled_t *out);
+void bmi088_scale(const bmi088_sample_t *raw, bmi088_scaled_t *out);
+
+// Both sensors run FIFOs (gyro 2 kHz, accel 1.6 kHz). The gyro FIFO
+// watermark (INT3 on PA22 / EXTINT6, level sensed) fires once per 1 kHz
+// tick; the ISR masks the line, stamps the interrupt with the DWT cycle
+// counter and starts a DMA drain of both FIFOs, and publishing unmasks it. The DMA completion interrupt averages the
+// frames into one of two sample slots, so the control task works on the
+// newest sample while the next one is transferred.
+void bmi088_drdy_init(void);
+uint32_t bmi088_drdy_count(void);
+uint32_t bmi088_drdy_cycles(void);
+
+// Number of samples published so far
+uint32_t bmi088_sample_count(void);
+// Latest published sample, raw and scaled, and the data-ready stamp it
+// was read for
+void bmi088_latest(bmi088_sample_t *raw, bmi088_scaled_t *out, uint32_t *drdy_stamp);
+// Watermark interrupts that arrived while a drain was still in flight
+uint32_t bmi088_dma_overruns(void);
 
 #endif
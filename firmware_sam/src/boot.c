@@ -0,0 +1,506 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "same51.h"
+#include "boot.h"
+#include "nvm.h"
+#include "sercom_uart.h"
+
+// Resident bootloader, linked at 0x0 (linker/boot.ld) and built with its
+// own objects at CPU_MHZ 48 ("make boot"). After reset it listens
+// BOOT_LISTEN_MS for a HELLO (BOOT_IDLE_MS if the application asked for
+// it through BOOT_MAILBOX), then starts the active slot. Protocol in
+// boot.h, slot states in bootcfg.h.
+
+extern void system_init(void);
+
+#define RX_MAX        (BOOT_FRAME_MAX + BOOT_FRAME_MAX / 254 + 2)  // COBS-encoded
+#define NO_BLOCK      0xFFFF
+#define CYCLES_PER_MS (CPU_HZ / 1000UL)
+#define RAM_START     0x20000000UL
+#define RAM_END       0x2003FFF0UL  // below the mailbox
+
+static uint8_t rx[RX_MAX];
+static uint16_t rx_len;
+static bool rx_overflow;
+static bool session;           // HELLO seen: other commands are accepted
+
+static bootcfg_t cfg;
+static bool writing;           // BEGIN accepted, END not yet
+static uint8_t write_slot;
+static uint32_t write_size;
+static uint32_t write_crc;
+
+// The block being assembled: flash content patched with DATA pages
+static uint32_t block_buf[NVM_BLOCK_SIZE / 4];
+static uint16_t open_block = NO_BLOCK;
+static uint16_t block_mask;    // pages received since the last COMMIT
+static uint8_t block_status;   // first DATA error since the last COMMIT
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static void send(telem_frame_t *f) {
+    uint8_t out[TELEM_MAX_FRAME];
+    uart_write(out, telem_finish(f, out));
+}
+
+static void send_ack(uint8_t cmd, uint8_t status, uint32_t arg) {
+    telem_frame_t f;
+    telem_begin(&f, TELEM_TYPE_BOOT_ACK);
+    telem_put_u8(&f, cmd);
+    telem_put_u8(&f, status);
+    telem_put_u32(&f, arg);
+    send(&f);
+}
+
+static void send_info(void) {
+    telem_frame_t f;
+    telem_begin(&f, TELEM_TYPE_BOOT_INFO);
+    telem_put_u8(&f, BOOT_VERSION);
+    telem_put_u8(&f, cfg.active);
+    for (uint8_t i = 0; i < BOOT_SLOTS; i++) {
+        telem_put_u8(&f, cfg.state[i]);
+    }
+    for (uint8_t i = 0; i < BOOT_SLOTS; i++) {
+        telem_put_u32(&f, cfg.size[i]);
+        telem_put_u32(&f, cfg.crc[i]);
+    }
+    telem_put_u16(&f, NVM_PAGE_SIZE);
+    telem_put_u16(&f, NVM_BLOCK_SIZE);
+    telem_put_u32(&f, BOOT_SLOT_SIZE);
+    telem_put_u16(&f, BOOT_DATA_MAX);
+    send(&f);
+}
+
+static bool store(void) {
+    return bootcfg_store(&cfg);
+}
+
+static void send_crcs(const uint8_t *p, uint16_t len) {
+    if (len != 4 || p[0] >= BOOT_SLOTS) {
+        return;
+    }
+    uint16_t page = get_u16(p + 1);
+    uint8_t n = (p[3] > BOOT_CRCS_MAX) ? BOOT_CRCS_MAX : p[3];
+    if ((uint32_t)(page + n) * NVM_PAGE_SIZE > BOOT_SLOT_SIZE) {
+        return;
+    }
+    const uint8_t *flash = (const uint8_t *)boot_slot_addr(p[0]);
+    telem_frame_t f;
+    telem_begin(&f, TELEM_TYPE_BOOT_CRCS);
+    telem_put_u8(&f, p[0]);
+    telem_put_u16(&f, page);
+    telem_put_u8(&f, n);
+    for (uint8_t i = 0; i < n; i++) {
+        telem_put_u32(&f, boot_crc32(0, flash + (uint32_t)(page + i) * NVM_PAGE_SIZE, NVM_PAGE_SIZE));
+    }
+    send(&f);
+}
+
+static uint8_t begin(const uint8_t *p, uint16_t len) {
+    if (len != 9 || p[0] >= BOOT_SLOTS) {
+        return BOOT_ERR_ARG;
+    }
+    uint8_t slot = p[0];
+    uint32_t size = get_u32(p + 1);
+    if (size == 0 || size > BOOT_SLOT_SIZE) {
+        return BOOT_ERR_ARG;
+    }
+    // Never overwrite the image that would start next
+    if (slot == cfg.active && cfg.state[slot] != BOOT_SLOT_EMPTY && cfg.state[slot] != BOOT_SLOT_BAD) {
+        return BOOT_ERR_ARG;
+    }
+    if (cfg.state[slot] != BOOT_SLOT_EMPTY) {
+        cfg.state[slot] = BOOT_SLOT_EMPTY;
+        cfg.size[slot] = 0;
+        cfg.crc[slot] = 0;
+        if (!store()) {
+            return BOOT_ERR_FLASH;
+        }
+    }
+    writing = true;
+    write_slot = slot;
+    write_size = size;
+    write_crc = get_u32(p + 5);
+    open_block = NO_BLOCK;
+    block_mask = 0;
+    block_status = BOOT_OK;
+    return BOOT_OK;
+}
+
+// Decode LZ tokens into the page at pos of the block buffer; old is the
+// block in flash, not yet erased (boot.h)
+static bool unpack(uint8_t *blk, const uint8_t *old, uint32_t pos, const uint8_t *in, uint16_t len) {
+    uint32_t end = pos + NVM_PAGE_SIZE;
+    uint16_t i = 0;
+    while (i < len) {
+        uint8_t t = in[i++];
+        if (t < 0x80) {
+            uint16_t n = (uint16_t)(t + 1);
+            if (i + n > len || pos + n > end) {
+                return false;
+            }
+            while (n--) {
+                blk[pos++] = in[i++];
+            }
+        } else {
+            uint16_t n = (uint16_t)((t & 0x7F) + 3);
+            if (i + 2 > len || pos + n > end) {
+                return false;
+            }
+            uint32_t src = get_u16(in + i);
+            i += 2;
+            const uint8_t *from = blk;
+            if (src >= NVM_BLOCK_SIZE) {
+                from = old;
+                src -= NVM_BLOCK_SIZE;
+            }
+            if (src + n > NVM_BLOCK_SIZE) {
+                return false;
+            }
+            while (n--) {
+                blk[pos++] = from[src++];
+            }
+        }
+    }
+    return pos == end;
+}
+
+static const uint32_t *block_flash(uint16_t block) {
+    return (const uint32_t *)(boot_slot_addr(write_slot) + (uint32_t)block * NVM_BLOCK_SIZE);
+}
+
+static void load_block(uint16_t block) {
+    const uint32_t *flash = block_flash(block);
+    for (uint32_t i = 0; i < NVM_BLOCK_SIZE / 4; i++) {
+        block_buf[i] = flash[i];
+    }
+    open_block = block;
+}
+
+static uint8_t data(const uint8_t *p, uint16_t len) {
+    if (!writing) {
+        return BOOT_ERR_STATE;
+    }
+    if (len < 3) {
+        return BOOT_ERR_ARG;
+    }
+    uint16_t page = get_u16(p);
+    if ((uint32_t)page * NVM_PAGE_SIZE >= write_size) {
+        return BOOT_ERR_ARG;
+    }
+    uint16_t block = page / BOOT_PAGES_PER_BLOCK;
+    if (open_block == NO_BLOCK) {
+        load_block(block);
+    } else if (block != open_block) {
+        return BOOT_ERR_STATE;
+    }
+    uint8_t *blk = (uint8_t *)block_buf;
+    uint32_t pos = (uint32_t)(page % BOOT_PAGES_PER_BLOCK) * NVM_PAGE_SIZE;
+    const uint8_t *in = p + 3;
+    uint16_t n = (uint16_t)(len - 3);
+    if (p[2] == BOOT_ENC_RAW && n == NVM_PAGE_SIZE) {
+        for (uint16_t i = 0; i < n; i++) {
+            blk[pos + i] = in[i];
+        }
+    } else if (p[2] != BOOT_ENC_LZ || !unpack(blk, (const uint8_t *)block_flash(block), pos, in, n)) {
+        return BOOT_ERR_DATA;
+    }
+    block_mask |= (uint16_t)(1u << (page % BOOT_PAGES_PER_BLOCK));
+    return BOOT_OK;
+}
+
+static bool block_matches(const uint32_t *flash) {
+    for (uint32_t i = 0; i < NVM_BLOCK_SIZE / 4; i++) {
+        if (flash[i] != block_buf[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool page_blank(const uint32_t *page) {
+    for (uint32_t i = 0; i < NVM_PAGE_SIZE / 4; i++) {
+        if (page[i] != 0xFFFFFFFFUL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void wait_ready(void) {
+    while (!nvm_ready()) {
+    }
+}
+
+// Erase and program the open block unless flash already holds it.
+// Returns the number of pages programmed, or -1 on a flash error.
+static int32_t program(void) {
+    uint32_t addr = boot_slot_addr(write_slot) + (uint32_t)open_block * NVM_BLOCK_SIZE;
+    const uint32_t *flash = (const uint32_t *)addr;
+    if (block_matches(flash)) {
+        return 0;
+    }
+    wait_ready();
+    nvm_erase_block(addr);
+    wait_ready();
+    int32_t pages = 0;
+    for (uint32_t i = 0; i < BOOT_PAGES_PER_BLOCK; i++) {
+        const uint32_t *page = &block_buf[i * NVM_PAGE_SIZE / 4];
+        if (page_blank(page)) {
+            continue;
+        }
+        nvm_write_page(addr + i * NVM_PAGE_SIZE, page);
+        wait_ready();
+        pages++;
+    }
+    bool failed = nvm_error();
+    cmcc_invalidate();
+    return (failed || !block_matches(flash)) ? -1 : pages;
+}
+
+static void commit(const uint8_t *p, uint16_t len) {
+    uint8_t status = block_status;
+    uint32_t arg = 0;
+    if (len != 4) {
+        status = BOOT_ERR_ARG;
+    } else if (status != BOOT_OK) {
+    } else if (!writing) {
+        status = BOOT_ERR_STATE;
+    } else if (open_block == NO_BLOCK || block_mask != get_u16(p + 2)) {
+        status = BOOT_ERR_MISSING;
+        arg = block_mask;
+    } else if (open_block != get_u16(p)) {
+        status = BOOT_ERR_STATE;
+    } else {
+        int32_t pages = program();
+        if (pages < 0) {
+            status = BOOT_ERR_FLASH;
+        } else {
+            arg = (uint32_t)pages;
+        }
+    }
+    // A failed block is dropped: its pages come again, decoded against
+    // the flash content as before
+    open_block = NO_BLOCK;
+    block_mask = 0;
+    block_status = BOOT_OK;
+    send_ack(BOOT_CMD_COMMIT, status, arg);
+}
+
+static void end(void) {
+    if (!writing || open_block != NO_BLOCK) {
+        send_ack(BOOT_CMD_END, BOOT_ERR_STATE, 0);
+        return;
+    }
+    uint32_t crc = boot_crc32(0, (const uint8_t *)boot_slot_addr(write_slot), write_size);
+    if (crc != write_crc) {
+        send_ack(BOOT_CMD_END, BOOT_ERR_CRC, crc);
+        return;
+    }
+    writing = false;
+    cfg.size[write_slot] = write_size;
+    cfg.crc[write_slot] = crc;
+    cfg.state[write_slot] = BOOT_SLOT_PENDING;
+    cfg.active = write_slot;
+    send_ack(BOOT_CMD_END, store() ? BOOT_OK : BOOT_ERR_FLASH, crc);
+}
+
+static uint8_t rollback(void) {
+    uint8_t other = (uint8_t)(cfg.active ^ 1);
+    if (cfg.state[other] != BOOT_SLOT_GOOD) {
+        return BOOT_ERR_ARG;
+    }
+    cfg.active = other;
+    return store() ? BOOT_OK : BOOT_ERR_FLASH;
+}
+
+static void set_baud(const uint8_t *p, uint16_t len) {
+    uint32_t baud = (len == 4) ? get_u32(p) : 0;
+    if (baud < 9600 || baud > PERIPH_HZ / 16) {
+        send_ack(BOOT_CMD_BAUD, BOOT_ERR_ARG, baud);
+        return;
+    }
+    // Acked at the old rate; the host switches once it has the ack
+    send_ack(BOOT_CMD_BAUD, BOOT_OK, baud);
+    uart_deinit();
+    uart_init(baud);
+}
+
+// Decode rx in place; returns the raw length or 0 if malformed
+static uint16_t cobs_decode(void) {
+    uint16_t in = 0;
+    uint16_t out = 0;
+    while (in < rx_len) {
+        uint8_t code = rx[in];
+        if (code == 0 || in + code > rx_len) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            rx[out++] = rx[in + i];
+        }
+        in += code;
+        if (code < 0xFF && in < rx_len) {
+            rx[out++] = 0;
+        }
+    }
+    return out;
+}
+
+// Handle a complete frame; returns true if it was a bootloader command
+static bool dispatch(void) {
+    uint16_t len = cobs_decode();
+    if (len < 5 || telem_crc16(rx, (uint16_t)(len - 2)) != get_u16(rx + len - 2)) {
+        return false;
+    }
+    uint8_t type = rx[2];
+    const uint8_t *p = rx + 3;
+    uint16_t plen = (uint16_t)(len - 5);
+    if (type == BOOT_CMD_HELLO) {
+        session = true;
+        send_info();
+        return true;
+    }
+    if (!session) {
+        return false;
+    }
+    switch (type) {
+    case BOOT_CMD_BAUD:
+        set_baud(p, plen);
+        break;
+    case BOOT_CMD_CRCS:
+        send_crcs(p, plen);
+        break;
+    case BOOT_CMD_BEGIN:
+        send_ack(type, begin(p, plen), 0);
+        break;
+    case BOOT_CMD_DATA: {
+        uint8_t status = data(p, plen);
+        if (status != BOOT_OK && block_status == BOOT_OK) {
+            block_status = status;
+        }
+        break;
+    }
+    case BOOT_CMD_COMMIT:
+        commit(p, plen);
+        break;
+    case BOOT_CMD_END:
+        end();
+        break;
+    case BOOT_CMD_ROLLBACK:
+        send_ack(type, rollback(), cfg.active);
+        break;
+    case BOOT_CMD_RUN:
+        send_ack(type, BOOT_OK, cfg.active);
+        uart_deinit();
+        system_reset();
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+static bool receive(uint8_t b) {
+    if (b != 0) {
+        if (rx_len < RX_MAX) {
+            rx[rx_len++] = b;
+        } else {
+            rx_overflow = true;
+        }
+        return false;
+    }
+    bool handled = rx_len > 0 && !rx_overflow && dispatch();
+    rx_len = 0;
+    rx_overflow = false;
+    return handled;
+}
+
+static bool vectors_ok(uint8_t slot) {
+    uint32_t base = boot_slot_addr(slot);
+    const uint32_t *vec = (const uint32_t *)base;
+    uint32_t pc = vec[1] & ~1UL;
+    return vec[0] > RAM_START && vec[0] <= RAM_END && (vec[1] & 1) &&
+           pc >= base && pc < base + BOOT_SLOT_SIZE;
+}
+
+static bool image_ok(uint8_t slot) {
+    return cfg.size[slot] > 0 && cfg.size[slot] <= BOOT_SLOT_SIZE &&
+           boot_crc32(0, (const uint8_t *)boot_slot_addr(slot), cfg.size[slot]) == cfg.crc[slot];
+}
+
+static void jump(uint8_t slot) {
+    uint32_t base = boot_slot_addr(slot);
+    const uint32_t *vec = (const uint32_t *)base;
+    uart_deinit();
+    cmcc_invalidate();
+    cmcc_disable();
+    SCB_VTOR = base;
+    __asm__ volatile ("msr msp, %0\n\tbx %1" : : "r"(vec[0]), "r"(vec[1]) : "memory");
+    while (1) {
+    }
+}
+
+// Start the active slot, moving it along the slot states first (a slot
+// still TRIED never confirmed and becomes BAD). Falls back to the other
+// slot if that one is GOOD. Returns only if neither can run.
+static void start_app(void) {
+    uint8_t slot = cfg.active;
+    if (cfg.state[slot] == BOOT_SLOT_TRIED) {
+        cfg.state[slot] = BOOT_SLOT_BAD;
+        store();
+    } else if (cfg.state[slot] == BOOT_SLOT_PENDING) {
+        cfg.state[slot] = image_ok(slot) ? BOOT_SLOT_TRIED : BOOT_SLOT_BAD;
+        store();
+    }
+    bool runs = cfg.state[slot] == BOOT_SLOT_TRIED || cfg.state[slot] == BOOT_SLOT_GOOD;
+    if (!runs || !vectors_ok(slot)) {
+        slot ^= 1;
+        if (cfg.state[slot] != BOOT_SLOT_GOOD || !vectors_ok(slot)) {
+            return;
+        }
+        cfg.active = slot;
+        store();
+    }
+    jump(slot);
+}
+
+int main(void) {
+    system_init();
+    nvm_init();
+    uart_init(BOOT_BAUD);
+    bool stay = BOOT_MAILBOX == BOOT_MAILBOX_ENTER;
+    BOOT_MAILBOX = 0;
+    bootcfg_load(&cfg);
+
+    uint32_t wait_ms = stay ? BOOT_IDLE_MS : BOOT_LISTEN_MS;
+    uint32_t last = dwt_cycles();
+    while (1) {
+        uint8_t b;
+        while (uart_read_byte(&b)) {
+            if (receive(b)) {
+                last = dwt_cycles();
+            }
+        }
+        if (dwt_cycles() - last < wait_ms * CYCLES_PER_MS) {
+            continue;
+        }
+        // A host that went quiet is gone: reset, which starts the
+        // application after the listen window
+        if (session || stay) {
+            uart_deinit();
+            system_reset();
+        }
+        start_app();
+        // Nothing to start: wait for a host
+        wait_ms = BOOT_IDLE_MS;
+        stay = true;
+        last = dwt_cycles();
+    }
+}
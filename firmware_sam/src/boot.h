@@ -0,0 +1,64 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include "bootcfg.h"
+#include "telemetry.h"
+
+// Bootloader protocol (src/boot.c) on the SERCOM0 UART, in telemetry
+// framing (telemetry.h). The host writes the slot that is not active,
+// one erase block (16 pages) at a time:
+//   HELLO                          -> INFO
+//   CRCS  slot u8 | page u16 | n u8 -> CRCS: slot | page | n | CRC32 x n
+//   BEGIN slot u8 | size u32 | crc u32
+//   DATA  page u16 | enc u8 | data  (no reply; pages of one block)
+//   COMMIT block u16 | mask u16    (the pages sent since the last COMMIT)
+//   END                            (checks the image CRC, activates it)
+//   RUN / ROLLBACK / BAUD baud u32
+// Every command but HELLO, CRCS and DATA is answered with
+//   ACK cmd u8 | status u8 | arg u32
+// Pages the host leaves out (same CRC as the new image) are not sent.
+// Blocks are only erased and programmed if their content changed. A
+// COMMIT that fails drops the block; the host sends its pages again.
+//
+// DATA encodings, always decoding to NVM_PAGE_SIZE bytes:
+//   BOOT_ENC_RAW  the page
+//   BOOT_ENC_LZ   tokens: 0x00..0x7F = t + 1 literal bytes follow,
+//                 0x80..0xFF = copy (t & 0x7F) + 3 bytes from offset u16,
+//                 byte by byte. Below NVM_BLOCK_SIZE the offset is into the
+//                 block buffer (the new image so far), above it into the
+//                 block's flash, which holds the old image until the COMMIT
+//                 (a delta against what the slot held before).
+
+#define BOOT_CMD_HELLO    0x90
+#define BOOT_CMD_BAUD     0x91
+#define BOOT_CMD_CRCS     0x92
+#define BOOT_CMD_BEGIN    0x93
+#define BOOT_CMD_DATA     0x94
+#define BOOT_CMD_COMMIT   0x95
+#define BOOT_CMD_END      0x96
+#define BOOT_CMD_RUN      0x97
+#define BOOT_CMD_ROLLBACK 0x98
+
+#define BOOT_OK           0
+#define BOOT_ERR_ARG      1  // bad slot, page, size or length
+#define BOOT_ERR_MISSING  2  // COMMIT mask differs from the pages received
+#define BOOT_ERR_FLASH    3  // erase, program or read-back failed
+#define BOOT_ERR_CRC      4  // image CRC mismatch at END
+#define BOOT_ERR_DATA     5  // DATA did not decode to one page
+#define BOOT_ERR_STATE    6  // no BEGIN, DATA outside the open block
+
+#define BOOT_ENC_RAW      0
+#define BOOT_ENC_LZ       1
+
+#define BOOT_VERSION      1
+#define BOOT_BAUD         460800  // XBee ATBD 9, as the application
+#define BOOT_LISTEN_MS    250     // after reset, for a HELLO
+#define BOOT_IDLE_MS      10000   // no frame for this long: reset
+#define BOOT_CRCS_MAX     8
+#define BOOT_PAGES_PER_BLOCK (NVM_BLOCK_SIZE / NVM_PAGE_SIZE)
+#define BOOT_DATA_MAX     (NVM_PAGE_SIZE + NVM_PAGE_SIZE / 128 + 8)  // worst-case LZ
+#define BOOT_FRAME_MAX    (3 + 3 + BOOT_DATA_MAX + 2)
+
+_Static_assert(BOOT_PAGES_PER_BLOCK <= 16, "COMMIT mask is 16 bits");
+
+#endif
@@ -0,0 +1,150 @@
+#include "bootcfg.h"
+
+#define RECORD_PAGES     (BOOTCFG_BLOCKS * NVM_BLOCK_SIZE / NVM_PAGE_SIZE)
+#define PAGES_PER_BLOCK  (NVM_BLOCK_SIZE / NVM_PAGE_SIZE)
+#define CHECKED_BYTES    ((uint32_t)sizeof(bootcfg_t) - 4)
+#define NO_PAGE          0xFF
+
+_Static_assert(sizeof(bootcfg_t) == 32, "record layout changed");
+
+extern const void *vector_table[];
+
+static uint32_t page_buf[NVM_PAGE_SIZE / 4];
+static uint8_t newest = NO_PAGE;   // page holding the record last loaded
+
+static const uint32_t crc32_nibble[16] = {
+    0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL,
+    0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+    0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+    0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL,
+};
+
+uint32_t boot_crc32(uint32_t crc, const uint8_t *data, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0xF];
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0xF];
+    }
+    return ~crc;
+}
+
+uint32_t boot_slot_addr(uint8_t slot) {
+    return slot ? BOOT_SLOT_B_ADDR : BOOT_SLOT_A_ADDR;
+}
+
+uint8_t boot_running_slot(void) {
+    return ((uint32_t)vector_table >= BOOT_SLOT_B_ADDR) ? 1 : 0;
+}
+
+static const bootcfg_t *record_at(uint8_t page) {
+    return (const bootcfg_t *)(BOOTCFG_ADDR + (uint32_t)page * NVM_PAGE_SIZE);
+}
+
+static bool record_valid(const bootcfg_t *r) {
+    return r->magic == BOOTCFG_MAGIC && r->active < BOOT_SLOTS &&
+           r->state[0] <= BOOT_SLOT_BAD && r->state[1] <= BOOT_SLOT_BAD &&
+           r->check == boot_crc32(0, (const uint8_t *)r, CHECKED_BYTES);
+}
+
+static bool page_blank(uint8_t page) {
+    const uint32_t *p = (const uint32_t *)record_at(page);
+    for (uint32_t i = 0; i < NVM_PAGE_SIZE / 4; i++) {
+        if (p[i] != 0xFFFFFFFFUL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void copy_record(bootcfg_t *dst, const bootcfg_t *src) {
+    dst->magic = src->magic;
+    dst->seq = src->seq;
+    for (uint8_t i = 0; i < BOOT_SLOTS; i++) {
+        dst->size[i] = src->size[i];
+        dst->crc[i] = src->crc[i];
+        dst->state[i] = src->state[i];
+    }
+    dst->active = src->active;
+    dst->reserved = 0;
+    dst->check = src->check;
+}
+
+bool bootcfg_load(bootcfg_t *c) {
+    newest = NO_PAGE;
+    for (uint8_t i = 0; i < RECORD_PAGES; i++) {
+        const bootcfg_t *r = record_at(i);
+        if (record_valid(r) && (newest == NO_PAGE || r->seq > record_at(newest)->seq)) {
+            newest = i;
+        }
+    }
+    if (newest != NO_PAGE) {
+        copy_record(c, record_at(newest));
+        return true;
+    }
+    c->magic = BOOTCFG_MAGIC;
+    c->seq = 0;
+    for (uint8_t i = 0; i < BOOT_SLOTS; i++) {
+        c->size[i] = 0;
+        c->crc[i] = 0;
+        c->state[i] = BOOT_SLOT_EMPTY;
+    }
+    c->state[0] = BOOT_SLOT_GOOD;
+    c->active = 0;
+    c->reserved = 0;
+    c->check = 0;
+    return false;
+}
+
+static void wait_ready(void) {
+    while (!nvm_ready()) {
+    }
+}
+
+// Records fill one block page by page. When it is full (or a page was
+// left half written) the other block is erased and used, so the newest
+// record is never in the block being erased.
+bool bootcfg_store(bootcfg_t *c) {
+    uint8_t page = (newest == NO_PAGE) ? 0 : (uint8_t)((newest + 1) % RECORD_PAGES);
+    if (page % PAGES_PER_BLOCK == 0 || !page_blank(page)) {
+        if (page % PAGES_PER_BLOCK != 0) {
+            page = (uint8_t)((page / PAGES_PER_BLOCK + 1) * PAGES_PER_BLOCK % RECORD_PAGES);
+        }
+        wait_ready();
+        nvm_erase_block(BOOTCFG_ADDR + (uint32_t)page * NVM_PAGE_SIZE);
+        wait_ready();
+    }
+
+    c->magic = BOOTCFG_MAGIC;
+    c->seq++;
+    c->reserved = 0;
+    c->check = boot_crc32(0, (const uint8_t *)c, CHECKED_BYTES);
+    for (uint32_t i = 0; i < NVM_PAGE_SIZE / 4; i++) {
+        page_buf[i] = 0xFFFFFFFFUL;
+    }
+    copy_record((bootcfg_t *)page_buf, c);
+    nvm_write_page(BOOTCFG_ADDR + (uint32_t)page * NVM_PAGE_SIZE, page_buf);
+    wait_ready();
+    bool failed = nvm_error();
+    cmcc_invalidate();
+    if (failed || !record_valid(record_at(page)) || record_at(page)->seq != c->seq) {
+        return false;
+    }
+    newest = page;
+    return true;
+}
+
+void bootcfg_confirm(void) {
+    bootcfg_t c;
+    bootcfg_load(&c);
+    uint8_t slot = boot_running_slot();
+    if (c.active == slot && c.state[slot] == BOOT_SLOT_TRIED) {
+        c.state[slot] = BOOT_SLOT_GOOD;
+        bootcfg_store(&c);
+    }
+}
+
+void boot_enter(void) {
+    BOOT_MAILBOX = BOOT_MAILBOX_ENTER;
+    system_reset();
+}
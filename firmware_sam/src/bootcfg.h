@@ -0,0 +1,85 @@
+#ifndef BOOTCFG_H
+#define BOOTCFG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nvm.h"
+
+// Flash map shared by the bootloader (src/boot.c) and the application.
+// The application is linked for either slot (linker/slot_a.ld,
+// slot_b.ld), and the bootloader starts the one the boot config selects.
+//   0x00000  bootloader            16K
+//   0x04000  slot A               248K
+//   0x42000  slot B               248K
+//   0x80000  (unused)             368K  bank B starts here
+//   0xDC000  boot config           16K  two blocks of one-page records
+//   0xE0000  blackbox log         128K  (blackbox.h)
+// Both slots fill the rest of bank A. The application erases and writes
+// the boot config and the blackbox while it runs, which stalls
+// instruction fetch from their bank, so no code may live in bank B.
+#define BOOT_SIZE        0x00004000UL
+#define BOOT_SLOT_A_ADDR 0x00004000UL
+#define BOOT_SLOT_B_ADDR 0x00042000UL
+#define BOOT_SLOT_SIZE   0x0003E000UL
+#define BOOT_BANK_B_ADDR 0x00080000UL
+#define BOOTCFG_ADDR     0x000DC000UL
+#define BOOTCFG_BLOCKS   2
+#define BOOT_SLOTS       2
+
+_Static_assert(BOOT_SLOT_A_ADDR + BOOT_SLOT_SIZE == BOOT_SLOT_B_ADDR, "slot A overlaps slot B");
+_Static_assert(BOOT_SLOT_B_ADDR + BOOT_SLOT_SIZE == BOOT_BANK_B_ADDR, "slot B must end at bank B");
+_Static_assert(BOOTCFG_ADDR >= BOOT_BANK_B_ADDR, "the boot config must be in bank B");
+_Static_assert(BOOT_SLOT_SIZE % NVM_BLOCK_SIZE == 0, "slots must be whole erase blocks");
+
+// Last 16 bytes of SRAM, outside the application's RAM region: a reset
+// keeps them, so the application can ask the bootloader to stay
+#define BOOT_MAILBOX       (*(volatile uint32_t *)0x2003FFF0UL)
+#define BOOT_MAILBOX_ENTER 0x54445055UL  // "UPDT"
+
+// Slot states. A new image is PENDING; the bootloader marks it TRIED when
+// it starts it, and the application marks it GOOD once it is up
+// (bootcfg_confirm). A slot still TRIED at the next reset never came up:
+// it becomes BAD and the other slot boots instead.
+#define BOOT_SLOT_EMPTY   0
+#define BOOT_SLOT_PENDING 1
+#define BOOT_SLOT_TRIED   2
+#define BOOT_SLOT_GOOD    3
+#define BOOT_SLOT_BAD     4
+
+#define BOOTCFG_MAGIC 0x32464342UL  // "BCF2", the slot layout above
+
+// One record per flash page; the valid one with the highest seq wins
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t size[BOOT_SLOTS];   // image bytes, 0 = unknown (flashed with a programmer)
+    uint32_t crc[BOOT_SLOTS];    // CRC32 of the image
+    uint8_t state[BOOT_SLOTS];   // BOOT_SLOT_*
+    uint8_t active;              // slot to boot
+    uint8_t reserved;
+    uint32_t check;              // CRC32 of everything above
+} bootcfg_t;
+
+// Newest valid record into *c. Without one (fresh part) this is slot A
+// GOOD, as left by the programmer, and returns false.
+bool bootcfg_load(bootcfg_t *c);
+
+// Append *c as a new record (bumps seq); call bootcfg_load first. Stalls
+// on flash; returns false if the write failed.
+bool bootcfg_store(bootcfg_t *c);
+
+uint32_t boot_slot_addr(uint8_t slot);
+
+// Slot the running code was linked for, from the vector table address
+uint8_t boot_running_slot(void);
+
+// Application: mark the running slot GOOD if this is its first boot
+void bootcfg_confirm(void);
+
+// Application: reset into the bootloader and keep it waiting for a host
+void boot_enter(void);
+
+// CRC32 (IEEE, reflected, as Go's hash/crc32). Start with 0.
+uint32_t boot_crc32(uint32_t crc, const uint8_t *data, uint32_t len);
+
+#endif
@@ -0,0 +1,301 @@
+#include "channels.h"
+
+#include "sercom_uart.h"
+#include "telemetry.h"
+
+// Rate ladder in ticks; every period divides CHAN_TICK_HZ, so the
+// schedule repeats each second
+static const uint16_t ladder[] = {2, 4, 10, 20, 50, 100, 200, 500, 1000};
+#define LEVELS   (sizeof(ladder) / sizeof(ladder[0]))
+#define NO_LEVEL 0xFF
+
+#define SLOTS       (CHAN_TICK_HZ / CHAN_RUN_PERIOD)  // service calls per second
+#define SLOT_WORDS  ((SLOTS + 31) / 32)
+
+// Wire sizes: seq, type, CRC, COBS code and both delimiters per frame
+#define FRAME_OVERHEAD 8
+#define DATA_HEADER    8   // tick + mask
+#define INFO_FIXED     7   // id, div, requested and granted rate
+#define PLAN_PAYLOAD   24
+#define REPORT_PER_RUN 2
+
+_Static_assert(DATA_HEADER + 2 * CHAN_MAX <= TELEM_MAX_PAYLOAD, "channel frame too large");
+_Static_assert(INFO_FIXED + CHAN_NAME_MAX <= TELEM_MAX_PAYLOAD, "info frame too large");
+_Static_assert(CHAN_TICK_HZ % CHAN_RUN_PERIOD == 0, "run period must divide a second");
+
+static const chan_def_t *defs;
+static uint8_t def_count;
+
+static uint16_t req_hz[CHAN_MAX];
+static uint8_t level[CHAN_MAX];     // granted ladder step, NO_LEVEL = not sent
+static uint32_t degraded;
+static uint32_t dropped;
+static uint32_t budget = CHAN_DEFAULT_BUDGET;
+static uint32_t planned;
+static uint32_t skipped;
+static bool replan;
+
+// Slots of the second in which each ladder step is due
+static uint32_t due_slots[LEVELS][SLOT_WORDS];
+static uint16_t phase;              // ticks into the current second
+
+static bool report_active;
+static bool report_all;             // every channel, not only subscribed
+static bool report_header;          // CHAN_PLAN frame still to send
+static uint8_t report_cursor;
+
+static uint8_t name_len(const char *s) {
+    uint8_t n = 0;
+    while (s[n] && n < CHAN_NAME_MAX) {
+        n++;
+    }
+    return n;
+}
+
+static uint16_t level_hz(uint8_t l) {
+    return (uint16_t)(CHAN_TICK_HZ / ladder[l]);
+}
+
+// Fastest ladder step not above the requested rate
+static uint8_t want_level(uint16_t hz) {
+    for (uint8_t l = 0; l < LEVELS; l++) {
+        if (level_hz(l) <= hz) {
+            return l;
+        }
+    }
+    return LEVELS - 1;
+}
+
+static uint16_t popcount32(uint32_t v) {
+    uint16_t n = 0;
+    while (v) {
+        v &= v - 1;
+        n++;
+    }
+    return n;
+}
+
+// Bytes per second of the current plan, plan report included
+static uint32_t plan_cost(void) {
+    uint32_t used[SLOT_WORDS];
+    for (uint16_t w = 0; w < SLOT_WORDS; w++) {
+        used[w] = 0;
+    }
+    uint32_t bytes = FRAME_OVERHEAD + PLAN_PAYLOAD;
+    for (uint8_t i = 0; i < def_count; i++) {
+        if (req_hz[i]) {
+            bytes += FRAME_OVERHEAD + INFO_FIXED + name_len(defs[i].name);
+        }
+        if (level[i] == NO_LEVEL) {
+            continue;
+        }
+        bytes += 2u * level_hz(level[i]);
+        for (uint16_t w = 0; w < SLOT_WORDS; w++) {
+            used[w] |= due_slots[level[i]][w];
+        }
+    }
+    uint32_t frames = 0;
+    for (uint16_t w = 0; w < SLOT_WORDS; w++) {
+        frames += popcount32(used[w]);
+    }
+    return bytes + frames * (FRAME_OVERHEAD + DATA_HEADER);
+}
+
+static void start_report(bool all) {
+    report_active = true;
+    report_all = all;
+    report_header = true;
+    report_cursor = 0;
+}
+
+// Grant every request, then step the fastest channel down until the plan
+// fits; ties go against the higher id, which is also dropped first
+static void plan(void) {
+    degraded = 0;
+    dropped = 0;
+    for (uint8_t i = 0; i < def_count; i++) {
+        level[i] = req_hz[i] ? want_level(req_hz[i]) : NO_LEVEL;
+    }
+    while ((planned = plan_cost()) > budget) {
+        uint8_t fastest = NO_LEVEL;
+        uint8_t last = NO_LEVEL;
+        for (uint8_t i = 0; i < def_count; i++) {
+            if (level[i] == NO_LEVEL) {
+                continue;
+            }
+            if (fastest == NO_LEVEL || level[i] <= level[fastest]) {
+                fastest = i;
+            }
+            last = i;
+        }
+        if (fastest == NO_LEVEL) {
+            break;
+        }
+        if (level[fastest] < LEVELS - 1) {
+            level[fastest]++;
+            degraded |= 1UL << fastest;
+        } else {
+            level[last] = NO_LEVEL;
+            dropped |= 1UL << last;
+            degraded &= ~(1UL << last);
+        }
+    }
+}
+
+void chan_init(const chan_def_t *table, uint8_t count) {
+    defs = table;
+    def_count = (count > CHAN_MAX) ? CHAN_MAX : count;
+    for (uint8_t i = 0; i < CHAN_MAX; i++) {
+        req_hz[i] = 0;
+        level[i] = NO_LEVEL;
+    }
+    for (uint8_t l = 0; l < LEVELS; l++) {
+        for (uint16_t s = 0; s < SLOTS; s++) {
+            if ((s * CHAN_RUN_PERIOD) % ladder[l] == 0) {
+                due_slots[l][s / 32] |= 1UL << (s % 32);
+            }
+        }
+    }
+    phase = 0;
+    skipped = 0;
+    replan = true;
+}
+
+bool chan_subscribe(uint8_t id, uint16_t hz) {
+    if (id >= def_count) {
+        return false;
+    }
+    req_hz[id] = (hz > CHAN_MAX_HZ) ? CHAN_MAX_HZ : hz;
+    replan = true;
+    return true;
+}
+
+void chan_set_budget(uint32_t bytes_per_s) {
+    budget = bytes_per_s;
+    replan = true;
+}
+
+void chan_list(void) {
+    start_report(true);
+}
+
+uint32_t chan_planned_bps(void) {
+    return planned;
+}
+
+uint32_t chan_skipped(void) {
+    return skipped;
+}
+
+static void send(telem_frame_t *f) {
+    uint8_t out[TELEM_MAX_FRAME];
+    uart_write(out, telem_finish(f, out));
+}
+
+static int16_t read_value(const chan_def_t *d) {
+    if (d->f) {
+        return telem_scaled_i16(*d->f, d->scale);
+    }
+    if (d->u8) {
+        return *d->u8;
+    }
+    return d->read ? d->read() : 0;
+}
+
+static void send_data(uint32_t tick, uint32_t mask) {
+    if (uart_tx_free() < TELEM_MAX_FRAME) {
+        skipped++;
+        return;
+    }
+    telem_frame_t f;
+    telem_begin(&f, TELEM_TYPE_CHANNELS);
+    telem_put_u32(&f, tick);
+    telem_put_u32(&f, mask);
+    for (uint8_t i = 0; i < def_count; i++) {
+        if (mask & (1UL << i)) {
+            telem_put_u16(&f, (uint16_t)read_value(&defs[i]));
+        }
+    }
+    send(&f);
+}
+
+static void send_plan(void) {
+    uint32_t subscribed = 0;
+    for (uint8_t i = 0; i < def_count; i++) {
+        if (req_hz[i]) {
+            subscribed |= 1UL << i;
+        }
+    }
+    telem_frame_t f;
+    telem_begin(&f, TELEM_TYPE_CHAN_PLAN);
+    telem_put_u32(&f, budget);
+    telem_put_u32(&f, planned);
+    telem_put_u32(&f, skipped);
+    telem_put_u32(&f, subscribed);
+    telem_put_u32(&f, degraded);
+    telem_put_u32(&f, dropped);
+    send(&f);
+}
+
+static void send_info(uint8_t id) {
+    const chan_def_t *d = &defs[id];
+    telem_frame_t f;
+    telem_begin(&f, TELEM_TYPE_CHAN_INFO);
+    telem_put_u8(&f, id);
+    telem_put_u16(&f, d->div);
+    telem_put_u16(&f, req_hz[id]);
+    telem_put_u16(&f, (level[id] == NO_LEVEL) ? 0 : level_hz(level[id]));
+    uint8_t n = name_len(d->name);
+    for (uint8_t i = 0; i < n; i++) {
+        telem_put_u8(&f, (uint8_t)d->name[i]);
+    }
+    send(&f);
+}
+
+// A few report frames per run, only while the TX ring has room to spare
+static void report_service(void) {
+    for (uint8_t n = 0; n < REPORT_PER_RUN && report_active; n++) {
+        if (uart_tx_free() < 4 * TELEM_MAX_FRAME) {
+            return;
+        }
+        if (report_header) {
+            send_plan();
+            report_header = false;
+            continue;
+        }
+        while (report_cursor < def_count && !report_all && !req_hz[report_cursor]) {
+            report_cursor++;
+        }
+        if (report_cursor >= def_count) {
+            report_active = false;
+            return;
+        }
+        send_info(report_cursor++);
+    }
+}
+
+void chan_service(uint32_t tick) {
+    if (replan) {
+        replan = false;
+        plan();
+        start_report(false);
+    } else if (phase == 0 && !report_active) {
+        start_report(false);
+    }
+
+    uint32_t mask = 0;
+    for (uint8_t i = 0; i < def_count; i++) {
+        if (level[i] != NO_LEVEL && phase % ladder[level[i]] == 0) {
+            mask |= 1UL << i;
+        }
+    }
+    if (mask) {
+        send_data(tick, mask);
+    }
+    report_service();
+
+    phase += CHAN_RUN_PERIOD;
+    if (phase >= CHAN_TICK_HZ) {
+        phase = 0;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Telemetry channel registry. Each channel is one named value that the
+// host subscribes to at a rate ("SUB:id,hz"). Channels due on the same
+// tick share one CHANNELS frame:
+//   tick u32 | mask u32 | i16 per set mask bit, ascending id
+// Rates are granted from a fixed ladder whose periods all divide one
+// second. When the subscriptions would exceed the link budget ("BW:n",
+// bytes/s), the fastest ones step down the ladder first. Once everything
+// is at the slowest rate, the highest ids are dropped. Lower ids are
+// therefore higher priority. The plan is reported in a CHAN_PLAN frame
+// plus one CHAN_INFO frame per subscribed channel, on every change and
+// once per second. "CH" lists every channel.
+
+#define CHAN_MAX            20     // fits one frame: 8 + 2 * 20 = 48 bytes
+#define CHAN_TICK_HZ        1000   // rate of the tick passed to chan_service
+#define CHAN_RUN_PERIOD     2      // ticks between chan_service calls
+#define CHAN_MAX_HZ         (CHAN_TICK_HZ / CHAN_RUN_PERIOD)
+#define CHAN_DEFAULT_BUDGET 32000  // bytes/s, ~70% of 460800 baud
+#define CHAN_NAME_MAX       16
+
+// One channel. Exactly one of f, u8 or read is set. Float values go out as
+// round(*f * scale); the host divides by div to get display units.
+typedef struct {
+    const char *name;
+    const float *f;
+    const uint8_t *u8;
+    int16_t (*read)(void);
+    float scale;
+    uint16_t div;
+} chan_def_t;
+
+#define CHAN_F(n, src, sc, d) { .name = (n), .f = (src), .scale = (sc), .div = (d) }
+#define CHAN_U8(n, src)       { .name = (n), .u8 = (src), .div = 1 }
+#define CHAN_FN(n, fn)        { .name = (n), .read = (fn), .div = 1 }
+
+void chan_init(const chan_def_t *defs, uint8_t count);
+
+// hz 0 unsubscribes. Returns false for an unknown id.
+bool chan_subscribe(uint8_t id, uint16_t hz);
+void chan_set_budget(uint32_t bytes_per_s);
+
+// Queue CHAN_INFO frames for every channel, subscribed or not
+void chan_list(void);
+
+// Run every CHAN_RUN_PERIOD ticks: sends the frame due this tick and
+// paces the plan report.
+void chan_service(uint32_t tick);
+
+uint32_t chan_planned_bps(void);
+uint32_t chan_skipped(void);  // frames not sent because the TX ring was full
+
+#endif
@@ -30,9 +30,12 @@ void pid_init(pid_ctrl_t *p, float kp, float ki, float kd, float output_limit) {
     p->integral = 0.0f;
     p->prev_error = 0.0f;
     p->output_limit = output_limit;
+    p->p_term = 0.0f;
+    p->i_term = 0.0f;
+    p->d_term = 0.0f;
 }
 
-float pid_update(pid_ctrl_t *p, float error, float dt) {
+RAMFUNC float pid_update(pid_ctrl_t *p, float error, float dt) {
     if (dt <= 0.0f) {
         return 0.0f;
     }
@@ -44,8 +47,10 @@ float pid_update(pid_ctrl_t *p, float error, float dt) {
     float derivative = (error - p->prev_error) / dt;
     p->prev_error = error;
 
-    float out = p->kp * error + p->ki * p->integral + p->kd * derivative;
-    return clamp(out, p->output_limit);
+    p->p_term = p->kp * error;
+    p->i_term = p->ki * p->integral;
+    p->d_term = p->kd * derivative;
+    return clamp(p->p_term + p->i_term + p->d_term, p->output_limit);
 }
 
 motor_cmd_t motor_mix(float balance, float throttle, float turn, float limit) {
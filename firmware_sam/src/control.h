@@ -1,6 +1,8 @@
 #ifndef CONTROL_H
 #define CONTROL_H
 
+#include "ramfunc.h"
+
 typedef struct {
     float kp;
     float ki;
@@ -8,10 +10,11 @@ typedef struct {
     float integral;
     float prev_error;
     float output_limit;
+    float p_term, i_term, d_term;  // last update, before the output clamp
 } pid_ctrl_t;
 
 void pid_init(pid_ctrl_t *p, float kp, float ki, float kd, float output_limit);
-float pid_update(pid_ctrl_t *p, float error, float dt);
+RAMFUNC float pid_update(pid_ctrl_t *p, float error, float dt);
 
 typedef struct {
     float left;
@@ -0,0 +1,31 @@
+#include "dmac.h"
+
+// Descriptor section (one first descriptor per channel) and write-back
+// section, where the DMAC keeps the live state of active channels.
+static DmacDescriptor base_desc[DMAC_CHANNELS];
+static DmacDescriptor wrb_desc[DMAC_CHANNELS];
+
+void dmac_init(void) {
+    DMAC->CTRL = 0;
+    DMAC->CTRL = DMAC_CTRL_SWRST;
+    while (DMAC->CTRL & DMAC_CTRL_SWRST) {
+    }
+    DMAC->BASEADDR = (uint32_t)base_desc;
+    DMAC->WRBADDR = (uint32_t)wrb_desc;
+    DMAC->CTRL = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN_ALL;
+}
+
+DmacDescriptor *dmac_desc(uint8_t ch) {
+    return &base_desc[ch];
+}
+
+void dmac_channel_init(uint8_t ch, uint8_t trigsrc) {
+    DmacChannel *c = &DMAC->CHANNEL[ch];
+    c->CHCTRLA &= ~DMAC_CHCTRLA_ENABLE;
+    while (c->CHCTRLA & DMAC_CHCTRLA_ENABLE) {
+    }
+    c->CHCTRLA = DMAC_CHCTRLA_SWRST;
+    while (c->CHCTRLA & DMAC_CHCTRLA_SWRST) {
+    }
+    c->CHCTRLA = DMAC_CHCTRLA_TRIGSRC(trigsrc) | DMAC_CHCTRLA_TRIGACT_BURST;
+}
@@ -0,0 +1,28 @@
+#ifndef DMAC_H
+#define DMAC_H
+
+#include <stdint.h>
+#include "same51.h"
+
+// Channel allocation
+#define DMAC_CH_SPI_TX 0
+#define DMAC_CH_SPI_RX 1
+#define DMAC_CHANNELS  2
+
+void dmac_init(void);
+
+// First descriptor of a channel (the one the DMAC fetches on enable)
+DmacDescriptor *dmac_desc(uint8_t ch);
+
+// Reset a channel and set its trigger; burst of one beat per trigger
+void dmac_channel_init(uint8_t ch, uint8_t trigsrc);
+
+static inline void dmac_channel_enable(uint8_t ch) {
+    DMAC->CHANNEL[ch].CHCTRLA |= DMAC_CHCTRLA_ENABLE;
+}
+
+static inline int dmac_channel_busy(uint8_t ch) {
+    return (DMAC->CHANNEL[ch].CHCTRLA & DMAC_CHCTRLA_ENABLE) != 0;
+}
+
+#endif
@@ -11,19 +11,55 @@
 #include "rc_input.h"
 #include "motion_script.h"
 #include "tmc2209.h"
+#include "tmc_uart.h"
+#include "telemetry.h"
+#include "channels.h"
+#include "servo.h"
+#include "bootcfg.h"
+#include "blackbox.h"
+#include "perf.h"
+#include "sched.h"
+#include "stack.h"
 
 // Configuration
-#define UART_BAUD       115200
-#define LOOP_HZ         400
-#define SYSTICK_HZ      10000
+#define UART_BAUD       460800   // XBee ATBD 9
+#define LOOP_HZ         1000     // gyro ODR; one control tick per data-ready edge
 #define CALIB_SAMPLES   200
 #define TARGET_PITCH    0.0f
 #define MOTOR_LIMIT     1000.0f  // steps/sec limit
+#define MOTOR_ACCEL     20000    // steps/s^2 ramp limit
+#define MOTOR_JERK      2000000  // steps/s^3 ramp limit
+#define MOTOR_IRUN      20       // run current, 0..31 of VREF full scale
+#define MOTOR_IHOLD     8        // standstill current
+#define TMC_UART_BAUD   115200
 #define STANDUP_DURATION_S 1.5f
 #define STANDUP_START_PITCH_DEG -25.0f
-#define RC_TIMEOUT_S    1.0f
+#define RC_TIMEOUT_S    1.0f     // ASCII command lines
+#define RC_FRAME_TIMEOUT_S 0.08f // binary commands, sent at 50 Hz
 #define MAX_TILT_DEG    40.0f
 
+// Back-rest arm (docs/back-rest-arm.md): HS-422 pulse widths and the
+// shutdown sequence. ARM_TRAVEL_MS is the measured up-to-down travel; the
+// SHUTDOWN frame's lower-to-lean ticks show it on the robot.
+#define ARM_UP_US          1000   // stowed while balancing
+#define ARM_DOWN_US        2000   // supporting the robot at rest
+#define ARM_TRAVEL_MS      400
+#define SHUTDOWN_LEAN_DEG  -4.0f  // target bias backward, onto the arm
+#define SHUTDOWN_LEAN_MS   300    // ramp time, then the motors are cut
+
+// Task periods in control ticks (rate-monotonic: shorter period = higher priority)
+#define CONTROL_PERIOD   1                // 1 kHz
+#define RC_PERIOD        (LOOP_HZ / 200)  // 200 Hz
+#define MOTION_PERIOD    (LOOP_HZ / 100)  // 100 Hz
+#define DRIVER_PERIOD    (LOOP_HZ / 100)  // 100 Hz
+#define TELEMETRY_PERIOD CHAN_RUN_PERIOD  // 500 Hz channel scheduler
+#define STATUS_PERIOD    (LOOP_HZ / 8)    // 8 Hz status frames
+#define BLACKBOX_PERIOD  (LOOP_HZ / 100)  // 100 Hz flash and dump service
+#define LED_PERIOD       (LOOP_HZ / 4)    // 4 Hz
+#define STACK_PERIOD     (LOOP_HZ / 100)  // 100 Hz stack scan, RAM frame at 1 Hz
+#define STACK_SCAN_WORDS 256              // 1 KB of stack per run
+#define CYCLES_PER_US   (CPU_HZ / 1000000UL)
+
 // LED pin on SAME51 Curiosity Nano (directly, typical is PA14)
 #define LED_PIN 14
 
@@ -34,63 +70,97 @@
 #define RIGHT_STEP_PIN  11
 #define RIGHT_DIR_PIN   12
 #define RIGHT_EN_PIN    13
+#define LEFT_UART_ADDR  0        // MS1/MS2 low
+#define RIGHT_UART_ADDR 1        // MS1 high
 
 extern void system_init(void);
-extern void system_systick_init(uint32_t tick_hz);
 extern void delay_ms(uint32_t ms);
 
-static volatile uint32_t control_ticks = 0;
-static tmc2209_t *g_motor_left = 0;
-static tmc2209_t *g_motor_right = 0;
-
+// Boot phases in order. Each is stamped with the DWT cycle count at its
+// end; system_init starts the counter from 0.
 typedef enum {
-    ROBOT_DISARMED = 0,
-    ROBOT_STANDUP,
-    ROBOT_READY
-} robot_state_t;
+    BOOT_CLOCKS = 0,  // clocks, LED, UART, SPI
+    BOOT_IMU,         // bmi088_init
+    BOOT_MOTORS,      // step timers and driver UART
+    BOOT_SETUP,       // filter, controller, parser, blackbox, channels
+    BOOT_CALIB,       // sampling start to calibration done
+    BOOT_PHASES
+} boot_phase_t;
+
+static const char *const boot_names[BOOT_PHASES] = {
+    "clocks", "imu", "motors", "setup", "calib"
+};
+static uint32_t boot_end[BOOT_PHASES];
+
+static void boot_mark(boot_phase_t phase) {
+    boot_end[phase] = dwt_cycles();
+}
 
-void SysTick_Handler(void) {
-    if (g_motor_left) {
-        tmc2209_tick(g_motor_left, SYSTICK_HZ);
-    }
-    if (g_motor_right) {
-        tmc2209_tick(g_motor_right, SYSTICK_HZ);
-    }
+// " name=us"
+static void boot_write_us(const char *name, uint32_t us) {
+    uart_write_str(" ");
+    uart_write_str(name);
+    uart_write_str("=");
+    perf_write_u32(uart_write_str, us);
+}
 
-    static uint32_t div = 0;
-    div++;
-    if (div >= (SYSTICK_HZ / LOOP_HZ)) {
-        div = 0;
-        control_ticks++;
+// "BOOT clocks= imu= motors= setup= calib= total=" and "BOOT imu por=
+// reset= accel=", all in µs, then the RAM line (stack.h)
+static void boot_report(void) {
+    uart_write_str("BOOT");
+    uint32_t prev = 0;
+    for (uint8_t i = 0; i < BOOT_PHASES; i++) {
+        boot_write_us(boot_names[i], (boot_end[i] - prev) / CYCLES_PER_US);
+        prev = boot_end[i];
     }
+    boot_write_us("total", prev / CYCLES_PER_US);
+
+    bmi088_init_times_t imu;
+    bmi088_init_times(&imu);
+    uart_write_str("\r\nBOOT imu");
+    boot_write_us("por", imu.por_us);
+    boot_write_us("reset", imu.reset_us);
+    boot_write_us("accel", imu.accel_start_us);
+    uart_write_str("\r\n");
+    stack_dump(uart_write_str);
 }
 
-static void print_int(int32_t val) {
-    char buf[12];
-    int i = 0;
-    int neg = 0;
-    if (val < 0) { neg = 1; val = -val; }
-    if (val == 0) { uart_write_byte('0'); return; }
-    while (val > 0) {
-        buf[i++] = '0' + (val % 10);
-        val /= 10;
-    }
-    if (neg) uart_write_byte('-');
-    while (i > 0) uart_write_byte(buf[--i]);
+static tmc2209_t motor_left, motor_right;
+
+typedef enum {
+    ROBOT_DISARMED = 0,
+    ROBOT_STANDUP,
+    ROBOT_READY,
+    ROBOT_SHUTDOWN_ARM,   // arm lowering, still balancing upright
+    ROBOT_SHUTDOWN_LEAN   // target ramping backward onto the arm
+} robot_state_t;
+
+// Shutdown phases, each stamped with the control tick it started on
+typedef enum {
+    SD_RETRACT = 0,  // arm raised on START BALANCE
+    SD_LOWER,        // shutdown requested, arm lowering
+    SD_LEAN,         // arm down, target biased backward
+    SD_OFF,          // motors disabled
+    SD_PHASES
+} shutdown_phase_t;
+
+// Data-ready edge to motor command, in CPU cycles
+typedef struct {
+    uint32_t max;
+    uint32_t sum;
+    uint32_t count;
+} latency_stats_t;
+
+static void latency_reset(latency_stats_t *l) {
+    l->max = 0;
+    l->sum = 0;
+    l->count = 0;
 }
 
-static void print_float(float val, int decimals) {
-    if (val < 0) { uart_write_byte('-'); val = -val; }
-    int32_t integer = (int32_t)val;
-    print_int(integer);
-    uart_write_byte('.');
-    val -= integer;
-    for (int d = 0; d < decimals; d++) {
-        val *= 10;
-        int digit = (int)val;
-        uart_write_byte('0' + digit);
-        val -= digit;
-    }
+static void latency_add(latency_stats_t *l, uint32_t cycles) {
+    if (cycles > l->max) l->max = cycles;
+    l->sum += cycles;
+    l->count++;
 }
 
 static void led_init(void) {
@@ -105,22 +175,553 @@ static void led_off(void) {
     PORTA->OUTSET = (1 << LED_PIN);
 }
 
-__attribute__((unused))
 static void led_toggle(void) {
     PORTA->OUTTGL = (1 << LED_PIN);
 }
 
 // Convert angle to degrees for display
+#define RAD_TO_DEG (180.0f / 3.14159265f)
+
 static float rad_to_deg(float rad) {
-    return rad * 180.0f / 3.14159265f;
+    return rad * RAD_TO_DEG;
+}
+
+// State shared between tasks. Tasks run to completion one at a time, so
+// plain statics are safe; only the ISRs need volatile.
+static attitude_filter_t filter;
+static pid_ctrl_t pid;
+static rc_parser_t rc_parser;
+static rc_cmd_t rc = {0};
+static motion_script_t script;
+
+static float roll_offset = 0.0f;
+static float pitch_offset = 0.0f;
+static uint32_t calib_count = 0;
+
+static const float dt = 1.0f / LOOP_HZ;
+static float standup_elapsed = 0.0f;
+static robot_state_t state = ROBOT_DISARMED;
+static uint32_t last_rc_tick = 0;
+static const uint32_t rc_timeout_ticks = (uint32_t)(RC_TIMEOUT_S * LOOP_HZ);
+static const uint32_t rc_frame_timeout_ticks = (uint32_t)(RC_FRAME_TIMEOUT_S * LOOP_HZ);
+_Static_assert(RC_TICK_HZ == LOOP_HZ, "rc_poll is stamped with control ticks");
+
+static const uint32_t arm_travel_ticks = (uint32_t)ARM_TRAVEL_MS * LOOP_HZ / 1000;
+static const uint32_t lean_ticks = (uint32_t)SHUTDOWN_LEAN_MS * LOOP_HZ / 1000;
+static uint32_t sd_tick[SD_PHASES];
+static float sd_lean_pitch;      // pitch when the lean started
+static float sd_off_pitch;       // pitch when the motors were cut
+static bool sd_report = false;   // SHUTDOWN frame waiting to be sent
+
+static latency_stats_t latency;
+static uint32_t last_tick = 0;
+static uint32_t missed_ticks = 0;
+
+static float roll = 0.0f, pitch = 0.0f;
+static float pitch_rate = 0.0f;
+static float target_pitch = TARGET_PITCH;
+static float balance = 0.0f;
+static motor_cmd_t cmd = {0.0f, 0.0f};
+
+// Latest motion script outputs, refreshed by the motion task
+static bool script_active = false;
+static float script_throttle = 0.0f;
+static float script_turn = 0.0f;
+static float script_target_pitch = TARGET_PITCH;
+
+// Blackbox: one record per control tick, filled in place
+static void blackbox_log(const bmi088_sample_t *raw, uint32_t latency_cycles) {
+    blackbox_record_t *r = blackbox_next();
+    if (!r) {
+        return;
+    }
+    uint32_t latency_us = latency_cycles / CYCLES_PER_US;
+    r->tick = last_tick;
+    r->ax = raw->ax;
+    r->ay = raw->ay;
+    r->az = raw->az;
+    r->gx = raw->gx;
+    r->gy = raw->gy;
+    r->gz = raw->gz;
+    r->roll = telem_scaled_i16(rad_to_deg(roll), TELEM_ANGLE_SCALE);
+    r->pitch = telem_scaled_i16(rad_to_deg(pitch), TELEM_ANGLE_SCALE);
+    r->target_pitch = telem_scaled_i16(rad_to_deg(target_pitch), TELEM_ANGLE_SCALE);
+    r->p_term = telem_scaled_i16(pid.p_term, 1.0f);
+    r->i_term = telem_scaled_i16(pid.i_term, 1.0f);
+    r->d_term = telem_scaled_i16(pid.d_term, 1.0f);
+    r->left = telem_scaled_i16(cmd.left, 1.0f);
+    r->right = telem_scaled_i16(cmd.right, 1.0f);
+    r->latency_us = (uint16_t)(latency_us > 0xFFFF ? 0xFFFF : latency_us);
+    r->state = (uint8_t)state;
+    r->mode = (uint8_t)((rc.mode & 0x7F) | (rc.enabled ? 0x80 : 0));
+    blackbox_commit();
+}
+
+static void motors_enable(bool on) {
+    tmc2209_enable(&motor_left, on ? 1 : 0);
+    tmc2209_enable(&motor_right, on ? 1 : 0);
+}
+
+// Fallen over: cut the motors now, no arm sequence
+static void robot_stop(void) {
+    motors_enable(false);
+    servo_set_us(ARM_DOWN_US);
+    motion_script_reset(&script);
+    state = ROBOT_DISARMED;
+}
+
+// Safe shutdown, step 1: lower the arm and keep balancing while it travels
+static void shutdown_begin(uint32_t tick) {
+    servo_set_us(ARM_DOWN_US);
+    motion_script_reset(&script);
+    sd_tick[SD_LOWER] = tick;
+    state = ROBOT_SHUTDOWN_ARM;
+}
+
+// Steps 2 and 3, run by the control task every tick
+static void shutdown_step(uint32_t tick) {
+    if (state == ROBOT_SHUTDOWN_ARM && tick - sd_tick[SD_LOWER] >= arm_travel_ticks) {
+        sd_tick[SD_LEAN] = tick;
+        sd_lean_pitch = pitch;
+        state = ROBOT_SHUTDOWN_LEAN;
+    }
+    if (state != ROBOT_SHUTDOWN_LEAN) {
+        return;
+    }
+    uint32_t t = tick - sd_tick[SD_LEAN];
+    if (t < lean_ticks) {
+        const float lean_rad = SHUTDOWN_LEAN_DEG * (3.14159265f / 180.0f);
+        target_pitch = TARGET_PITCH + lean_rad * (float)t / (float)lean_ticks;
+        return;
+    }
+    motors_enable(false);
+    sd_tick[SD_OFF] = tick;
+    sd_off_pitch = pitch;
+    sd_report = true;
+    state = ROBOT_DISARMED;
+    blackbox_trigger(BB_TRIG_DISARM);
+}
+
+// SHUTDOWN frame: the four phase ticks, then pitch at lean and at cut-off
+static void send_shutdown(void) {
+    telem_frame_t f;
+    telem_begin(&f, TELEM_TYPE_SHUTDOWN);
+    for (uint8_t i = 0; i < SD_PHASES; i++) {
+        telem_put_u32(&f, sd_tick[i]);
+    }
+    telem_put_scaled_i16(&f, rad_to_deg(sd_lean_pitch), TELEM_ANGLE_SCALE);
+    telem_put_scaled_i16(&f, rad_to_deg(sd_off_pitch), TELEM_ANGLE_SCALE);
+    uint8_t out[TELEM_MAX_FRAME];
+    if (uart_write(out, telem_finish(&f, out))) {
+        sd_report = false;
+    }
+}
+
+// Control: read IMU, compute, command motors
+static void task_control(void) {
+    uint32_t control_ticks = bmi088_sample_count();
+    missed_ticks += control_ticks - last_tick - 1;
+    last_tick = control_ticks;
+
+    // The sample was fetched by DMA before this task was released
+    bmi088_sample_t raw;
+    bmi088_scaled_t imu;
+    uint32_t drdy_cycles;
+    uint32_t t0 = perf_begin();
+    bmi088_latest(&raw, &imu, &drdy_cycles);
+    perf_end(PERF_IMU_READ, t0);
+
+    if (calib_count < CALIB_SAMPLES) {
+        float roll_acc = 0.0f, pitch_acc = 0.0f;
+        attitude_accel_angles(imu.ax, imu.ay, imu.az, &roll_acc, &pitch_acc);
+        roll_offset += roll_acc;
+        pitch_offset += pitch_acc;
+        calib_count++;
+
+        if (calib_count == CALIB_SAMPLES) {
+            roll_offset /= (float)CALIB_SAMPLES;
+            pitch_offset /= (float)CALIB_SAMPLES;
+            uart_write_str("Calibration done\r\n");
+            boot_mark(BOOT_CALIB);
+            boot_report();
+        }
+        return;
+    }
+
+    // Time covered by this tick's FIFO frames, nominal if none arrived
+    float tick_dt = (imu.dt > 0.0f) ? imu.dt : dt;
+
+    t0 = perf_begin();
+    attitude_update(&filter, imu.gx, imu.gy, imu.gz,
+                    imu.ax, imu.ay, imu.az, tick_dt, &roll, &pitch);
+    perf_end(PERF_ATTITUDE, t0);
+    roll -= roll_offset;
+    pitch -= pitch_offset;
+    pitch_rate = imu.gy;
+
+    if (state != ROBOT_DISARMED) {
+        uint32_t timeout = rc_parser.binary ? rc_frame_timeout_ticks : rc_timeout_ticks;
+        if ((control_ticks - last_rc_tick) > timeout) {
+            rc.enabled = false;
+            blackbox_trigger(BB_TRIG_TIMEOUT);
+        }
+        if (fabsf(rad_to_deg(pitch)) > MAX_TILT_DEG) {
+            rc.enabled = false;
+            blackbox_trigger(BB_TRIG_TILT);
+            robot_stop();
+        }
+    }
+
+    target_pitch = TARGET_PITCH;
+    if (state == ROBOT_STANDUP) {
+        float start_rad = STANDUP_START_PITCH_DEG * (3.14159265f / 180.0f);
+        float end_rad = TARGET_PITCH;
+        float t_norm = standup_elapsed / STANDUP_DURATION_S;
+        if (t_norm >= 1.0f) {
+            t_norm = 1.0f;
+            state = ROBOT_READY;
+        }
+        target_pitch = start_rad + (end_rad - start_rad) * t_norm;
+        standup_elapsed += dt;
+    }
+    shutdown_step(control_ticks);
+
+    // Apply RC mixing
+    float throttle = 0.0f;
+    float turn = 0.0f;
+    if (script_active && rc.enabled && rc.mode != 0 && state == ROBOT_READY) {
+        throttle = script_throttle * 500.0f;
+        turn = script_turn * 200.0f;
+        target_pitch = script_target_pitch;
+    } else if (rc.enabled) {
+        if (state == ROBOT_READY) {
+            throttle = rc.throttle * 500.0f;
+            turn = rc.turn * 200.0f;
+        }
+    }
+    float error = target_pitch - pitch;
+    t0 = perf_begin();
+    balance = pid_update(&pid, error, tick_dt);
+    cmd = motor_mix(balance, throttle, turn, MOTOR_LIMIT);
+    perf_end(PERF_PID, t0);
+
+    tmc2209_set_speed_q16(&motor_left, TMC2209_Q16(cmd.left));
+    tmc2209_set_speed_q16(&motor_right, TMC2209_Q16(cmd.right));
+    uint32_t latency_cycles = dwt_cycles() - drdy_cycles;
+    latency_add(&latency, latency_cycles);
+    blackbox_log(&raw, latency_cycles);
+}
+
+// Hot-path benchmark ("BENCH", disarmed only): attitude and PID updates
+// on fixed input and private state, with the CMCC off and then on. Prints
+// the fastest and mean cycles per iteration (interrupts keep running)
+// with the build's clock and RAMFUNC setting, so builds can be compared.
+#define BENCH_ITERATIONS 1000
+#ifdef RAMFUNC_DISABLE
+#define BENCH_RAMFUNC 0
+#else
+#define BENCH_RAMFUNC 1
+#endif
+
+static volatile float bench_sink;
+
+static void bench_run(uint32_t *min, uint32_t *avg) {
+    attitude_filter_t f;
+    pid_ctrl_t p;
+    attitude_init(&f);
+    pid_init(&p, 50.0f, 0.0f, 2.0f, MOTOR_LIMIT);
+    float r = 0.0f, pi = 0.0f, out = 0.0f;
+    uint32_t best = UINT32_MAX;
+    uint32_t start = dwt_cycles();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        uint32_t t0 = dwt_cycles();
+        attitude_update(&f, 0.01f, -0.02f, 0.0f, 0.3f, -0.2f, 9.8f, dt, &r, &pi);
+        out += pid_update(&p, TARGET_PITCH - pi, dt);
+        uint32_t c = dwt_cycles() - t0;
+        if (c < best) best = c;
+    }
+    *avg = (dwt_cycles() - start) / BENCH_ITERATIONS;
+    *min = best;
+    bench_sink = out + r;
+}
+
+static void bench(void) {
+    bool cache = cmcc_enabled();
+    for (uint8_t on = 0; on < 2; on++) {
+        if (on) {
+            cmcc_invalidate();
+            cmcc_enable();
+        } else {
+            cmcc_disable();
+        }
+        uint32_t min, avg;
+        bench_run(&min, &avg);
+        uart_write_str("BENCH mhz=");
+        perf_write_u32(uart_write_str, CPU_MHZ);
+        uart_write_str(" ramfunc=");
+        perf_write_u32(uart_write_str, BENCH_RAMFUNC);
+        uart_write_str(" cmcc=");
+        perf_write_u32(uart_write_str, on);
+        uart_write_str(" min=");
+        perf_write_u32(uart_write_str, min);
+        uart_write_str(" avg=");
+        perf_write_u32(uart_write_str, avg);
+        uart_write_str(" ns=");
+        perf_write_u32(uart_write_str, min * 1000 / CPU_MHZ);
+        uart_write_str("\r\n");
+    }
+    if (!cache) {
+        cmcc_disable();
+    }
+}
+
+// RC: drain the XBee link, handle arm/disarm and PERF
+static void task_rc(void) {
+    uint32_t t0 = perf_begin();
+    uint32_t now = bmi088_sample_count();
+    if (rc_poll(&rc_parser, &rc, now)) {
+        last_rc_tick = now;
+    }
+    perf_end(PERF_RC_POLL, t0);
+
+    static int last_enabled = 0;
+    if (rc.enabled != last_enabled) {
+        if (rc.enabled) {
+            // START BALANCE: the controller holds the resting pitch, so
+            // the arm can come up at once
+            servo_set_us(ARM_UP_US);
+            sd_tick[SD_RETRACT] = now;
+            if (state == ROBOT_SHUTDOWN_ARM || state == ROBOT_SHUTDOWN_LEAN) {
+                // Re-armed mid-sequence: the motors never stopped
+                state = ROBOT_READY;
+            } else {
+                motors_enable(true);
+                state = ROBOT_STANDUP;
+                standup_elapsed = 0.0f;
+                blackbox_rearm();
+            }
+        } else if (state == ROBOT_STANDUP || state == ROBOT_READY) {
+            shutdown_begin(now);
+        }
+        last_enabled = rc.enabled;
+    }
+
+    if (rc_parser.bench_request) {
+        rc_parser.bench_request = false;
+        if (rc.enabled) {
+            uart_write_str("BENCH ERR armed\r\n");
+        } else {
+            bench();
+        }
+    }
+
+    // Firmware update ("UPDATE", disarmed only): the bootloader takes over
+    // the link after a reset (firmware_sam/README.md)
+    if (rc_parser.update_request) {
+        rc_parser.update_request = false;
+        if (rc.enabled) {
+            uart_write_str("UPDATE ERR armed\r\n");
+        } else {
+            motors_enable(false);
+            uart_write_str("UPDATE OK\r\n");
+            uart_deinit();
+            boot_enter();
+        }
+    }
+
+    // A new image is only kept once it got this far (bootcfg.h). Done
+    // here rather than in the control task: the record write stalls flash.
+    static bool confirmed = false;
+    if (!confirmed && calib_count == CALIB_SAMPLES) {
+        confirmed = true;
+        bootcfg_confirm();
+    }
+
+    if (rc_parser.perf_request) {
+        rc_parser.perf_request = false;
+        perf_dump(uart_write_str);
+        perf_reset();
+        sched_dump(uart_write_str);
+        if (calib_count == CALIB_SAMPLES) {
+            boot_report();
+        }
+    }
+
+    switch (rc_parser.bb_request) {
+    case RC_BB_DUMP:       blackbox_dump(BB_SRC_RAM);   break;
+    case RC_BB_DUMP_FLASH: blackbox_dump(BB_SRC_FLASH); break;
+    case RC_BB_SAVE:       blackbox_save();             break;
+    case RC_BB_REARM:      blackbox_rearm();            break;
+    default: break;
+    }
+    rc_parser.bb_request = RC_BB_NONE;
+}
+
+// Motion script: refresh throttle/turn/pitch targets for the control task
+static void task_motion(void) {
+    if (rc.enabled && rc.mode != 0 && state == ROBOT_READY) {
+        motion_script_step(&script, rc.mode, dt * MOTION_PERIOD,
+                           &script_throttle, &script_turn, &script_target_pitch);
+        script_active = true;
+    } else {
+        script_active = false;
+    }
+}
+
+// Drivers: microstep switching and diagnostics over PDN_UART
+static void task_driver(void) {
+    tmc_uart_poll();
+    tmc2209_service(&motor_left);
+    tmc2209_service(&motor_right);
+}
+
+// Telemetry: the subscribed channels due this run, queued without waiting
+static void task_telemetry(void) {
+    if (calib_count < CALIB_SAMPLES) {
+        return;
+    }
+    uint32_t t0 = perf_begin();
+    chan_service(last_tick);
+    if (sd_report) {
+        send_shutdown();
+    }
+    perf_end(PERF_TELEMETRY, t0);
+}
+
+// Status: loop health, driver diagnostics and RC link statistics
+static void task_status(void) {
+    telem_frame_t f;
+    uint8_t out[TELEM_MAX_FRAME];
+    uint32_t lat_avg = latency.count ? latency.sum / latency.count : 0;
+    uart_rx_stats_t rx;
+    uart_rx_stats(&rx);
+    telem_begin(&f, TELEM_TYPE_STATUS);
+    telem_put_u16(&f, (uint16_t)(lat_avg / CYCLES_PER_US));
+    telem_put_u16(&f, (uint16_t)(latency.max / CYCLES_PER_US));
+    telem_put_u32(&f, missed_ticks);
+    telem_put_u32(&f, bmi088_dma_overruns());
+    telem_put_u32(&f, uart_tx_dropped());
+    telem_put_u16(&f, (uint16_t)motor_left.sg_result);
+    telem_put_u16(&f, (uint16_t)motor_right.sg_result);
+    telem_put_u32(&f, motor_left.tstep);
+    telem_put_u32(&f, motor_right.tstep);
+    telem_put_u32(&f, motor_left.drv_status);
+    telem_put_u32(&f, motor_right.drv_status);
+    telem_put_u32(&f, rx.overruns);
+    telem_put_u32(&f, rx.frame_errors);
+    telem_put_u32(&f, rx.dropped);
+    uart_write(out, telem_finish(&f, out));
+    latency_reset(&latency);
+
+    rc_link_t *link = &rc_parser.link;
+    uint32_t rtt_avg = link->rtt_count ? link->rtt_sum_us / link->rtt_count : 0;
+    telem_begin(&f, TELEM_TYPE_RC_LINK);
+    telem_put_u32(&f, link->frames);
+    telem_put_u32(&f, link->lost);
+    telem_put_u32(&f, link->late);
+    telem_put_u32(&f, link->bad);
+    telem_put_u16(&f, (uint16_t)(rtt_avg / 100));
+    telem_put_u16(&f, (uint16_t)(link->rtt_max_us / 100));
+    uart_write(out, telem_finish(&f, out));
+    link->rtt_sum_us = 0;
+    link->rtt_max_us = 0;
+    link->rtt_count = 0;
+}
+
+// Stack: a slice of the high-water scan each run, RAM use once a second
+static void task_stack(void) {
+    static uint8_t runs = 0;
+    stack_scan(STACK_SCAN_WORDS);
+    if (++runs < LOOP_HZ / STACK_PERIOD) {
+        return;
+    }
+    runs = 0;
+
+    stack_ram_t r;
+    stack_ram(&r);
+    telem_frame_t f;
+    uint8_t out[TELEM_MAX_FRAME];
+    telem_begin(&f, TELEM_TYPE_RAM);
+    telem_put_u32(&f, r.data);
+    telem_put_u32(&f, r.bss);
+    telem_put_u32(&f, r.free);
+    telem_put_u32(&f, r.noinit);
+    telem_put_u32(&f, r.stack);
+    telem_put_u32(&f, r.stack_used);
+    telem_put_u32(&f, r.faults);
+    telem_put_u32(&f, r.fault_addr);
+    uart_write(out, telem_finish(&f, out));
+}
+
+static void task_blackbox(void) {
+    blackbox_service();
+}
+
+// LED: solid while armed, heartbeat blink while disarmed
+static void task_led(void) {
+    if (state != ROBOT_DISARMED) {
+        led_on();
+    } else {
+        led_toggle();
+    }
+}
+
+#define TASK(n, fn, per, dl, prio) \
+    { .name = (n), .run = (fn), .period = (per), .deadline = (dl), .priority = (prio) }
+
+static int16_t read_state(void) {
+    return (int16_t)state;
+}
+
+static int16_t read_arm(void) {
+    return (int16_t)servo_pulse_us();
 }
 
+// Telemetry channels; the index is the id used in "SUB:id,hz" and lower
+// ids keep their rate longer when the link budget is short
+static const chan_def_t channels[] = {
+    CHAN_F("roll",         &roll,         RAD_TO_DEG * 100.0f, 100),
+    CHAN_F("pitch",        &pitch,        RAD_TO_DEG * 100.0f, 100),
+    CHAN_F("pitch_rate",   &pitch_rate,   RAD_TO_DEG * 10.0f,  10),
+    CHAN_F("target_pitch", &target_pitch, RAD_TO_DEG * 100.0f, 100),
+    CHAN_F("balance",      &balance,      1.0f,                1),
+    CHAN_F("left",         &cmd.left,     1.0f,                1),
+    CHAN_F("right",        &cmd.right,    1.0f,                1),
+    CHAN_F("p_term",       &pid.p_term,   1.0f,                1),
+    CHAN_F("i_term",       &pid.i_term,   1.0f,                1),
+    CHAN_F("d_term",       &pid.d_term,   1.0f,                1),
+    CHAN_F("rc_throttle",  &rc.throttle,  1000.0f,             1000),
+    CHAN_F("rc_turn",      &rc.turn,      1000.0f,             1000),
+    CHAN_FN("state",       read_state),
+    CHAN_U8("mode",        &rc.mode),
+    CHAN_U8("enabled",     (const uint8_t *)&rc.enabled),
+    CHAN_FN("arm_us",      read_arm),
+};
+_Static_assert(CHAN_TICK_HZ == LOOP_HZ, "channels are scheduled in control ticks");
+
+// Sent until the host subscribes to something else
+#define DEFAULT_CHANNEL_HZ 50
+static const uint8_t default_channels[] = {0, 1, 12, 14};  // roll, pitch, state, enabled
+
+static task_t tasks[] = {
+    TASK("control",   task_control,   CONTROL_PERIOD,   CONTROL_PERIOD,   0),
+    TASK("rc",        task_rc,        RC_PERIOD,        RC_PERIOD,        1),
+    TASK("motion",    task_motion,    MOTION_PERIOD,    MOTION_PERIOD,    2),
+    TASK("driver",    task_driver,    DRIVER_PERIOD,    DRIVER_PERIOD,    3),
+    TASK("telemetry", task_telemetry, TELEMETRY_PERIOD, TELEMETRY_PERIOD, 4),
+    TASK("status",    task_status,    STATUS_PERIOD,    STATUS_PERIOD,    5),
+    TASK("blackbox",  task_blackbox,  BLACKBOX_PERIOD,  BLACKBOX_PERIOD,  6),
+    TASK("stack",     task_stack,     STACK_PERIOD,     STACK_PERIOD,     7),
+    TASK("led",       task_led,       LED_PERIOD,       LED_PERIOD,       8),
+};
+
 int main(void) {
+    stack_init();
     system_init();
-    system_systick_init(SYSTICK_HZ);
     led_init();
     uart_init(UART_BAUD);
     spi_init();
+    boot_mark(BOOT_CLOCKS);
     if (!bmi088_init()) {
         uart_write_str("BMI088 init failed\r\n");
         while (1) {
@@ -129,178 +730,50 @@ int main(void) {
         }
     }
 
+    boot_mark(BOOT_IMU);
     uart_write_str("SAME51 Balancing Robot Ready\r\n");
 
     // Initialize motors
-    tmc2209_t motor_left, motor_right;
     tmc2209_init(&motor_left, LEFT_STEP_PIN, LEFT_DIR_PIN, LEFT_EN_PIN);
     tmc2209_init(&motor_right, RIGHT_STEP_PIN, RIGHT_DIR_PIN, RIGHT_EN_PIN);
-    g_motor_left = &motor_left;
-    g_motor_right = &motor_right;
+    tmc2209_set_limits(&motor_left, MOTOR_ACCEL, MOTOR_JERK);
+    tmc2209_set_limits(&motor_right, MOTOR_ACCEL, MOTOR_JERK);
+    tmc_uart_init(TMC_UART_BAUD);
+    tmc2209_attach_uart(&motor_left, LEFT_UART_ADDR, MOTOR_IRUN, MOTOR_IHOLD);
+    tmc2209_attach_uart(&motor_right, RIGHT_UART_ADDR, MOTOR_IRUN, MOTOR_IHOLD);
+    servo_init(ARM_DOWN_US);  // the robot boots resting on the arm
+    boot_mark(BOOT_MOTORS);
 
     // Initialize filter and controller
-    attitude_filter_t filter;
     attitude_init(&filter);
-
-    pid_ctrl_t pid;
     pid_init(&pid, 50.0f, 0.0f, 2.0f, MOTOR_LIMIT);  // Tuning needed
-
-    // RC input parser
-    rc_parser_t rc_parser;
     rc_init(&rc_parser);
-    rc_cmd_t rc = {0};
-
-    motion_script_t script;
     motion_script_init(&script);
-
-    // Calibration
-    float roll_offset = 0.0f;
-    float pitch_offset = 0.0f;
-    uint32_t calib_count = 0;
+    latency_reset(&latency);
+    blackbox_init();
+    chan_init(channels, sizeof(channels) / sizeof(channels[0]));
+    for (uint8_t i = 0; i < sizeof(default_channels); i++) {
+        chan_subscribe(default_channels[i], DEFAULT_CHANNEL_HZ);
+    }
 
     uart_write_str("Calibrating... hold still\r\n");
 
-    // Timing
-    const float dt = 1.0f / LOOP_HZ;
-    uint32_t sample_count = 0;
-    float standup_elapsed = 0.0f;
-    robot_state_t state = ROBOT_DISARMED;
-    uint32_t last_rc_tick = 0;
-    const uint32_t rc_timeout_ticks = (uint32_t)(RC_TIMEOUT_S * LOOP_HZ);
-
-    uint32_t last_tick = 0;
-    while (1) {
-        if (control_ticks == last_tick) {
-            continue;
-        }
-        last_tick = control_ticks;
-        // Poll XBee for RC commands
-        if (rc_poll(&rc_parser, &rc)) {
-            last_rc_tick = control_ticks;
-        }
-
-        // Handle LED test command (enable toggles LED)
-        static int last_enabled = 0;
-        if (rc.enabled != last_enabled) {
-            if (rc.enabled) {
-                led_on();
-                tmc2209_enable(&motor_left, 1);
-                tmc2209_enable(&motor_right, 1);
-                state = ROBOT_STANDUP;
-                standup_elapsed = 0.0f;
-            } else {
-                led_off();
-                tmc2209_enable(&motor_left, 0);
-                tmc2209_enable(&motor_right, 0);
-                motion_script_reset(&script);
-                state = ROBOT_DISARMED;
-            }
-            last_enabled = rc.enabled;
-        }
-
-        // Read IMU
-        bmi088_scaled_t imu;
-        bmi088_read_scaled(&imu);
-
-        // Calibration phase
-        if (calib_count < CALIB_SAMPLES) {
-            float roll_acc = 0.0f, pitch_acc = 0.0f;
-            attitude_accel_angles(imu.ax, imu.ay, imu.az, &roll_acc, &pitch_acc);
-            roll_offset += roll_acc;
-            pitch_offset += pitch_acc;
-            calib_count++;
-
-            if (calib_count == CALIB_SAMPLES) {
-                roll_offset /= (float)CALIB_SAMPLES;
-                pitch_offset /= (float)CALIB_SAMPLES;
-                uart_write_str("Calibration done\r\n");
-            }
-            continue;
-        }
+    perf_set_budget(PERF_LOOP, CPU_HZ / LOOP_HZ);
+    perf_set_budget(PERF_STEP_ISR, CPU_HZ / TMC2209_MAX_STEP_HZ);
+    perf_reset();
 
-        // Update attitude filter
-        float roll = 0.0f, pitch = 0.0f;
-        attitude_update(&filter, imu.gx, imu.gy, imu.gz,
-                        imu.ax, imu.ay, imu.az, dt, &roll, &pitch);
-        roll -= roll_offset;
-        pitch -= pitch_offset;
-
-        if (state != ROBOT_DISARMED) {
-            if ((control_ticks - last_rc_tick) > rc_timeout_ticks) {
-                rc.enabled = false;
-            }
-            if (fabsf(rad_to_deg(pitch)) > MAX_TILT_DEG) {
-                rc.enabled = false;
-            }
-        }
+    boot_mark(BOOT_SETUP);
+    bmi088_drdy_init();
+    last_tick = bmi088_sample_count();
+    sched_init(tasks, sizeof(tasks) / sizeof(tasks[0]), bmi088_sample_count);
 
-        // Balance control
-        float target_pitch = TARGET_PITCH;
-        if (state == ROBOT_STANDUP) {
-            float start_rad = STANDUP_START_PITCH_DEG * (3.14159265f / 180.0f);
-            float end_rad = TARGET_PITCH;
-            float t_norm = standup_elapsed / STANDUP_DURATION_S;
-            if (t_norm >= 1.0f) {
-                t_norm = 1.0f;
-                state = ROBOT_READY;
-            }
-            target_pitch = start_rad + (end_rad - start_rad) * t_norm;
-            standup_elapsed += dt;
-        }
-
-        // Apply RC mixing
-        float throttle = 0.0f;
-        float turn = 0.0f;
-        float scripted_target_pitch = TARGET_PITCH;
-        if (rc.enabled && rc.mode != 0 && state == ROBOT_READY) {
-            float script_throttle = 0.0f;
-            float script_turn = 0.0f;
-            motion_script_step(&script, rc.mode, dt, &script_throttle, &script_turn, &scripted_target_pitch);
-            throttle = script_throttle * 500.0f;
-            turn = script_turn * 200.0f;
-            target_pitch = scripted_target_pitch;
-        } else if (rc.enabled) {
-            if (state == ROBOT_READY) {
-                throttle = rc.throttle * 500.0f;
-                turn = rc.turn * 200.0f;
-            }
-        }
-        float error = target_pitch - pitch;
-        float balance = pid_update(&pid, error, dt);
-        motor_cmd_t cmd = motor_mix(balance, throttle, turn, MOTOR_LIMIT);
-
-        // Set motor speeds
-        tmc2209_set_speed(&motor_left, (int32_t)cmd.left);
-        tmc2209_set_speed(&motor_right, (int32_t)cmd.right);
-
-        // Output telemetry (every 50 samples)
-        if ((sample_count++ % 50) == 0) {
-            float time_s = (float)sample_count / (float)LOOP_HZ;
-            float target_pitch_deg = rad_to_deg(target_pitch);
-            uart_write_str("R:");
-            print_float(rad_to_deg(roll), 1);
-            uart_write_str(" P:");
-            print_float(rad_to_deg(pitch), 1);
-            uart_write_str(" Y:0");
-            uart_write_str(" T:");
-            print_float(time_s, 2);
-            uart_write_str(" LM:");
-            print_float(cmd.left, 0);
-            uart_write_str(" RM:");
-            print_float(cmd.right, 0);
-            uart_write_str(" MODE:");
-            print_int((int32_t)rc.mode);
-            uart_write_str(" EN:");
-            print_int(rc.enabled ? 1 : 0);
-            uart_write_str(" TP:");
-            print_float(target_pitch_deg, 1);
-            uart_write_str(" ST:");
-            print_int((int32_t)state);
-            uart_write_str(" BAL:");
-            print_float(balance, 1);
-            uart_write_str("\r\n");
+    while (1) {
+        uint32_t t0 = perf_begin();
+        if (sched_dispatch()) {
+            perf_end(PERF_LOOP, t0);
+        } else {
+            sched_idle();
         }
-
     }
 
     return 0;
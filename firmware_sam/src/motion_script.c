@@ -1,13 +1,158 @@
 #include "motion_script.h"
-#include <math.h>
+
+// One full sine period in 256 steps, Q15. Indexed by the top 8 bits of the
+// NCO phase and linearly interpolated with the next 16.
+static const int16_t sine_q15[256] = {
+	0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+	6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+	12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+	18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+	23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+	27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+	30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+	32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+	32767, 32757, 32728, 32678, 32609, 32521, 32412, 32285,
+	32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571,
+	30273, 29956, 29621, 29268, 28898, 28510, 28105, 27683,
+	27245, 26790, 26319, 25832, 25329, 24811, 24279, 23731,
+	23170, 22594, 22005, 21403, 20787, 20159, 19519, 18868,
+	18204, 17530, 16846, 16151, 15446, 14732, 14010, 13279,
+	12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+	6393, 5602, 4808, 4011, 3212, 2410, 1608, 804,
+	0, -804, -1608, -2410, -3212, -4011, -4808, -5602,
+	-6393, -7179, -7962, -8739, -9512, -10278, -11039, -11793,
+	-12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+	-18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+	-23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+	-27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+	-30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+	-32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+	-32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+	-32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+	-30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+	-27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+	-23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+	-18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+	-12539, -11793, -11039, -10278, -9512, -8739, -7962, -7179,
+	-6393, -5602, -4808, -4011, -3212, -2410, -1608, -804,
+};
+
+#define SEG(dur, per, thr, thr_amp, turn, turn_amp, pitch, pitch_amp) \
+	{ (dur), (per), (thr), (thr_amp), (turn), (turn_amp), (pitch), (pitch_amp) }
+
+// Built-in scripts for modes 1..11.
+//                    dur_ms period  thr amp  turn  amp  pitch  amp
+static const motion_segment_t seg_circle[] = {
+	SEG(0,    0,     300, 0,   200,  0,   0,     0),
+};
+static const motion_segment_t seg_figure8[] = {
+	SEG(0,    4000,  300, 0,   0,    250, 0,     0),
+};
+static const motion_segment_t seg_figure8_slow[] = {
+	SEG(0,    6000,  300, 0,   0,    200, 0,     0),
+};
+static const motion_segment_t seg_figure8_fast[] = {
+	SEG(0,    3000,  300, 0,   0,    300, 0,     0),
+};
+static const motion_segment_t seg_spin[] = {
+	SEG(0,    0,     0,   0,   350,  0,   0,     0),
+};
+static const motion_segment_t seg_stop_go[] = {
+	SEG(1000, 0,     300, 0,   0,    0,   0,     0),
+	SEG(1000, 0,     0,   0,   0,    0,   0,     0),
+};
+static const motion_segment_t seg_square[] = {
+	SEG(1000, 0,     300, 0,   0,    0,   0,     0),
+	SEG(500,  0,     0,   0,   350,  0,   0,     0),
+	SEG(1000, 0,     300, 0,   0,    0,   0,     0),
+	SEG(500,  0,     0,   0,   350,  0,   0,     0),
+	SEG(1000, 0,     300, 0,   0,    0,   0,     0),
+	SEG(500,  0,     0,   0,   350,  0,   0,     0),
+	SEG(1000, 0,     300, 0,   0,    0,   0,     0),
+	SEG(500,  0,     0,   0,   350,  0,   0,     0),
+};
+static const motion_segment_t seg_slalom[] = {
+	SEG(0,    3000,  300, 0,   0,    400, 0,     0),
+};
+static const motion_segment_t seg_lean_fwd[] = {
+	SEG(0,    0,     0,   0,   0,    0,   500,   0),
+};
+static const motion_segment_t seg_lean_back[] = {
+	SEG(0,    0,     0,   0,   0,    0,   -500,  0),
+};
+static const motion_segment_t seg_pitch_osc[] = {
+	SEG(0,    10000, 0,   0,   0,    0,   0,     300),
+};
+
+typedef struct {
+	const motion_segment_t *seg;
+	uint8_t count;
+} motion_table_t;
+
+#define TABLE(a) { (a), (uint8_t)(sizeof(a) / sizeof((a)[0])) }
+
+static const motion_table_t builtin[] = {
+	{ 0, 0 },               // 0: manual
+	TABLE(seg_circle),
+	TABLE(seg_figure8),
+	TABLE(seg_figure8_slow),
+	TABLE(seg_figure8_fast),
+	TABLE(seg_spin),
+	TABLE(seg_stop_go),
+	TABLE(seg_square),
+	TABLE(seg_slalom),
+	TABLE(seg_lean_fwd),
+	TABLE(seg_lean_back),
+	TABLE(seg_pitch_osc),
+};
+
+#define BUILTIN_COUNT (sizeof(builtin) / sizeof(builtin[0]))
+
+static motion_segment_t user_seg[MS_USER_SLOTS][MS_MAX_SEGMENTS];
+static uint8_t user_count[MS_USER_SLOTS];
+
+static motion_table_t table_for_mode(uint8_t mode) {
+	motion_table_t t = { 0, 0 };
+	if (mode < BUILTIN_COUNT) {
+		t = builtin[mode];
+	} else if (mode >= MS_USER_MODE_BASE && mode < MS_USER_MODE_BASE + MS_USER_SLOTS) {
+		uint8_t slot = mode - MS_USER_MODE_BASE;
+		t.seg = user_seg[slot];
+		t.count = user_count[slot];
+	}
+	return t;
+}
+
+static int32_t sine_lookup(uint32_t phase) {
+	uint32_t idx = phase >> 24;
+	int32_t frac = (int32_t)((phase >> 8) & 0xFFFF);
+	int32_t a = sine_q15[idx];
+	int32_t b = sine_q15[(idx + 1) & 0xFF];
+	return a + (((b - a) * frac) >> 16);
+}
+
+static uint32_t phase_increment(const motion_segment_t *seg, float dt) {
+	if (seg->period_ms == 0 || dt <= 0.0f) {
+		return 0;
+	}
+	float cycles = dt * 1000.0f / (float)seg->period_ms;
+	if (cycles >= 1.0f) {
+		return 0;
+	}
+	return (uint32_t)(cycles * 4294967296.0f);
+}
 
 void motion_script_init(motion_script_t *s) {
-	s->t = 0.0f;
 	s->last_mode = 0;
+	motion_script_reset(s);
 }
 
 void motion_script_reset(motion_script_t *s) {
-	s->t = 0.0f;
+	s->seg_idx = 0;
+	s->seg_elapsed_us = 0;
+	s->phase = 0;
+	s->phase_inc = 0;
+	s->inc_dt = 0.0f;
 }
 
 void motion_script_step(motion_script_t *s, uint8_t mode, float dt,
@@ -17,101 +162,125 @@ void motion_script_step(motion_script_t *s, uint8_t mode, float dt,
 		motion_script_reset(s);
 		s->last_mode = mode;
 	}
+	*out_throttle = 0.0f;
+	*out_turn = 0.0f;
 	*out_target_pitch_rad = 0.0f;
 
-	if (mode == 1) {
-		// Circle: constant forward + constant turn.
-		*out_throttle = 0.3f;
-		*out_turn = 0.2f;
-	} else if (mode >= 2 && mode <= 4) {
-		// Figure-8 variants: constant forward, sinusoidal turn.
-		const float PI = 3.14159265f;
-		float period_s = 4.0f;
-		float turn_amp = 0.25f;
-		if (mode == 3) {
-			period_s = 6.0f;
-			turn_amp = 0.20f;
-		} else if (mode == 4) {
-			period_s = 3.0f;
-			turn_amp = 0.30f;
-		}
-		float phase = (2.0f * PI * s->t) / period_s;
-		*out_throttle = 0.3f;
-		*out_turn = turn_amp * sinf(phase);
-	} else if (mode == 5) {
-		// Spin in place: zero throttle, constant turn.
-		*out_throttle = 0.0f;
-		*out_turn = 0.35f;
-	} else if (mode == 6) {
-		// Stop-and-go: 1s forward, 1s stop.
-		const float period_s = 2.0f;
-		float phase = s->t;
-		while (phase >= period_s) {
-			phase -= period_s;
-		}
-		if (phase < 1.0f) {
-			*out_throttle = 0.3f;
-		} else {
-			*out_throttle = 0.0f;
+	motion_table_t t = table_for_mode(mode);
+	if (t.count == 0) {
+		return;
+	}
+	if (s->seg_idx >= t.count) {
+		s->seg_idx = 0;
+		s->seg_elapsed_us = 0;
+	}
+
+	// Advance past finished segments before sampling this tick.
+	const motion_segment_t *seg = &t.seg[s->seg_idx];
+	bool entered = false;
+	for (uint8_t n = 0; n < t.count; n++) {
+		uint32_t dur_us = (uint32_t)seg->duration_ms * 1000U;
+		if (dur_us == 0 || s->seg_elapsed_us < dur_us) {
+			break;
 		}
-		*out_turn = 0.0f;
-	} else if (mode == 7) {
-		// Square path: forward 1s, turn 0.5s, repeat.
-		const float period_s = 6.0f;
-		float phase = s->t;
-		while (phase >= period_s) {
-			phase -= period_s;
+		s->seg_elapsed_us -= dur_us;
+		s->seg_idx = (uint8_t)((s->seg_idx + 1) % t.count);
+		seg = &t.seg[s->seg_idx];
+		s->phase = 0;
+		entered = true;
+	}
+	if (entered || dt != s->inc_dt) {
+		s->phase_inc = phase_increment(seg, dt);
+		s->inc_dt = dt;
+	}
+
+	int32_t thr = seg->throttle;
+	int32_t turn = seg->turn;
+	int32_t pitch = seg->pitch_cdeg;
+	if (seg->period_ms > 0) {
+		int32_t sn = sine_lookup(s->phase);
+		thr += (seg->throttle_amp * sn) >> 15;
+		turn += (seg->turn_amp * sn) >> 15;
+		pitch += (seg->pitch_amp_cdeg * sn) >> 15;
+	}
+	*out_throttle = (float)thr * 0.001f;
+	*out_turn = (float)turn * 0.001f;
+	*out_target_pitch_rad = (float)pitch * (3.14159265f / 18000.0f);
+
+	if (dt > 0.0f) {
+		s->seg_elapsed_us += (uint32_t)(dt * 1000000.0f + 0.5f);
+		s->phase += s->phase_inc;
+	}
+}
+
+bool motion_script_upload(uint8_t slot, uint8_t index, const motion_segment_t *seg) {
+	if (slot >= MS_USER_SLOTS || index >= MS_MAX_SEGMENTS) {
+		return false;
+	}
+	if (index == 0) {
+		user_count[slot] = 0;
+	} else if (index != user_count[slot]) {
+		return false;
+	}
+	user_seg[slot][index] = *seg;
+	user_count[slot] = index + 1;
+	return true;
+}
+
+static bool parse_int(const char **p, int32_t *out) {
+	const char *s = *p;
+	int32_t sign = 1;
+	int32_t v = 0;
+	if (*s == '-') {
+		sign = -1;
+		s++;
+	}
+	if (*s < '0' || *s > '9') {
+		return false;
+	}
+	while (*s >= '0' && *s <= '9') {
+		v = v * 10 + (*s - '0');
+		if (v > 65535) {
+			return false;
 		}
-		if (phase < 1.0f) {
-			*out_throttle = 0.3f;
-			*out_turn = 0.0f;
-		} else if (phase < 1.5f) {
-			*out_throttle = 0.0f;
-			*out_turn = 0.35f;
-		} else if (phase < 2.5f) {
-			*out_throttle = 0.3f;
-			*out_turn = 0.0f;
-		} else if (phase < 3.0f) {
-			*out_throttle = 0.0f;
-			*out_turn = 0.35f;
-		} else if (phase < 4.0f) {
-			*out_throttle = 0.3f;
-			*out_turn = 0.0f;
-		} else if (phase < 4.5f) {
-			*out_throttle = 0.0f;
-			*out_turn = 0.35f;
-		} else if (phase < 5.5f) {
-			*out_throttle = 0.3f;
-			*out_turn = 0.0f;
-		} else {
-			*out_throttle = 0.0f;
-			*out_turn = 0.35f;
+		s++;
+	}
+	if (*s == ',') {
+		s++;
+	}
+	*p = s;
+	*out = sign * v;
+	return true;
+}
+
+bool motion_script_upload_line(const char *args) {
+	int32_t v[MS_UPLOAD_FIELDS];
+	for (int i = 0; i < MS_UPLOAD_FIELDS; i++) {
+		if (!parse_int(&args, &v[i])) {
+			return false;
 		}
-	} else if (mode == 8) {
-		// Slalom: forward with higher-amplitude sinusoidal turn.
-		const float PI = 3.14159265f;
-		const float period_s = 3.0f;
-		float phase = (2.0f * PI * s->t) / period_s;
-		*out_throttle = 0.3f;
-		*out_turn = 0.40f * sinf(phase);
-	} else if (mode == 9) {
-		// Balance challenge: hold +5 degrees.
-		*out_target_pitch_rad = 5.0f * (3.14159265f / 180.0f);
-	} else if (mode == 10) {
-		// Balance challenge: hold -5 degrees.
-		*out_target_pitch_rad = -5.0f * (3.14159265f / 180.0f);
-	} else if (mode == 11) {
-		// Balance challenge: slow oscillation +/-3 degrees.
-		const float PI = 3.14159265f;
-		const float period_s = 10.0f;
-		float phase = (2.0f * PI * s->t) / period_s;
-		*out_target_pitch_rad = (3.0f * (3.14159265f / 180.0f)) * sinf(phase);
-	} else {
-		*out_throttle = 0.0f;
-		*out_turn = 0.0f;
 	}
+	return motion_script_upload_values(v);
+}
 
-	if (dt > 0.0f) {
-		s->t += dt;
+bool motion_script_upload_values(const int32_t *v) {
+	if (v[0] < 0 || v[1] < 0 || v[2] < 0 || v[3] < 0) {
+		return false;
+	}
+	// Range-check before the uint8_t casts, or slot 256 would land on slot 0
+	if (v[0] >= MS_USER_SLOTS || v[1] >= MS_MAX_SEGMENTS) {
+		return false;
+	}
+	for (int i = 4; i < MS_UPLOAD_FIELDS; i++) {
+		if (v[i] < INT16_MIN || v[i] > INT16_MAX) {
+			return false;
+		}
 	}
+	motion_segment_t seg = {
+		(uint16_t)v[2], (uint16_t)v[3],
+		(int16_t)v[4], (int16_t)v[5],
+		(int16_t)v[6], (int16_t)v[7],
+		(int16_t)v[8], (int16_t)v[9],
+	};
+	return motion_script_upload((uint8_t)v[0], (uint8_t)v[1], &seg);
 }
@@ -1,20 +1,56 @@
 #ifndef MOTION_SCRIPT_H
 #define MOTION_SCRIPT_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+// A motion script is a table of segments played in order and looped.
+// Each channel is base + amp * sin(phase); the phase is a 32-bit NCO that
+// restarts at zero on every segment, so 2^32 counts = one waveform period.
+#define MS_MAX_SEGMENTS   16
+#define MS_USER_SLOTS     4
+#define MS_USER_MODE_BASE 12  // modes 12..15 play uploaded slots 0..3
+
+typedef struct {
+	uint16_t duration_ms;     // 0 = hold this segment forever
+	uint16_t period_ms;       // waveform period, 0 = constant outputs
+	int16_t throttle;         // permille of full throttle
+	int16_t throttle_amp;
+	int16_t turn;             // permille of full turn
+	int16_t turn_amp;
+	int16_t pitch_cdeg;       // target pitch, centidegrees
+	int16_t pitch_amp_cdeg;
+} motion_segment_t;
+
 typedef struct {
-	float t;
 	uint8_t last_mode;
+	uint8_t seg_idx;
+	uint32_t seg_elapsed_us;
+	uint32_t phase;
+	uint32_t phase_inc;
+	float inc_dt;             // dt that phase_inc was computed for
 } motion_script_t;
 
 void motion_script_init(motion_script_t *s);
 void motion_script_reset(motion_script_t *s);
 
 // mode: 0 = manual, 1 = circle, 2-4 = figure-8 variants, 5 = spin,
-// 6 = stop-and-go, 7 = square, 8 = slalom, 9-11 = balance challenge
+// 6 = stop-and-go, 7 = square, 8 = slalom, 9-11 = balance challenge,
+// 12-15 = uploaded scripts
 void motion_script_step(motion_script_t *s, uint8_t mode, float dt,
 						float *out_throttle, float *out_turn,
 						float *out_target_pitch_rad);
 
+// Store one segment of an uploaded script. Index 0 starts a new script;
+// later indices must follow in order. Returns false on a bad slot/index.
+bool motion_script_upload(uint8_t slot, uint8_t index, const motion_segment_t *seg);
+
+// Parse "slot,index,dur_ms,period_ms,thr,thr_amp,turn,turn_amp,pitch,pitch_amp"
+// (the payload of an XBee "MS:" line) and upload it.
+#define MS_UPLOAD_FIELDS 10
+bool motion_script_upload_line(const char *args);
+
+// Same, from the ten fields already parsed into integers
+bool motion_script_upload_values(const int32_t *v);
+
 #endif
@@ -0,0 +1,33 @@
+#include "nvm.h"
+
+static void nvm_command(uint32_t addr, uint8_t cmd) {
+    NVMCTRL->ADDR = addr;
+    NVMCTRL->CTRLB = NVMCTRL_CTRLB_CMDEX | cmd;
+}
+
+void nvm_init(void) {
+    NVMCTRL->CTRLA = (NVMCTRL->CTRLA & ~NVMCTRL_CTRLA_WMODE_MASK) | NVMCTRL_CTRLA_WMODE_MAN;
+    NVMCTRL->INTFLAG = NVMCTRL_INTFLAG_DONE | NVMCTRL_INTFLAG_ERRORS;
+}
+
+void nvm_erase_block(uint32_t addr) {
+    nvm_command(addr & ~(uint32_t)(NVM_BLOCK_SIZE - 1), NVMCTRL_CMD_EB);
+}
+
+void nvm_write_page(uint32_t addr, const uint32_t *data) {
+    nvm_command(addr, NVMCTRL_CMD_PBC);
+    while (!nvm_ready()) {
+    }
+    // Writes to the flash address space land in the page buffer
+    volatile uint32_t *dst = (volatile uint32_t *)addr;
+    for (uint32_t i = 0; i < NVM_PAGE_SIZE / 4; i++) {
+        dst[i] = data[i];
+    }
+    nvm_command(addr, NVMCTRL_CMD_WP);
+}
+
+bool nvm_error(void) {
+    uint16_t flags = NVMCTRL->INTFLAG & NVMCTRL_INTFLAG_ERRORS;
+    NVMCTRL->INTFLAG = flags;
+    return flags != 0;
+}
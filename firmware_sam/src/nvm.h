@@ -0,0 +1,30 @@
+#ifndef NVM_H
+#define NVM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "same51.h"
+
+// Flash programming through NVMCTRL in manual write mode. Operations only
+// start a command; poll nvm_ready() before the next one. Bank B
+// (0x80000..0xFFFFF) can be programmed while code runs from bank A.
+// The CMCC caches flash reads: call cmcc_invalidate() once a command is
+// done before reading the area back.
+
+void nvm_init(void);
+
+static inline bool nvm_ready(void) {
+    return (NVMCTRL->STATUS & NVMCTRL_STATUS_READY) != 0;
+}
+
+// Start erasing the NVM_BLOCK_SIZE block containing addr
+void nvm_erase_block(uint32_t addr);
+
+// Fill the page buffer with NVM_PAGE_SIZE bytes and start the page write.
+// addr must be page aligned and the page erased.
+void nvm_write_page(uint32_t addr, const uint32_t *data);
+
+// True if a command since the last call failed (lock, address, program)
+bool nvm_error(void);
+
+#endif
@@ -0,0 +1,83 @@
+#include "perf.h"
+
+#ifdef PERF_HOST
+uint32_t perf_host_cycles = 0;
+#endif
+
+static perf_slot_t slots[PERF_COUNT];
+static uint32_t window_start = 0;
+
+static const char *const slot_names[PERF_COUNT] = {
+    "imu",
+    "attitude",
+    "pid",
+    "rc",
+    "telemetry",
+    "loop",
+    "step",
+};
+
+void perf_reset(void) {
+    for (int i = 0; i < PERF_COUNT; i++) {
+        slots[i].min = UINT32_MAX;
+        slots[i].max = 0;
+        slots[i].sum = 0;
+        slots[i].count = 0;
+        slots[i].overruns = 0;
+    }
+    window_start = perf_cycles();
+}
+
+void perf_set_budget(perf_id_t id, uint32_t cycles) {
+    slots[id].budget = cycles;
+}
+
+void perf_record(perf_id_t id, uint32_t cycles) {
+    perf_slot_t *s = &slots[id];
+    if (cycles < s->min) s->min = cycles;
+    if (cycles > s->max) s->max = cycles;
+    s->sum += cycles;
+    s->count++;
+    if (s->budget != 0 && cycles > s->budget) {
+        s->overruns++;
+    }
+}
+
+const perf_slot_t *perf_slot(perf_id_t id) {
+    return &slots[id];
+}
+
+void perf_write_u32(void (*write_str)(const char *s), uint32_t v) {
+    char buf[11];
+    int i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    do {
+        buf[--i] = (char)('0' + (v % 10));
+        v /= 10;
+    } while (v > 0);
+    write_str(&buf[i]);
+}
+
+void perf_dump(void (*write_str)(const char *s)) {
+    uint32_t elapsed = perf_cycles() - window_start;
+    for (int i = 0; i < PERF_COUNT; i++) {
+        const perf_slot_t *s = &slots[i];
+        uint32_t avg = s->count ? (uint32_t)(s->sum / s->count) : 0;
+        uint32_t load = elapsed ? (uint32_t)((s->sum * 1000U) / elapsed) : 0;
+        write_str("PERF ");
+        write_str(slot_names[i]);
+        write_str(" n=");
+        perf_write_u32(write_str, s->count);
+        write_str(" min=");
+        perf_write_u32(write_str, s->count ? s->min : 0);
+        write_str(" avg=");
+        perf_write_u32(write_str, avg);
+        write_str(" max=");
+        perf_write_u32(write_str, s->max);
+        write_str(" ovr=");
+        perf_write_u32(write_str, s->overruns);
+        write_str(" load=");
+        perf_write_u32(write_str, load);
+        write_str("\r\n");
+    }
+}
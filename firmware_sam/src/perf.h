@@ -0,0 +1,65 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+// Cycle-count profiling. Each slot keeps min/avg/max cycles per call and
+// counts calls over its budget. On target the stamps come from the DWT
+// cycle counter; host builds (-DPERF_HOST) read perf_host_cycles instead,
+// which firmware/tools/perf_test.c advances by hand (make perf-test).
+
+typedef enum {
+    PERF_IMU_READ = 0,
+    PERF_ATTITUDE,
+    PERF_PID,
+    PERF_RC_POLL,
+    PERF_TELEMETRY,
+    PERF_LOOP,
+    PERF_STEP_ISR,
+    PERF_COUNT
+} perf_id_t;
+
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t count;
+    uint32_t budget;    // cycles, 0 = no overrun check
+    uint32_t overruns;
+} perf_slot_t;
+
+#ifdef PERF_HOST
+extern uint32_t perf_host_cycles;
+static inline uint32_t perf_cycles(void) {
+    return perf_host_cycles;
+}
+#else
+#include "same51.h"
+static inline uint32_t perf_cycles(void) {
+    return dwt_cycles();
+}
+#endif
+
+void perf_reset(void);
+void perf_set_budget(perf_id_t id, uint32_t cycles);
+void perf_record(perf_id_t id, uint32_t cycles);
+const perf_slot_t *perf_slot(perf_id_t id);
+
+static inline uint32_t perf_begin(void) {
+    return perf_cycles();
+}
+
+static inline void perf_end(perf_id_t id, uint32_t start) {
+    perf_record(id, perf_cycles() - start);
+}
+
+// Write one "PERF <name> n= min= avg= max= ovr= load=" line per slot.
+// load is per-mille of the cycles elapsed since perf_reset(). The 32-bit
+// window wraps after 2^32 cycles (~36 s at 120 MHz), so callers reset
+// after each dump.
+void perf_dump(void (*write_str)(const char *s));
+
+// Decimal formatter shared by the dump helpers.
+void perf_write_u32(void (*write_str)(const char *s), uint32_t v);
+
+#endif
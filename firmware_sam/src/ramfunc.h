@@ -0,0 +1,15 @@
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+// Hot-path functions marked RAMFUNC run from SRAM: no flash wait states
+// and no cache misses. The linker script places .ramfunc in .data, so
+// startup.c copies it with the initialised data. long_call because SRAM
+// is out of BL range from flash. Empty in host builds and with
+// -DRAMFUNC_DISABLE (make RAMFUNC=0).
+#if defined(__arm__) && !defined(RAMFUNC_DISABLE)
+#define RAMFUNC __attribute__((section(".ramfunc"), long_call, noinline))
+#else
+#define RAMFUNC
+#endif
+
+#endif
@@ -1,115 +1,478 @@
 #include "rc_input.h"
 
-#include <stdlib.h>
-#include <string.h>
-
+#include "channels.h"
+#include "motion_script.h"
 #include "sercom_uart.h"
+#include "telemetry.h"
+
+// Parser states
+#define RC_PS_START   0
+#define RC_PS_KEYWORD 1
+#define RC_PS_NUMBER  2
+#define RC_PS_SKIP    3  // bad byte seen, drop the rest of the line
+#define RC_PS_FRAME   4  // collecting a binary frame up to the next 0x00
+
+// Keywords, matched a byte at a time. Ones ending in ':' take numbers.
+#define RC_KW_ARM      0
+#define RC_KW_DISARM   1
+#define RC_KW_MODE     2
+#define RC_KW_PERF     3
+#define RC_KW_BB       4
+#define RC_KW_BB_FLASH 5
+#define RC_KW_BB_SAVE  6
+#define RC_KW_BB_REARM 7
+#define RC_KW_MS       8
+#define RC_KW_SUB      9
+#define RC_KW_BW       10
+#define RC_KW_CH       11
+#define RC_KW_BENCH    12
+#define RC_KW_UPDATE   13
+#define RC_KW_COUNT    14
+#define RC_KW_NONE     0xFF
+
+static const char *const keywords[RC_KW_COUNT] = {
+    "ARM", "DISARM", "MODE:", "PERF", "BB", "BB:FLASH", "BB:SAVE", "BB:REARM", "MS:",
+    "SUB:", "BW:", "CH", "BENCH", "UPDATE",
+};
+
+#define RC_KW_ALL ((uint16_t)((1u << RC_KW_COUNT) - 1))
+
+// Number flags
+#define RC_NUM_DIGITS 0x01
+#define RC_NUM_NEG    0x02
+#define RC_NUM_SIGN   0x04
+#define RC_NUM_DOT    0x08
+
+static const int16_t frac_weight[3] = {100, 10, 1};
+
+static void reset_number(rc_parser_t *p) {
+    p->num_flags = 0;
+    p->num_int = 0;
+    p->num_frac = 0;
+    p->num_fdigits = 0;
+}
+
+static void reset_line(rc_parser_t *p) {
+    p->state = RC_PS_START;
+    p->cmd = RC_KW_NONE;
+    p->kw_len = 0;
+    p->kw_cand = RC_KW_ALL;
+    p->nfields = 0;
+    reset_number(p);
+}
 
 void rc_init(rc_parser_t *p) {
-    p->idx = 0;
+    reset_line(p);
+    p->frame_len = 0;
+    p->link.frames = 0;
+    p->link.lost = 0;
+    p->link.late = 0;
+    p->link.bad = 0;
+    p->link.rtt_sum_us = 0;
+    p->link.rtt_max_us = 0;
+    p->link.rtt_count = 0;
+    p->link.last_seq = 0;
+    p->link.synced = false;
+    p->binary = false;
+    p->perf_request = false;
+    p->bench_request = false;
+    p->update_request = false;
+    p->bb_request = RC_BB_NONE;
     p->last.throttle = 0.0f;
     p->last.turn = 0.0f;
     p->last.enabled = false;
     p->last.mode = 0;
 }
 
-static float clamp_unit(float v) {
-    if (v > 1.0f) {
-        return 1.0f;
+static bool is_digit(uint8_t b) {
+    return b >= '0' && b <= '9';
+}
+
+static bool is_number_start(uint8_t b) {
+    return is_digit(b) || b == '-' || b == '+' || b == '.';
+}
+
+static bool is_keyword_char(uint8_t b) {
+    return (b >= 'A' && b <= 'Z') || b == ':';
+}
+
+// Keyword that ends exactly at the bytes seen so far
+static uint8_t keyword_match(const rc_parser_t *p) {
+    for (uint8_t i = 0; i < RC_KW_COUNT; i++) {
+        if ((p->kw_cand & (1u << i)) && keywords[i][p->kw_len] == '\0') {
+            return i;
+        }
     }
-    if (v < -1.0f) {
-        return -1.0f;
+    return RC_KW_NONE;
+}
+
+static bool keyword_byte(rc_parser_t *p, uint8_t b) {
+    for (uint8_t i = 0; i < RC_KW_COUNT; i++) {
+        if ((p->kw_cand & (1u << i)) && (uint8_t)keywords[i][p->kw_len] != b) {
+            p->kw_cand &= (uint16_t)~(1u << i);
+        }
     }
-    return v;
+    p->kw_len++;
+    return p->kw_cand != 0;
 }
 
-static bool parse_line(const char *line, rc_cmd_t *out) {
-    // Expected format: "throttle,turn,enable[,mode]"
-    // Example: "0.10,-0.25,1,1"
-    char tmp[64];
-    strncpy(tmp, line, sizeof(tmp) - 1);
-    tmp[sizeof(tmp) - 1] = '\0';
+// Store the number just finished. Numeric lines keep thousandths, keyword
+// arguments are plain integers.
+static bool end_field(rc_parser_t *p) {
+    if (!(p->num_flags & RC_NUM_DIGITS) || p->nfields >= RC_MAX_FIELDS) {
+        return false;
+    }
+    int32_t v;
+    if (p->cmd == RC_KW_NONE) {
+        v = p->num_int * RC_FIX_ONE + p->num_frac;
+    } else {
+        if (p->num_flags & RC_NUM_DOT) {
+            return false;
+        }
+        v = p->num_int;
+    }
+    p->field[p->nfields++] = (p->num_flags & RC_NUM_NEG) ? -v : v;
+    reset_number(p);
+    return true;
+}
 
-    char *save = NULL;
-    char *tok = strtok_r(tmp, ",", &save);
-    float vals[4];
-    int count = 0;
-    while (tok && count < 4) {
-        vals[count++] = strtof(tok, NULL);
-        tok = strtok_r(NULL, ",", &save);
+static bool number_byte(rc_parser_t *p, uint8_t b) {
+    if (is_digit(b)) {
+        uint8_t d = (uint8_t)(b - '0');
+        if (p->num_flags & RC_NUM_DOT) {
+            // Digits past the third decimal are dropped
+            if (p->num_fdigits < 3) {
+                p->num_frac = (int16_t)(p->num_frac + d * frac_weight[p->num_fdigits++]);
+            }
+        } else {
+            p->num_int = p->num_int * 10 + d;
+            if (p->num_int > RC_MAX_INT) {
+                return false;
+            }
+        }
+        p->num_flags |= RC_NUM_DIGITS;
+        return true;
     }
-    if (count < 3) {
+    switch (b) {
+    case '-':
+    case '+':
+        if (p->num_flags) {
+            return false;
+        }
+        p->num_flags = (b == '-') ? (RC_NUM_SIGN | RC_NUM_NEG) : RC_NUM_SIGN;
+        return true;
+    case '.':
+        if (p->num_flags & RC_NUM_DOT) {
+            return false;
+        }
+        p->num_flags |= RC_NUM_DOT;
+        return true;
+    case ',':
+        return end_field(p);
+    default:
+        return false;
+    }
+}
+
+static float fix_to_unit(int32_t v) {
+    if (v > RC_FIX_ONE) {
+        v = RC_FIX_ONE;
+    }
+    if (v < -RC_FIX_ONE) {
+        v = -RC_FIX_ONE;
+    }
+    return (float)v * (1.0f / RC_FIX_ONE);
+}
+
+static uint8_t clamp_mode(int32_t mode) {
+    if (mode < 0) {
+        return 0;
+    }
+    if (mode > 255) {
+        return 255;
+    }
+    return (uint8_t)mode;
+}
+
+// "throttle,turn,enable[,mode]", e.g. "0.10,-0.25,1,1"
+static bool apply_numeric(rc_parser_t *p) {
+    if (p->nfields < 3 || p->nfields > 4) {
         return false;
     }
-    out->throttle = clamp_unit(vals[0]);
-    out->turn = clamp_unit(vals[1]);
-    out->enabled = (vals[2] != 0.0f);
-    if (count >= 4) {
-        int mode = (int)vals[3];
-        if (mode < 0) {
-            mode = 0;
+    p->last.throttle = fix_to_unit(p->field[0]);
+    p->last.turn = fix_to_unit(p->field[1]);
+    p->last.enabled = (p->field[2] != 0);
+    p->last.mode = (p->nfields == 4) ? clamp_mode(p->field[3] / RC_FIX_ONE) : 0;
+    return true;
+}
+
+static bool apply_keyword(rc_parser_t *p) {
+    switch (p->cmd) {
+    case RC_KW_ARM:
+        p->last.enabled = true;
+        return true;
+    case RC_KW_DISARM:
+        p->last.enabled = false;
+        return true;
+    case RC_KW_MODE:
+        if (p->nfields != 1) {
+            return false;
+        }
+        p->last.mode = clamp_mode(p->field[0]);
+        return true;
+    case RC_KW_PERF:
+        p->perf_request = true;
+        return false;
+    case RC_KW_BB:
+        p->bb_request = RC_BB_DUMP;
+        return false;
+    case RC_KW_BB_FLASH:
+        p->bb_request = RC_BB_DUMP_FLASH;
+        return false;
+    case RC_KW_BB_SAVE:
+        p->bb_request = RC_BB_SAVE;
+        return false;
+    case RC_KW_BB_REARM:
+        p->bb_request = RC_BB_REARM;
+        return false;
+    case RC_KW_MS: {
+        // Motion script upload: one segment per line
+        bool ok = p->nfields == MS_UPLOAD_FIELDS && motion_script_upload_values(p->field);
+        uart_write_str(ok ? "MS OK\r\n" : "MS ERR\r\n");
+        return false;
+    }
+    case RC_KW_SUB:
+        // Telemetry subscription: channel id and rate, 0 Hz unsubscribes
+        // Bounds are checked here, not left to the field cap, before narrowing
+        if (p->nfields != 2 || p->field[0] < 0 || p->field[0] >= CHAN_MAX ||
+            p->field[1] < 0 || p->field[1] > UINT16_MAX ||
+            !chan_subscribe((uint8_t)p->field[0], (uint16_t)p->field[1])) {
+            uart_write_str("SUB ERR\r\n");
         }
-        if (mode > 255) {
-            mode = 255;
+        return false;
+    case RC_KW_BW:
+        // Link budget in bytes/s
+        if (p->nfields == 1 && p->field[0] > 0 && p->field[0] <= UINT16_MAX) {
+            chan_set_budget((uint32_t)p->field[0]);
+        } else {
+            uart_write_str("BW ERR\r\n");
         }
-        out->mode = (uint8_t)mode;
+        return false;
+    case RC_KW_CH:
+        chan_list();
+        return false;
+    case RC_KW_BENCH:
+        p->bench_request = true;
+        return false;
+    case RC_KW_UPDATE:
+        p->update_request = true;
+        return false;
+    default:
+        return false;
+    }
+}
+
+static uint16_t get_u16(const uint8_t *b) {
+    return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *b) {
+    return (uint32_t)get_u16(b) | ((uint32_t)get_u16(b + 2) << 16);
+}
+
+// Decode p->frame in place; returns the raw length or 0 if malformed
+static uint8_t cobs_decode(rc_parser_t *p) {
+    uint8_t in = 0;
+    uint8_t out = 0;
+    while (in < p->frame_len) {
+        uint8_t code = p->frame[in];
+        if (code == 0 || in + code > p->frame_len) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            p->frame[out++] = p->frame[in + i];
+        }
+        in = (uint8_t)(in + code);
+        if (code < 0xFF && in < p->frame_len) {
+            p->frame[out++] = 0;
+        }
+    }
+    return out;
+}
+
+// Count the seq against the newest one seen. Returns false for a late
+// (reordered or repeated) command, which must not override a newer one.
+static bool track_seq(rc_link_t *l, uint16_t seq) {
+    int16_t gap = (int16_t)(seq - (uint16_t)(l->last_seq + 1));
+    if (!l->synced || gap > RC_SEQ_RESYNC || gap < -RC_SEQ_RESYNC) {
+        l->synced = true;
+    } else if (gap < 0) {
+        l->late++;
+        if (l->lost > 0) {
+            l->lost--;
+        }
+        return false;
     } else {
-        out->mode = 0;
+        l->lost += (uint32_t)gap;
+    }
+    l->last_seq = seq;
+    return true;
+}
+
+static void send_ack(uint16_t seq, uint32_t host_us, uint32_t now) {
+    telem_frame_t f;
+    uint8_t out[TELEM_MAX_FRAME];
+    telem_begin(&f, TELEM_TYPE_RC_ACK);
+    telem_put_u16(&f, seq);
+    telem_put_u32(&f, host_us);
+    telem_put_u32(&f, now);
+    uart_write(out, telem_finish(&f, out));
+}
+
+static bool end_frame(rc_parser_t *p, uint32_t now) {
+    uint8_t len = cobs_decode(p);
+    const uint8_t *raw = p->frame;
+    if (len != 3 + RC_CMD_PAYLOAD + 2 || raw[2] != TELEM_TYPE_RC_CMD ||
+        telem_crc16(raw, (uint16_t)(len - 2)) != get_u16(raw + len - 2)) {
+        p->link.bad++;
+        return false;
+    }
+    uint16_t seq = get_u16(raw);
+    const uint8_t *c = raw + 3;
+    uint32_t host_us = get_u32(c);
+    uint32_t echo_tick = get_u32(c + 4);
+    uint32_t echo_hold_us = get_u32(c + 8);
+    send_ack(seq, host_us, now);
+    p->link.frames++;
+
+    // RTT from the newest ack the host has seen, less its hold time
+    if (echo_tick != 0) {
+        uint32_t since_us = (now - echo_tick) * (1000000UL / RC_TICK_HZ);
+        uint32_t rtt_us = (since_us > echo_hold_us) ? since_us - echo_hold_us : 0;
+        p->link.rtt_sum_us += rtt_us;
+        p->link.rtt_count++;
+        if (rtt_us > p->link.rtt_max_us) {
+            p->link.rtt_max_us = rtt_us;
+        }
     }
+
+    if (!track_seq(&p->link, seq)) {
+        return false;
+    }
+    p->last.throttle = fix_to_unit((int16_t)get_u16(c + 12));
+    p->last.turn = fix_to_unit((int16_t)get_u16(c + 14));
+    p->last.enabled = (c[16] & RC_CMD_ENABLED) != 0;
+    p->last.mode = c[17];
+    p->binary = true;
     return true;
 }
 
-bool rc_poll(rc_parser_t *p, rc_cmd_t *out) {
+static bool end_line(rc_parser_t *p) {
+    bool updated = false;
+    switch (p->state) {
+    case RC_PS_KEYWORD:
+        p->cmd = keyword_match(p);
+        updated = apply_keyword(p);
+        break;
+    case RC_PS_NUMBER:
+        if (!end_field(p)) {
+            p->nfields = 0;
+        }
+        updated = (p->cmd == RC_KW_NONE) ? apply_numeric(p) : apply_keyword(p);
+        break;
+    case RC_PS_SKIP:
+        if (p->cmd == RC_KW_MS) {
+            uart_write_str("MS ERR\r\n");
+        }
+        break;
+    default:
+        break;
+    }
+    reset_line(p);
+    if (updated) {
+        p->binary = false;
+    }
+    return updated;
+}
+
+bool rc_feed(rc_parser_t *p, uint8_t b, uint32_t now) {
+    // 0x00 opens and closes a frame; it never occurs in a line or inside
+    // a COBS-encoded frame
+    if (b == 0) {
+        bool updated = false;
+        if (p->state == RC_PS_FRAME && p->frame_len > 0) {
+            updated = end_frame(p, now);
+            reset_line(p);
+        } else {
+            reset_line(p);
+            p->state = RC_PS_FRAME;
+        }
+        p->frame_len = 0;
+        return updated;
+    }
+    if (p->state == RC_PS_FRAME) {
+        if (p->frame_len < RC_FRAME_MAX) {
+            p->frame[p->frame_len++] = b;
+        } else {
+            p->link.bad++;
+            p->frame_len = 0;
+            reset_line(p);
+        }
+        return false;
+    }
+    if (b == '\n' || b == '\r') {
+        return end_line(p);
+    }
+    if (b == ' ' || b == '\t') {
+        return false;
+    }
+    bool ok = true;
+    switch (p->state) {
+    case RC_PS_START:
+        if (is_number_start(b)) {
+            p->state = RC_PS_NUMBER;
+            ok = number_byte(p, b);
+        } else if (is_keyword_char(b)) {
+            p->state = RC_PS_KEYWORD;
+            ok = keyword_byte(p, b);
+        } else {
+            ok = false;
+        }
+        break;
+    case RC_PS_KEYWORD:
+        if (is_number_start(b)) {
+            // Arguments follow a complete "XXX:" keyword
+            p->cmd = keyword_match(p);
+            ok = (p->cmd == RC_KW_MODE || p->cmd == RC_KW_MS ||
+                  p->cmd == RC_KW_SUB || p->cmd == RC_KW_BW);
+            if (ok) {
+                p->state = RC_PS_NUMBER;
+                ok = number_byte(p, b);
+            }
+        } else {
+            ok = is_keyword_char(b) && keyword_byte(p, b);
+        }
+        break;
+    case RC_PS_NUMBER:
+        ok = number_byte(p, b);
+        break;
+    default:
+        break;
+    }
+    if (!ok) {
+        p->state = RC_PS_SKIP;
+    }
+    return false;
+}
+
+bool rc_poll(rc_parser_t *p, rc_cmd_t *out, uint32_t now) {
     uint8_t b;
     while (uart_read_byte(&b)) {
-        if (b == '\n' || b == '\r') {
-            if (p->idx == 0) {
-                continue;
-            }
-            p->buf[p->idx] = '\0';
-            p->idx = 0;
-            if (strcmp(p->buf, "ARM") == 0) {
-                p->last.enabled = true;
-                if (out) {
-                    *out = p->last;
-                }
-                return true;
-            }
-            if (strcmp(p->buf, "DISARM") == 0) {
-                p->last.enabled = false;
-                if (out) {
-                    *out = p->last;
-                }
-                return true;
-            }
-            if (strncmp(p->buf, "MODE:", 5) == 0) {
-                int mode = (int)strtol(p->buf + 5, NULL, 10);
-                if (mode < 0) {
-                    mode = 0;
-                }
-                if (mode > 255) {
-                    mode = 255;
-                }
-                p->last.mode = (uint8_t)mode;
-                if (out) {
-                    *out = p->last;
-                }
-                return true;
+        if (rc_feed(p, b, now)) {
+            if (out) {
+                *out = p->last;
             }
-            rc_cmd_t parsed;
-            if (parse_line(p->buf, &parsed)) {
-                p->last = parsed;
-                if (out) {
-                    *out = parsed;
-                }
-                return true;
-            }
-            return false;
-        }
-        if (p->idx < sizeof(p->buf) - 1) {
-            p->buf[p->idx++] = (char)b;
-        } else {
-            p->idx = 0;
+            return true;
         }
     }
     return false;
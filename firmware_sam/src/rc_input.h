@@ -11,13 +11,75 @@ typedef struct {
     uint8_t mode;
 } rc_cmd_t;
 
+// Numbers are parsed as they arrive into fixed-point thousandths, so a
+// line is handled without buffering it and without strtof/strtol.
+#define RC_FIX_ONE     1000
+#define RC_MAX_FIELDS  10     // MS: segments are the longest command
+#define RC_MAX_INT     65535  // largest integer part accepted per field
+
+// Binary commands arrive as telemetry-style frames between 0x00 bytes
+// (TELEM_TYPE_RC_CMD, see telemetry.h), interleaved with ASCII lines:
+//   host_us u32 | echo_tick u32 | echo_hold_us u32 |
+//   throttle i16 | turn i16 | flags u8 | mode u8
+// throttle and turn are permille, flags bit 0 = enabled. The frame seq
+// numbers the commands. Each one is answered with a TELEM_TYPE_RC_ACK
+//   cmd_seq u16 | host_us u32 | tick u32
+// echo_tick is the tick of the newest ack the host has seen and
+// echo_hold_us how long the host held it, which gives the robot the RTT.
+#define RC_FRAME_MAX      32
+#define RC_CMD_PAYLOAD    18
+#define RC_CMD_ENABLED    0x01
+#define RC_SEQ_RESYNC     1000  // a seq jump larger than this restarts counting
+#define RC_TICK_HZ        1000  // rate of the tick count passed to rc_poll
+
 typedef struct {
-    char buf[64];
-    unsigned int idx;
+    uint32_t frames;        // valid commands
+    uint32_t lost;          // gaps in seq, less late arrivals
+    uint32_t late;          // older than the newest seq (reordered or duplicate)
+    uint32_t bad;           // CRC, COBS or length errors
+    uint32_t rtt_sum_us;    // window since the caller last cleared it
+    uint32_t rtt_max_us;
+    uint32_t rtt_count;
+    uint16_t last_seq;
+    bool synced;
+} rc_link_t;
+
+typedef struct {
+    uint8_t state;      // RC_PS_*
+    uint8_t cmd;        // matched keyword, RC_KW_NONE for a numeric line
+    uint8_t kw_len;
+    uint16_t kw_cand;   // keywords still matching the bytes seen so far
+    uint8_t nfields;
+    uint8_t num_flags;
+    int32_t num_int;
+    int16_t num_frac;   // thousandths
+    uint8_t num_fdigits;
+    int32_t field[RC_MAX_FIELDS];
+    uint8_t frame[RC_FRAME_MAX];
+    uint8_t frame_len;
+    rc_link_t link;
+    bool binary;        // last command came in a frame
     rc_cmd_t last;
+    bool perf_request;  // set by a "PERF" line, cleared by the caller
+    bool bench_request; // set by a "BENCH" line, cleared by the caller
+    bool update_request; // set by an "UPDATE" line (enter the bootloader)
+    uint8_t bb_request; // RC_BB_* from a "BB..." line, cleared by the caller
 } rc_parser_t;
 
+// Blackbox commands
+#define RC_BB_NONE       0
+#define RC_BB_DUMP       1  // "BB": freeze and stream the SRAM copy
+#define RC_BB_DUMP_FLASH 2  // "BB:FLASH": stream the copy saved in flash
+#define RC_BB_SAVE       3  // "BB:SAVE": write the frozen SRAM copy to flash
+#define RC_BB_REARM      4  // "BB:REARM": clear and record again
+
 void rc_init(rc_parser_t *p);
-bool rc_poll(rc_parser_t *p, rc_cmd_t *out);
+// Parse buffered XBee bytes (queued by the UART RX interrupt) up to the
+// first complete command. now is the control tick count stamped into
+// acks. Returns true if *out was updated.
+bool rc_poll(rc_parser_t *p, rc_cmd_t *out, uint32_t now);
+// Feed one byte. Returns true when it completed a command that updated
+// p->last (a binary command, throttle line, ARM, DISARM or MODE:).
+bool rc_feed(rc_parser_t *p, uint8_t b, uint32_t now);
 
 #endif
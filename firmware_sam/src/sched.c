@@ -0,0 +1,115 @@
+#include "sched.h"
+
+#include "perf.h"
+
+static task_t *task_table = 0;
+static uint8_t task_count = 0;
+static uint32_t (*tick_now)(void) = 0;
+static uint64_t idle_cycles = 0;
+static uint32_t window_start = 0;
+
+static void reset_accounting(void) {
+    for (uint8_t i = 0; i < task_count; i++) {
+        task_table[i].runs = 0;
+        task_table[i].misses = 0;
+        task_table[i].skips = 0;
+        task_table[i].max_cycles = 0;
+        task_table[i].cycles = 0;
+    }
+    idle_cycles = 0;
+    window_start = perf_cycles();
+}
+
+void sched_init(task_t *tasks, uint8_t count, uint32_t (*now)(void)) {
+    task_table = tasks;
+    task_count = count;
+    tick_now = now;
+    // First releases land on the next tick
+    uint32_t t = now() + 1;
+    for (uint8_t i = 0; i < count; i++) {
+        tasks[i].release = t;
+    }
+    reset_accounting();
+}
+
+bool sched_dispatch(void) {
+    uint32_t now = tick_now();
+    task_t *next = 0;
+    for (uint8_t i = 0; i < task_count; i++) {
+        task_t *t = &task_table[i];
+        if ((int32_t)(now - t->release) < 0) {
+            continue;
+        }
+        if (!next || t->priority < next->priority) {
+            next = t;
+        }
+    }
+    if (!next) {
+        return false;
+    }
+
+    // Drop releases that are already a full period stale
+    uint32_t late = now - next->release;
+    if (late >= next->period) {
+        uint32_t n = late / next->period;
+        next->skips += n;
+        next->release += n * next->period;
+    }
+    uint32_t release = next->release;
+    next->release += next->period;
+
+    uint32_t start = perf_cycles();
+    next->run();
+    uint32_t cycles = perf_cycles() - start;
+
+    next->runs++;
+    next->cycles += cycles;
+    if (cycles > next->max_cycles) {
+        next->max_cycles = cycles;
+    }
+    if ((int32_t)(tick_now() - (release + next->deadline)) >= 0) {
+        next->misses++;
+    }
+    return true;
+}
+
+void sched_idle(void) {
+    uint32_t tick = tick_now();
+    uint32_t start = perf_cycles();
+    // Mask interrupts so an edge between the check and WFI still wakes us
+    __asm__ volatile ("cpsid i" ::: "memory");
+    if (tick_now() == tick) {
+        __asm__ volatile ("wfi");
+    }
+    __asm__ volatile ("cpsie i" ::: "memory");
+    idle_cycles += perf_cycles() - start;
+}
+
+static void dump_line(void (*write_str)(const char *s), const char *name,
+                      uint32_t runs, uint32_t misses, uint32_t skips,
+                      uint32_t max_cycles, uint64_t cycles, uint32_t elapsed) {
+    write_str("TASK ");
+    write_str(name);
+    write_str(" n=");
+    perf_write_u32(write_str, runs);
+    write_str(" miss=");
+    perf_write_u32(write_str, misses);
+    write_str(" skip=");
+    perf_write_u32(write_str, skips);
+    write_str(" max=");
+    perf_write_u32(write_str, max_cycles);
+    write_str(" load=");
+    perf_write_u32(write_str, elapsed ? (uint32_t)((cycles * 1000U) / elapsed) : 0);
+    write_str("\r\n");
+}
+
+void sched_dump(void (*write_str)(const char *s)) {
+    uint32_t elapsed = perf_cycles() - window_start;
+    for (uint8_t i = 0; i < task_count; i++) {
+        const task_t *t = &task_table[i];
+        dump_line(write_str, t->name, t->runs, t->misses, t->skips,
+                  t->max_cycles, t->cycles, elapsed);
+    }
+    dump_line(write_str, "idle", 0, 0, 0, 0, idle_cycles, elapsed);
+    reset_accounting();
+}
@@ -0,0 +1,41 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Cooperative rate-monotonic scheduler. Time is counted in control ticks
+// (one per IMU data-ready edge). Each task is released every `period`
+// ticks and must finish within `deadline` ticks of its release; the
+// highest-priority released task runs to completion, then the table is
+// scanned again. With nothing released the core sleeps in WFI.
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+    uint16_t period;      // ticks between releases
+    uint16_t deadline;    // ticks after release by which the run must finish
+    uint8_t priority;     // 0 = highest
+
+    // Runtime state, zeroed by sched_init()
+    uint32_t release;     // tick of the pending release
+    uint32_t runs;
+    uint32_t misses;      // runs that finished after their deadline
+    uint32_t skips;       // releases dropped because the task fell behind
+    uint32_t max_cycles;
+    uint64_t cycles;
+} task_t;
+
+void sched_init(task_t *tasks, uint8_t count, uint32_t (*now)(void));
+
+// Run the highest-priority released task. Returns false if none was due.
+bool sched_dispatch(void);
+
+// Sleep until the tick source advances.
+void sched_idle(void);
+
+// One "TASK <name> n= miss= skip= max= load=" line per task plus idle.
+// max is cycles per run, load is per-mille of CPU since the last dump.
+void sched_dump(void (*write_str)(const char *s));
+
+#endif
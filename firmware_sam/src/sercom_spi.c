@@ -48,8 +48,8 @@ void spi_init(void) {
     }
 
     // BAUD: fBAUD = fREF / (2 * (BAUD + 1))
-    // For 48 MHz and ~4 MHz SPI: BAUD = 48/(2*4) - 1 = 5
-    SERCOM1_SPI->BAUD = 5;
+    // BMI088 allows 10 MHz; from 48 MHz the closest below is BAUD = 2 (8 MHz)
+    SERCOM1_SPI->BAUD = 2;
 
     // Enable SERCOM1
     SERCOM1_SPI->CTRLA |= SERCOM_CTRLA_ENABLE;
@@ -68,3 +68,7 @@ uint8_t spi_transfer(uint8_t data) {
     }
     return (uint8_t)SERCOM1_SPI->DATA;
 }
+
+volatile void *spi_data_reg(void) {
+    return &SERCOM1_SPI->DATA;
+}
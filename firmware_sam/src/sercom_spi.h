@@ -6,4 +6,7 @@
 void spi_init(void);
 uint8_t spi_transfer(uint8_t data);
 
+// DATA register address, for DMA descriptors
+volatile void *spi_data_reg(void);
+
 #endif
@@ -8,6 +8,20 @@
 #define UART_TX_PIN 4
 #define UART_RX_PIN 5
 
+#define TX_MASK (UART_TX_RING_SIZE - 1)
+#define RX_MASK (UART_RX_RING_SIZE - 1)
+
+static uint8_t tx_ring[UART_TX_RING_SIZE];
+static volatile uint16_t tx_head;  // written by producers
+static volatile uint16_t tx_tail;  // written by the DRE interrupt
+static volatile uint32_t tx_dropped;
+static volatile bool tx_started;   // a byte went out since uart_init
+
+static uint8_t rx_ring[UART_RX_RING_SIZE];
+static volatile uint16_t rx_head;  // written by the RXC interrupt
+static volatile uint16_t rx_tail;  // written by uart_read_byte
+static volatile uart_rx_stats_t rx_stats;
+
 void uart_init(uint32_t baud) {
     // Disable SERCOM0 before configuration
     SERCOM0_USART->CTRLA = SERCOM_CTRLA_SWRST;
@@ -26,8 +40,10 @@ void uart_init(uint32_t baud) {
     PORTA->PMUX[UART_RX_PIN / 2] |= (0x03 << 4); // Function D
 
     // Configure SERCOM0 as USART
-    // CTRLA: MODE=USART_INT_CLK, TXPO=0 (TX=PAD0), RXPO=1 (RX=PAD1), DORD=1 (LSB first)
+    // CTRLA: MODE=USART_INT_CLK, TXPO=0 (TX=PAD0), RXPO=1 (RX=PAD1), DORD=1 (LSB first),
+    // SAMPR=1 (16x oversampling, fractional BAUD)
     SERCOM0_USART->CTRLA = SERCOM_CTRLA_MODE_USART
+                         | SERCOM_USART_CTRLA_SAMPR(1)
                          | (0 << 16)   // TXPO: TX on PAD0
                          | (1 << 20)   // RXPO: RX on PAD1
                          | (1 << 30);  // DORD: LSB first
@@ -37,40 +53,131 @@ void uart_init(uint32_t baud) {
     while (SERCOM0_USART->SYNCBUSY) {
     }
 
-    // BAUD register (async arithmetic mode):
-    // Pre-calculated for common baud rates at 48 MHz
-    // BAUD = 65536 * (1 - 16 * fBAUD / fREF)
-    uint16_t br;
-    if (baud <= 9600) br = 62898;
-    else if (baud <= 19200) br = 60293;
-    else if (baud <= 38400) br = 55079;
-    else if (baud <= 57600) br = 49564;
-    else if (baud <= 115200) br = 63019;
-    else br = 63019;  // default 115200
-    SERCOM0_USART->BAUD = br;
+    // fREF / (16 * baud) = BAUD + FP / 8, rounded to the nearest eighth.
+    // At 48 MHz (PERIPH_HZ): 115200 and 460800 are +0.16%, 1000000 is exact.
+    uint32_t div8 = (PERIPH_HZ + baud) / (2 * baud);
+    SERCOM0_USART->BAUD = (uint16_t)(div8 >> 3) | SERCOM_USART_BAUD_FP(div8 & 7);
 
     // Enable SERCOM0
     SERCOM0_USART->CTRLA |= SERCOM_CTRLA_ENABLE;
     while (SERCOM0_USART->SYNCBUSY) {
     }
+
+    tx_head = 0;
+    tx_tail = 0;
+    tx_started = false;
+    rx_head = 0;
+    rx_tail = 0;
+    SERCOM0_USART->INTENSET = SERCOM_USART_INTFLAG_RXC;
+    nvic_enable_irq(SERCOM0_0_IRQn);
+    nvic_enable_irq(SERCOM0_2_IRQn);
+}
+
+void SERCOM0_0_Handler(void) {
+    uint16_t tail = tx_tail;
+    if (tail == tx_head) {
+        SERCOM0_USART->INTENCLR = SERCOM_USART_INTFLAG_DRE;
+        return;
+    }
+    compiler_barrier();
+    SERCOM0_USART->DATA = tx_ring[tail];
+    tx_started = true;
+    tx_tail = (uint16_t)((tail + 1) & TX_MASK);
 }
 
-void uart_write_byte(uint8_t b) {
-    while (!(SERCOM0_USART->INTFLAG & SERCOM_USART_INTFLAG_DRE)) {
+// Errors in STATUS belong to the byte at the head of the FIFO, so read
+// them before DATA. A frame error byte is discarded.
+void SERCOM0_2_Handler(void) {
+    uint16_t status = SERCOM0_USART->STATUS;
+    uint8_t b = (uint8_t)SERCOM0_USART->DATA;
+    if (status & (SERCOM_USART_STATUS_BUFOVF | SERCOM_USART_STATUS_FERR | SERCOM_USART_STATUS_PERR)) {
+        SERCOM0_USART->STATUS = status;
+        if (status & SERCOM_USART_STATUS_BUFOVF) {
+            rx_stats.overruns++;
+        }
+        if (status & SERCOM_USART_STATUS_FERR) {
+            rx_stats.frame_errors++;
+            return;
+        }
     }
-    SERCOM0_USART->DATA = b;
+    uint16_t head = rx_head;
+    uint16_t next = (uint16_t)((head + 1) & RX_MASK);
+    if (next == rx_tail) {
+        rx_stats.dropped++;
+        return;
+    }
+    rx_ring[head] = b;
+    compiler_barrier();
+    rx_head = next;
+}
+
+bool uart_write(const uint8_t *data, uint16_t len) {
+    uint16_t head = tx_head;
+    uint16_t used = (uint16_t)((head - tx_tail) & TX_MASK);
+    if (len > TX_MASK - used) {
+        tx_dropped++;
+        return false;
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        tx_ring[(head + i) & TX_MASK] = data[i];
+    }
+    compiler_barrier();
+    tx_head = (uint16_t)((head + len) & TX_MASK);
+    SERCOM0_USART->INTENSET = SERCOM_USART_INTFLAG_DRE;
+    return true;
+}
+
+void uart_write_byte(uint8_t b) {
+    uart_write(&b, 1);
 }
 
 void uart_write_str(const char *s) {
-    while (*s) {
-        uart_write_byte((uint8_t)*s++);
+    uint16_t len = 0;
+    while (s[len]) {
+        len++;
     }
+    uart_write((const uint8_t *)s, len);
+}
+
+void uart_flush(void) {
+    while (tx_tail != tx_head) {
+    }
+}
+
+void uart_deinit(void) {
+    uart_flush();
+    // TXC is set once the shifter is empty; it never sets if nothing was sent
+    while (tx_started && !(SERCOM0_USART->INTFLAG & SERCOM_USART_INTFLAG_TXC)) {
+    }
+    nvic_disable_irq(SERCOM0_0_IRQn);
+    nvic_disable_irq(SERCOM0_2_IRQn);
+    SERCOM0_USART->CTRLA = SERCOM_CTRLA_SWRST;
+    while (SERCOM0_USART->SYNCBUSY & 1) {
+    }
+}
+
+uint32_t uart_tx_dropped(void) {
+    return tx_dropped;
+}
+
+uint16_t uart_tx_free(void) {
+    return (uint16_t)(TX_MASK - ((tx_head - tx_tail) & TX_MASK));
 }
 
 bool uart_read_byte(uint8_t *out) {
-    if (SERCOM0_USART->INTFLAG & SERCOM_USART_INTFLAG_RXC) {
-        *out = (uint8_t)SERCOM0_USART->DATA;
-        return true;
+    uint16_t tail = rx_tail;
+    if (tail == rx_head) {
+        return false;
     }
-    return false;
+    compiler_barrier();
+    *out = rx_ring[tail];
+    compiler_barrier();
+    rx_tail = (uint16_t)((tail + 1) & RX_MASK);
+    return true;
+}
+
+void uart_rx_stats(uart_rx_stats_t *out) {
+    out->overruns = rx_stats.overruns;
+    out->frame_errors = rx_stats.frame_errors;
+    out->dropped = rx_stats.dropped;
 }
@@ -4,9 +4,35 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// TX is a ring drained by the DRE interrupt; writes never wait. A write
+// that does not fit is dropped whole and counted.
+#define UART_TX_RING_SIZE 2048  // power of two, holds a full PERF dump
+
+// RX is a ring filled by the RXC interrupt (single producer) and drained
+// by uart_read_byte from the main loop (single consumer).
+#define UART_RX_RING_SIZE 256   // power of two, > 0.5 s of RC lines
+
 void uart_init(uint32_t baud);
+bool uart_write(const uint8_t *data, uint16_t len);
 void uart_write_byte(uint8_t b);
 void uart_write_str(const char *s);
 bool uart_read_byte(uint8_t *out);
 
+// Wait until everything queued has been handed to the shifter
+void uart_flush(void);
+// Send everything queued, then reset SERCOM0 and mask its interrupts
+// (before a baud change, or before the bootloader starts the application)
+void uart_deinit(void);
+uint32_t uart_tx_dropped(void);
+uint16_t uart_tx_free(void);
+
+// Receive errors since boot
+typedef struct {
+    uint32_t overruns;      // BUFOVF: hardware buffer overflowed
+    uint32_t frame_errors;  // FERR: bad stop bit
+    uint32_t dropped;       // bytes lost because the RX ring was full
+} uart_rx_stats_t;
+
+void uart_rx_stats(uart_rx_stats_t *out);
+
 #endif
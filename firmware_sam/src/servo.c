@@ -0,0 +1,51 @@
+#include "servo.h"
+#include "same51.h"
+
+#define SERVO_PMUX PORT_PMUX_E  // TC5/WO0
+
+static uint16_t pulse;
+
+static uint16_t pulse_ticks(uint16_t us) {
+    return (uint16_t)(((uint32_t)us * (SERVO_TICK_HZ / 100000UL)) / 10UL);
+}
+
+void servo_set_us(uint16_t pulse_us) {
+    if (pulse_us < SERVO_MIN_US) {
+        pulse_us = SERVO_MIN_US;
+    } else if (pulse_us > SERVO_MAX_US) {
+        pulse_us = SERVO_MAX_US;
+    }
+    pulse = pulse_us;
+    // Buffered: loaded at the wrap, so a frame never gets a torn pulse
+    TC5->CCBUF[0] = pulse_ticks(pulse_us);
+}
+
+uint16_t servo_pulse_us(void) {
+    return pulse;
+}
+
+void servo_init(uint16_t pulse_us) {
+    MCLK->APBCMASK |= MCLK_APBCMASK_TC5;
+    GCLK->GENCTRL[GCLK_GEN_SERVO] = GCLK_GENCTRL_SRC_DFLL | GCLK_GENCTRL_GENEN |
+                                    GCLK_GENCTRL_DIV(SERVO_CLOCK_DIV);
+    while (GCLK->SYNCBUSY & GCLK_SYNCBUSY_GENCTRL(GCLK_GEN_SERVO)) {
+    }
+    GCLK->PCHCTRL[GCLK_TC4_TC5] = GCLK_PCHCTRL_CHEN | GCLK_PCHCTRL_GEN(GCLK_GEN_SERVO);
+
+    TC5->CTRLA = TC_CTRLA_SWRST;
+    while (TC5->SYNCBUSY & TC_SYNCBUSY_SWRST) {
+    }
+    TC5->CTRLA = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_PRESCALER_DIV1;
+    TC5->WAVE = TC_WAVE_NPWM;
+    servo_set_us(pulse_us);
+    TC5->CC[0] = pulse_ticks(pulse);
+    while (TC5->SYNCBUSY & TC_SYNCBUSY_CC(0)) {
+    }
+
+    PORTB->PINCFG[SERVO_PIN] = PORT_PINCFG_PMUXEN;
+    PORTB->PMUX[SERVO_PIN / 2] = (PORTB->PMUX[SERVO_PIN / 2] & 0xF0) | PORT_PMUX_PMUXE(SERVO_PMUX);
+
+    TC5->CTRLA |= TC_CTRLA_ENABLE;
+    while (TC5->SYNCBUSY & TC_SYNCBUSY_ENABLE) {
+    }
+}
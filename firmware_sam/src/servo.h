@@ -0,0 +1,23 @@
+#ifndef SERVO_H
+#define SERVO_H
+
+#include <stdint.h>
+
+// Hobby servo PWM (back-rest arm, docs/back-rest-arm.md) on PB10 =
+// TC5/WO0. The SAME51 has no TCC5, so the arm uses TC5, which is free.
+// TC5 counts at 3.2 MHz (DFLL48M / 15 on GCLK3) in 16-bit normal PWM, so
+// a frame is the 16-bit wrap, 20.48 ms (48.8 Hz), and the pulse width
+// resolves to 0.3125 us. Pulse changes take effect at the next frame.
+#define SERVO_PIN        10     // PB10
+#define SERVO_CLOCK_DIV  15
+#define SERVO_TICK_HZ    (PERIPH_HZ / SERVO_CLOCK_DIV)
+#define SERVO_MIN_US     500
+#define SERVO_MAX_US     2500
+
+// Starts the PWM with the given pulse width
+void servo_init(uint16_t pulse_us);
+// Clamped to SERVO_MIN_US..SERVO_MAX_US
+void servo_set_us(uint16_t pulse_us);
+uint16_t servo_pulse_us(void);
+
+#endif
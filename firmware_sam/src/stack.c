@@ -0,0 +1,142 @@
+#include "stack.h"
+
+#include "perf.h"
+#include "same51.h"
+
+#define FAULT_MAGIC 0x5354414BUL  // "STAK"
+
+// Left by the fault handler for the next boot; .noinit is not cleared
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t addr;
+    uint32_t cfsr;
+} fault_record_t;
+
+static fault_record_t fault __attribute__((section(".noinit")));
+
+static uint32_t *scan_pos;
+static uint32_t *high_water;  // lowest word found overwritten
+
+// Linker symbols are addresses, not objects, so the sums are done on integers
+static uint32_t *stack_floor(void) {
+    return (uint32_t *)((uint32_t)&_sstack + STACK_GUARD);
+}
+
+static uint32_t span(const void *lo, const void *hi) {
+    return (uint32_t)hi - (uint32_t)lo;
+}
+
+// Entered with MSP back at the top of the stack; the faulting frames are
+// lost, only the address and status are kept
+__attribute__((used)) static void stack_fault(void) {
+    uint32_t cfsr = SCB_CFSR;
+    if (fault.magic != FAULT_MAGIC) {
+        fault.magic = FAULT_MAGIC;
+        fault.count = 0;
+    }
+    fault.count++;
+    fault.cfsr = cfsr;
+    fault.addr = (cfsr & SCB_CFSR_MMARVALID) ? SCB_MMFAR : 0;
+    system_reset();
+}
+
+// The stack pointer may be inside the guard, so nothing is pushed before
+// MSP is reset
+__attribute__((naked)) void MemManage_Handler(void) {
+    __asm__ volatile (
+        "ldr r0, =_estack\n\t"
+        "msr msp, r0\n\t"
+        "b stack_fault\n\t"
+        ".ltorg\n\t");
+}
+
+// Every IRQ runs at priority 0, so a guard hit inside a handler escalates
+// here instead of MemManage. Faults without MemManage status hang in
+// Default_Handler as before.
+__attribute__((naked)) void HardFault_Handler(void) {
+    __asm__ volatile (
+        "ldr r0, =0xE000ED28\n\t"  // SCB_CFSR
+        "ldr r0, [r0]\n\t"
+        "tst r0, #0xFF\n\t"        // SCB_CFSR_MMFSR_MASK
+        "beq Default_Handler\n\t"
+        "ldr r0, =_estack\n\t"
+        "msr msp, r0\n\t"
+        "b stack_fault\n\t"
+        ".ltorg\n\t");
+}
+
+void stack_init(void) {
+    if (fault.magic != FAULT_MAGIC) {
+        fault.magic = FAULT_MAGIC;
+        fault.count = 0;
+        fault.addr = 0;
+        fault.cfsr = 0;
+    }
+    scan_pos = stack_floor();
+    high_water = &_estack;
+
+    // Region 0: the guard, no access and no execute; the default map
+    // covers the rest for privileged code
+    MPU->RNR = 0;
+    MPU->RBAR = (uint32_t)&_sstack;
+    MPU->RASR = MPU_RASR_XN | MPU_RASR_AP_NONE |
+                MPU_RASR_SIZE(STACK_GUARD_LOG2) | MPU_RASR_ENABLE;
+    MPU->CTRL = MPU_CTRL_PRIVDEFENA | MPU_CTRL_ENABLE;
+    SCB_SHCSR |= SCB_SHCSR_MEMFAULTENA;
+    __asm__ volatile ("dsb\n\tisb" ::: "memory");
+}
+
+void stack_scan(uint32_t words) {
+    uint32_t *p = scan_pos;
+    while (words-- > 0 && p < high_water) {
+        if (*p != STACK_CANARY) {
+            high_water = p;
+            break;
+        }
+        p++;
+    }
+    scan_pos = (p < high_water) ? p : stack_floor();
+}
+
+void stack_ram(stack_ram_t *r) {
+    r->data = span(&_sdata, &_edata);
+    r->bss = span(&_sbss, &_ebss);
+    r->free = span(&_ebss, &_snoinit);
+    r->noinit = span(&_snoinit, &_sstack);
+    r->stack = span(stack_floor(), &_estack);
+    r->stack_used = span(high_water, &_estack);
+    r->faults = fault.count;
+    r->fault_addr = fault.addr;
+}
+
+static void write_field(void (*write_str)(const char *s), const char *name, uint32_t v) {
+    write_str(name);
+    perf_write_u32(write_str, v);
+}
+
+static void write_hex(void (*write_str)(const char *s), uint32_t v) {
+    char buf[11] = "0x";
+    for (int i = 0; i < 8; i++) {
+        buf[2 + i] = "0123456789ABCDEF"[(v >> (28 - 4 * i)) & 0xF];
+    }
+    buf[10] = '\0';
+    write_str(buf);
+}
+
+void stack_dump(void (*write_str)(const char *s)) {
+    stack_ram_t r;
+    stack_ram(&r);
+    write_field(write_str, "RAM data=", r.data);
+    write_field(write_str, " bss=", r.bss);
+    write_field(write_str, " free=", r.free);
+    write_field(write_str, " noinit=", r.noinit);
+    write_field(write_str, " stack=", r.stack);
+    write_field(write_str, " used=", r.stack_used);
+    write_field(write_str, " faults=", r.faults);
+    if (r.faults > 0) {
+        write_str(" addr=");
+        write_hex(write_str, r.fault_addr);
+    }
+    write_str("\r\n");
+}
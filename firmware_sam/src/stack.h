@@ -0,0 +1,55 @@
+#ifndef STACK_H
+#define STACK_H
+
+#include <stdint.h>
+
+// Stack and RAM accounting. The linker script (linker/same51j20a.ld)
+// places the stack at the top of RAM in its own section, .noinit just
+// below it and .data/.bss from the bottom; what is left between them is
+// free (there is no heap). Reset_Handler paints the stack below its own
+// frame with STACK_CANARY. stack_init() then makes the lowest STACK_GUARD
+// bytes no-access in the MPU: an overflow faults into a handler that
+// records the address in .noinit and resets, instead of running on into
+// .bss. stack_scan() walks up from the guard for the lowest overwritten
+// word, a few words per call, so the high-water mark costs no more than
+// a short task run.
+
+#define STACK_CANARY     0xDEADBEEFUL
+#define STACK_GUARD      256   // bytes, matches the linker script
+#define STACK_GUARD_LOG2 8
+
+extern uint32_t _sdata, _edata, _sbss, _ebss;
+extern uint32_t _snoinit, _sstack, _estack;
+
+typedef struct {
+    uint32_t data;        // .data and .ramfunc, bytes
+    uint32_t bss;
+    uint32_t free;        // between .bss and .noinit
+    uint32_t noinit;
+    uint32_t stack;       // usable, above the guard
+    uint32_t stack_used;  // high-water mark
+    uint32_t faults;      // guard hits since power-up
+    uint32_t fault_addr;  // data address of the last hit, 0 if not known
+} stack_ram_t;
+
+// Fill [from, to) with the canary; called from Reset_Handler
+static inline void stack_paint(uint32_t *from, uint32_t *to) {
+    while (from < to) {
+        *from++ = STACK_CANARY;
+    }
+}
+
+// Arm the MPU guard and MemManage fault, and pick up a fault record left
+// by the last reset
+void stack_init(void);
+
+// Check up to `words` canary words; restarts from the guard after each pass
+void stack_scan(uint32_t words);
+
+void stack_ram(stack_ram_t *r);
+
+// "RAM data= bss= free= noinit= stack= used= faults=" and " addr=0x..."
+// after a guard hit, all in bytes
+void stack_dump(void (*write_str)(const char *s));
+
+#endif
@@ -1,5 +1,8 @@
 #include <stdint.h>
 
+#include "same51.h"
+#include "stack.h"
+
 extern uint32_t _etext;
 extern uint32_t _sdata;
 extern uint32_t _edata;
@@ -22,8 +25,17 @@ void DebugMon_Handler(void)   __attribute__((weak, alias("Default_Handler")));
 void PendSV_Handler(void)     __attribute__((weak, alias("Default_Handler")));
 void SysTick_Handler(void)    __attribute__((weak, alias("Default_Handler")));
 
+void EIC_EXTINT_6_Handler(void) __attribute__((weak, alias("Default_Handler")));
+void DMAC_1_Handler(void)       __attribute__((weak, alias("Default_Handler")));
+void TCC0_0_Handler(void)       __attribute__((weak, alias("Default_Handler")));
+void TCC1_0_Handler(void)       __attribute__((weak, alias("Default_Handler")));
+void SERCOM0_0_Handler(void)    __attribute__((weak, alias("Default_Handler")));
+void SERCOM0_2_Handler(void)    __attribute__((weak, alias("Default_Handler")));
+void SERCOM4_0_Handler(void)    __attribute__((weak, alias("Default_Handler")));
+void SERCOM4_2_Handler(void)    __attribute__((weak, alias("Default_Handler")));
+
 __attribute__((section(".vectors")))
-const void *vector_table[] = {
+const void *vector_table[16 + PERIPH_IRQ_COUNT] = {
     &_estack,
     Reset_Handler,
     NMI_Handler,
@@ -37,7 +49,15 @@ const void *vector_table[] = {
     0,
     PendSV_Handler,
     SysTick_Handler,
-    // IRQs would follow here...
+    // External IRQs, indexed by IRQn + 16
+    [16 + EIC_EXTINT_0_IRQn + 6] = EIC_EXTINT_6_Handler,
+    [16 + DMAC_0_IRQn + 1]       = DMAC_1_Handler,
+    [16 + SERCOM0_0_IRQn]        = SERCOM0_0_Handler,
+    [16 + SERCOM0_2_IRQn]        = SERCOM0_2_Handler,
+    [16 + SERCOM4_0_IRQn]        = SERCOM4_0_Handler,
+    [16 + SERCOM4_2_IRQn]        = SERCOM4_2_Handler,
+    [16 + TCC0_0_IRQn]           = TCC0_0_Handler,
+    [16 + TCC1_0_IRQn]           = TCC1_0_Handler,
 };
 
 void Reset_Handler(void) {
@@ -55,6 +75,11 @@ void Reset_Handler(void) {
         *dst++ = 0;
     }
 
+    // Paint the free stack below this frame for the high-water scan
+    uint32_t *sp;
+    __asm__ volatile ("mov %0, sp" : "=r"(sp));
+    stack_paint(&_sstack, sp);
+
     // Enable FPU (Cortex-M4F)
     // Set CP10 and CP11 full access
     *((volatile uint32_t *)0xE000ED88UL) |= (0xF << 20);
@@ -1,16 +1,78 @@
 #include "same51.h"
 
-// System runs at 48 MHz from DFLL48M (default after reset on SAME51)
-// For simplicity, we use the default clock configuration.
+// Clock tree:
+//   DFLL48M (open loop, the reset default) -> GCLK1 -> peripherals
+//   DFLL48M / 24 -> GCLK2 -> DPLL0 reference (2 MHz)
+//   DPLL0 (CPU_MHZ) -> GCLK0 -> CPU
+// Peripheral baud rates and timer periods depend only on PERIPH_HZ, so the
+// CPU clock can change without touching them. With CPU_MHZ 48 the CPU
+// stays on DFLL48M and DPLL0 is left off.
+_Static_assert(CPU_MHZ == 48 || (CPU_MHZ >= 96 && CPU_MHZ <= 120 && CPU_MHZ % 2 == 0),
+               "CPU_MHZ must be 48 or an even DPLL0 rate of 96..120");
+
+#define DPLL_REF_DIV 24
+#define DPLL_REF_MHZ (48 / DPLL_REF_DIV)
+
+// Flash read wait states needed at each CPU clock (NVM characteristics)
+static const uint8_t nvm_ws_max_mhz[] = {24, 51, 77, 101, 119};
+
+static uint16_t nvm_wait_states(uint32_t mhz) {
+    uint16_t ws = 0;
+    while (ws < sizeof(nvm_ws_max_mhz) && mhz > nvm_ws_max_mhz[ws]) {
+        ws++;
+    }
+    return ws;
+}
+
+static void gclk_generator(uint8_t gen, uint32_t src, uint16_t div) {
+    GCLK->GENCTRL[gen] = src | GCLK_GENCTRL_GENEN | GCLK_GENCTRL_DIV(div);
+    while (GCLK->SYNCBUSY & GCLK_SYNCBUSY_GENCTRL(gen)) {
+    }
+}
+
+static void clock_init(void) {
+    // Wait states first: they must cover the faster clock before it starts
+    NVMCTRL->CTRLA = (NVMCTRL->CTRLA & ~(NVMCTRL_CTRLA_AUTOWS | NVMCTRL_CTRLA_RWS_MASK))
+                   | NVMCTRL_CTRLA_RWS(nvm_wait_states(CPU_MHZ));
+
+    gclk_generator(GCLK_GEN_PERIPH, GCLK_GENCTRL_SRC_DFLL, 1);
+
+#if CPU_MHZ != 48
+    gclk_generator(GCLK_GEN_DPLL_REF, GCLK_GENCTRL_SRC_DFLL, DPLL_REF_DIV);
+    GCLK->PCHCTRL[GCLK_OSCCTRL_FDPLL0] = GCLK_PCHCTRL_CHEN | GCLK_PCHCTRL_GEN(GCLK_GEN_DPLL_REF);
+
+    // fDPLL = fREF * (LDR + 1)
+    OscctrlDpll *dpll = &OSCCTRL->DPLL[0];
+    dpll->DPLLRATIO = OSCCTRL_DPLLRATIO_LDR(CPU_MHZ / DPLL_REF_MHZ - 1);
+    while (dpll->DPLLSYNCBUSY & OSCCTRL_DPLLSYNCBUSY_DPLLRATIO) {
+    }
+    dpll->DPLLCTRLB = OSCCTRL_DPLLCTRLB_REFCLK_GCLK;
+    dpll->DPLLCTRLA = OSCCTRL_DPLLCTRLA_ENABLE;
+    while (dpll->DPLLSYNCBUSY & OSCCTRL_DPLLSYNCBUSY_ENABLE) {
+    }
+    while ((dpll->DPLLSTATUS & (OSCCTRL_DPLLSTATUS_LOCK | OSCCTRL_DPLLSTATUS_CLKRDY)) !=
+           (OSCCTRL_DPLLSTATUS_LOCK | OSCCTRL_DPLLSTATUS_CLKRDY)) {
+    }
+    gclk_generator(GCLK_GEN_CPU, GCLK_GENCTRL_SRC_DPLL0, 1);
+#endif
+}
 
 void system_init(void) {
+    clock_init();
+    cmcc_enable();
+
     // Enable SERCOM0 and SERCOM1 in MCLK
     MCLK->APBAMASK |= (1 << 12); // SERCOM0
     MCLK->APBAMASK |= (1 << 13); // SERCOM1
 
-    // Route GCLK0 (48 MHz) to SERCOM0 and SERCOM1
-    GCLK->PCHCTRL[GCLK_SERCOM0_CORE] = (1 << 6) | 0; // Enable, GCLK0
-    GCLK->PCHCTRL[GCLK_SERCOM1_CORE] = (1 << 6) | 0; // Enable, GCLK0
+    // Route the 48 MHz peripheral clock to SERCOM0 and SERCOM1
+    GCLK->PCHCTRL[GCLK_SERCOM0_CORE] = GCLK_PCHCTRL_PERIPH;
+    GCLK->PCHCTRL[GCLK_SERCOM1_CORE] = GCLK_PCHCTRL_PERIPH;
+
+    // Free-running DWT cycle counter for timestamps
+    CORE_DEMCR |= DEMCR_TRCENA;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA;
 }
 
 void system_systick_init(uint32_t tick_hz) {
@@ -23,9 +85,18 @@ void system_systick_init(uint32_t tick_hz) {
     SYSTICK->CTRL = SYSTICK_CTRL_CLKSOURCE | SYSTICK_CTRL_TICKINT | SYSTICK_CTRL_ENABLE;
 }
 
+// Delays count DWT cycles (started in system_init), so they are exact at
+// any CPU_HZ and do not stretch when interrupts run. One call must stay
+// below the counter's wrap (~36 s at 120 MHz).
+void delay_us(uint32_t us) {
+    uint32_t start = dwt_cycles();
+    uint32_t cycles = us * (CPU_HZ / 1000000UL);
+    while (dwt_cycles() - start < cycles) {
+    }
+}
+
 void delay_ms(uint32_t ms) {
-    // Simple busy-wait delay (assumes ~48 MHz, rough estimate)
-    for (volatile uint32_t i = 0; i < ms * 6000; i++) {
-        __asm__("nop");
+    while (ms--) {
+        delay_us(1000);
     }
 }
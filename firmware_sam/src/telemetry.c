@@ -0,0 +1,75 @@
+#include "telemetry.h"
+
+static uint16_t seq;
+
+void telem_begin(telem_frame_t *f, uint8_t type) {
+    f->len = 0;
+    telem_put_u16(f, seq++);
+    telem_put_u8(f, type);
+}
+
+void telem_put_u8(telem_frame_t *f, uint8_t v) {
+    // Leave room for the CRC
+    if (f->len < TELEM_MAX_RAW - 2) {
+        f->raw[f->len++] = v;
+    }
+}
+
+void telem_put_u16(telem_frame_t *f, uint16_t v) {
+    telem_put_u8(f, (uint8_t)v);
+    telem_put_u8(f, (uint8_t)(v >> 8));
+}
+
+void telem_put_u32(telem_frame_t *f, uint32_t v) {
+    telem_put_u16(f, (uint16_t)v);
+    telem_put_u16(f, (uint16_t)(v >> 16));
+}
+
+int16_t telem_scaled_i16(float v, float scale) {
+    float q = v * scale;
+    q += (q < 0.0f) ? -0.5f : 0.5f;
+    if (q > 32767.0f) q = 32767.0f;
+    if (q < -32768.0f) q = -32768.0f;
+    return (int16_t)q;
+}
+
+void telem_put_scaled_i16(telem_frame_t *f, float v, float scale) {
+    telem_put_u16(f, (uint16_t)telem_scaled_i16(v, scale));
+}
+
+uint16_t telem_crc16(const uint8_t *data, uint16_t len) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t telem_finish(telem_frame_t *f, uint8_t *out) {
+    uint16_t crc = telem_crc16(f->raw, f->len);
+    f->raw[f->len++] = (uint8_t)crc;
+    f->raw[f->len++] = (uint8_t)(crc >> 8);
+
+    // COBS: each code byte gives the distance to the next zero. Frames
+    // are under 254 bytes, so one code per zero plus the leading one.
+    uint16_t n = 0;
+    out[n++] = 0x00;
+    uint16_t code_at = n++;
+    uint8_t code = 1;
+    for (uint8_t i = 0; i < f->len; i++) {
+        if (f->raw[i] == 0) {
+            out[code_at] = code;
+            code_at = n++;
+            code = 1;
+        } else {
+            out[n++] = f->raw[i];
+            code++;
+        }
+    }
+    out[code_at] = code;
+    out[n++] = 0x00;
+    return n;
+}
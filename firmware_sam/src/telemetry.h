@@ -0,0 +1,61 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+// Binary telemetry frames for the XBee link. A frame is
+//   seq (u16) | type (u8) | payload | CRC16 (u16)
+// little-endian, CRC16-CCITT (poly 0x1021, init 0xFFFF) over everything
+// before it. The frame is COBS-encoded and wrapped in 0x00 delimiters, so
+// a receiver resyncs on the next zero and ASCII replies sent between
+// frames arrive as their own chunks. seq counts every frame sent.
+
+#define TELEM_TYPE_STATE  0x01  // fixed state frame, replaced by CHANNELS
+#define TELEM_TYPE_STATUS 0x02  // counters and driver diagnostics, 8 Hz
+#define TELEM_TYPE_BB_INFO   0x03  // blackbox dump header
+#define TELEM_TYPE_BB_RECORD 0x04  // one blackbox record
+#define TELEM_TYPE_BB_END    0x05  // blackbox dump complete
+#define TELEM_TYPE_RC_ACK    0x06  // echo of each binary RC command
+#define TELEM_TYPE_RC_LINK   0x07  // RC command link statistics, 8 Hz
+#define TELEM_TYPE_CHANNELS  0x08  // subscribed channel values (channels.h)
+#define TELEM_TYPE_CHAN_INFO 0x09  // one channel's name, scale and rates
+#define TELEM_TYPE_CHAN_PLAN 0x0A  // link budget and subscription state
+#define TELEM_TYPE_SHUTDOWN  0x0B  // back-rest arm phase ticks, per sequence
+#define TELEM_TYPE_BOOT_INFO 0x0C  // bootloader replies (boot.h)
+#define TELEM_TYPE_BOOT_ACK  0x0D
+#define TELEM_TYPE_BOOT_CRCS 0x0E
+#define TELEM_TYPE_RAM       0x0F  // RAM sections and stack high-water (stack.h), 1 Hz
+
+// Host to robot, same framing: a binary RC command (see rc_input.h)
+#define TELEM_TYPE_RC_CMD    0x81
+// 0x90..0x98: bootloader commands (boot.h)
+
+#define TELEM_MAX_PAYLOAD 48
+#define TELEM_MAX_RAW     (3 + TELEM_MAX_PAYLOAD + 2)
+#define TELEM_MAX_FRAME   (TELEM_MAX_RAW + 1 + 2)  // COBS overhead + delimiters
+
+// Fixed-point scales shared with the host decoder
+#define TELEM_ANGLE_SCALE 100.0f  // centidegrees
+
+typedef struct {
+    uint8_t raw[TELEM_MAX_RAW];
+    uint8_t len;
+} telem_frame_t;
+
+void telem_begin(telem_frame_t *f, uint8_t type);
+void telem_put_u8(telem_frame_t *f, uint8_t v);
+void telem_put_u16(telem_frame_t *f, uint16_t v);
+void telem_put_u32(telem_frame_t *f, uint32_t v);
+
+// Round v * scale to the nearest integer, saturated to int16. scale is
+// any factor (TELEM_ANGLE_SCALE, 1), not a fixed-point format.
+int16_t telem_scaled_i16(float v, float scale);
+void telem_put_scaled_i16(telem_frame_t *f, float v, float scale);
+
+// Append the CRC and COBS-encode into out (TELEM_MAX_FRAME bytes).
+// Returns the encoded length including both delimiters.
+uint16_t telem_finish(telem_frame_t *f, uint8_t *out);
+
+uint16_t telem_crc16(const uint8_t *data, uint16_t len);
+
+#endif
@@ -1,18 +1,117 @@
 #include "tmc2209.h"
 #include "same51.h"
+#include "perf.h"
+#include "ramfunc.h"
+#include "tmc_uart.h"
 
 // TMC2209 uses STEP/DIR/EN interface
 // EN is active low (LOW = enabled)
 // DIR: HIGH = one direction, LOW = other direction
 // STEP: rising edge triggers one microstep
 
+// 2 us STEP high time (TMC2209 needs ~100 ns minimum)
+#define STEP_PULSE_TICKS (TMC2209_STEP_TIMER_HZ / 500000UL)
+// The planner runs from the overflow ISR once this many ticks have passed
+// (4 kHz). Step intervals longer than that are split into pulse-less
+// chunks so the ISR, and with it the planner, never waits longer.
+#define PLAN_TICKS       (TMC2209_STEP_TIMER_HZ / 4000UL)
+#define CHUNK_TICKS      PLAN_TICKS
+#define IDLE_PERIOD      (CHUNK_TICKS - 1)
+// Leftover gaps shorter than this (10 us) are dropped, not loaded
+#define MIN_GAP_TICKS    (TMC2209_STEP_TIMER_HZ / 100000UL)
+#define TICKS_PER_US     (TMC2209_STEP_TIMER_HZ / 1000000UL)
+#define PLAN_MAX_DT_US   65535UL
+#define US_TO_Q32        4295ULL  // 2^32 / 1e6, rounded
+#define MIN_SPEED_Q16    ((int32_t)TMC2209_MIN_STEP_HZ << 16)
+#define MAX_SPEED_Q16    ((int32_t)TMC2209_MAX_STEP_HZ << 16)
+
+// Register values written by tmc2209_attach_uart
+#define GCONF_VALUE      0x1C1        // I_scale_analog, pdn_disable, mstep_reg_select, multistep_filt
+#define CHOPCONF_BASE    0x10000053UL // reset default: TOFF=3, HSTRT=5, intpol
+#define CHOPCONF_MRES(x) ((uint32_t)(x) << 24)
+#define IHOLDDELAY       6
+#define TPOWERDOWN_VALUE 20           // ~0.4 s at standstill before IHOLD
+#define TCOOLTHRS_VALUE  0xFFFFF      // CoolStep and StallGuard at all speeds
+#define COOLCONF_VALUE   0x0225       // semin=5, seup=2 steps, semax=2
+
+typedef struct {
+    uint8_t step_pin;
+    Tcc *tcc;
+    uint8_t cc;          // CC channel driving the pin's WO output
+    uint8_t pmux;        // PORT function for that WO output
+    uint32_t apbb_mask;
+    uint8_t irqn;
+} step_timer_t;
+
+static const step_timer_t step_timers[] = {
+    { 8,  TCC0, 0, PORT_PMUX_F, MCLK_APBBMASK_TCC0, TCC0_0_IRQn },  // PA08 = TCC0/WO0
+    { 11, TCC1, 3, PORT_PMUX_G, MCLK_APBBMASK_TCC1, TCC1_0_IRQn },  // PA11 = TCC1/WO7
+};
+
+#define STEP_TIMER_COUNT (sizeof(step_timers) / sizeof(step_timers[0]))
+
+static tmc2209_t *timer_owner[STEP_TIMER_COUNT];
+
+static void step_timer_init(const step_timer_t *t) {
+    MCLK->APBBMASK |= t->apbb_mask;
+    GCLK->PCHCTRL[GCLK_TCC0_TCC1] = GCLK_PCHCTRL_PERIPH;
+
+    Tcc *tcc = t->tcc;
+    tcc->CTRLA = TCC_CTRLA_SWRST;
+    while (tcc->SYNCBUSY & TCC_SYNCBUSY_SWRST) {
+    }
+    tcc->CTRLA = TCC_CTRLA_PRESCALER_DIV1;
+    tcc->WAVE = TCC_WAVE_NPWM;
+    tcc->PER = IDLE_PERIOD;
+    tcc->CC[t->cc] = 0;  // 0% duty: no pulses until a speed is set
+    while (tcc->SYNCBUSY & (TCC_SYNCBUSY_WAVE | TCC_SYNCBUSY_PER | TCC_SYNCBUSY_CC(t->cc))) {
+    }
+
+    // Hand the STEP pin to the timer
+    uint8_t pin = t->step_pin;
+    PORTA->PINCFG[pin] = PORT_PINCFG_PMUXEN;
+    if (pin & 1) {
+        PORTA->PMUX[pin / 2] = (PORTA->PMUX[pin / 2] & 0x0F) | PORT_PMUX_PMUXO(t->pmux);
+    } else {
+        PORTA->PMUX[pin / 2] = (PORTA->PMUX[pin / 2] & 0xF0) | PORT_PMUX_PMUXE(t->pmux);
+    }
+
+    tcc->INTFLAG = TCC_INT_OVF;
+    tcc->INTENSET = TCC_INT_OVF;
+    nvic_enable_irq(t->irqn);
+
+    tcc->CTRLA |= TCC_CTRLA_ENABLE;
+    while (tcc->SYNCBUSY & TCC_SYNCBUSY_ENABLE) {
+    }
+}
+
 void tmc2209_init(tmc2209_t *m, uint8_t step_pin, uint8_t dir_pin, uint8_t en_pin) {
     m->step_pin = step_pin;
     m->dir_pin = dir_pin;
     m->en_pin = en_pin;
     m->position = 0;
-    m->target_speed = 0;
-    m->step_accumulator = 0;
+    m->target_q16 = 0;
+    m->halt = 0;
+    m->speed_q16 = 0;
+    m->accel = 0;
+    m->plan_ticks = 0;
+    m->interval = 0;
+    m->gap = 0;
+    m->per_active = IDLE_PERIOD;
+    m->per_next = IDLE_PERIOD;
+    m->pulse = 0;
+    m->pulse_next = 0;
+    m->uart = 0;
+    m->uart_addr = 0;
+    m->shift = 0;
+    m->shift_target = 0;
+    m->mres_status = TMC_UART_IDLE;
+    m->diag_idx = 0;
+    m->diag_status = TMC_UART_IDLE;
+    m->sg_result = 0;
+    m->tstep = 0;
+    m->drv_status = 0;
+    tmc2209_set_limits(m, 0, 0);
 
     // Configure pins as outputs
     PORTA->DIRSET = (1 << step_pin) | (1 << dir_pin) | (1 << en_pin);
@@ -23,8 +122,18 @@ void tmc2209_init(tmc2209_t *m, uint8_t step_pin, uint8_t dir_pin, uint8_t en_pi
     // Default direction
     PORTA->OUTCLR = (1 << dir_pin);
 
-    // Step pin low
+    // Step pin low until the timer takes it over
     PORTA->OUTCLR = (1 << step_pin);
+
+    m->timer = STEP_TIMER_COUNT;
+    for (uint8_t i = 0; i < STEP_TIMER_COUNT; i++) {
+        if (step_timers[i].step_pin == step_pin) {
+            m->timer = i;
+            timer_owner[i] = m;
+            step_timer_init(&step_timers[i]);
+            break;
+        }
+    }
 }
 
 void tmc2209_enable(tmc2209_t *m, int enable) {
@@ -32,53 +141,242 @@ void tmc2209_enable(tmc2209_t *m, int enable) {
         PORTA->OUTCLR = (1 << m->en_pin);  // EN low = enabled
     } else {
         PORTA->OUTSET = (1 << m->en_pin);  // EN high = disabled
+        // A released motor does not keep its speed; restart from rest
+        m->target_q16 = 0;
+        m->halt = 1;
     }
 }
 
+void tmc2209_set_limits(tmc2209_t *m, uint32_t accel, uint32_t jerk) {
+    // Caps keep the Q32 dt products inside 64 bits
+    if (accel > TMC2209_MAX_ACCEL) accel = TMC2209_MAX_ACCEL;
+    if (jerk > TMC2209_MAX_JERK) jerk = TMC2209_MAX_JERK;
+    m->max_accel = accel;
+    m->max_jerk = jerk;
+    // Speed still gained while accel ramps to zero: a^2 / (2 j), in Q16
+    m->brake_scale = jerk ? 32768.0f / (float)jerk : 0.0f;
+}
+
+void tmc2209_set_speed_q16(tmc2209_t *m, int32_t steps_per_sec_q16) {
+    if (steps_per_sec_q16 > MAX_SPEED_Q16) steps_per_sec_q16 = MAX_SPEED_Q16;
+    if (steps_per_sec_q16 < -MAX_SPEED_Q16) steps_per_sec_q16 = -MAX_SPEED_Q16;
+    m->target_q16 = steps_per_sec_q16;
+}
+
 void tmc2209_set_speed(tmc2209_t *m, int32_t steps_per_sec) {
-    m->target_speed = steps_per_sec;
+    if (steps_per_sec > TMC2209_MAX_STEP_HZ) steps_per_sec = TMC2209_MAX_STEP_HZ;
+    if (steps_per_sec < -TMC2209_MAX_STEP_HZ) steps_per_sec = -TMC2209_MAX_STEP_HZ;
+    tmc2209_set_speed_q16(m, steps_per_sec << 16);
+}
 
-    // Set direction
-    if (steps_per_sec >= 0) {
-        PORTA->OUTCLR = (1 << m->dir_pin);
+// Advance speed_q16 towards the target by dt_us under the accel/jerk limits.
+// With a jerk limit, accel keeps growing until the speed that would still be
+// gained while ramping accel back to zero covers the remaining error.
+static void planner_update(tmc2209_t *m, uint32_t dt_us) {
+    int32_t target = m->target_q16;
+    int64_t err = (int64_t)target - m->speed_q16;
+
+    if (m->max_accel == 0) {
+        m->speed_q16 = target;
+        m->accel = 0;
+        return;
+    }
+
+    int32_t a;
+    if (m->max_jerk == 0) {
+        a = (err > 0) ? (int32_t)m->max_accel : (err < 0) ? -(int32_t)m->max_accel : 0;
     } else {
-        PORTA->OUTSET = (1 << m->dir_pin);
+        float af = (float)m->accel;
+        int64_t brake = (int64_t)(af * (af < 0.0f ? -af : af) * m->brake_scale);
+        int32_t da = (int32_t)(((uint64_t)m->max_jerk * dt_us * US_TO_Q32) >> 32);
+        if (da == 0) da = 1;
+        a = m->accel;
+        if (err - brake > 0) {
+            a += da;
+        } else if (err - brake < 0) {
+            a -= da;
+        }
+        if (a > (int32_t)m->max_accel) a = (int32_t)m->max_accel;
+        if (a < -(int32_t)m->max_accel) a = -(int32_t)m->max_accel;
     }
-}
 
-void tmc2209_step(tmc2209_t *m) {
-    // Generate step pulse
-    PORTA->OUTSET = (1 << m->step_pin);
-    // Brief delay (TMC2209 needs ~100ns minimum)
-    for (volatile int i = 0; i < 10; i++) {
-        __asm__("nop");
+    // dv = a * dt in Q16: a * dt_us * 2^32/1e6 >> 16
+    int64_t v = m->speed_q16 + (((int64_t)a * dt_us * (int64_t)US_TO_Q32) >> 16);
+    if ((err >= 0 && v >= target) || (err <= 0 && v <= target)) {
+        v = target;
+        a = 0;
     }
-    PORTA->OUTCLR = (1 << m->step_pin);
+    m->speed_q16 = (int32_t)v;
+    m->accel = a;
+}
 
-    // Update position
-    if (m->target_speed >= 0) {
-        m->position++;
+// Load the next period. PERBUF/CCBUF are written right after an overflow,
+// so they always land together at the next one. A step interval starts
+// with a pulse period and continues with pulse-less chunks until its
+// remaining gap is used up.
+static void step_timer_load(const step_timer_t *t, tmc2209_t *m) {
+    uint32_t per = IDLE_PERIOD;
+    uint32_t cc = 0;
+    int8_t pulse = 0;
+    if (m->interval == 0) {
+        m->gap = 0;
     } else {
-        m->position--;
+        uint32_t interval = m->interval << m->shift;
+        if (m->gap > interval) {
+            m->gap = interval;  // sped up: pull the next pulse in
+        }
+        if (m->gap < MIN_GAP_TICKS) {
+            // Adopt a new microstep resolution once the driver has it. A
+            // pulse already queued may still land at the old size.
+            if (m->shift_target != m->shift) {
+                if (m->mres_status == TMC_UART_DONE) {
+                    m->shift = m->shift_target;
+                    interval = m->interval << m->shift;
+                } else if (m->mres_status != TMC_UART_PENDING) {
+                    m->shift_target = m->shift;
+                }
+            }
+            m->gap = interval;
+            cc = STEP_PULSE_TICKS;
+            pulse = (int8_t)(1 << m->shift);
+            if (m->speed_q16 < 0) {
+                pulse = (int8_t)-pulse;
+            }
+            // The pulse for the running period has already risen, so DIR
+            // can change now for the next one.
+            if (pulse > 0) {
+                PORTA->OUTCLR = (1 << m->dir_pin);
+            } else {
+                PORTA->OUTSET = (1 << m->dir_pin);
+            }
+        }
+        uint32_t chunk = m->gap;
+        if (chunk > 2 * CHUNK_TICKS) {
+            chunk = CHUNK_TICKS;
+        } else if (chunk > CHUNK_TICKS) {
+            chunk /= 2;
+        }
+        m->gap -= chunk;
+        per = chunk - 1;
+    }
+    m->per_next = per;
+    m->pulse_next = pulse;
+    t->tcc->PERBUF = per;
+    t->tcc->CCBUF[t->cc] = cc;
+}
+
+// Fine-microstep interval in timer ticks for the planned speed, 0 = stopped
+static uint32_t step_interval(int32_t speed_q16) {
+    uint32_t rate = (speed_q16 < 0) ? (uint32_t)-speed_q16 : (uint32_t)speed_q16;
+    if (rate < (uint32_t)MIN_SPEED_Q16) {
+        return 0;
     }
+    return (uint32_t)((float)TMC2209_STEP_TIMER_HZ * 65536.0f / (float)rate);
 }
 
-// Simple velocity-based stepping
-void tmc2209_tick(tmc2209_t *m, uint32_t tick_hz) {
-    if (m->target_speed == 0) {
+// One overflow per timer period: count the pulse that starts now, run the
+// planner when a planner interval has passed, and queue the next period.
+RAMFUNC static void step_timer_isr(uint8_t i) {
+    uint32_t t0 = perf_begin();
+    const step_timer_t *t = &step_timers[i];
+    t->tcc->INTFLAG = TCC_INT_OVF;
+    tmc2209_t *m = timer_owner[i];
+    if (!m) {
+        perf_end(PERF_STEP_ISR, t0);
         return;
     }
 
-    int32_t speed = m->target_speed;
-    if (speed < 0) {
-        speed = -speed;
+    m->plan_ticks += m->per_active + 1;
+    m->per_active = m->per_next;
+    m->pulse = m->pulse_next;
+    m->position += m->pulse;
+
+    if (m->halt) {
+        m->halt = 0;
+        m->speed_q16 = 0;
+        m->accel = 0;
+        m->interval = 0;
+        m->plan_ticks = 0;
+    } else if (m->plan_ticks >= PLAN_TICKS) {
+        uint32_t dt_us = m->plan_ticks / TICKS_PER_US;
+        m->plan_ticks -= dt_us * TICKS_PER_US;
+        if (dt_us > PLAN_MAX_DT_US) dt_us = PLAN_MAX_DT_US;
+        planner_update(m, dt_us);
+        m->interval = step_interval(m->speed_q16);
     }
+    step_timer_load(t, m);
+    perf_end(PERF_STEP_ISR, t0);
+}
+
+void tmc2209_attach_uart(tmc2209_t *m, uint8_t addr, uint8_t irun, uint8_t ihold) {
+    m->uart = 1;
+    m->uart_addr = addr;
+    m->shift = 0;
+    m->shift_target = 0;
+    tmc_uart_write(addr, TMC_REG_GCONF, GCONF_VALUE, 0);
+    tmc_uart_write(addr, TMC_REG_CHOPCONF, CHOPCONF_BASE | CHOPCONF_MRES(TMC2209_MRES_FINE), 0);
+    tmc2209_set_current(m, irun, ihold);
+    tmc_uart_write(addr, TMC_REG_TPOWERDOWN, TPOWERDOWN_VALUE, 0);
+    tmc_uart_write(addr, TMC_REG_TCOOLTHRS, TCOOLTHRS_VALUE, 0);
+    tmc_uart_write(addr, TMC_REG_COOLCONF, COOLCONF_VALUE, 0);
+}
 
-    // Accumulator-based step generation
-    // step_accumulator += |speed|; if >= tick_hz, step and subtract tick_hz
-    m->step_accumulator += speed;
-    if ((uint32_t)m->step_accumulator >= tick_hz) {
-        m->step_accumulator -= tick_hz;
-        tmc2209_step(m);
+void tmc2209_set_current(tmc2209_t *m, uint8_t irun, uint8_t ihold) {
+    if (!m->uart) {
+        return;
     }
+    if (irun > 31) irun = 31;
+    if (ihold > 31) ihold = 31;
+    uint32_t v = (uint32_t)ihold | ((uint32_t)irun << 8) | ((uint32_t)IHOLDDELAY << 16);
+    tmc_uart_write(m->uart_addr, TMC_REG_IHOLD_IRUN, v, 0);
+}
+
+// Request coarse steps when fast and fine steps when slow. The step ISR
+// switches its pulse size once the CHOPCONF write has gone out.
+static void microstep_service(tmc2209_t *m) {
+    if (m->shift_target != m->shift || m->mres_status == TMC_UART_PENDING) {
+        return;
+    }
+    int32_t v = m->speed_q16 >> 16;
+    if (v < 0) v = -v;
+    uint8_t want = m->shift;
+    if (m->shift == 0 && v > TMC2209_COARSE_ABOVE) {
+        want = TMC2209_COARSE_SHIFT;
+    } else if (m->shift != 0 && v < TMC2209_FINE_BELOW) {
+        want = 0;
+    }
+    if (want == m->shift) {
+        return;
+    }
+    // MRES counts down from 256 microsteps: 16 -> 4 is MRES 4 -> 6
+    uint32_t chop = CHOPCONF_BASE | CHOPCONF_MRES(TMC2209_MRES_FINE + want);
+    if (tmc_uart_write(m->uart_addr, TMC_REG_CHOPCONF, chop, &m->mres_status)) {
+        m->shift_target = want;
+    }
+}
+
+void tmc2209_service(tmc2209_t *m) {
+    if (!m->uart) {
+        return;
+    }
+    microstep_service(m);
+
+    if (m->diag_status == TMC_UART_PENDING) {
+        return;
+    }
+    static const uint8_t diag_regs[] = {
+        TMC_REG_SG_RESULT, TMC_REG_TSTEP, TMC_REG_DRV_STATUS
+    };
+    volatile uint32_t *dest[] = { &m->sg_result, &m->tstep, &m->drv_status };
+    if (tmc_uart_read(m->uart_addr, diag_regs[m->diag_idx], dest[m->diag_idx], &m->diag_status)) {
+        m->diag_idx = (uint8_t)((m->diag_idx + 1) % 3);
+    }
+}
+
+void TCC0_0_Handler(void) {
+    step_timer_isr(0);
+}
+
+void TCC1_0_Handler(void) {
+    step_timer_isr(1);
 }
@@ -3,21 +3,86 @@
 
 #include <stdint.h>
 
+#include "same51.h"
+
+// STEP is generated in hardware: each motor's STEP pin is a TCC waveform
+// output in normal-PWM mode, PER sets the step period and CC a fixed pulse
+// width. Supported STEP pins: PA08 (TCC0/WO0), PA11 (TCC1/WO7).
+#define TMC2209_STEP_TIMER_HZ  PERIPH_HZ  // TCC clock, GCLK1
+#define TMC2209_MIN_STEP_HZ    20      // slower speeds stop the motor
+#define TMC2209_MAX_STEP_HZ    32000   // keeps Q16 steps/s inside int32
+
+// Ramp planner limits (0 = unlimited)
+#define TMC2209_MAX_ACCEL      1000000UL   // steps/s^2
+#define TMC2209_MAX_JERK       10000000UL  // steps/s^3
+
+// Microstep switching over the UART link: STEP pulses are fine microsteps
+// at low speed and 2^TMC2209_COARSE_SHIFT of them at high speed, so the
+// timers emit fewer pulses. Speeds and position stay in fine microsteps.
+#define TMC2209_MRES_FINE      4      // CHOPCONF.MRES 4 = 16 microsteps
+#define TMC2209_COARSE_SHIFT   2      // coarse = 4 microsteps
+#define TMC2209_COARSE_ABOVE   8000   // fine microsteps/s
+#define TMC2209_FINE_BELOW     6000
+
+// Speeds are Q16 fixed point: steps/s * 65536
+#define TMC2209_Q16(x)         ((int32_t)((x) * 65536.0f))
+
 typedef struct {
     uint8_t step_pin;
     uint8_t dir_pin;
     uint8_t en_pin;
-    int32_t position;
-    int32_t target_speed;  // steps per second (signed for direction)
-    int32_t step_accumulator;
+    uint8_t timer;                 // index into the step timer table
+    volatile int32_t position;     // counted by the timer overflow ISR
+    volatile int32_t target_q16;   // commanded speed, steps/s Q16
+    volatile uint8_t halt;         // drop speed to zero at the next ISR
+
+    // Planner state, owned by the step timer ISR
+    int32_t speed_q16;             // current ramped speed, steps/s Q16
+    int32_t accel;                 // current acceleration, steps/s^2
+    uint32_t max_accel;            // steps/s^2
+    uint32_t max_jerk;             // steps/s^3
+    float brake_scale;             // Q16 speed per (steps/s^2)^2 at max_jerk
+    uint32_t plan_ticks;           // timer ticks since the last planner update
+    uint32_t interval;             // step interval in timer ticks, 0 = stopped
+    uint32_t gap;                  // ticks of the interval not yet loaded
+    uint32_t per_active;           // PER of the running period
+    uint32_t per_next;             // PER loaded at the next overflow
+    int8_t pulse;                  // signed fine microsteps of the running pulse
+    int8_t pulse_next;
+
+    // PDN_UART register interface (tmc2209_attach_uart)
+    uint8_t uart;                  // 1 = configured over the UART link
+    uint8_t uart_addr;             // node address from MS1/MS2
+    uint8_t shift;                 // fine microsteps per pulse = 1 << shift
+    volatile uint8_t shift_target; // resolution being switched to
+    volatile uint8_t mres_status;  // CHOPCONF write in flight
+    uint8_t diag_idx;              // next diagnostic register to poll
+    volatile uint8_t diag_status;
+    volatile uint32_t sg_result;   // StallGuard load measure, low = high load
+    volatile uint32_t tstep;       // measured step period, 1/12 MHz units
+    volatile uint32_t drv_status;
 } tmc2209_t;
 
 void tmc2209_init(tmc2209_t *m, uint8_t step_pin, uint8_t dir_pin, uint8_t en_pin);
 void tmc2209_enable(tmc2209_t *m, int enable);
+
+// Acceleration and jerk limits for the ramp planner; 0 disables a limit.
+// Call before the motor is enabled.
+void tmc2209_set_limits(tmc2209_t *m, uint32_t accel, uint32_t jerk);
+
+// Set the target speed. The planner in the step timer ISR ramps towards it
+// within the configured limits.
+void tmc2209_set_speed_q16(tmc2209_t *m, int32_t steps_per_sec_q16);
 void tmc2209_set_speed(tmc2209_t *m, int32_t steps_per_sec);
-void tmc2209_step(tmc2209_t *m);
 
-// Call from timer interrupt at fixed rate (e.g., 10 kHz)
-void tmc2209_tick(tmc2209_t *m, uint32_t tick_hz);
+// Take the driver over the shared PDN_UART bus (tmc_uart_init first):
+// microstep resolution from CHOPCONF, StealthChop with CoolStep, and
+// run/hold current scaled 0..31 on top of VREF.
+void tmc2209_attach_uart(tmc2209_t *m, uint8_t addr, uint8_t irun, uint8_t ihold);
+void tmc2209_set_current(tmc2209_t *m, uint8_t irun, uint8_t ihold);
+
+// Call periodically: switches microstep resolution with speed and polls
+// SG_RESULT, TSTEP and DRV_STATUS, one register per call.
+void tmc2209_service(tmc2209_t *m);
 
 #endif
@@ -0,0 +1,255 @@
+#include "tmc_uart.h"
+#include "same51.h"
+
+// SERCOM4 UART pins (SAME51J20A):
+// PB08 = SERCOM4 PAD[0] = TX (PMUX D), through 1k to PDN_UART
+// PB09 = SERCOM4 PAD[1] = RX (PMUX D), straight to PDN_UART
+// Every transmitted byte is echoed back on RX and checked.
+
+#define TMC_TX_PIN 8
+#define TMC_RX_PIN 9
+
+#define TMC_SYNC        0x05
+#define TMC_MASTER_ADDR 0xFF
+#define TMC_WRITE       0x80
+
+// No reply after 3 ms = driver missing or unpowered
+#define TMC_TIMEOUT_CYCLES (CPU_HZ / 333)
+// Quiet time after an error before the next request
+#define TMC_RECOVER_CYCLES (CPU_HZ / 1000)
+
+typedef struct {
+    uint8_t addr;
+    uint8_t reg;          // TMC_WRITE set for writes
+    uint32_t value;
+    volatile uint32_t *result;
+    volatile uint8_t *status;
+} tmc_req_t;
+
+typedef enum {
+    BUS_IDLE = 0,
+    BUS_ACTIVE,
+    BUS_RECOVER
+} bus_state_t;
+
+static tmc_req_t queue[TMC_UART_QUEUE_LEN];
+static volatile uint8_t q_head;  // written by the main loop
+static volatile uint8_t q_tail;  // written by the ISR
+
+static volatile bus_state_t bus_state;
+static volatile uint32_t bus_stamp;
+static uint8_t frame[8];
+static uint8_t reply[8];
+static uint8_t tx_len;
+static uint8_t tx_idx;
+static uint8_t rx_len;
+static uint8_t rx_idx;
+static volatile uint32_t error_count;
+
+#define BUS_IRQS (SERCOM_USART_INTFLAG_DRE | SERCOM_USART_INTFLAG_RXC)
+
+uint8_t tmc_uart_crc(const uint8_t *data, uint8_t len) {
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            if ((crc >> 7) ^ (b & 0x01)) {
+                crc = (uint8_t)((crc << 1) ^ 0x07);
+            } else {
+                crc = (uint8_t)(crc << 1);
+            }
+            b >>= 1;
+        }
+    }
+    return crc;
+}
+
+// Start the request at the queue tail. Runs with the SERCOM IRQs masked.
+static void bus_start(void) {
+    if (q_tail == q_head) {
+        bus_state = BUS_IDLE;
+        return;
+    }
+    const tmc_req_t *r = &queue[q_tail];
+    frame[0] = TMC_SYNC;
+    frame[1] = r->addr;
+    frame[2] = r->reg;
+    if (r->reg & TMC_WRITE) {
+        frame[3] = (uint8_t)(r->value >> 24);
+        frame[4] = (uint8_t)(r->value >> 16);
+        frame[5] = (uint8_t)(r->value >> 8);
+        frame[6] = (uint8_t)r->value;
+        frame[7] = tmc_uart_crc(frame, 7);
+        tx_len = 8;
+        rx_len = 8;
+    } else {
+        frame[3] = tmc_uart_crc(frame, 3);
+        tx_len = 4;
+        rx_len = 4 + 8;
+    }
+    tx_idx = 0;
+    rx_idx = 0;
+    bus_state = BUS_ACTIVE;
+    bus_stamp = dwt_cycles();
+    SERCOM4_USART->INTENSET = BUS_IRQS;
+}
+
+// Retire the request at the queue tail
+static void bus_finish(bool ok) {
+    const tmc_req_t *r = &queue[q_tail];
+    if (ok && !(r->reg & TMC_WRITE)) {
+        uint32_t v = ((uint32_t)reply[3] << 24) | ((uint32_t)reply[4] << 16)
+                   | ((uint32_t)reply[5] << 8) | reply[6];
+        if (r->result) {
+            *r->result = v;
+        }
+    }
+    if (r->status) {
+        *r->status = ok ? TMC_UART_DONE : TMC_UART_ERROR;
+    }
+    q_tail = (uint8_t)((q_tail + 1) % TMC_UART_QUEUE_LEN);
+    SERCOM4_USART->INTENCLR = BUS_IRQS;
+    if (ok) {
+        bus_start();
+    } else {
+        // Let the bus go quiet; tmc_uart_poll() drains RX and resumes
+        error_count++;
+        bus_state = BUS_RECOVER;
+        bus_stamp = dwt_cycles();
+    }
+}
+
+static bool reply_valid(uint8_t reg) {
+    return reply[0] == TMC_SYNC && reply[1] == TMC_MASTER_ADDR && reply[2] == reg
+        && reply[7] == tmc_uart_crc(reply, 7);
+}
+
+static void bus_isr(void) {
+    if (bus_state != BUS_ACTIVE) {
+        SERCOM4_USART->INTENCLR = BUS_IRQS;
+        return;
+    }
+    uint8_t flags = SERCOM4_USART->INTFLAG & SERCOM4_USART->INTENSET;
+    if (flags & SERCOM_USART_INTFLAG_RXC) {
+        uint8_t b = (uint8_t)SERCOM4_USART->DATA;
+        if (rx_idx < tx_len) {
+            if (b != frame[rx_idx]) {
+                bus_finish(false);  // collision or no loopback
+                return;
+            }
+        } else {
+            reply[rx_idx - tx_len] = b;
+        }
+        rx_idx++;
+        if (rx_idx == rx_len) {
+            bus_finish(tx_len == 8 || reply_valid(frame[2]));
+            return;
+        }
+    }
+    if ((flags & SERCOM_USART_INTFLAG_DRE) && tx_idx < tx_len) {
+        SERCOM4_USART->DATA = frame[tx_idx++];
+        if (tx_idx == tx_len) {
+            SERCOM4_USART->INTENCLR = SERCOM_USART_INTFLAG_DRE;
+        }
+    }
+}
+
+void SERCOM4_0_Handler(void) {
+    bus_isr();
+}
+
+void SERCOM4_2_Handler(void) {
+    bus_isr();
+}
+
+void tmc_uart_init(uint32_t baud) {
+    MCLK->APBDMASK |= MCLK_APBDMASK_SERCOM4;
+    GCLK->PCHCTRL[GCLK_SERCOM4_CORE] = GCLK_PCHCTRL_PERIPH;
+
+    SERCOM4_USART->CTRLA = SERCOM_CTRLA_SWRST;
+    while (SERCOM4_USART->SYNCBUSY & 1) {
+    }
+
+    PORTB->PINCFG[TMC_TX_PIN] = PORT_PINCFG_PMUXEN;
+    PORTB->PMUX[TMC_TX_PIN / 2] = (PORTB->PMUX[TMC_TX_PIN / 2] & 0xF0) | PORT_PMUX_PMUXE(PORT_PMUX_D);
+    PORTB->PINCFG[TMC_RX_PIN] = PORT_PINCFG_PMUXEN | PORT_PINCFG_INEN | PORT_PINCFG_PULLEN;
+    PORTB->OUTSET = (1 << TMC_RX_PIN);  // pull-up keeps the idle line high
+    PORTB->PMUX[TMC_RX_PIN / 2] = (PORTB->PMUX[TMC_RX_PIN / 2] & 0x0F) | PORT_PMUX_PMUXO(PORT_PMUX_D);
+
+    // Same framing as the XBee port: TX on PAD0, RX on PAD1, LSB first
+    SERCOM4_USART->CTRLA = SERCOM_CTRLA_MODE_USART
+                         | (0 << 16)   // TXPO: TX on PAD0
+                         | (1 << 20)   // RXPO: RX on PAD1
+                         | (1 << 30);  // DORD: LSB first
+    SERCOM4_USART->CTRLB = SERCOM_USART_CTRLB_TXEN | SERCOM_USART_CTRLB_RXEN;
+    while (SERCOM4_USART->SYNCBUSY) {
+    }
+
+    // BAUD = 65536 * (1 - 16 * fBAUD / fREF)
+    SERCOM4_USART->BAUD = (uint16_t)(65536UL - (uint32_t)(((uint64_t)baud * 16 * 65536) / PERIPH_HZ));
+
+    SERCOM4_USART->CTRLA |= SERCOM_CTRLA_ENABLE;
+    while (SERCOM4_USART->SYNCBUSY) {
+    }
+
+    q_head = 0;
+    q_tail = 0;
+    bus_state = BUS_IDLE;
+    nvic_enable_irq(SERCOM4_0_IRQn);
+    nvic_enable_irq(SERCOM4_2_IRQn);
+}
+
+static bool submit(uint8_t addr, uint8_t reg, uint32_t value,
+                   volatile uint32_t *result, volatile uint8_t *status) {
+    uint8_t next = (uint8_t)((q_head + 1) % TMC_UART_QUEUE_LEN);
+    if (next == q_tail) {
+        return false;
+    }
+    tmc_req_t *r = &queue[q_head];
+    r->addr = addr;
+    r->reg = reg;
+    r->value = value;
+    r->result = result;
+    r->status = status;
+    if (status) {
+        *status = TMC_UART_PENDING;
+    }
+
+    uint8_t en = SERCOM4_USART->INTENSET;
+    SERCOM4_USART->INTENCLR = BUS_IRQS;
+    q_head = next;
+    if (bus_state == BUS_IDLE) {
+        bus_start();
+    } else {
+        SERCOM4_USART->INTENSET = en;
+    }
+    return true;
+}
+
+bool tmc_uart_write(uint8_t addr, uint8_t reg, uint32_t value, volatile uint8_t *status) {
+    return submit(addr, (uint8_t)(reg | TMC_WRITE), value, 0, status);
+}
+
+bool tmc_uart_read(uint8_t addr, uint8_t reg, volatile uint32_t *result, volatile uint8_t *status) {
+    return submit(addr, (uint8_t)(reg & ~TMC_WRITE), 0, result, status);
+}
+
+void tmc_uart_poll(void) {
+    uint8_t en = SERCOM4_USART->INTENSET;
+    SERCOM4_USART->INTENCLR = BUS_IRQS;
+    uint32_t elapsed = dwt_cycles() - bus_stamp;
+    if (bus_state == BUS_ACTIVE && elapsed > TMC_TIMEOUT_CYCLES) {
+        bus_finish(false);
+    } else if (bus_state == BUS_RECOVER && elapsed > TMC_RECOVER_CYCLES) {
+        while (SERCOM4_USART->INTFLAG & SERCOM_USART_INTFLAG_RXC) {
+            (void)SERCOM4_USART->DATA;
+        }
+        bus_start();
+    } else {
+        SERCOM4_USART->INTENSET = en;
+    }
+}
+
+uint32_t tmc_uart_errors(void) {
+    return error_count;
+}
@@ -0,0 +1,50 @@
+#ifndef TMC_UART_H
+#define TMC_UART_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// TMC2209 single-wire PDN_UART bus on SERCOM4 (PB08 TX via 1k, PB09 RX).
+// Both drivers share the bus, addressed by their MS1/MS2 node address.
+// Transactions are queued and run from the SERCOM interrupt; callers poll
+// a status byte instead of waiting.
+
+// Registers
+#define TMC_REG_GCONF       0x00
+#define TMC_REG_IFCNT       0x02
+#define TMC_REG_IHOLD_IRUN  0x10
+#define TMC_REG_TPOWERDOWN  0x11
+#define TMC_REG_TSTEP       0x12
+#define TMC_REG_TCOOLTHRS   0x14
+#define TMC_REG_SGTHRS      0x40
+#define TMC_REG_SG_RESULT   0x41
+#define TMC_REG_COOLCONF    0x42
+#define TMC_REG_CHOPCONF    0x6C
+#define TMC_REG_DRV_STATUS  0x6F
+
+// Transaction status
+#define TMC_UART_IDLE    0
+#define TMC_UART_PENDING 1
+#define TMC_UART_DONE    2
+#define TMC_UART_ERROR   3
+
+#define TMC_UART_QUEUE_LEN 16
+
+void tmc_uart_init(uint32_t baud);
+
+// Queue a register write or read. *status (may be null) goes PENDING now
+// and DONE/ERROR when the transaction finishes; a read stores the register
+// in *result first. Returns false if the queue is full.
+bool tmc_uart_write(uint8_t addr, uint8_t reg, uint32_t value, volatile uint8_t *status);
+bool tmc_uart_read(uint8_t addr, uint8_t reg, volatile uint32_t *result, volatile uint8_t *status);
+
+// Call from the main loop: fails a transaction with no reply and restarts
+// the bus after an error.
+void tmc_uart_poll(void);
+
+uint32_t tmc_uart_errors(void);
+
+// CRC8 (poly 0x07, bits processed LSB first) over a datagram
+uint8_t tmc_uart_crc(const uint8_t *data, uint8_t len);
+
+#endif
@@ -0,0 +1,214 @@
+// Package boot talks to the SAME51 bootloader (firmware_sam/src/boot.h)
+// over the robot's UART: it uploads application images into the slot that
+// is not running, sending only the pages that changed, LZ-compressed and
+// optionally as a delta against the previous image. Target emulates the
+// bootloader for tests.
+package boot
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+
+	"balancing_robot/internal/telemetry"
+)
+
+const (
+	TypeInfo = 0x0C
+	TypeAck  = 0x0D
+	TypeCRCs = 0x0E
+
+	CmdHello    = 0x90
+	CmdBaud     = 0x91
+	CmdCRCs     = 0x92
+	CmdBegin    = 0x93
+	CmdData     = 0x94
+	CmdCommit   = 0x95
+	CmdEnd      = 0x96
+	CmdRun      = 0x97
+	CmdRollback = 0x98
+
+	StatusOK      = 0
+	StatusArg     = 1
+	StatusMissing = 2
+	StatusFlash   = 3
+	StatusCRC     = 4
+	StatusData    = 5
+	StatusState   = 6
+
+	EncRaw = 0
+	EncLZ  = 1
+
+	SlotEmpty   = 0
+	SlotPending = 1
+	SlotTried   = 2
+	SlotGood    = 3
+	SlotBad     = 4
+
+	PageSize      = 512
+	BlockSize     = 8192
+	PagesPerBlock = BlockSize / PageSize
+	SlotSize      = 0x3E000
+	CRCsMax       = 8
+	Version       = 1
+
+	infoPayload = 30
+	ackPayload  = 6
+)
+
+var (
+	ErrShort = errors.New("boot: frame too short")
+	ErrCRC   = errors.New("boot: CRC mismatch")
+	ErrType  = errors.New("boot: not a bootloader frame")
+)
+
+var statusNames = map[uint8]string{
+	StatusOK:      "ok",
+	StatusArg:     "bad argument",
+	StatusMissing: "pages missing",
+	StatusFlash:   "flash error",
+	StatusCRC:     "image CRC mismatch",
+	StatusData:    "page did not decode",
+	StatusState:   "out of sequence",
+}
+
+var slotNames = map[uint8]string{
+	SlotEmpty:   "empty",
+	SlotPending: "pending",
+	SlotTried:   "tried",
+	SlotGood:    "good",
+	SlotBad:     "bad",
+}
+
+func StatusName(s uint8) string {
+	if n, ok := statusNames[s]; ok {
+		return n
+	}
+	return fmt.Sprintf("status %d", s)
+}
+
+func SlotName(s uint8) string {
+	if n, ok := slotNames[s]; ok {
+		return n
+	}
+	return fmt.Sprintf("state %d", s)
+}
+
+// Info is the bootloader's reply to HELLO.
+type Info struct {
+	Version   uint8
+	Active    uint8
+	State     [2]uint8
+	Size      [2]uint32
+	CRC       [2]uint32
+	PageSize  uint16
+	BlockSize uint16
+	SlotSize  uint32
+	DataMax   uint16
+}
+
+// Ack answers every command but HELLO, CRCS and DATA.
+type Ack struct {
+	Cmd    uint8
+	Status uint8
+	Arg    uint32
+}
+
+// CRCs holds the CRC32 of Count flash pages of Slot from Page on.
+type CRCs struct {
+	Slot uint8
+	Page uint16
+	CRC  []uint32
+}
+
+// Frame builds the wire bytes (with delimiters) of one frame.
+func Frame(seq uint16, typ byte, payload []byte) []byte {
+	raw := make([]byte, 3, 3+len(payload)+2)
+	binary.LittleEndian.PutUint16(raw, seq)
+	raw[2] = typ
+	raw = append(raw, payload...)
+	raw = binary.LittleEndian.AppendUint16(raw, telemetry.CRC16(raw))
+	out := append([]byte{0}, telemetry.COBSEncode(raw)...)
+	return append(out, 0)
+}
+
+// Unframe checks a COBS-decoded frame and returns its type and payload.
+func Unframe(raw []byte) (uint8, []byte, error) {
+	if len(raw) < 5 {
+		return 0, nil, ErrShort
+	}
+	body := raw[:len(raw)-2]
+	if telemetry.CRC16(body) != binary.LittleEndian.Uint16(raw[len(raw)-2:]) {
+		return 0, nil, ErrCRC
+	}
+	return body[2], body[3:], nil
+}
+
+// DecodeReply parses a bootloader reply into an Info, Ack or CRCs.
+func DecodeReply(raw []byte) (interface{}, error) {
+	typ, p, err := Unframe(raw)
+	if err != nil {
+		return nil, err
+	}
+	le := binary.LittleEndian
+	switch typ {
+	case TypeInfo:
+		if len(p) < infoPayload {
+			return nil, ErrShort
+		}
+		return Info{
+			Version:   p[0],
+			Active:    p[1],
+			State:     [2]uint8{p[2], p[3]},
+			Size:      [2]uint32{le.Uint32(p[4:]), le.Uint32(p[12:])},
+			CRC:       [2]uint32{le.Uint32(p[8:]), le.Uint32(p[16:])},
+			PageSize:  le.Uint16(p[20:]),
+			BlockSize: le.Uint16(p[22:]),
+			SlotSize:  le.Uint32(p[24:]),
+			DataMax:   le.Uint16(p[28:]),
+		}, nil
+	case TypeAck:
+		if len(p) < ackPayload {
+			return nil, ErrShort
+		}
+		return Ack{Cmd: p[0], Status: p[1], Arg: le.Uint32(p[2:])}, nil
+	case TypeCRCs:
+		if len(p) < 4 || len(p) < 4+4*int(p[3]) {
+			return nil, ErrShort
+		}
+		c := CRCs{Slot: p[0], Page: le.Uint16(p[1:])}
+		for i := 0; i < int(p[3]); i++ {
+			c.CRC = append(c.CRC, le.Uint32(p[4+4*i:]))
+		}
+		return c, nil
+	}
+	return nil, ErrType
+}
+
+func encodeInfo(seq uint16, in Info) []byte {
+	p := []byte{in.Version, in.Active, in.State[0], in.State[1]}
+	for i := 0; i < 2; i++ {
+		p = binary.LittleEndian.AppendUint32(p, in.Size[i])
+		p = binary.LittleEndian.AppendUint32(p, in.CRC[i])
+	}
+	p = binary.LittleEndian.AppendUint16(p, in.PageSize)
+	p = binary.LittleEndian.AppendUint16(p, in.BlockSize)
+	p = binary.LittleEndian.AppendUint32(p, in.SlotSize)
+	p = binary.LittleEndian.AppendUint16(p, in.DataMax)
+	return Frame(seq, TypeInfo, p)
+}
+
+func encodeAck(seq uint16, a Ack) []byte {
+	p := binary.LittleEndian.AppendUint32([]byte{a.Cmd, a.Status}, a.Arg)
+	return Frame(seq, TypeAck, p)
+}
+
+func encodeCRCs(seq uint16, c CRCs) []byte {
+	p := []byte{c.Slot}
+	p = binary.LittleEndian.AppendUint16(p, c.Page)
+	p = append(p, byte(len(c.CRC)))
+	for _, v := range c.CRC {
+		p = binary.LittleEndian.AppendUint32(p, v)
+	}
+	return Frame(seq, TypeCRCs, p)
+}
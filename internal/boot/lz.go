@@ -0,0 +1,176 @@
+package boot
+
+import "errors"
+
+// LZ page encoding (BOOT_ENC_LZ in firmware_sam/src/boot.h). A page is
+// decoded in place into the block buffer. A copy names an offset into the
+// buffer (the new image so far, a run if it overlaps itself) or, past
+// BlockSize, into the block's flash, which keeps the old image until the
+// COMMIT: a delta against whatever slot held before.
+
+const (
+	lzMinMatch    = 3
+	lzMaxMatch    = 0x7F + lzMinMatch
+	lzMaxLiterals = 0x80
+	lzCandidates  = 48 // positions tried per hash bucket
+)
+
+var ErrLZ = errors.New("boot: malformed LZ page")
+
+// blockView is the host's copy of the block buffer the bootloader decodes
+// into and of the block's flash. known marks bytes the host knows.
+type blockView struct {
+	buf      [BlockSize]byte
+	known    [BlockSize]bool
+	old      [BlockSize]byte
+	oldKnown [BlockSize]bool
+}
+
+func lzKey(a, b, c byte) uint32 {
+	return uint32(a) | uint32(b)<<8 | uint32(c)<<16
+}
+
+// compressPage encodes page for block offset pos against v, then writes
+// the page into v as the bootloader will. It returns nil if the encoding
+// is not smaller than the page.
+func compressPage(v *blockView, pos int, page []byte) []byte {
+	index := make(map[uint32][]int)
+	add := func(i int) {
+		if i >= 0 && i+2 < BlockSize && v.known[i] && v.known[i+1] && v.known[i+2] {
+			k := lzKey(v.buf[i], v.buf[i+1], v.buf[i+2])
+			index[k] = append(index[k], i)
+		}
+	}
+	for i := 0; i+2 < BlockSize; i++ {
+		add(i)
+		if v.oldKnown[i] && v.oldKnown[i+1] && v.oldKnown[i+2] {
+			k := lzKey(v.old[i], v.old[i+1], v.old[i+2])
+			index[k] = append(index[k], BlockSize+i)
+		}
+	}
+
+	// Bytes of this page are written into v.buf as they are produced, so
+	// v.buf always holds what the bootloader's buffer holds at that point
+	matchLen := func(s, out int) int {
+		// A copy stays within the buffer or within the flash block
+		end := BlockSize
+		if s >= BlockSize {
+			end = 2 * BlockSize
+		}
+		n := 0
+		for n < lzMaxMatch && out+n < pos+PageSize && s+n < end {
+			i := s + n
+			var b byte
+			if i >= BlockSize {
+				if !v.oldKnown[i-BlockSize] {
+					break
+				}
+				b = v.old[i-BlockSize]
+			} else if i >= out && i < out+n {
+				// Written by this copy a few bytes back
+				b = page[i-pos]
+			} else if v.known[i] {
+				b = v.buf[i]
+			} else {
+				break
+			}
+			if b != page[out+n-pos] {
+				break
+			}
+			n++
+		}
+		return n
+	}
+
+	var enc, lit []byte
+	flush := func() {
+		for len(lit) > 0 {
+			n := len(lit)
+			if n > lzMaxLiterals {
+				n = lzMaxLiterals
+			}
+			enc = append(enc, byte(n-1))
+			enc = append(enc, lit[:n]...)
+			lit = lit[n:]
+		}
+	}
+	emit := func(out, n int) {
+		for i := 0; i < n; i++ {
+			v.buf[out+i] = page[out+i-pos]
+			v.known[out+i] = true
+		}
+		for i := out - 2; i < out+n; i++ {
+			add(i)
+		}
+	}
+
+	out := pos
+	for out < pos+PageSize {
+		best, bestSrc := 0, 0
+		if out+lzMinMatch <= pos+PageSize {
+			o := out - pos
+			cands := index[lzKey(page[o], page[o+1], page[o+2])]
+			for j := len(cands) - 1; j >= 0 && j >= len(cands)-lzCandidates; j-- {
+				if n := matchLen(cands[j], out); n > best {
+					best, bestSrc = n, cands[j]
+				}
+			}
+		}
+		if best >= lzMinMatch {
+			flush()
+			enc = append(enc, byte(0x80|(best-lzMinMatch)), byte(bestSrc), byte(bestSrc>>8))
+			emit(out, best)
+			out += best
+			continue
+		}
+		lit = append(lit, page[out-pos])
+		emit(out, 1)
+		out++
+	}
+	flush()
+	if len(enc) >= PageSize {
+		return nil
+	}
+	return enc
+}
+
+// unpackPage decodes enc into blk at pos as the bootloader does, old being
+// the block's flash.
+func unpackPage(blk, old []byte, pos int, enc []byte) error {
+	end := pos + PageSize
+	for i := 0; i < len(enc); {
+		t := enc[i]
+		i++
+		if t < 0x80 {
+			n := int(t) + 1
+			if i+n > len(enc) || pos+n > end {
+				return ErrLZ
+			}
+			copy(blk[pos:], enc[i:i+n])
+			pos += n
+			i += n
+			continue
+		}
+		n := int(t&0x7F) + lzMinMatch
+		if i+2 > len(enc) || pos+n > end {
+			return ErrLZ
+		}
+		src := int(enc[i]) | int(enc[i+1])<<8
+		i += 2
+		from := blk
+		if src >= BlockSize {
+			from, src = old, src-BlockSize
+		}
+		if src+n > BlockSize {
+			return ErrLZ
+		}
+		for k := 0; k < n; k++ {
+			blk[pos] = from[src+k]
+			pos++
+		}
+	}
+	if pos != end {
+		return ErrLZ
+	}
+	return nil
+}
@@ -0,0 +1,319 @@
+package boot
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/binary"
+	"hash/crc32"
+	"io"
+
+	"balancing_robot/internal/telemetry"
+)
+
+// Target emulates the bootloader (firmware_sam/src/boot.c) and the flash
+// it manages, for testing uploads without a robot. The boot config is kept
+// as its fields rather than as flash records.
+type Target struct {
+	Slot   [2][]byte // flash content, erased bytes are 0xFF
+	Active uint8
+	State  [2]uint8
+	Size   [2]uint32
+	CRC    [2]uint32
+	Baud   int
+
+	Erases     int // blocks erased
+	PageWrites int // pages programmed
+
+	// Fault injection: DropData drops the nth DATA frame (from 0) as a
+	// CRC error would; FailProgram makes that many block programs fail.
+	DropData    func(n int) bool
+	FailProgram int
+
+	seq       uint16
+	session   bool
+	writing   bool
+	slot      uint8
+	size, crc uint32
+	open      int
+	mask      uint16
+	status    uint8
+	buf       [BlockSize]byte
+	dataCount int
+}
+
+// NewTarget is a part fresh from the programmer: slot A holds app, GOOD
+// with unknown size, as bootcfg_load assumes without a record.
+func NewTarget(app []byte) *Target {
+	t := &Target{Baud: 460800, open: -1}
+	for i := range t.Slot {
+		t.Slot[i] = bytes.Repeat([]byte{0xFF}, SlotSize)
+	}
+	copy(t.Slot[0], app)
+	t.State[0] = SlotGood
+	return t
+}
+
+// Serve answers the frames read from r on w until r ends.
+func (t *Target) Serve(r io.Reader, w io.Writer) error {
+	br := bufio.NewReader(r)
+	var chunk []byte
+	for {
+		b, err := br.ReadByte()
+		if err != nil {
+			if err == io.EOF {
+				return nil
+			}
+			return err
+		}
+		if b != 0 {
+			chunk = append(chunk, b)
+			continue
+		}
+		if len(chunk) > 0 {
+			if raw, err := telemetry.COBSDecode(chunk); err == nil {
+				if reply := t.handle(raw); reply != nil {
+					if _, err := w.Write(reply); err != nil {
+						return err
+					}
+				}
+			}
+		}
+		chunk = chunk[:0]
+	}
+}
+
+func (t *Target) info() Info {
+	return Info{
+		Version: Version, Active: t.Active, State: t.State, Size: t.Size, CRC: t.CRC,
+		PageSize: PageSize, BlockSize: BlockSize, SlotSize: SlotSize, DataMax: PageSize + 12,
+	}
+}
+
+func (t *Target) reply(frame func(seq uint16) []byte) []byte {
+	f := frame(t.seq)
+	t.seq++
+	return f
+}
+
+func (t *Target) ack(cmd, status uint8, arg uint32) []byte {
+	return t.reply(func(seq uint16) []byte { return encodeAck(seq, Ack{cmd, status, arg}) })
+}
+
+func (t *Target) handle(raw []byte) []byte {
+	typ, p, err := Unframe(raw)
+	if err != nil {
+		return nil
+	}
+	if typ == CmdHello {
+		t.session = true
+		return t.reply(func(seq uint16) []byte { return encodeInfo(seq, t.info()) })
+	}
+	if !t.session {
+		return nil
+	}
+	switch typ {
+	case CmdBaud:
+		if len(p) != 4 {
+			return t.ack(typ, StatusArg, 0)
+		}
+		t.Baud = int(binary.LittleEndian.Uint32(p))
+		return t.ack(typ, StatusOK, uint32(t.Baud))
+	case CmdCRCs:
+		return t.crcs(p)
+	case CmdBegin:
+		return t.ack(typ, t.begin(p), 0)
+	case CmdData:
+		n := t.dataCount
+		t.dataCount++
+		if t.DropData != nil && t.DropData(n) {
+			return nil
+		}
+		if s := t.data(p); s != StatusOK && t.status == StatusOK {
+			t.status = s
+		}
+		return nil
+	case CmdCommit:
+		s, arg := t.commit(p)
+		return t.ack(typ, s, arg)
+	case CmdEnd:
+		s, arg := t.end()
+		return t.ack(typ, s, arg)
+	case CmdRollback:
+		other := t.Active ^ 1
+		if t.State[other] != SlotGood {
+			return t.ack(typ, StatusArg, uint32(t.Active))
+		}
+		t.Active = other
+		return t.ack(typ, StatusOK, uint32(t.Active))
+	case CmdRun:
+		a := t.ack(typ, StatusOK, uint32(t.Active))
+		t.session = false
+		t.writing = false
+		return a
+	}
+	return nil
+}
+
+func (t *Target) crcs(p []byte) []byte {
+	if len(p) != 4 || p[0] > 1 {
+		return nil
+	}
+	page := int(binary.LittleEndian.Uint16(p[1:]))
+	n := int(p[3])
+	if n > CRCsMax {
+		n = CRCsMax
+	}
+	if (page+n)*PageSize > SlotSize {
+		return nil
+	}
+	c := CRCs{Slot: p[0], Page: uint16(page)}
+	for i := 0; i < n; i++ {
+		off := (page + i) * PageSize
+		c.CRC = append(c.CRC, crc32.ChecksumIEEE(t.Slot[p[0]][off:off+PageSize]))
+	}
+	return t.reply(func(seq uint16) []byte { return encodeCRCs(seq, c) })
+}
+
+func (t *Target) begin(p []byte) uint8 {
+	if len(p) != 9 || p[0] > 1 {
+		return StatusArg
+	}
+	slot := p[0]
+	size := binary.LittleEndian.Uint32(p[1:])
+	if size == 0 || size > SlotSize {
+		return StatusArg
+	}
+	if slot == t.Active && t.State[slot] != SlotEmpty && t.State[slot] != SlotBad {
+		return StatusArg
+	}
+	t.State[slot], t.Size[slot], t.CRC[slot] = SlotEmpty, 0, 0
+	t.writing = true
+	t.slot, t.size, t.crc = slot, size, binary.LittleEndian.Uint32(p[5:])
+	t.open, t.mask, t.status = -1, 0, StatusOK
+	return StatusOK
+}
+
+func (t *Target) data(p []byte) uint8 {
+	if !t.writing {
+		return StatusState
+	}
+	if len(p) < 3 {
+		return StatusArg
+	}
+	page := int(binary.LittleEndian.Uint16(p))
+	if uint32(page*PageSize) >= t.size {
+		return StatusArg
+	}
+	block := page / PagesPerBlock
+	if t.open < 0 {
+		copy(t.buf[:], t.Slot[t.slot][block*BlockSize:])
+		t.open = block
+	} else if block != t.open {
+		return StatusState
+	}
+	pos := page % PagesPerBlock * PageSize
+	in := p[3:]
+	switch {
+	case p[2] == EncRaw && len(in) == PageSize:
+		copy(t.buf[pos:], in)
+	case p[2] != EncLZ || unpackPage(t.buf[:], t.Slot[t.slot][block*BlockSize:], pos, in) != nil:
+		return StatusData
+	}
+	t.mask |= 1 << (page % PagesPerBlock)
+	return StatusOK
+}
+
+func (t *Target) commit(p []byte) (uint8, uint32) {
+	status, arg := t.status, uint32(0)
+	switch {
+	case len(p) != 4:
+		status = StatusArg
+	case status != StatusOK:
+	case !t.writing:
+		status = StatusState
+	case t.open < 0 || t.mask != binary.LittleEndian.Uint16(p[2:]):
+		status, arg = StatusMissing, uint32(t.mask)
+	case t.open != int(binary.LittleEndian.Uint16(p)):
+		status = StatusState
+	default:
+		n, ok := t.program()
+		if !ok {
+			status = StatusFlash
+		}
+		arg = uint32(n)
+	}
+	t.open, t.mask, t.status = -1, 0, StatusOK
+	return status, arg
+}
+
+func (t *Target) program() (int, bool) {
+	flash := t.Slot[t.slot][t.open*BlockSize : (t.open+1)*BlockSize]
+	if bytes.Equal(flash, t.buf[:]) {
+		return 0, true
+	}
+	for i := range flash {
+		flash[i] = 0xFF
+	}
+	t.Erases++
+	if t.FailProgram > 0 {
+		t.FailProgram--
+		return 0, false
+	}
+	n := 0
+	blank := bytes.Repeat([]byte{0xFF}, PageSize)
+	for i := 0; i < PagesPerBlock; i++ {
+		page := t.buf[i*PageSize : (i+1)*PageSize]
+		if !bytes.Equal(page, blank) {
+			copy(flash[i*PageSize:], page)
+			t.PageWrites++
+			n++
+		}
+	}
+	return n, true
+}
+
+func (t *Target) end() (uint8, uint32) {
+	if !t.writing || t.open >= 0 {
+		return StatusState, 0
+	}
+	crc := crc32.ChecksumIEEE(t.Slot[t.slot][:t.size])
+	if crc != t.crc {
+		return StatusCRC, crc
+	}
+	t.writing = false
+	t.Size[t.slot], t.CRC[t.slot], t.State[t.slot] = t.size, crc, SlotPending
+	t.Active = t.slot
+	return StatusOK, crc
+}
+
+// Reset runs the bootloader's slot selection as after a reset and
+// returns the slot it starts, or false if neither can run.
+func (t *Target) Reset() (uint8, bool) {
+	slot := t.Active
+	switch t.State[slot] {
+	case SlotTried:
+		t.State[slot] = SlotBad
+	case SlotPending:
+		if t.Size[slot] > 0 && crc32.ChecksumIEEE(t.Slot[slot][:t.Size[slot]]) == t.CRC[slot] {
+			t.State[slot] = SlotTried
+		} else {
+			t.State[slot] = SlotBad
+		}
+	}
+	if t.State[slot] == SlotTried || t.State[slot] == SlotGood {
+		return slot, true
+	}
+	slot ^= 1
+	if t.State[slot] != SlotGood {
+		return 0, false
+	}
+	t.Active = slot
+	return slot, true
+}
+
+// Confirm is the application's bootcfg_confirm: the running slot is GOOD.
+func (t *Target) Confirm() {
+	if t.State[t.Active] == SlotTried {
+		t.State[t.Active] = SlotGood
+	}
+}
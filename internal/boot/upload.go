@@ -0,0 +1,409 @@
+package boot
+
+import (
+	"bufio"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"io"
+	"sync/atomic"
+	"time"
+
+	"balancing_robot/internal/telemetry"
+)
+
+var ErrTimeout = errors.New("boot: no reply")
+
+// Stats describes one upload.
+type Stats struct {
+	Pages      int   // pages in the image
+	Skipped    int   // already in flash, not sent
+	Sent       int   // DATA frames, retries included
+	LZ         int   // of those, LZ-encoded
+	DataBytes  int   // page payload bytes sent
+	Blocks     int   // blocks erased and programmed
+	Retries    int   // blocks sent again after a failed COMMIT
+	TxBytes    int64 // everything written to the link
+	RxBytes    int64
+	Elapsed    time.Duration
+	Programmed int // pages programmed, as reported by the bootloader
+}
+
+// WireTime is how long the bytes sent take at baud (8N1), without
+// round-trip latency.
+func (s Stats) WireTime(baud int) time.Duration {
+	return time.Duration(s.TxBytes*10) * time.Second / time.Duration(baud)
+}
+
+// Uploader drives the bootloader over rw (the robot's UART).
+type Uploader struct {
+	rw      io.ReadWriter
+	replies chan interface{}
+	rx      int64
+	seq     uint16
+
+	Timeout       time.Duration // per reply
+	CommitTimeout time.Duration // erase and program of one block
+	Retries       int           // per block
+	Full          bool          // send every page, ignoring what flash holds
+	Stats         Stats
+}
+
+func NewUploader(rw io.ReadWriter) *Uploader {
+	u := &Uploader{
+		rw:            rw,
+		replies:       make(chan interface{}, 64),
+		Timeout:       time.Second,
+		CommitTimeout: 3 * time.Second,
+		Retries:       4,
+	}
+	go u.read()
+	return u
+}
+
+func (u *Uploader) read() {
+	defer close(u.replies)
+	br := bufio.NewReader(u.rw)
+	var chunk []byte
+	for {
+		b, err := br.ReadByte()
+		if err != nil {
+			return
+		}
+		atomic.AddInt64(&u.rx, 1)
+		if b != 0 {
+			chunk = append(chunk, b)
+			continue
+		}
+		if len(chunk) == 0 {
+			continue
+		}
+		// ASCII from the application ("UPDATE OK") and telemetry are skipped
+		if raw, err := telemetry.COBSDecode(chunk); err == nil {
+			if v, err := DecodeReply(raw); err == nil {
+				u.replies <- v
+			}
+		}
+		chunk = chunk[:0]
+	}
+}
+
+func (u *Uploader) send(typ byte, payload []byte) error {
+	f := Frame(u.seq, typ, payload)
+	u.seq++
+	u.Stats.TxBytes += int64(len(f))
+	_, err := u.rw.Write(f)
+	return err
+}
+
+// next returns the next reply accepted by match, dropping others.
+func (u *Uploader) next(timeout time.Duration, match func(interface{}) bool) (interface{}, error) {
+	deadline := time.After(timeout)
+	for {
+		select {
+		case v, ok := <-u.replies:
+			if !ok {
+				return nil, io.EOF
+			}
+			if match(v) {
+				return v, nil
+			}
+		case <-deadline:
+			return nil, ErrTimeout
+		}
+	}
+}
+
+func (u *Uploader) ack(cmd uint8, timeout time.Duration) (Ack, error) {
+	v, err := u.next(timeout, func(v interface{}) bool {
+		a, ok := v.(Ack)
+		return ok && a.Cmd == cmd
+	})
+	if err != nil {
+		return Ack{}, err
+	}
+	return v.(Ack), nil
+}
+
+func (u *Uploader) command(cmd uint8, payload []byte) (Ack, error) {
+	if err := u.send(cmd, payload); err != nil {
+		return Ack{}, err
+	}
+	a, err := u.ack(cmd, u.Timeout)
+	if err == nil && a.Status != StatusOK {
+		err = fmt.Errorf("boot: command 0x%02X: %s", cmd, StatusName(a.Status))
+	}
+	return a, err
+}
+
+// Enter asks a running application to reset into the bootloader. Harmless
+// if the bootloader is already listening.
+func (u *Uploader) Enter() error {
+	_, err := u.rw.Write([]byte("UPDATE\n"))
+	return err
+}
+
+// Hello repeats HELLO until the bootloader answers or wait runs out, e.g.
+// while the robot is power cycled into its listen window.
+func (u *Uploader) Hello(wait time.Duration) (Info, error) {
+	deadline := time.Now().Add(wait)
+	for {
+		if err := u.send(CmdHello, nil); err != nil {
+			return Info{}, err
+		}
+		v, err := u.next(100*time.Millisecond, func(v interface{}) bool {
+			_, ok := v.(Info)
+			return ok
+		})
+		if err == nil {
+			return v.(Info), nil
+		}
+		if err != ErrTimeout || time.Now().After(deadline) {
+			return Info{}, err
+		}
+	}
+}
+
+// Baud switches the link rate. setLocal changes the host side once the
+// bootloader has acked at the old rate.
+func (u *Uploader) Baud(baud int, setLocal func(int) error) error {
+	if _, err := u.command(CmdBaud, binary.LittleEndian.AppendUint32(nil, uint32(baud))); err != nil {
+		return err
+	}
+	if err := setLocal(baud); err != nil {
+		return err
+	}
+	_, err := u.Hello(u.Timeout)
+	return err
+}
+
+// PageCRCs reads the CRC32 of the first n pages of slot, a few queries in
+// flight at a time.
+func (u *Uploader) PageCRCs(slot uint8, n int) ([]uint32, error) {
+	crcs := make([]uint32, n)
+	have := make([]bool, n)
+	const inFlight = 8
+	for try := 0; try <= u.Retries; try++ {
+		var asked []int
+		for p := 0; p < n; p += CRCsMax {
+			if have[p] {
+				continue
+			}
+			cnt := n - p
+			if cnt > CRCsMax {
+				cnt = CRCsMax
+			}
+			q := []byte{slot}
+			q = binary.LittleEndian.AppendUint16(q, uint16(p))
+			if err := u.send(CmdCRCs, append(q, byte(cnt))); err != nil {
+				return nil, err
+			}
+			asked = append(asked, p)
+			if len(asked) == inFlight || p+CRCsMax >= n {
+				if err := u.collectCRCs(slot, asked, crcs, have); err != nil && err != ErrTimeout {
+					return nil, err
+				}
+				asked = asked[:0]
+			}
+		}
+		done := true
+		for _, h := range have {
+			done = done && h
+		}
+		if done {
+			return crcs, nil
+		}
+	}
+	return nil, ErrTimeout
+}
+
+func (u *Uploader) collectCRCs(slot uint8, asked []int, crcs []uint32, have []bool) error {
+	for range asked {
+		v, err := u.next(u.Timeout, func(v interface{}) bool {
+			c, ok := v.(CRCs)
+			return ok && c.Slot == slot
+		})
+		if err != nil {
+			return err
+		}
+		c := v.(CRCs)
+		for i, crc := range c.CRC {
+			if p := int(c.Page) + i; p < len(crcs) {
+				crcs[p] = crc
+				have[p] = true
+			}
+		}
+	}
+	return nil
+}
+
+// UploadSlot is the slot an upload should go to: the one not running,
+// unless the active one holds nothing worth keeping.
+func (in Info) UploadSlot() uint8 {
+	if in.State[in.Active] == SlotEmpty || in.State[in.Active] == SlotBad {
+		return in.Active
+	}
+	return in.Active ^ 1
+}
+
+func pageOf(img []byte, p int) []byte {
+	page := make([]byte, PageSize)
+	for i := range page {
+		page[i] = 0xFF
+	}
+	if off := p * PageSize; off < len(img) {
+		copy(page, img[off:])
+	}
+	return page
+}
+
+// Upload writes image (linked for slot) and makes it the active slot; it
+// starts on the next reset (Run). previous, if not nil, is what the host
+// believes slot holds (the image uploaded there before): pages whose CRC
+// still matches flash serve as the base for delta copies.
+func (u *Uploader) Upload(slot uint8, image, previous []byte) error {
+	start := time.Now()
+	defer func() {
+		u.Stats.RxBytes = atomic.LoadInt64(&u.rx)
+		u.Stats.Elapsed = time.Since(start)
+	}()
+	if len(image) == 0 || len(image) > SlotSize {
+		return fmt.Errorf("boot: image of %d bytes does not fit a %d byte slot", len(image), SlotSize)
+	}
+	pages := (len(image) + PageSize - 1) / PageSize
+	blocks := (pages + PagesPerBlock - 1) / PagesPerBlock
+	u.Stats.Pages = pages
+
+	// Flash content of every page the host can know: unchanged pages and
+	// pages of the previous image that are still there
+	flashCRC, err := u.PageCRCs(slot, blocks*PagesPerBlock)
+	if err != nil {
+		return fmt.Errorf("boot: page CRCs: %w", err)
+	}
+	same := make([]bool, blocks*PagesPerBlock)
+	oldKnown := make([]bool, blocks*PagesPerBlock)
+	for p := range same {
+		if p < pages && !u.Full {
+			same[p] = crc32.ChecksumIEEE(pageOf(image, p)) == flashCRC[p]
+		}
+		if previous != nil && !u.Full {
+			oldKnown[p] = crc32.ChecksumIEEE(pageOf(previous, p)) == flashCRC[p]
+		}
+	}
+
+	begin := []byte{slot}
+	begin = binary.LittleEndian.AppendUint32(begin, uint32(len(image)))
+	begin = binary.LittleEndian.AppendUint32(begin, crc32.ChecksumIEEE(image))
+	if _, err := u.command(CmdBegin, begin); err != nil {
+		return err
+	}
+
+	for b := 0; b < blocks; b++ {
+		if err := u.block(b, pages, image, previous, same, oldKnown); err != nil {
+			return err
+		}
+	}
+
+	a, err := u.command(CmdEnd, nil)
+	if err != nil {
+		return fmt.Errorf("%w (flash CRC %08X)", err, a.Arg)
+	}
+	return nil
+}
+
+// block sends the changed pages of block b and commits them, again after
+// a failed COMMIT.
+func (u *Uploader) block(b, pages int, image, previous []byte, same, oldKnown []bool) error {
+	first := b * PagesPerBlock
+	for try := 0; ; try++ {
+		var v blockView
+		var mask uint16
+		for i := 0; i < PagesPerBlock; i++ {
+			p := first + i
+			switch {
+			case same[p]:
+				copy(v.buf[i*PageSize:], pageOf(image, p))
+			case oldKnown[p]:
+				copy(v.buf[i*PageSize:], pageOf(previous, p))
+			default:
+				continue
+			}
+			for k := 0; k < PageSize; k++ {
+				v.known[i*PageSize+k] = true
+			}
+		}
+		v.old, v.oldKnown = v.buf, v.known
+		for i := 0; i < PagesPerBlock && first+i < pages; i++ {
+			p := first + i
+			if same[p] {
+				if try == 0 {
+					u.Stats.Skipped++
+				}
+				continue
+			}
+			page := pageOf(image, p)
+			payload := binary.LittleEndian.AppendUint16(nil, uint16(p))
+			if enc := compressPage(&v, i*PageSize, page); enc != nil {
+				payload = append(append(payload, EncLZ), enc...)
+				u.Stats.LZ++
+			} else {
+				payload = append(append(payload, EncRaw), page...)
+			}
+			if err := u.send(CmdData, payload); err != nil {
+				return err
+			}
+			u.Stats.Sent++
+			u.Stats.DataBytes += len(payload) - 3
+			mask |= 1 << i
+		}
+		if mask == 0 {
+			return nil
+		}
+
+		commit := binary.LittleEndian.AppendUint16(nil, uint16(b))
+		commit = binary.LittleEndian.AppendUint16(commit, mask)
+		if err := u.send(CmdCommit, commit); err != nil {
+			return err
+		}
+		a, err := u.ack(CmdCommit, u.CommitTimeout)
+		if err == nil && a.Status == StatusOK {
+			if a.Arg > 0 {
+				u.Stats.Blocks++
+				u.Stats.Programmed += int(a.Arg)
+			}
+			return nil
+		}
+		if err != nil && err != ErrTimeout {
+			return err
+		}
+		if try >= u.Retries {
+			if err == nil {
+				err = errors.New(StatusName(a.Status))
+			}
+			return fmt.Errorf("boot: block %d: %w", b, err)
+		}
+		// After a flash error or a lost ack the block's flash content is
+		// unknown: send all of it, without delta copies
+		if err == ErrTimeout || a.Status == StatusFlash {
+			for i := 0; i < PagesPerBlock; i++ {
+				same[first+i] = false
+				oldKnown[first+i] = false
+			}
+		}
+		u.Stats.Retries++
+	}
+}
+
+// Run resets the robot; the bootloader then starts the active slot.
+func (u *Uploader) Run() error {
+	_, err := u.command(CmdRun, nil)
+	return err
+}
+
+// Rollback makes the other slot active again if it holds a good image and
+// returns the slot that will start.
+func (u *Uploader) Rollback() (uint8, error) {
+	a, err := u.command(CmdRollback, nil)
+	return uint8(a.Arg), err
+}
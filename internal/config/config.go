@@ -10,6 +10,7 @@ type Config struct {
 	RateHz         float64      `yaml:"rate_hz"`
 	DurationS      float64      `yaml:"duration_s"`
 	Units          string       `yaml:"units"`
+	Format         string       `yaml:"format"`
 	Seed           int64        `yaml:"seed"`
 	Motion         MotionConfig `yaml:"motion"`
 	GyroNoiseStd   float64      `yaml:"gyro_noise_std"`
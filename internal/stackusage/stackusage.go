@@ -0,0 +1,230 @@
+// Package stackusage adds up worst-case stack depths from GCC's call graph
+// output (-fstack-usage -fcallgraph-info=su, one VCG .ci file per
+// translation unit). Each defined function has its own frame size; the
+// depth of a function is its frame plus the deepest chain of callees.
+// A call through a pointer is resolved to the deepest function that has
+// no direct caller (scheduler tasks, callbacks); pointer calls made from
+// there are not expanded again, or every callback would be charged the
+// deepest task. Functions GCC knows nothing about (libgcc, assembly, those
+// nested pointer calls) count as zero and are listed.
+package stackusage
+
+import (
+	"bufio"
+	"fmt"
+	"io"
+	"regexp"
+	"sort"
+	"strconv"
+	"strings"
+)
+
+// IndirectCall is the callee GCC records for a call through a pointer.
+const IndirectCall = "__indirect_call"
+
+// Func is one function defined in the analysed objects.
+type Func struct {
+	Name    string // the .ci title; static functions are "file.c:name"
+	Loc     string // file:line:col
+	Frame   int    // own frame, bytes
+	Dynamic bool   // alloca or VLA: Frame is only the fixed part
+	Calls   []string
+}
+
+// Graph collects the functions of every parsed file.
+type Graph struct {
+	Funcs map[string]*Func
+}
+
+func NewGraph() *Graph {
+	return &Graph{Funcs: map[string]*Func{}}
+}
+
+var (
+	nodeRe  = regexp.MustCompile(`^node: \{ title: "([^"]*)" label: "([^"]*)"`)
+	edgeRe  = regexp.MustCompile(`^edge: \{ sourcename: "([^"]*)" targetname: "([^"]*)"`)
+	frameRe = regexp.MustCompile(`^(\d+) bytes \(([a-z,]+)\)$`)
+)
+
+// Parse adds the functions and calls of one .ci file.
+func (g *Graph) Parse(r io.Reader) error {
+	s := bufio.NewScanner(r)
+	line := 0
+	for s.Scan() {
+		line++
+		text := strings.TrimSpace(s.Text())
+		if m := nodeRe.FindStringSubmatch(text); m != nil {
+			// label: name\nfile:line:col\nN bytes (static); none for externals
+			parts := strings.Split(m[2], `\n`)
+			if len(parts) < 3 {
+				continue
+			}
+			fm := frameRe.FindStringSubmatch(parts[2])
+			if fm == nil {
+				return fmt.Errorf("line %d: frame %q", line, parts[2])
+			}
+			n, _ := strconv.Atoi(fm[1])
+			f := g.fn(m[1])
+			f.Loc = parts[1]
+			f.Frame = n
+			f.Dynamic = strings.HasPrefix(fm[2], "dynamic")
+			continue
+		}
+		if m := edgeRe.FindStringSubmatch(text); m != nil {
+			f := g.fn(m[1])
+			f.Calls = append(f.Calls, m[2])
+		}
+	}
+	return s.Err()
+}
+
+func (g *Graph) fn(name string) *Func {
+	f, ok := g.Funcs[name]
+	if !ok {
+		f = &Func{Name: name}
+		g.Funcs[name] = f
+	}
+	return f
+}
+
+// Result is the worst-case depth from one function down.
+type Result struct {
+	Name      string
+	Loc       string
+	Frame     int
+	Depth     int      // bytes, this frame included
+	Path      []string // the deepest chain, starting with Name
+	Recursive bool     // a cycle was cut; the true depth is unbounded
+	Dynamic   bool     // a frame on some chain grows at run time
+	Indirect  bool     // a call through a pointer was resolved by guess
+	Unknown   []string // callees without stack information
+}
+
+// Roots are defined functions that nothing else calls directly.
+func (g *Graph) Roots() []string {
+	called := map[string]bool{}
+	for name, f := range g.Funcs {
+		for _, c := range f.Calls {
+			if c != name {
+				called[c] = true
+			}
+		}
+	}
+	var roots []string
+	for name, f := range g.Funcs {
+		if f.Loc != "" && !called[name] {
+			roots = append(roots, name)
+		}
+	}
+	sort.Strings(roots)
+	return roots
+}
+
+// Analyze computes the depth of every defined function. Calls through
+// pointers go to the deepest root accepted by indirect (nil: any root).
+func (g *Graph) Analyze(indirect func(name string) bool) map[string]*Result {
+	a := &analysis{g: g, active: map[string]bool{}}
+	a.done[0] = map[string]*Result{}
+	a.done[1] = map[string]*Result{}
+	for _, name := range g.Roots() {
+		if indirect == nil || indirect(name) {
+			a.targets = append(a.targets, name)
+		}
+	}
+	// Sorted, so cycles are cut in the same place every run
+	names := make([]string, 0, len(g.Funcs))
+	for name, f := range g.Funcs {
+		if f.Loc != "" {
+			names = append(names, name)
+		}
+	}
+	sort.Strings(names)
+	for _, name := range names {
+		a.depth(name)
+	}
+	return a.done[0]
+}
+
+type analysis struct {
+	g       *Graph
+	targets []string
+	done    [2]map[string]*Result // outside and inside a resolved pointer call
+	active  map[string]bool
+	guess   int
+}
+
+func (a *analysis) depth(name string) *Result {
+	done := a.done[0]
+	if a.guess > 0 {
+		done = a.done[1]
+	}
+	if r, ok := done[name]; ok {
+		return r
+	}
+	f := a.g.Funcs[name]
+	r := &Result{Name: name, Path: []string{name}}
+	if f == nil || f.Loc == "" {
+		r.Unknown = []string{name}
+		return r
+	}
+	r.Loc, r.Frame, r.Depth, r.Dynamic = f.Loc, f.Frame, f.Frame, f.Dynamic
+	a.active[name] = true
+	unknown := map[string]bool{}
+	for _, callee := range f.Calls {
+		var sub []*Result
+		switch {
+		case callee == IndirectCall && a.guess > 0:
+			unknown[callee] = true
+			continue
+		case callee == IndirectCall:
+			r.Indirect = true
+			a.guess++
+			for _, t := range a.targets {
+				if !a.active[t] {
+					sub = append(sub, a.depth(t))
+				}
+			}
+			a.guess--
+		case a.active[callee]:
+			// A cycle closed by a guessed target is not recursion in the code
+			r.Recursive = r.Recursive || a.guess == 0
+			continue
+		default:
+			sub = append(sub, a.depth(callee))
+		}
+		for _, s := range sub {
+			r.Recursive = r.Recursive || s.Recursive
+			r.Dynamic = r.Dynamic || s.Dynamic
+			r.Indirect = r.Indirect || s.Indirect
+			for _, u := range s.Unknown {
+				unknown[u] = true
+			}
+			if f.Frame+s.Depth > r.Depth {
+				r.Depth = f.Frame + s.Depth
+				r.Path = append([]string{name}, s.Path...)
+			}
+		}
+	}
+	delete(a.active, name)
+	for u := range unknown {
+		r.Unknown = append(r.Unknown, u)
+	}
+	sort.Strings(r.Unknown)
+	done[name] = r
+	return r
+}
+
+// ByDepth sorts results deepest first, then by name.
+func ByDepth(m map[string]*Result) []*Result {
+	out := make([]*Result, 0, len(m))
+	for _, r := range m {
+		out = append(out, r)
+	}
+	sort.Slice(out, func(i, j int) bool {
+		if out[i].Depth != out[j].Depth {
+			return out[i].Depth > out[j].Depth
+		}
+		return out[i].Name < out[j].Name
+	})
+	return out
+}
@@ -0,0 +1,80 @@
+package stream
+
+import (
+	"encoding/binary"
+	"math"
+
+	"balancing_robot/internal/imu"
+	"balancing_robot/internal/model"
+)
+
+// Binary sample frame read by the AVR firmware (firmware/src/imu_input.h):
+// sync, sequence, time stamp in microseconds modulo 65536, six int16 axes
+// in BMI088 counts and a CRC-8 (poly 0x07) of everything after the sync.
+const (
+	FrameSync = 0xA5
+	FrameSize = 17
+
+	// Counts per rad/s (+-2000 deg/s range) and per m/s^2 (+-3 g range)
+	FrameGyroLSB  = 32768 / (2000 * math.Pi / 180)
+	FrameAccelLSB = 32768 / (3 * model.Gravity)
+)
+
+// EncodeFrame packs one sample. Gyro rates are taken in deg/s when units
+// is "deg", as the emulator writes them, and in rad/s otherwise. Values
+// beyond the sensor range saturate.
+func EncodeFrame(seq uint8, s imu.Sample, units string) []byte {
+	f := make([]byte, FrameSize)
+	f[0] = FrameSync
+	f[1] = seq
+	binary.LittleEndian.PutUint16(f[2:], uint16(int64(math.Round(s.T*1e6))))
+	gyroScale := FrameGyroLSB
+	if units == "deg" {
+		gyroScale *= math.Pi / 180
+	}
+	for i := 0; i < 3; i++ {
+		binary.LittleEndian.PutUint16(f[4+2*i:], uint16(saturate16(s.Gyro[i]*gyroScale)))
+		binary.LittleEndian.PutUint16(f[10+2*i:], uint16(saturate16(s.Accel[i]*FrameAccelLSB)))
+	}
+	f[FrameSize-1] = CRC8(f[1 : FrameSize-1])
+	return f
+}
+
+// DecodeFrame is the inverse of EncodeFrame with SI units and the time
+// stamp left in microseconds.
+func DecodeFrame(f []byte) (seq uint8, stampUS uint16, s imu.Sample, ok bool) {
+	if len(f) != FrameSize || f[0] != FrameSync || CRC8(f[1:FrameSize-1]) != f[FrameSize-1] {
+		return 0, 0, s, false
+	}
+	for i := 0; i < 3; i++ {
+		s.Gyro[i] = float64(int16(binary.LittleEndian.Uint16(f[4+2*i:]))) / FrameGyroLSB
+		s.Accel[i] = float64(int16(binary.LittleEndian.Uint16(f[10+2*i:]))) / FrameAccelLSB
+	}
+	return f[1], binary.LittleEndian.Uint16(f[2:]), s, true
+}
+
+func CRC8(data []byte) uint8 {
+	var crc uint8
+	for _, b := range data {
+		crc ^= b
+		for i := 0; i < 8; i++ {
+			if crc&0x80 != 0 {
+				crc = crc<<1 ^ 0x07
+			} else {
+				crc <<= 1
+			}
+		}
+	}
+	return crc
+}
+
+func saturate16(v float64) int16 {
+	r := math.Round(v)
+	if r > math.MaxInt16 {
+		return math.MaxInt16
+	}
+	if r < math.MinInt16 {
+		return math.MinInt16
+	}
+	return int16(r)
+}
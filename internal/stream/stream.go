@@ -15,10 +15,21 @@ type Streamer struct {
 	stdout *os.File
 	udp    *net.UDPConn
 	format string
+	// Stdout: "csv" lines or "frame", the binary frames of EncodeFrame
+	output string
+	units  string
+	seq    uint8
 }
 
 func New(cfg config.Config) (*Streamer, error) {
-	s := &Streamer{stdout: os.Stdout, format: cfg.UDP.Format}
+	s := &Streamer{stdout: os.Stdout, format: cfg.UDP.Format, output: cfg.Format, units: cfg.Units}
+	switch s.output {
+	case "":
+		s.output = "csv"
+	case "csv", "frame":
+	default:
+		return nil, fmt.Errorf("unknown output format %q", s.output)
+	}
 	if cfg.UDP.Enabled {
 		addr, err := net.ResolveUDPAddr("udp", cfg.UDP.Addr)
 		if err != nil {
@@ -44,6 +55,9 @@ func (s *Streamer) Close() error {
 }
 
 func (s *Streamer) WriteHeader() error {
+	if s.output == "frame" {
+		return nil
+	}
 	_, err := fmt.Fprintln(s.stdout, "t,gx,gy,gz,ax,ay,az")
 	return err
 }
@@ -54,7 +68,13 @@ func (s *Streamer) WriteSample(sample imu.Sample) error {
 		sample.Gyro[0], sample.Gyro[1], sample.Gyro[2],
 		sample.Accel[0], sample.Accel[1], sample.Accel[2],
 	)
-	if _, err := fmt.Fprintln(s.stdout, line); err != nil {
+	if s.output == "frame" {
+		_, err := s.stdout.Write(EncodeFrame(s.seq, sample, s.units))
+		s.seq++
+		if err != nil {
+			return err
+		}
+	} else if _, err := fmt.Fprintln(s.stdout, line); err != nil {
 		return err
 	}
 	if s.udp != nil {
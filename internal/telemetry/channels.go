@@ -0,0 +1,82 @@
+package telemetry
+
+import (
+	"fmt"
+	"math/bits"
+)
+
+// ChannelSet learns channel names and scales from ChannelInfo frames and
+// turns Channels frames into named values.
+type ChannelSet struct {
+	byID   map[uint8]ChannelInfo
+	byName map[string]uint8
+}
+
+func NewChannelSet() *ChannelSet {
+	return &ChannelSet{byID: map[uint8]ChannelInfo{}, byName: map[string]uint8{}}
+}
+
+func (s *ChannelSet) Add(c ChannelInfo) {
+	s.byID[c.ID] = c
+	s.byName[c.Name] = c.ID
+}
+
+// Lookup returns what the firmware last reported for the named channel.
+func (s *ChannelSet) Lookup(name string) (ChannelInfo, bool) {
+	id, ok := s.byName[name]
+	if !ok {
+		return ChannelInfo{}, false
+	}
+	return s.byID[id], true
+}
+
+func (s *ChannelSet) ByID(id uint8) (ChannelInfo, bool) {
+	c, ok := s.byID[id]
+	return c, ok
+}
+
+// Value is one decoded channel value in display units.
+type Value struct {
+	Name  string
+	Value float64
+}
+
+// Values decodes c in id order. Channels not described yet are skipped.
+func (s *ChannelSet) Values(c Channels) []Value {
+	out := make([]Value, 0, len(c.Raw))
+	mask := c.Mask
+	for i := 0; mask != 0 && i < len(c.Raw); i++ {
+		id := uint8(bits.TrailingZeros32(mask))
+		mask &= mask - 1
+		info, ok := s.byID[id]
+		if !ok {
+			continue
+		}
+		div := float64(info.Div)
+		if div == 0 {
+			div = 1
+		}
+		out = append(out, Value{Name: info.Name, Value: float64(c.Raw[i]) / div})
+	}
+	return out
+}
+
+// Get returns the named channel's value from c, if present.
+func (s *ChannelSet) Get(c Channels, name string) (float64, bool) {
+	for _, v := range s.Values(c) {
+		if v.Name == name {
+			return v.Value, true
+		}
+	}
+	return 0, false
+}
+
+// SubscribeCommand is the line that sets the named channel's rate
+// (0 unsubscribes). The channel must have been described already.
+func (s *ChannelSet) SubscribeCommand(name string, hz int) (string, error) {
+	id, ok := s.byName[name]
+	if !ok {
+		return "", fmt.Errorf("unknown channel %q", name)
+	}
+	return fmt.Sprintf("SUB:%d,%d\n", id, hz), nil
+}
@@ -0,0 +1,93 @@
+package telemetry
+
+import (
+	"sync"
+	"time"
+)
+
+// RCLinkStats is the host's view of the command link.
+type RCLinkStats struct {
+	Sent    uint64
+	Acked   uint64
+	RTTLast time.Duration
+	RTTMin  time.Duration
+	RTTMax  time.Duration
+	rttSum  time.Duration
+}
+
+// RTTAvg is the mean round trip over all acks so far.
+func (s RCLinkStats) RTTAvg() time.Duration {
+	if s.Acked == 0 {
+		return 0
+	}
+	return s.rttSum / time.Duration(s.Acked)
+}
+
+// RCSender numbers binary RC commands, stamps them with the host clock and
+// measures the round trip from the robot's acks. Safe for one goroutine
+// sending while another feeds acks.
+type RCSender struct {
+	mu       sync.Mutex
+	start    time.Time
+	seq      uint16
+	echoTick uint32
+	ackAt    time.Time
+	haveAck  bool
+	stats    RCLinkStats
+}
+
+func NewRCSender(now time.Time) *RCSender {
+	return &RCSender{start: now}
+}
+
+func (s *RCSender) hostUs(now time.Time) uint32 {
+	return uint32(now.Sub(s.start) / time.Microsecond)
+}
+
+// Command builds the next command frame to write to the robot.
+func (s *RCSender) Command(throttle, turn float64, enabled bool, mode uint8, now time.Time) []byte {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	c := RCCommand{
+		Seq:        s.seq,
+		HostTimeUs: s.hostUs(now),
+		Throttle:   throttle,
+		Turn:       turn,
+		Enabled:    enabled,
+		Mode:       mode,
+	}
+	if s.haveAck {
+		c.EchoTick = s.echoTick
+		c.EchoHoldUs = uint32(now.Sub(s.ackAt) / time.Microsecond)
+	}
+	s.seq++
+	s.stats.Sent++
+	return EncodeRCCommand(c)
+}
+
+// Ack records an ack received at now and returns its round trip time.
+func (s *RCSender) Ack(a RCAck, now time.Time) time.Duration {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	rtt := time.Duration(s.hostUs(now)-a.HostTimeUs) * time.Microsecond
+	s.echoTick = a.Tick
+	s.ackAt = now
+	s.haveAck = true
+	st := &s.stats
+	st.Acked++
+	st.RTTLast = rtt
+	st.rttSum += rtt
+	if st.Acked == 1 || rtt < st.RTTMin {
+		st.RTTMin = rtt
+	}
+	if rtt > st.RTTMax {
+		st.RTTMax = rtt
+	}
+	return rtt
+}
+
+func (s *RCSender) Stats() RCLinkStats {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	return s.stats
+}
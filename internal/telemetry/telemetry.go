@@ -0,0 +1,808 @@
+// Package telemetry decodes the SAME51 firmware's binary telemetry frames
+// (firmware_sam/src/telemetry.h). A frame is seq (u16) | type (u8) |
+// payload | CRC16-CCITT (u16), little-endian, COBS-encoded between 0x00
+// delimiters. ASCII replies from the firmware arrive as their own chunks.
+package telemetry
+
+import (
+	"bufio"
+	"encoding/binary"
+	"errors"
+	"io"
+	"math"
+	"math/bits"
+	"time"
+)
+
+const (
+	TypeState    = 0x01
+	TypeStatus   = 0x02
+	TypeBBInfo   = 0x03
+	TypeBBRecord = 0x04
+	TypeBBEnd    = 0x05
+	TypeRCAck    = 0x06
+	TypeRCLink   = 0x07
+	TypeChannels = 0x08
+	TypeChanInfo = 0x09
+	TypeChanPlan = 0x0A
+	TypeShutdown = 0x0B
+	TypeRAM      = 0x0F
+
+	// TypeRCCommand frames go from the host to the robot.
+	TypeRCCommand = 0x81
+
+	// LoopHz is the control tick rate that State.Tick counts in.
+	LoopHz = 1000
+
+	angleScale = 100.0 // centidegrees
+	rateScale  = 10.0  // 0.1 deg/s
+
+	statePayload    = 21
+	statusPayload   = 48
+	bbInfoPayload   = 9
+	bbRecordPayload = 38
+	bbEndPayload    = 2
+	rcAckPayload    = 10
+	rcLinkPayload   = 20
+	rcCmdPayload    = 18
+	chanHeader      = 8
+	chanInfoFixed   = 7
+	chanPlanPayload = 24
+	shutdownPayload = 20
+	ramPayload      = 32
+	maxChunk        = 4096
+)
+
+var (
+	ErrCOBS  = errors.New("telemetry: bad COBS encoding")
+	ErrShort = errors.New("telemetry: frame too short")
+	ErrCRC   = errors.New("telemetry: CRC mismatch")
+	ErrType  = errors.New("telemetry: unknown frame type")
+)
+
+// State is the control loop snapshot sent every TELEMETRY_PERIOD ticks.
+type State struct {
+	Seq            uint16
+	Tick           uint32
+	RollDeg        float64
+	PitchDeg       float64
+	PitchRateDps   float64
+	TargetPitchDeg float64
+	Balance        float64 // PID output, steps/s
+	Left           float64 // motor command, steps/s
+	Right          float64
+	State          uint8
+	Mode           uint8
+	Enabled        bool
+}
+
+// TimeS is the firmware time of the sample in seconds.
+func (s State) TimeS() float64 {
+	return float64(s.Tick) / LoopHz
+}
+
+// Status carries loop health counters and TMC2209 diagnostics, left then right.
+type Status struct {
+	Seq         uint16
+	LatAvgUs    uint16
+	LatMaxUs    uint16
+	Missed      uint32
+	DMAOverruns uint32
+	TxDropped   uint32
+	SG          [2]uint16
+	TStep       [2]uint32
+	DrvStatus   [2]uint32
+	RxOverruns  uint32 // XBee UART hardware buffer overflows
+	RxFrameErrs uint32
+	RxDropped   uint32 // bytes lost to a full RX ring
+}
+
+// Blackbox trigger reasons and dump sources (firmware_sam/src/blackbox.h).
+const (
+	BBTrigNone    = 0
+	BBTrigTilt    = 1
+	BBTrigDisarm  = 2
+	BBTrigTimeout = 3
+	BBTrigManual  = 4
+
+	BBSrcRAM   = 0
+	BBSrcFlash = 1
+)
+
+// BBInfo opens a blackbox dump.
+type BBInfo struct {
+	Seq         uint16
+	Source      uint8
+	Reason      uint8
+	RecordSize  uint8
+	Count       uint16
+	TriggerTick uint32
+}
+
+// BBRecord is one control tick from the blackbox, oldest first by Index.
+type BBRecord struct {
+	Seq            uint16
+	Index          uint16
+	Tick           uint32
+	Accel          [3]int16 // raw LSB
+	Gyro           [3]int16
+	RollDeg        float64
+	PitchDeg       float64
+	TargetPitchDeg float64
+	PTerm          float64 // steps/s
+	ITerm          float64
+	DTerm          float64
+	Left           float64
+	Right          float64
+	LatencyUs      uint16
+	State          uint8
+	Mode           uint8
+	Enabled        bool
+}
+
+// BBEnd closes a blackbox dump.
+type BBEnd struct {
+	Seq   uint16
+	Count uint16
+}
+
+// RCCommand is a binary RC command (firmware_sam/src/rc_input.h). Seq
+// numbers the commands; EchoTick and EchoHoldUs return the newest RCAck
+// the host has seen so the robot can measure the round trip too.
+type RCCommand struct {
+	Seq        uint16
+	HostTimeUs uint32
+	EchoTick   uint32
+	EchoHoldUs uint32 // time between receiving that ack and sending this
+	Throttle   float64
+	Turn       float64
+	Enabled    bool
+	Mode       uint8
+}
+
+// RCAck answers every RCCommand with the robot's tick at reception.
+type RCAck struct {
+	Seq        uint16
+	CmdSeq     uint16
+	HostTimeUs uint32 // echoed from the command
+	Tick       uint32
+}
+
+// RCLink is the robot's view of the command link, sent at 8 Hz. The RTT
+// figures cover the window since the previous RCLink.
+type RCLink struct {
+	Seq      uint16
+	Frames   uint32
+	Lost     uint32
+	Late     uint32 // reordered or repeated
+	Bad      uint32 // CRC, COBS or length errors
+	RTTAvgMs float64
+	RTTMaxMs float64
+}
+
+// Channels carries the subscribed channels due on one tick. Raw holds one
+// value per set Mask bit in ascending id order; ChannelSet gives them names.
+type Channels struct {
+	Seq  uint16
+	Tick uint32
+	Mask uint32
+	Raw  []int16
+}
+
+// ChannelInfo describes one channel (firmware_sam/src/channels.h). The
+// value in display units is raw / Div. GrantedHz is 0 when not sent.
+type ChannelInfo struct {
+	Seq       uint16
+	ID        uint8
+	Div       uint16
+	ReqHz     uint16
+	GrantedHz uint16
+	Name      string
+}
+
+// ChanPlan is the firmware's subscription plan against the link budget.
+// The masks have one bit per channel id.
+type ChanPlan struct {
+	Seq        uint16
+	BudgetBps  uint32
+	PlannedBps uint32
+	Skipped    uint32 // frames not sent because the TX ring was full
+	Subscribed uint32
+	Degraded   uint32 // granted below the requested rate
+	Dropped    uint32 // not sent at all
+}
+
+// Shutdown reports one back-rest arm shutdown sequence
+// (firmware_sam/README.md): the control tick each phase started on and the
+// pitch in degrees when the robot started leaning back and when the
+// motors were cut. Ticks count at LoopHz.
+type Shutdown struct {
+	Seq         uint16
+	RetractTick uint32 // arm raised on the last START BALANCE
+	LowerTick   uint32 // shutdown requested, arm lowering
+	LeanTick    uint32 // arm down, target biased backward
+	OffTick     uint32 // motors disabled
+	LeanPitch   float64
+	OffPitch    float64
+}
+
+// ArmTravel is the time allowed for the arm to come down.
+func (s Shutdown) ArmTravel() time.Duration {
+	return time.Duration(s.LeanTick-s.LowerTick) * time.Millisecond
+}
+
+// RAM is the firmware's memory use (firmware_sam/src/stack.h), sent once
+// a second. Sizes are in bytes. StackUsed is the high-water mark of the
+// canary scan; Faults counts stack guard hits since power-up, each of
+// which reset the robot.
+type RAM struct {
+	Seq       uint16
+	Data      uint32 // .data and .ramfunc
+	BSS       uint32
+	Free      uint32 // between .bss and the stack, no heap
+	NoInit    uint32
+	Stack     uint32 // usable, above the guard
+	StackUsed uint32
+	Faults    uint32
+	FaultAddr uint32 // data address of the last hit, 0 if not known
+}
+
+// StackHeadroom is the stack never yet touched.
+func (r RAM) StackHeadroom() uint32 {
+	if r.StackUsed > r.Stack {
+		return 0
+	}
+	return r.Stack - r.StackUsed
+}
+
+// CRC16 is CRC16-CCITT (poly 0x1021, init 0xFFFF, no reflection).
+func CRC16(data []byte) uint16 {
+	crc := uint16(0xFFFF)
+	for _, b := range data {
+		crc ^= uint16(b) << 8
+		for i := 0; i < 8; i++ {
+			if crc&0x8000 != 0 {
+				crc = crc<<1 ^ 0x1021
+			} else {
+				crc <<= 1
+			}
+		}
+	}
+	return crc
+}
+
+// COBSEncode encodes raw without the 0x00 delimiters.
+func COBSEncode(raw []byte) []byte {
+	out := make([]byte, 1, len(raw)+len(raw)/254+2)
+	codeAt := 0
+	code := byte(1)
+	for _, b := range raw {
+		if b != 0 {
+			out = append(out, b)
+			code++
+		}
+		if b == 0 || code == 0xFF {
+			out[codeAt] = code
+			codeAt = len(out)
+			out = append(out, 0)
+			code = 1
+		}
+	}
+	out[codeAt] = code
+	return out
+}
+
+// COBSDecode reverses COBSEncode; enc must not contain the delimiters.
+func COBSDecode(enc []byte) ([]byte, error) {
+	out := make([]byte, 0, len(enc))
+	for i := 0; i < len(enc); {
+		code := int(enc[i])
+		if code == 0 || i+code > len(enc) {
+			return nil, ErrCOBS
+		}
+		out = append(out, enc[i+1:i+code]...)
+		i += code
+		if code < 0xFF && i < len(enc) {
+			out = append(out, 0)
+		}
+	}
+	return out, nil
+}
+
+// Decode parses one COBS-decoded frame into a State or Status.
+func Decode(raw []byte) (interface{}, error) {
+	if len(raw) < 5 {
+		return nil, ErrShort
+	}
+	body := raw[:len(raw)-2]
+	if CRC16(body) != binary.LittleEndian.Uint16(raw[len(raw)-2:]) {
+		return nil, ErrCRC
+	}
+	seq := binary.LittleEndian.Uint16(body)
+	p := body[3:]
+	switch body[2] {
+	case TypeState:
+		if len(p) < statePayload {
+			return nil, ErrShort
+		}
+		q := func(off int, scale float64) float64 {
+			return float64(int16(binary.LittleEndian.Uint16(p[off:]))) / scale
+		}
+		return State{
+			Seq:            seq,
+			Tick:           binary.LittleEndian.Uint32(p),
+			RollDeg:        q(4, angleScale),
+			PitchDeg:       q(6, angleScale),
+			PitchRateDps:   q(8, rateScale),
+			TargetPitchDeg: q(10, angleScale),
+			Balance:        q(12, 1),
+			Left:           q(14, 1),
+			Right:          q(16, 1),
+			State:          p[18],
+			Mode:           p[19],
+			Enabled:        p[20] != 0,
+		}, nil
+	case TypeStatus:
+		if len(p) < statusPayload {
+			return nil, ErrShort
+		}
+		u16 := func(off int) uint16 { return binary.LittleEndian.Uint16(p[off:]) }
+		u32 := func(off int) uint32 { return binary.LittleEndian.Uint32(p[off:]) }
+		return Status{
+			Seq:         seq,
+			LatAvgUs:    u16(0),
+			LatMaxUs:    u16(2),
+			Missed:      u32(4),
+			DMAOverruns: u32(8),
+			TxDropped:   u32(12),
+			SG:          [2]uint16{u16(16), u16(18)},
+			TStep:       [2]uint32{u32(20), u32(24)},
+			DrvStatus:   [2]uint32{u32(28), u32(32)},
+			RxOverruns:  u32(36),
+			RxFrameErrs: u32(40),
+			RxDropped:   u32(44),
+		}, nil
+	case TypeBBInfo:
+		if len(p) < bbInfoPayload {
+			return nil, ErrShort
+		}
+		return BBInfo{
+			Seq:         seq,
+			Source:      p[0],
+			Reason:      p[1],
+			RecordSize:  p[2],
+			Count:       binary.LittleEndian.Uint16(p[3:]),
+			TriggerTick: binary.LittleEndian.Uint32(p[5:]),
+		}, nil
+	case TypeBBRecord:
+		if len(p) < bbRecordPayload {
+			return nil, ErrShort
+		}
+		i16 := func(off int) int16 { return int16(binary.LittleEndian.Uint16(p[off:])) }
+		q := func(off int, scale float64) float64 { return float64(i16(off)) / scale }
+		return BBRecord{
+			Seq:            seq,
+			Index:          binary.LittleEndian.Uint16(p),
+			Tick:           binary.LittleEndian.Uint32(p[2:]),
+			Accel:          [3]int16{i16(6), i16(8), i16(10)},
+			Gyro:           [3]int16{i16(12), i16(14), i16(16)},
+			RollDeg:        q(18, angleScale),
+			PitchDeg:       q(20, angleScale),
+			TargetPitchDeg: q(22, angleScale),
+			PTerm:          q(24, 1),
+			ITerm:          q(26, 1),
+			DTerm:          q(28, 1),
+			Left:           q(30, 1),
+			Right:          q(32, 1),
+			LatencyUs:      binary.LittleEndian.Uint16(p[34:]),
+			State:          p[36],
+			Mode:           p[37] & 0x7F,
+			Enabled:        p[37]&0x80 != 0,
+		}, nil
+	case TypeBBEnd:
+		if len(p) < bbEndPayload {
+			return nil, ErrShort
+		}
+		return BBEnd{Seq: seq, Count: binary.LittleEndian.Uint16(p)}, nil
+	case TypeRCAck:
+		if len(p) < rcAckPayload {
+			return nil, ErrShort
+		}
+		return RCAck{
+			Seq:        seq,
+			CmdSeq:     binary.LittleEndian.Uint16(p),
+			HostTimeUs: binary.LittleEndian.Uint32(p[2:]),
+			Tick:       binary.LittleEndian.Uint32(p[6:]),
+		}, nil
+	case TypeRCLink:
+		if len(p) < rcLinkPayload {
+			return nil, ErrShort
+		}
+		u32 := func(off int) uint32 { return binary.LittleEndian.Uint32(p[off:]) }
+		ms := func(off int) float64 { return float64(binary.LittleEndian.Uint16(p[off:])) / 10 }
+		return RCLink{
+			Seq:      seq,
+			Frames:   u32(0),
+			Lost:     u32(4),
+			Late:     u32(8),
+			Bad:      u32(12),
+			RTTAvgMs: ms(16),
+			RTTMaxMs: ms(18),
+		}, nil
+	case TypeChannels:
+		if len(p) < chanHeader {
+			return nil, ErrShort
+		}
+		mask := binary.LittleEndian.Uint32(p[4:])
+		n := bits.OnesCount32(mask)
+		if len(p) < chanHeader+2*n {
+			return nil, ErrShort
+		}
+		raw := make([]int16, n)
+		for i := range raw {
+			raw[i] = int16(binary.LittleEndian.Uint16(p[chanHeader+2*i:]))
+		}
+		return Channels{Seq: seq, Tick: binary.LittleEndian.Uint32(p), Mask: mask, Raw: raw}, nil
+	case TypeChanInfo:
+		if len(p) < chanInfoFixed {
+			return nil, ErrShort
+		}
+		return ChannelInfo{
+			Seq:       seq,
+			ID:        p[0],
+			Div:       binary.LittleEndian.Uint16(p[1:]),
+			ReqHz:     binary.LittleEndian.Uint16(p[3:]),
+			GrantedHz: binary.LittleEndian.Uint16(p[5:]),
+			Name:      string(p[chanInfoFixed:]),
+		}, nil
+	case TypeChanPlan:
+		if len(p) < chanPlanPayload {
+			return nil, ErrShort
+		}
+		u32 := func(off int) uint32 { return binary.LittleEndian.Uint32(p[off:]) }
+		return ChanPlan{
+			Seq:        seq,
+			BudgetBps:  u32(0),
+			PlannedBps: u32(4),
+			Skipped:    u32(8),
+			Subscribed: u32(12),
+			Degraded:   u32(16),
+			Dropped:    u32(20),
+		}, nil
+	case TypeShutdown:
+		if len(p) < shutdownPayload {
+			return nil, ErrShort
+		}
+		return Shutdown{
+			Seq:         seq,
+			RetractTick: binary.LittleEndian.Uint32(p),
+			LowerTick:   binary.LittleEndian.Uint32(p[4:]),
+			LeanTick:    binary.LittleEndian.Uint32(p[8:]),
+			OffTick:     binary.LittleEndian.Uint32(p[12:]),
+			LeanPitch:   float64(int16(binary.LittleEndian.Uint16(p[16:]))) / angleScale,
+			OffPitch:    float64(int16(binary.LittleEndian.Uint16(p[18:]))) / angleScale,
+		}, nil
+	case TypeRAM:
+		if len(p) < ramPayload {
+			return nil, ErrShort
+		}
+		u32 := func(off int) uint32 { return binary.LittleEndian.Uint32(p[off:]) }
+		return RAM{
+			Seq:       seq,
+			Data:      u32(0),
+			BSS:       u32(4),
+			Free:      u32(8),
+			NoInit:    u32(12),
+			Stack:     u32(16),
+			StackUsed: u32(20),
+			Faults:    u32(24),
+			FaultAddr: u32(28),
+		}, nil
+	case TypeRCCommand:
+		if len(p) < rcCmdPayload {
+			return nil, ErrShort
+		}
+		return RCCommand{
+			Seq:        seq,
+			HostTimeUs: binary.LittleEndian.Uint32(p),
+			EchoTick:   binary.LittleEndian.Uint32(p[4:]),
+			EchoHoldUs: binary.LittleEndian.Uint32(p[8:]),
+			Throttle:   float64(int16(binary.LittleEndian.Uint16(p[12:]))) / 1000,
+			Turn:       float64(int16(binary.LittleEndian.Uint16(p[14:]))) / 1000,
+			Enabled:    p[16]&1 != 0,
+			Mode:       p[17],
+		}, nil
+	}
+	return nil, ErrType
+}
+
+func frame(seq uint16, typ byte, payload []byte) []byte {
+	raw := make([]byte, 3, 3+len(payload)+2)
+	binary.LittleEndian.PutUint16(raw, seq)
+	raw[2] = typ
+	raw = append(raw, payload...)
+	raw = binary.LittleEndian.AppendUint16(raw, CRC16(raw))
+	out := append([]byte{0}, COBSEncode(raw)...)
+	return append(out, 0)
+}
+
+func putQ(b []byte, v, scale float64) {
+	q := v * scale
+	if q < 0 {
+		q -= 0.5
+	} else {
+		q += 0.5
+	}
+	if q > 32767 {
+		q = 32767
+	}
+	if q < -32768 {
+		q = -32768
+	}
+	binary.LittleEndian.PutUint16(b, uint16(int16(q)))
+}
+
+// EncodeState builds the wire bytes (with delimiters) the firmware sends for s.
+func EncodeState(s State) []byte {
+	p := make([]byte, statePayload)
+	binary.LittleEndian.PutUint32(p, s.Tick)
+	putQ(p[4:], s.RollDeg, angleScale)
+	putQ(p[6:], s.PitchDeg, angleScale)
+	putQ(p[8:], s.PitchRateDps, rateScale)
+	putQ(p[10:], s.TargetPitchDeg, angleScale)
+	putQ(p[12:], s.Balance, 1)
+	putQ(p[14:], s.Left, 1)
+	putQ(p[16:], s.Right, 1)
+	p[18] = s.State
+	p[19] = s.Mode
+	if s.Enabled {
+		p[20] = 1
+	}
+	return frame(s.Seq, TypeState, p)
+}
+
+// EncodeStatus builds the wire bytes (with delimiters) the firmware sends for s.
+func EncodeStatus(s Status) []byte {
+	p := make([]byte, 0, statusPayload)
+	p = binary.LittleEndian.AppendUint16(p, s.LatAvgUs)
+	p = binary.LittleEndian.AppendUint16(p, s.LatMaxUs)
+	p = binary.LittleEndian.AppendUint32(p, s.Missed)
+	p = binary.LittleEndian.AppendUint32(p, s.DMAOverruns)
+	p = binary.LittleEndian.AppendUint32(p, s.TxDropped)
+	p = binary.LittleEndian.AppendUint16(p, s.SG[0])
+	p = binary.LittleEndian.AppendUint16(p, s.SG[1])
+	p = binary.LittleEndian.AppendUint32(p, s.TStep[0])
+	p = binary.LittleEndian.AppendUint32(p, s.TStep[1])
+	p = binary.LittleEndian.AppendUint32(p, s.DrvStatus[0])
+	p = binary.LittleEndian.AppendUint32(p, s.DrvStatus[1])
+	p = binary.LittleEndian.AppendUint32(p, s.RxOverruns)
+	p = binary.LittleEndian.AppendUint32(p, s.RxFrameErrs)
+	p = binary.LittleEndian.AppendUint32(p, s.RxDropped)
+	return frame(s.Seq, TypeStatus, p)
+}
+
+// EncodeBBRecord builds the wire bytes (with delimiters) of one dumped record.
+func EncodeBBRecord(r BBRecord) []byte {
+	p := make([]byte, bbRecordPayload)
+	binary.LittleEndian.PutUint16(p, r.Index)
+	binary.LittleEndian.PutUint32(p[2:], r.Tick)
+	for i := 0; i < 3; i++ {
+		binary.LittleEndian.PutUint16(p[6+2*i:], uint16(r.Accel[i]))
+		binary.LittleEndian.PutUint16(p[12+2*i:], uint16(r.Gyro[i]))
+	}
+	putQ(p[18:], r.RollDeg, angleScale)
+	putQ(p[20:], r.PitchDeg, angleScale)
+	putQ(p[22:], r.TargetPitchDeg, angleScale)
+	putQ(p[24:], r.PTerm, 1)
+	putQ(p[26:], r.ITerm, 1)
+	putQ(p[28:], r.DTerm, 1)
+	putQ(p[30:], r.Left, 1)
+	putQ(p[32:], r.Right, 1)
+	binary.LittleEndian.PutUint16(p[34:], r.LatencyUs)
+	p[36] = r.State
+	p[37] = r.Mode & 0x7F
+	if r.Enabled {
+		p[37] |= 0x80
+	}
+	return frame(r.Seq, TypeBBRecord, p)
+}
+
+// EncodeBBInfo builds the wire bytes (with delimiters) of a dump header.
+func EncodeBBInfo(b BBInfo) []byte {
+	p := []byte{b.Source, b.Reason, b.RecordSize}
+	p = binary.LittleEndian.AppendUint16(p, b.Count)
+	p = binary.LittleEndian.AppendUint32(p, b.TriggerTick)
+	return frame(b.Seq, TypeBBInfo, p)
+}
+
+// EncodeBBEnd builds the wire bytes (with delimiters) of a dump trailer.
+func EncodeBBEnd(b BBEnd) []byte {
+	return frame(b.Seq, TypeBBEnd, binary.LittleEndian.AppendUint16(nil, b.Count))
+}
+
+// EncodeRCCommand builds the wire bytes (with delimiters) of a command
+// for the robot. Throttle and turn are clamped to [-1, 1].
+func EncodeRCCommand(c RCCommand) []byte {
+	unit := func(v float64) float64 { return math.Max(-1, math.Min(1, v)) }
+	p := make([]byte, rcCmdPayload)
+	binary.LittleEndian.PutUint32(p, c.HostTimeUs)
+	binary.LittleEndian.PutUint32(p[4:], c.EchoTick)
+	binary.LittleEndian.PutUint32(p[8:], c.EchoHoldUs)
+	putQ(p[12:], unit(c.Throttle), 1000)
+	putQ(p[14:], unit(c.Turn), 1000)
+	if c.Enabled {
+		p[16] = 1
+	}
+	p[17] = c.Mode
+	return frame(c.Seq, TypeRCCommand, p)
+}
+
+// EncodeRCAck builds the wire bytes (with delimiters) the firmware sends for a.
+func EncodeRCAck(a RCAck) []byte {
+	p := binary.LittleEndian.AppendUint16(nil, a.CmdSeq)
+	p = binary.LittleEndian.AppendUint32(p, a.HostTimeUs)
+	p = binary.LittleEndian.AppendUint32(p, a.Tick)
+	return frame(a.Seq, TypeRCAck, p)
+}
+
+// EncodeChannels builds the wire bytes (with delimiters) of a channel frame.
+func EncodeChannels(c Channels) []byte {
+	p := binary.LittleEndian.AppendUint32(nil, c.Tick)
+	p = binary.LittleEndian.AppendUint32(p, c.Mask)
+	for _, v := range c.Raw {
+		p = binary.LittleEndian.AppendUint16(p, uint16(v))
+	}
+	return frame(c.Seq, TypeChannels, p)
+}
+
+// EncodeChannelInfo builds the wire bytes (with delimiters) of a channel description.
+func EncodeChannelInfo(c ChannelInfo) []byte {
+	p := []byte{c.ID}
+	p = binary.LittleEndian.AppendUint16(p, c.Div)
+	p = binary.LittleEndian.AppendUint16(p, c.ReqHz)
+	p = binary.LittleEndian.AppendUint16(p, c.GrantedHz)
+	return frame(c.Seq, TypeChanInfo, append(p, c.Name...))
+}
+
+// EncodeShutdown builds the wire bytes (with delimiters) of a shutdown report.
+func EncodeShutdown(s Shutdown) []byte {
+	p := binary.LittleEndian.AppendUint32(nil, s.RetractTick)
+	p = binary.LittleEndian.AppendUint32(p, s.LowerTick)
+	p = binary.LittleEndian.AppendUint32(p, s.LeanTick)
+	p = binary.LittleEndian.AppendUint32(p, s.OffTick)
+	p = append(p, 0, 0, 0, 0)
+	putQ(p[16:], s.LeanPitch, angleScale)
+	putQ(p[18:], s.OffPitch, angleScale)
+	return frame(s.Seq, TypeShutdown, p)
+}
+
+// EncodeRAM builds the wire bytes (with delimiters) the firmware sends for r.
+func EncodeRAM(r RAM) []byte {
+	var p []byte
+	for _, v := range []uint32{r.Data, r.BSS, r.Free, r.NoInit, r.Stack, r.StackUsed, r.Faults, r.FaultAddr} {
+		p = binary.LittleEndian.AppendUint32(p, v)
+	}
+	return frame(r.Seq, TypeRAM, p)
+}
+
+// Stats counts what a Reader has seen so far.
+type Stats struct {
+	Frames    uint64
+	Lost      uint64 // frames missing from the sequence
+	CRCErrors uint64
+	Malformed uint64
+}
+
+// Reader splits a byte stream into frames and ASCII text.
+type Reader struct {
+	br      *bufio.Reader
+	lastSeq uint16
+	haveSeq bool
+	Stats   Stats
+}
+
+func NewReader(r io.Reader) *Reader {
+	return &Reader{br: bufio.NewReader(r)}
+}
+
+// Next returns the next State or Status, or a string for an ASCII chunk
+// (which may hold several lines). Chunks that are neither are counted in
+// Stats and skipped.
+func (r *Reader) Next() (interface{}, error) {
+	var chunk []byte
+	for {
+		b, err := r.br.ReadByte()
+		if err != nil {
+			return nil, err
+		}
+		if b != 0 {
+			if len(chunk) < maxChunk {
+				chunk = append(chunk, b)
+			}
+			continue
+		}
+		if len(chunk) == 0 {
+			continue
+		}
+		if v, ok := r.decode(chunk); ok {
+			return v, nil
+		}
+		chunk = chunk[:0]
+	}
+}
+
+func (r *Reader) decode(chunk []byte) (interface{}, bool) {
+	raw, err := COBSDecode(chunk)
+	var v interface{}
+	if err == nil {
+		v, err = Decode(raw)
+	}
+	if err == nil {
+		r.track(binary.LittleEndian.Uint16(raw))
+		return v, true
+	}
+	if printable(chunk) {
+		return string(chunk), true
+	}
+	if err == ErrCRC {
+		r.Stats.CRCErrors++
+	} else {
+		r.Stats.Malformed++
+	}
+	return nil, false
+}
+
+func (r *Reader) track(seq uint16) {
+	if r.haveSeq {
+		r.Stats.Lost += uint64(seq - r.lastSeq - 1)
+	}
+	r.lastSeq = seq
+	r.haveSeq = true
+	r.Stats.Frames++
+}
+
+func printable(b []byte) bool {
+	for _, c := range b {
+		if (c < 0x20 || c > 0x7E) && c != '\r' && c != '\n' && c != '\t' {
+			return false
+		}
+	}
+	return true
+}
+
+// BBDump collects the frames of one blackbox dump.
+type BBDump struct {
+	Info     BBInfo
+	Records  []BBRecord
+	Started  bool
+	Complete bool
+}
+
+// Add feeds one item from Reader.Next and reports whether the dump ended.
+// Frames before the BBInfo header are ignored.
+func (d *BBDump) Add(v interface{}) bool {
+	switch f := v.(type) {
+	case BBInfo:
+		*d = BBDump{Info: f, Started: true, Records: make([]BBRecord, 0, f.Count)}
+	case BBRecord:
+		if d.Started {
+			d.Records = append(d.Records, f)
+		}
+	case BBEnd:
+		if d.Started {
+			d.Complete = true
+		}
+	}
+	return d.Complete
+}
+
+// Missing counts records announced by the header but not received.
+func (d *BBDump) Missing() int {
+	seen := make(map[uint16]bool, len(d.Records))
+	for _, r := range d.Records {
+		if r.Index < d.Info.Count {
+			seen[r.Index] = true
+		}
+	}
+	return int(d.Info.Count) - len(seen)
+}
@@ -0,0 +1,64 @@
+package tests
+
+import (
+	"bytes"
+	"io"
+	"testing"
+
+	"balancing_robot/internal/telemetry"
+)
+
+func TestBlackboxDumpDecode(t *testing.T) {
+	var stream bytes.Buffer
+	// Live telemetry keeps flowing around the dump
+	stream.Write(telemetry.EncodeState(telemetry.State{Seq: 1}))
+	stream.Write(telemetry.EncodeBBInfo(telemetry.BBInfo{
+		Seq: 2, Source: telemetry.BBSrcFlash, Reason: telemetry.BBTrigTilt, RecordSize: 36, Count: 4, TriggerTick: 5000,
+	}))
+	for i := uint16(0); i < 4; i++ {
+		rec := telemetry.BBRecord{
+			Seq: 3 + i, Index: i, Tick: 4998 + uint32(i),
+			Accel: [3]int16{-120, 30, 10920}, Gyro: [3]int16{5, -16400, 0},
+			RollDeg: 0.5, PitchDeg: -41.25, TargetPitchDeg: 0, PTerm: -2062, ITerm: 0, DTerm: 37,
+			Left: -1000, Right: -1000, LatencyUs: 312, State: 2, Mode: 3, Enabled: i < 2,
+		}
+		wire := telemetry.EncodeBBRecord(rec)
+		if i == 2 {
+			wire[len(wire)-3] ^= 0x01 // corrupt the CRC: record 2 is lost
+		}
+		stream.Write(wire)
+	}
+	stream.WriteString("MS OK\r\n")
+	stream.Write(telemetry.EncodeBBEnd(telemetry.BBEnd{Seq: 7, Count: 4}))
+
+	var dump telemetry.BBDump
+	r := telemetry.NewReader(&stream)
+	for {
+		v, err := r.Next()
+		if err == io.EOF {
+			break
+		}
+		if err != nil {
+			t.Fatalf("next: %v", err)
+		}
+		if dump.Add(v) {
+			break
+		}
+	}
+	if !dump.Complete || dump.Info.Count != 4 || dump.Info.Reason != telemetry.BBTrigTilt || dump.Info.TriggerTick != 5000 {
+		t.Fatalf("dump header %+v complete=%v", dump.Info, dump.Complete)
+	}
+	if len(dump.Records) != 3 || dump.Missing() != 1 {
+		t.Fatalf("got %d records, %d missing; want 3 and 1", len(dump.Records), dump.Missing())
+	}
+	rec := dump.Records[2]
+	if rec.Index != 3 || rec.Tick != 5001 || rec.Gyro[1] != -16400 || rec.Accel[2] != 10920 {
+		t.Fatalf("record fields %+v", rec)
+	}
+	if rec.PitchDeg != -41.25 || rec.PTerm != -2062 || rec.Left != -1000 || rec.LatencyUs != 312 {
+		t.Fatalf("record values %+v", rec)
+	}
+	if rec.Mode != 3 || rec.Enabled || !dump.Records[0].Enabled {
+		t.Fatalf("mode/enabled %+v", rec)
+	}
+}
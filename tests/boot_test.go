@@ -0,0 +1,244 @@
+package tests
+
+import (
+	"bytes"
+	"encoding/binary"
+	"io"
+	"math/rand"
+	"testing"
+	"time"
+
+	"balancing_robot/internal/boot"
+)
+
+// fakeFirmware is size bytes of Thumb-like code: recurring instruction
+// sequences with some random immediates between them, so it compresses
+// about as well as a real image.
+func fakeFirmware(seed int64, size int) []byte {
+	r := rand.New(rand.NewSource(seed))
+	seqs := make([][]byte, 64)
+	for i := range seqs {
+		seqs[i] = make([]byte, 2*(2+r.Intn(8)))
+		r.Read(seqs[i])
+	}
+	img := make([]byte, 0, size+32)
+	for len(img) < size {
+		img = append(img, seqs[r.Intn(len(seqs))]...)
+		if r.Intn(3) == 0 {
+			img = binary.LittleEndian.AppendUint16(img, uint16(r.Intn(0x10000)))
+		}
+	}
+	return img[:size]
+}
+
+// connect runs tgt behind a pair of pipes, as the robot behind its UART.
+func connect(t *testing.T, tgt *boot.Target) *boot.Uploader {
+	t.Helper()
+	hostR, devW := io.Pipe()
+	devR, hostW := io.Pipe()
+	go tgt.Serve(devR, devW)
+	t.Cleanup(func() {
+		hostW.Close()
+		devW.Close()
+	})
+	u := boot.NewUploader(struct {
+		io.Reader
+		io.Writer
+	}{hostR, hostW})
+	u.Timeout = 200 * time.Millisecond
+	u.CommitTimeout = 200 * time.Millisecond
+	return u
+}
+
+func upload(t *testing.T, u *boot.Uploader, image, previous []byte) (boot.Info, uint8) {
+	t.Helper()
+	if err := u.Enter(); err != nil {
+		t.Fatalf("enter: %v", err)
+	}
+	info, err := u.Hello(time.Second)
+	if err != nil {
+		t.Fatalf("hello: %v", err)
+	}
+	slot := info.UploadSlot()
+	if err := u.Upload(slot, image, previous); err != nil {
+		t.Fatalf("upload: %v", err)
+	}
+	return info, slot
+}
+
+func checkSlot(t *testing.T, tgt *boot.Target, slot uint8, image []byte) {
+	t.Helper()
+	if !bytes.Equal(tgt.Slot[slot][:len(image)], image) {
+		t.Fatalf("slot %d does not hold the image", slot)
+	}
+}
+
+func TestBootUploadFresh(t *testing.T) {
+	appA := fakeFirmware(1, 40000)
+	appB := fakeFirmware(2, 41234)
+	tgt := boot.NewTarget(appA)
+	u := connect(t, tgt)
+
+	info, slot := upload(t, u, appB, nil)
+	if info.Active != 0 || info.State[0] != boot.SlotGood || slot != 1 {
+		t.Fatalf("info %+v, upload slot %d", info, slot)
+	}
+	checkSlot(t, tgt, 1, appB)
+	checkSlot(t, tgt, 0, appA)
+	if tgt.Active != 1 || tgt.State[1] != boot.SlotPending || tgt.Size[1] != uint32(len(appB)) {
+		t.Fatalf("after upload: active %d states %v size %d", tgt.Active, tgt.State, tgt.Size[1])
+	}
+
+	s := u.Stats
+	if s.Pages != 81 || s.Skipped != 0 || s.Sent != 81 || s.Retries != 0 {
+		t.Fatalf("stats %+v", s)
+	}
+	if s.LZ == 0 || s.DataBytes >= len(appB) {
+		t.Fatalf("pages not compressed: %d LZ, %d of %d bytes", s.LZ, s.DataBytes, len(appB))
+	}
+	// The same transfer through MPLAB IPE takes minutes; here it is the
+	// wire time at the XBee's rate plus one round trip per block
+	if wt := s.WireTime(460800); wt > 2*time.Second {
+		t.Fatalf("wire time %v at 460800 baud", wt)
+	}
+	t.Logf("%d bytes in %d data bytes, %v on the wire at 460800 baud", len(appB), s.DataBytes, s.WireTime(460800))
+
+	if err := u.Run(); err != nil {
+		t.Fatalf("run: %v", err)
+	}
+	if started, ok := tgt.Reset(); !ok || started != 1 || tgt.State[1] != boot.SlotTried {
+		t.Fatalf("reset started %d (%v), states %v", started, ok, tgt.State)
+	}
+	tgt.Confirm()
+	if tgt.State[1] != boot.SlotGood {
+		t.Fatalf("states %v after confirm", tgt.State)
+	}
+}
+
+func TestBootUploadSkipsUnchangedPages(t *testing.T) {
+	appA := fakeFirmware(1, 40000)
+	tgt := boot.NewTarget(appA)
+	tgt.Active, tgt.State[1] = 1, boot.SlotGood // slot B running, A inactive
+
+	// A gain change: a few bytes in one page
+	tweaked := append([]byte(nil), appA...)
+	binary.LittleEndian.PutUint32(tweaked[20004:], 0x3F4CCCCD)
+	u := connect(t, tgt)
+	_, slot := upload(t, u, tweaked, nil)
+	if slot != 0 {
+		t.Fatalf("uploaded to slot %d", slot)
+	}
+	checkSlot(t, tgt, 0, tweaked)
+	s := u.Stats
+	if s.Sent != 1 || s.Skipped != s.Pages-1 || s.Blocks != 1 || tgt.Erases != 1 {
+		t.Fatalf("stats %+v, %d erases", s, tgt.Erases)
+	}
+}
+
+func TestBootUploadDelta(t *testing.T) {
+	appA := fakeFirmware(1, 40000)
+	tgt := boot.NewTarget(appA)
+	tgt.Active, tgt.State[1] = 1, boot.SlotGood
+
+	// Code inserted early shifts everything after it: every page changes,
+	// but each is a copy of old bytes a little further back
+	shifted := append(append(append([]byte(nil), appA[:1000]...), fakeFirmware(3, 24)...), appA[1000:]...)
+
+	plain := boot.NewTarget(appA)
+	plain.Active, plain.State[1] = 1, boot.SlotGood
+	up := connect(t, plain)
+	upload(t, up, shifted, nil)
+
+	u := connect(t, tgt)
+	upload(t, u, shifted, appA)
+	checkSlot(t, tgt, 0, shifted)
+	checkSlot(t, plain, 0, shifted)
+	if u.Stats.Sent != up.Stats.Sent {
+		t.Fatalf("sent %d pages with the old image, %d without", u.Stats.Sent, up.Stats.Sent)
+	}
+	if u.Stats.DataBytes*10 > up.Stats.DataBytes {
+		t.Fatalf("delta %d bytes, plain LZ %d bytes", u.Stats.DataBytes, up.Stats.DataBytes)
+	}
+	t.Logf("shifted image: %d bytes as delta, %d bytes LZ only", u.Stats.DataBytes, up.Stats.DataBytes)
+}
+
+func TestBootUploadRetriesBlocks(t *testing.T) {
+	appA := fakeFirmware(1, 40000)
+	appB := fakeFirmware(2, 30000)
+	tgt := boot.NewTarget(appA)
+	tgt.DropData = func(n int) bool { return n == 3 }
+	tgt.FailProgram = 1
+	u := connect(t, tgt)
+
+	upload(t, u, appB, nil)
+	checkSlot(t, tgt, 1, appB)
+	if u.Stats.Retries != 2 {
+		t.Fatalf("%d retries, want 2 (lost frame, flash error)", u.Stats.Retries)
+	}
+}
+
+func TestBootRollback(t *testing.T) {
+	appA := fakeFirmware(1, 40000)
+	appB := fakeFirmware(2, 30000)
+	tgt := boot.NewTarget(appA)
+	u := connect(t, tgt)
+	upload(t, u, appB, nil)
+
+	// The new image starts once but never confirms: the next reset goes
+	// back to slot A
+	if slot, _ := tgt.Reset(); slot != 1 {
+		t.Fatalf("first reset started slot %d", slot)
+	}
+	if slot, ok := tgt.Reset(); !ok || slot != 0 || tgt.State[1] != boot.SlotBad || tgt.Active != 0 {
+		t.Fatalf("second reset started %d (%v), states %v active %d", slot, ok, tgt.State, tgt.Active)
+	}
+
+	// A good image in B, then back to A on request
+	upload(t, u, appB, nil)
+	tgt.Reset()
+	tgt.Confirm()
+	if _, err := u.Hello(time.Second); err != nil {
+		t.Fatalf("hello: %v", err)
+	}
+	slot, err := u.Rollback()
+	if err != nil || slot != 0 {
+		t.Fatalf("rollback to %d: %v", slot, err)
+	}
+	if started, _ := tgt.Reset(); started != 0 {
+		t.Fatalf("started slot %d after rollback", started)
+	}
+}
+
+func TestBootRefusesRunningSlot(t *testing.T) {
+	appA := fakeFirmware(1, 40000)
+	tgt := boot.NewTarget(appA)
+	u := connect(t, tgt)
+	if _, err := u.Hello(time.Second); err != nil {
+		t.Fatalf("hello: %v", err)
+	}
+	if err := u.Upload(0, fakeFirmware(2, 1000), nil); err == nil {
+		t.Fatalf("upload over the active slot accepted")
+	}
+	checkSlot(t, tgt, 0, appA)
+}
+
+func TestBootSlotsHoldTheSameImage(t *testing.T) {
+	appA := fakeFirmware(1, 40000)
+	tgt := boot.NewTarget(appA)
+	u := connect(t, tgt)
+	info, err := u.Hello(time.Second)
+	if err != nil {
+		t.Fatalf("hello: %v", err)
+	}
+	if info.SlotSize != boot.SlotSize {
+		t.Fatalf("bootloader reports %d byte slots, want %d", info.SlotSize, boot.SlotSize)
+	}
+	if err := u.Upload(1, fakeFirmware(2, boot.SlotSize+1), nil); err == nil {
+		t.Fatalf("image larger than a slot accepted")
+	}
+	big := fakeFirmware(2, boot.SlotSize)
+	if err := u.Upload(1, big, nil); err != nil {
+		t.Fatalf("upload of %d bytes to slot B: %v", boot.SlotSize, err)
+	}
+	checkSlot(t, tgt, 1, big)
+}
@@ -0,0 +1,108 @@
+package tests
+
+import (
+	"bytes"
+	"encoding/hex"
+	"math"
+	"testing"
+
+	"balancing_robot/internal/telemetry"
+)
+
+func decodeWire(t *testing.T, wire []byte) interface{} {
+	t.Helper()
+	raw, err := telemetry.COBSDecode(wire[1 : len(wire)-1])
+	if err != nil {
+		t.Fatalf("COBS: %v", err)
+	}
+	v, err := telemetry.Decode(raw)
+	if err != nil {
+		t.Fatalf("decode: %v", err)
+	}
+	return v
+}
+
+func TestChannelsRoundTrip(t *testing.T) {
+	in := telemetry.Channels{Seq: 7, Tick: 123456, Mask: 1<<0 | 1<<3 | 1<<12, Raw: []int16{-1234, 0, 2}}
+	got := decodeWire(t, telemetry.EncodeChannels(in)).(telemetry.Channels)
+	if got.Seq != in.Seq || got.Tick != in.Tick || got.Mask != in.Mask || len(got.Raw) != 3 ||
+		got.Raw[0] != -1234 || got.Raw[1] != 0 || got.Raw[2] != 2 {
+		t.Fatalf("got %+v, want %+v", got, in)
+	}
+
+	// A mask that promises more values than the payload holds
+	short := telemetry.EncodeChannels(telemetry.Channels{Mask: 0x7, Raw: []int16{1, 2}})
+	raw, _ := telemetry.COBSDecode(short[1 : len(short)-1])
+	if _, err := telemetry.Decode(raw); err != telemetry.ErrShort {
+		t.Fatalf("short frame: err %v", err)
+	}
+}
+
+func TestChannelSetNamesValues(t *testing.T) {
+	set := telemetry.NewChannelSet()
+	for _, c := range []telemetry.ChannelInfo{
+		{ID: 0, Div: 100, ReqHz: 50, GrantedHz: 50, Name: "roll"},
+		{ID: 1, Div: 100, ReqHz: 50, GrantedHz: 50, Name: "pitch"},
+		{ID: 12, Div: 1, ReqHz: 50, GrantedHz: 50, Name: "state"},
+	} {
+		info := decodeWire(t, telemetry.EncodeChannelInfo(c)).(telemetry.ChannelInfo)
+		if info != c {
+			t.Fatalf("info %+v, want %+v", info, c)
+		}
+		set.Add(info)
+	}
+
+	// Channel 5 is not described yet and is skipped
+	frame := telemetry.Channels{Mask: 1<<1 | 1<<5 | 1<<12, Raw: []int16{-2865, 99, 2}}
+	vals := set.Values(frame)
+	if len(vals) != 2 || vals[0].Name != "pitch" || math.Abs(vals[0].Value+28.65) > 1e-9 ||
+		vals[1].Name != "state" || vals[1].Value != 2 {
+		t.Fatalf("values %+v", vals)
+	}
+	if _, ok := set.Get(frame, "roll"); ok {
+		t.Fatal("roll was not in the frame")
+	}
+
+	cmd, err := set.SubscribeCommand("state", 500)
+	if err != nil || cmd != "SUB:12,500\n" {
+		t.Fatalf("subscribe %q, %v", cmd, err)
+	}
+	if _, err := set.SubscribeCommand("yaw", 10); err == nil {
+		t.Fatal("unknown channel accepted")
+	}
+}
+
+// Frames written by firmware_sam/src/channels.c on the host
+func TestChannelsFirmwareVectors(t *testing.T) {
+	frame := func(s string) []byte {
+		b, err := hex.DecodeString(s)
+		if err != nil {
+			t.Fatal(err)
+		}
+		return append(append([]byte{0}, b...), 0)
+	}
+
+	plan := decodeWire(t, frame("0201020a027d0103a704010101010102830101010101010101010103a550")).(telemetry.ChanPlan)
+	want := telemetry.ChanPlan{Seq: 1, BudgetBps: 32000, PlannedBps: 1191, Subscribed: 0x83}
+	if plan != want {
+		t.Fatalf("plan %+v, want %+v", plan, want)
+	}
+
+	info := decodeWire(t, frame("0202020902640232023207726f6c6ccb37")).(telemetry.ChannelInfo)
+	if info.ID != 0 || info.Div != 100 || info.ReqHz != 50 || info.GrantedHz != 50 || info.Name != "roll" {
+		t.Fatalf("info %+v", info)
+	}
+
+	data := decodeWire(t, frame("010102080101010283010106c302cff40203bbbf")).(telemetry.Channels)
+	if data.Tick != 0 || data.Mask != 0x83 || len(data.Raw) != 3 {
+		t.Fatalf("data %+v", data)
+	}
+	set := telemetry.NewChannelSet()
+	set.Add(info)
+	if roll, ok := set.Get(data, "roll"); !ok || math.Abs(roll-7.07) > 1e-9 {
+		t.Fatalf("roll %v %v", roll, ok)
+	}
+	if !bytes.Equal(telemetry.EncodeChannels(data), frame("010102080101010283010106c302cff40203bbbf")) {
+		t.Fatal("re-encoded data frame differs")
+	}
+}
@@ -0,0 +1,59 @@
+package tests
+
+import (
+	"bytes"
+	"math"
+	"testing"
+
+	"balancing_robot/internal/imu"
+	"balancing_robot/internal/stream"
+)
+
+func TestFrameMatchesFirmware(t *testing.T) {
+	// The sample firmware/src/imu_bench.c decodes, byte for byte
+	s := imu.Sample{
+		T:     12.3456,
+		Gyro:  [3]float64{0.012345, -0.023456, 0.003456},
+		Accel: [3]float64{0.123456, -0.234567, 9.801234},
+	}
+	want := []byte{0xA5, 0x07, 0x00, 0x61, 0x0C, 0x00, 0xEA, 0xFF, 0x03,
+		0x00, 0x8A, 0x00, 0xFB, 0xFE, 0xA5, 0x2A, 0xFB}
+	if got := stream.EncodeFrame(7, s, "si"); !bytes.Equal(got, want) {
+		t.Fatalf("frame % X, want % X", got, want)
+	}
+}
+
+func TestFrameRoundTrip(t *testing.T) {
+	s := imu.Sample{
+		T:     70.000123,
+		Gyro:  [3]float64{1.5, -30, 0.001},
+		Accel: [3]float64{-9.80665, 0.5, 40},
+	}
+	seq, stamp, got, ok := stream.DecodeFrame(stream.EncodeFrame(200, s, "si"))
+	if !ok || seq != 200 || stamp != uint16(70000123%65536) {
+		t.Fatalf("decode ok=%v seq=%d stamp=%d", ok, seq, stamp)
+	}
+	for i := 0; i < 3; i++ {
+		if math.Abs(got.Gyro[i]-s.Gyro[i]) > 0.5/stream.FrameGyroLSB {
+			t.Fatalf("gyro[%d] %v, want %v", i, got.Gyro[i], s.Gyro[i])
+		}
+	}
+	// 40 m/s^2 is beyond +-3 g and saturates
+	if math.Abs(got.Accel[0]-s.Accel[0]) > 0.5/stream.FrameAccelLSB || got.Accel[2] != 32767/stream.FrameAccelLSB {
+		t.Fatalf("accel %v", got.Accel)
+	}
+
+	deg := s
+	for i := range deg.Gyro {
+		deg.Gyro[i] *= 180 / math.Pi
+	}
+	if !bytes.Equal(stream.EncodeFrame(1, deg, "deg"), stream.EncodeFrame(1, s, "si")) {
+		t.Fatalf("deg/s input encodes differently")
+	}
+
+	f := stream.EncodeFrame(1, s, "si")
+	f[9] ^= 0x01
+	if _, _, _, ok := stream.DecodeFrame(f); ok {
+		t.Fatalf("corrupted frame accepted")
+	}
+}
@@ -0,0 +1,99 @@
+package tests
+
+import (
+	"bytes"
+	"math"
+	"testing"
+	"time"
+
+	"balancing_robot/internal/telemetry"
+)
+
+func TestRCCommandRoundTrip(t *testing.T) {
+	in := telemetry.RCCommand{
+		Seq:        513,
+		HostTimeUs: 123456789,
+		EchoTick:   4990,
+		EchoHoldUs: 8000,
+		Throttle:   -1.5, // clamped
+		Turn:       0.123,
+		Enabled:    true,
+		Mode:       12,
+	}
+	wire := telemetry.EncodeRCCommand(in)
+	if wire[0] != 0 || wire[len(wire)-1] != 0 || bytes.IndexByte(wire[1:len(wire)-1], 0) >= 0 {
+		t.Fatalf("bad framing: % x", wire)
+	}
+	raw, err := telemetry.COBSDecode(wire[1 : len(wire)-1])
+	if err != nil {
+		t.Fatalf("COBS: %v", err)
+	}
+	v, err := telemetry.Decode(raw)
+	if err != nil {
+		t.Fatalf("decode: %v", err)
+	}
+	got := v.(telemetry.RCCommand)
+	want := in
+	want.Throttle = -1
+	if math.Abs(got.Turn-want.Turn) > 1e-9 {
+		t.Fatalf("turn %v, want %v", got.Turn, want.Turn)
+	}
+	got.Turn = want.Turn
+	if got != want {
+		t.Fatalf("got %+v, want %+v", got, want)
+	}
+}
+
+// Ack produced by firmware_sam/src/rc_input.c for command seq 0 stamped
+// host_us=1000, received at tick 5000.
+func TestRCAckFirmwareVector(t *testing.T) {
+	wire := []byte{0x00, 0x01, 0x01, 0x02, 0x06, 0x01, 0x03, 0xE8, 0x03, 0x01, 0x03, 0x88, 0x13, 0x01, 0x03, 0x51, 0x2D, 0x00}
+	r := telemetry.NewReader(bytes.NewReader(wire))
+	v, err := r.Next()
+	if err != nil {
+		t.Fatalf("next: %v", err)
+	}
+	want := telemetry.RCAck{Seq: 0, CmdSeq: 0, HostTimeUs: 1000, Tick: 5000}
+	if v != want {
+		t.Fatalf("got %+v, want %+v", v, want)
+	}
+}
+
+func TestRCSenderRoundTrip(t *testing.T) {
+	t0 := time.Unix(1000, 0)
+	s := telemetry.NewRCSender(t0)
+
+	decode := func(wire []byte) telemetry.RCCommand {
+		raw, err := telemetry.COBSDecode(wire[1 : len(wire)-1])
+		if err != nil {
+			t.Fatalf("COBS: %v", err)
+		}
+		v, err := telemetry.Decode(raw)
+		if err != nil {
+			t.Fatalf("decode: %v", err)
+		}
+		return v.(telemetry.RCCommand)
+	}
+
+	c0 := decode(s.Command(0.2, 0, true, 0, t0.Add(5*time.Millisecond)))
+	if c0.Seq != 0 || c0.HostTimeUs != 5000 || c0.EchoTick != 0 || c0.EchoHoldUs != 0 {
+		t.Fatalf("first command %+v", c0)
+	}
+	rtt := s.Ack(telemetry.RCAck{CmdSeq: 0, HostTimeUs: c0.HostTimeUs, Tick: 777}, t0.Add(17*time.Millisecond))
+	if rtt != 12*time.Millisecond {
+		t.Fatalf("rtt %v, want 12ms", rtt)
+	}
+
+	// The next command echoes the ack's tick and how long it was held
+	c1 := decode(s.Command(0.2, 0, true, 0, t0.Add(25*time.Millisecond)))
+	if c1.Seq != 1 || c1.EchoTick != 777 || c1.EchoHoldUs != 8000 {
+		t.Fatalf("second command %+v", c1)
+	}
+	s.Ack(telemetry.RCAck{CmdSeq: 1, HostTimeUs: c1.HostTimeUs, Tick: 800}, t0.Add(45*time.Millisecond))
+
+	st := s.Stats()
+	if st.Sent != 2 || st.Acked != 2 || st.RTTMin != 12*time.Millisecond ||
+		st.RTTMax != 20*time.Millisecond || st.RTTAvg() != 16*time.Millisecond {
+		t.Fatalf("stats %+v avg %v", st, st.RTTAvg())
+	}
+}
@@ -0,0 +1,90 @@
+package tests
+
+import (
+	"reflect"
+	"strings"
+	"testing"
+
+	"balancing_robot/internal/stackusage"
+)
+
+// Trimmed from arm-none-eabi-gcc -fcallgraph-info=su output
+const ciMain = `graph: { title: "src/main.c"
+node: { title: "src/main.c:task_control" label: "task_control\nsrc/main.c:310:13\n40 bytes (static)" }
+edge: { sourcename: "src/main.c:task_control" targetname: "attitude_update" label: "src/main.c:320:5" }
+edge: { sourcename: "src/main.c:task_control" targetname: "__indirect_call" label: "src/main.c:330:5" }
+node: { title: "attitude_update" label: "attitude_update\nsrc/attitude.h:20:6" shape : ellipse }
+node: { title: "src/main.c:task_led" label: "task_led\nsrc/main.c:600:13\n8 bytes (static)" }
+node: { title: "main" label: "main\nsrc/main.c:720:5\n16 bytes (static)" }
+edge: { sourcename: "main" targetname: "sched_dispatch" label: "src/main.c:760:13" }
+node: { title: "sched_dispatch" label: "sched_dispatch\nsrc/sched.h:32:6" shape : ellipse }
+node: { title: "SysTick_Handler" label: "SysTick_Handler\nsrc/main.c:800:6\n24 bytes (static)" }
+edge: { sourcename: "SysTick_Handler" targetname: "__aeabi_uldivmod" label: "src/main.c:801:5" }
+node: { title: "__aeabi_uldivmod" label: "__aeabi_uldivmod\n<built-in>" shape : ellipse }
+}
+`
+
+const ciRest = `graph: { title: "src/sched.c"
+node: { title: "sched_dispatch" label: "sched_dispatch\nsrc/sched.c:40:6\n24 bytes (static)" }
+node: { title: "__indirect_call" label: "Indirect Call Placeholder" shape : ellipse }
+edge: { sourcename: "sched_dispatch" targetname: "__indirect_call" label: "src/sched.c:60:9" }
+}
+graph: { title: "src/attitude.c"
+node: { title: "attitude_update" label: "attitude_update\nsrc/attitude.c:30:6\n72 bytes (static)" }
+node: { title: "walk" label: "walk\nsrc/attitude.c:90:6\n16 bytes (dynamic,bounded)" }
+edge: { sourcename: "walk" targetname: "walk" label: "src/attitude.c:95:9" }
+node: { title: "Reset_Handler" label: "Reset_Handler\nsrc/startup.c:60:6\n8 bytes (static)" }
+edge: { sourcename: "Reset_Handler" targetname: "main" label: "src/startup.c:80:5" }
+}
+`
+
+func TestStackUsageDepths(t *testing.T) {
+	g := stackusage.NewGraph()
+	for _, ci := range []string{ciMain, ciRest} {
+		if err := g.Parse(strings.NewReader(ci)); err != nil {
+			t.Fatalf("parse: %v", err)
+		}
+	}
+	roots := g.Roots()
+	want := []string{"Reset_Handler", "SysTick_Handler", "src/main.c:task_control", "src/main.c:task_led", "walk"}
+	if !reflect.DeepEqual(roots, want) {
+		t.Fatalf("roots %v, want %v", roots, want)
+	}
+
+	r := g.Analyze(func(name string) bool { return strings.HasPrefix(name, "src/main.c:task_") })
+
+	// Reset_Handler > main > sched_dispatch > (pointer) task_control > attitude_update
+	reset := r["Reset_Handler"]
+	if reset.Depth != 8+16+24+40+72 {
+		t.Fatalf("Reset_Handler depth %d", reset.Depth)
+	}
+	path := []string{"Reset_Handler", "main", "sched_dispatch", "src/main.c:task_control", "attitude_update"}
+	if !reflect.DeepEqual(reset.Path, path) {
+		t.Fatalf("path %v", reset.Path)
+	}
+	if !reset.Indirect || reset.Recursive || reset.Dynamic {
+		t.Fatalf("flags %+v", reset)
+	}
+	// task_control's own pointer call is not expanded a second time
+	if !reflect.DeepEqual(reset.Unknown, []string{"__indirect_call"}) {
+		t.Fatalf("unknown %v", reset.Unknown)
+	}
+
+	irq := r["SysTick_Handler"]
+	if irq.Depth != 24 || !reflect.DeepEqual(irq.Unknown, []string{"__aeabi_uldivmod"}) {
+		t.Fatalf("handler %+v", irq)
+	}
+	if w := r["walk"]; !w.Recursive || !w.Dynamic || w.Depth != 16 {
+		t.Fatalf("walk %+v", w)
+	}
+	if d := stackusage.ByDepth(r); d[0].Name != "Reset_Handler" || d[len(d)-1].Name != "src/main.c:task_led" {
+		t.Fatalf("order %s..%s", d[0].Name, d[len(d)-1].Name)
+	}
+}
+
+func TestStackUsageBadFrame(t *testing.T) {
+	ci := `node: { title: "f" label: "f\na.c:1:1\nlots of bytes" }`
+	if err := stackusage.NewGraph().Parse(strings.NewReader(ci)); err == nil {
+		t.Fatalf("want an error for an unreadable frame size")
+	}
+}
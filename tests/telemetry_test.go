@@ -0,0 +1,179 @@
+package tests
+
+import (
+	"bytes"
+	"io"
+	"math"
+	"testing"
+	"time"
+
+	"balancing_robot/internal/telemetry"
+)
+
+func TestTelemetryCRC16(t *testing.T) {
+	if got := telemetry.CRC16([]byte("123456789")); got != 0x29B1 {
+		t.Fatalf("CRC16 check value 0x%04X, want 0x29B1", got)
+	}
+}
+
+func TestTelemetryCOBSRoundTrip(t *testing.T) {
+	cases := [][]byte{
+		{},
+		{0},
+		{0, 0},
+		{1, 2, 0, 3},
+		bytes.Repeat([]byte{0xAA}, 254),
+		bytes.Repeat([]byte{0xAA}, 600),
+		append(bytes.Repeat([]byte{7}, 300), 0, 0, 9),
+	}
+	for i, raw := range cases {
+		enc := telemetry.COBSEncode(raw)
+		if bytes.IndexByte(enc, 0) >= 0 {
+			t.Fatalf("case %d: encoding contains zero", i)
+		}
+		dec, err := telemetry.COBSDecode(enc)
+		if err != nil {
+			t.Fatalf("case %d: decode: %v", i, err)
+		}
+		if !bytes.Equal(dec, raw) {
+			t.Fatalf("case %d: round trip mismatch", i)
+		}
+	}
+}
+
+// Bytes produced by firmware_sam/src/telemetry.c for seq 0, a STATE frame
+// starting tick=1000, roll=-12.345 deg, pitch=0, pitch rate saturated.
+func TestTelemetryFirmwareVector(t *testing.T) {
+	wire := []byte{0x01, 0x01, 0x04, 0x01, 0xE8, 0x03, 0x01, 0x03, 0x2D, 0xFB, 0x01, 0x05, 0xFF, 0x7F, 0x0C, 0x1C}
+	raw, err := telemetry.COBSDecode(wire)
+	if err != nil {
+		t.Fatalf("decode: %v", err)
+	}
+	body := raw[:len(raw)-2]
+	crc := uint16(raw[len(raw)-2]) | uint16(raw[len(raw)-1])<<8
+	if telemetry.CRC16(body) != crc {
+		t.Fatalf("CRC mismatch: 0x%04X vs 0x%04X", telemetry.CRC16(body), crc)
+	}
+	if int16(uint16(body[7])|uint16(body[8])<<8) != -1235 {
+		t.Fatalf("roll field %v", body[7:9])
+	}
+}
+
+func TestTelemetryStateRoundTrip(t *testing.T) {
+	want := telemetry.State{
+		Seq: 513, Tick: 123456, RollDeg: 1.23, PitchDeg: -4.56, PitchRateDps: -250.3,
+		TargetPitchDeg: -25, Balance: 812, Left: -1000, Right: 1000, State: 2, Mode: 12, Enabled: true,
+	}
+	v, err := telemetry.NewReader(bytes.NewReader(telemetry.EncodeState(want))).Next()
+	if err != nil {
+		t.Fatalf("next: %v", err)
+	}
+	got, ok := v.(telemetry.State)
+	if !ok {
+		t.Fatalf("got %T, want State", v)
+	}
+	near := func(a, b, tol float64) bool { return math.Abs(a-b) <= tol }
+	if got.Seq != want.Seq || got.Tick != want.Tick || got.State != want.State ||
+		got.Mode != want.Mode || got.Enabled != want.Enabled {
+		t.Fatalf("header fields %+v, want %+v", got, want)
+	}
+	if !near(got.RollDeg, want.RollDeg, 0.005) || !near(got.PitchDeg, want.PitchDeg, 0.005) ||
+		!near(got.PitchRateDps, want.PitchRateDps, 0.05) || !near(got.TargetPitchDeg, want.TargetPitchDeg, 0.005) {
+		t.Fatalf("angles %+v, want %+v", got, want)
+	}
+	if got.Balance != want.Balance || got.Left != want.Left || got.Right != want.Right {
+		t.Fatalf("motor fields %+v, want %+v", got, want)
+	}
+	if !near(got.TimeS(), 123.456, 1e-9) {
+		t.Fatalf("time %.6f", got.TimeS())
+	}
+}
+
+func TestTelemetryShutdownRoundTrip(t *testing.T) {
+	want := telemetry.Shutdown{
+		Seq: 7, RetractTick: 1000, LowerTick: 52000, LeanTick: 52400, OffTick: 52700,
+		LeanPitch: 1.25, OffPitch: -3.5,
+	}
+	v, err := telemetry.NewReader(bytes.NewReader(telemetry.EncodeShutdown(want))).Next()
+	if err != nil {
+		t.Fatalf("next: %v", err)
+	}
+	got, ok := v.(telemetry.Shutdown)
+	if !ok {
+		t.Fatalf("got %T, want Shutdown", v)
+	}
+	if got != want {
+		t.Fatalf("got %+v, want %+v", got, want)
+	}
+	if got.ArmTravel() != 400*time.Millisecond {
+		t.Fatalf("arm travel %v", got.ArmTravel())
+	}
+}
+
+func TestTelemetryRAMRoundTrip(t *testing.T) {
+	want := telemetry.RAM{
+		Seq: 9, Data: 1480, BSS: 23104, Free: 221504, NoInit: 64,
+		Stack: 16368, StackUsed: 2712, Faults: 1, FaultAddr: 0x2003BF7C,
+	}
+	v, err := telemetry.NewReader(bytes.NewReader(telemetry.EncodeRAM(want))).Next()
+	if err != nil {
+		t.Fatalf("next: %v", err)
+	}
+	got, ok := v.(telemetry.RAM)
+	if !ok {
+		t.Fatalf("got %T, want RAM", v)
+	}
+	if got != want {
+		t.Fatalf("got %+v, want %+v", got, want)
+	}
+	if got.StackHeadroom() != 16368-2712 {
+		t.Fatalf("headroom %d", got.StackHeadroom())
+	}
+}
+
+func TestTelemetryReaderResync(t *testing.T) {
+	var stream bytes.Buffer
+	stream.WriteString("SAME51 Balancing Robot Ready\r\n")
+	stream.Write(telemetry.EncodeState(telemetry.State{Seq: 10}))
+	stream.Write([]byte{0x13, 0x37}) // line noise before the next delimiter
+	bad := telemetry.EncodeState(telemetry.State{Seq: 11, PitchDeg: 3})
+	bad[5] ^= 0x40
+	stream.Write(bad)
+	stream.WriteString("MS OK\r\n")
+	stream.Write(telemetry.EncodeStatus(telemetry.Status{Seq: 14, Missed: 3, DrvStatus: [2]uint32{0xC0000000, 0}, RxDropped: 9}))
+
+	r := telemetry.NewReader(&stream)
+	var items []interface{}
+	for {
+		v, err := r.Next()
+		if err == io.EOF {
+			break
+		}
+		if err != nil {
+			t.Fatalf("next: %v", err)
+		}
+		items = append(items, v)
+	}
+	if len(items) != 4 {
+		t.Fatalf("got %d items: %#v", len(items), items)
+	}
+	if s, ok := items[0].(string); !ok || s != "SAME51 Balancing Robot Ready\r\n" {
+		t.Fatalf("item 0 %#v", items[0])
+	}
+	if s, ok := items[1].(telemetry.State); !ok || s.Seq != 10 {
+		t.Fatalf("item 1 %#v", items[1])
+	}
+	if s, ok := items[2].(string); !ok || s != "MS OK\r\n" {
+		t.Fatalf("item 2 %#v", items[2])
+	}
+	st, ok := items[3].(telemetry.Status)
+	if !ok || st.Missed != 3 || st.DrvStatus[0] != 0xC0000000 || st.RxDropped != 9 {
+		t.Fatalf("item 3 %#v", items[3])
+	}
+	if r.Stats.Frames != 2 || r.Stats.Lost != 3 {
+		t.Fatalf("stats %+v, want 2 frames, 3 lost", r.Stats)
+	}
+	if r.Stats.CRCErrors+r.Stats.Malformed != 2 {
+		t.Fatalf("stats %+v, want two bad chunks", r.Stats)
+	}
+}